@@ -0,0 +1,233 @@
+#include "AssetArchive.h"
+
+#include <cstring>      // strncmp and memcpy
+#include <fstream>      // Archive writing
+#include <algorithm>    // sort and lower_bound
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>    // File mapping
+#else
+    #include <fcntl.h>      // open
+    #include <unistd.h>     // close
+    #include <sys/mman.h>   // mmap
+    #include <sys/stat.h>   // fstat
+#endif
+
+// Every blob starts on this boundary so GPU data can be read straight from the mapping
+const size_t ARCHIVE_ALIGNMENT = 64;
+
+const char ARCHIVE_MAGIC[4] = { 'C', 'P', 'A', 'K' };
+const uint32_t ARCHIVE_VERSION = 3;
+
+// File header: magic, version, entry count, then the offset of the table of contents
+struct ArchiveHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+    uint64_t tocOffset;
+};
+
+AssetArchive::~AssetArchive()
+{
+    close();
+}
+
+// Map the whole archive read-only and validate its table of contents
+// Blobs returned by find point into the mapping and stay valid until the archive is closed
+bool AssetArchive::open(const char* filename)
+{
+    close();
+
+    #ifdef _WIN32
+        HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER fileSize;
+        HANDLE mapping = NULL;
+
+        if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+            mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+        if (mapping == NULL)
+        {
+            CloseHandle(file);
+            return false;
+        }
+
+        fileHandle = file;
+        mappingHandle = mapping;
+        mapped = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        mappedSize = (size_t)fileSize.QuadPart;
+    #else
+        fileDescriptor = ::open(filename, O_RDONLY);
+
+        if (fileDescriptor < 0)
+            return false;
+
+        struct stat fileStatus;
+
+        if (fstat(fileDescriptor, &fileStatus) == 0 && fileStatus.st_size > 0)
+        {
+            void* view = mmap(NULL, (size_t)fileStatus.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+
+            if (view != MAP_FAILED)
+            {
+                mapped = (const uint8_t*)view;
+                mappedSize = (size_t)fileStatus.st_size;
+            }
+        }
+    #endif
+
+    if (mapped == nullptr)
+    {
+        close();
+        return false;
+    }
+
+    // Check the header and that the table of contents and every blob lie inside the file
+    const ArchiveHeader* header = (const ArchiveHeader*)mapped;
+    bool valid = mappedSize >= sizeof(ArchiveHeader) && memcmp(header->magic, ARCHIVE_MAGIC, 4) == 0 && header->version == ARCHIVE_VERSION &&
+        header->tocOffset <= mappedSize && header->entryCount <= (mappedSize - header->tocOffset) / sizeof(TocEntry);
+
+    if (valid)
+    {
+        toc = (const TocEntry*)(mapped + header->tocOffset);
+        tocCount = header->entryCount;
+
+        for (size_t i = 0; i < tocCount && valid; i++)
+            valid = toc[i].offset <= mappedSize && toc[i].size <= mappedSize - toc[i].offset && toc[i].name[sizeof(toc[i].name) - 1] == '\0';
+    }
+
+    if (!valid)
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+// Unmap the archive; every pointer handed out by find becomes invalid
+void AssetArchive::close()
+{
+    #ifdef _WIN32
+        if (mapped)
+            UnmapViewOfFile(mapped);
+
+        if (mappingHandle)
+            CloseHandle((HANDLE)mappingHandle);
+
+        if (fileHandle)
+            CloseHandle((HANDLE)fileHandle);
+
+        fileHandle = nullptr;
+        mappingHandle = nullptr;
+    #else
+        if (mapped)
+            munmap((void*)mapped, mappedSize);
+
+        if (fileDescriptor >= 0)
+            ::close(fileDescriptor);
+
+        fileDescriptor = -1;
+    #endif
+
+    mapped = nullptr;
+    mappedSize = 0;
+    toc = nullptr;
+    tocCount = 0;
+}
+
+bool AssetArchive::isOpen() const
+{
+    return mapped != nullptr;
+}
+
+// Look up a blob by name with a binary search of the table of contents; returns nullptr when the archive has no such blob
+const uint8_t* AssetArchive::find(const char* name, size_t& size) const
+{
+    const TocEntry* end = toc + tocCount;
+    const TocEntry* entry = lower_bound(toc, end, name, [](const TocEntry& tocEntry, const char* key) {
+        return strncmp(tocEntry.name, key, sizeof(tocEntry.name)) < 0;
+    });
+
+    if (entry == end || strncmp(entry->name, name, sizeof(entry->name)) != 0)
+        return nullptr;
+
+    size = (size_t)entry->size;
+
+    return mapped + entry->offset;
+}
+
+// The whole mapping
+const uint8_t* AssetArchive::data() const
+{
+    return mapped;
+}
+
+size_t AssetArchive::size() const
+{
+    return mappedSize;
+}
+
+size_t AssetArchive::entryCount() const
+{
+    return tocCount;
+}
+
+// Write the entries as an archive: the header, the table of contents sorted by name, then every blob on an aligned offset
+// Names longer than the table of contents allows are rejected
+bool AssetArchive::write(const char* filename, vector<ArchiveEntry>& entries)
+{
+    sort(entries.begin(), entries.end(), [](const ArchiveEntry& a, const ArchiveEntry& b) { return a.name < b.name; });
+
+    ArchiveHeader header;
+    memcpy(header.magic, ARCHIVE_MAGIC, 4);
+    header.version = ARCHIVE_VERSION;
+    header.entryCount = (uint32_t)entries.size();
+    header.reserved = 0;
+    header.tocOffset = sizeof(ArchiveHeader);
+
+    // Lay out the blobs after the table of contents
+    vector<TocEntry> tocEntries(entries.size());
+    uint64_t offset = header.tocOffset + sizeof(TocEntry) * entries.size();
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (entries[i].name.size() >= sizeof(tocEntries[i].name))
+            return false;
+
+        memset(tocEntries[i].name, 0, sizeof(tocEntries[i].name));
+        memcpy(tocEntries[i].name, entries[i].name.c_str(), entries[i].name.size());
+
+        offset = (offset + ARCHIVE_ALIGNMENT - 1) / ARCHIVE_ALIGNMENT * ARCHIVE_ALIGNMENT;
+        tocEntries[i].offset = offset;
+        tocEntries[i].size = entries[i].data.size();
+        offset += entries[i].data.size();
+    }
+
+    ofstream file(filename, ios::binary | ios::trunc);
+
+    if (!file)
+        return false;
+
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)tocEntries.data(), sizeof(TocEntry) * tocEntries.size());
+
+    const char padding[ARCHIVE_ALIGNMENT] = {};
+    uint64_t written = header.tocOffset + sizeof(TocEntry) * entries.size();
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        file.write(padding, (streamsize)(tocEntries[i].offset - written));
+        file.write((const char*)entries[i].data.data(), (streamsize)entries[i].data.size());
+        written = tocEntries[i].offset + entries[i].data.size();
+    }
+
+    return (bool)file;
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#ifndef ASSET_ARCHIVE_H
+#define ASSET_ARCHIVE_H
+
+using namespace std;
+
+// One named blob to write into an archive
+struct ArchiveEntry {
+    string name;
+    vector<uint8_t> data;
+};
+
+class AssetArchive {
+public:
+    ~AssetArchive();
+    bool open(const char* filename);
+    void close();
+    bool isOpen() const;
+    const uint8_t* find(const char* name, size_t& size) const;
+    const uint8_t* data() const;
+    size_t size() const;
+    size_t entryCount() const;
+    static bool write(const char* filename, vector<ArchiveEntry>& entries);
+
+private:
+    // Table of contents entry as stored in the file; the table is sorted by name
+    struct TocEntry {
+        char name[48];
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    const uint8_t* mapped = nullptr;
+    size_t mappedSize = 0;
+    const TocEntry* toc = nullptr;
+    size_t tocCount = 0;
+
+    #ifdef _WIN32
+        void* fileHandle = nullptr;
+        void* mappingHandle = nullptr;
+    #else
+        int fileDescriptor = -1;
+    #endif
+};
+
+#endif
\ No newline at end of file
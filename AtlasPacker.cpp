@@ -0,0 +1,97 @@
+#include "AtlasPacker.h"
+
+#include <algorithm>
+#include <numeric>
+
+// Place every rectangle in a page of the given size with the skyline bottom-left heuristic
+// Rectangles are placed tallest first, each at the position that keeps its top lowest; returns false when they do not all fit
+bool AtlasPacker::pack(vector<AtlasRect>& rects, int width, int height)
+{
+    pageWidth = width, pageHeight = height;
+    skyline.assign(1, { 0, 0, width });
+
+    vector<size_t> order(rects.size());
+    iota(order.begin(), order.end(), 0);
+
+    stable_sort(order.begin(), order.end(), [&rects](size_t a, size_t b) {
+        return rects[a].height != rects[b].height ? rects[a].height > rects[b].height : rects[a].width > rects[b].width;
+    });
+
+    for (size_t i : order)
+    {
+        size_t node;
+
+        if (!findPosition(rects[i].width, rects[i].height, rects[i].x, rects[i].y, node))
+            return false;
+
+        addRect(node, rects[i].x, rects[i].y, rects[i].width, rects[i].height);
+    }
+
+    return true;
+}
+
+// Find the skyline node where the rectangle rests lowest, preferring the narrower node on a tie to leave wide gaps for wide rectangles
+bool AtlasPacker::findPosition(int width, int height, int& x, int& y, size_t& node) const
+{
+    int bestTop = pageHeight + 1, bestWidth = pageWidth + 1;
+
+    for (size_t i = 0; i < skyline.size(); i++)
+    {
+        if (skyline[i].x + width > pageWidth)
+            break;
+
+        // The rectangle rests on the highest node it spans
+        int restY = 0;
+        int spanned = 0;
+
+        for (size_t j = i; spanned < width; j++)
+        {
+            restY = max(restY, skyline[j].y);
+            spanned += skyline[j].width;
+        }
+
+        int top = restY + height;
+
+        if (top <= pageHeight && (top < bestTop || (top == bestTop && skyline[i].width < bestWidth)))
+        {
+            bestTop = top, bestWidth = skyline[i].width;
+            x = skyline[i].x, y = restY, node = i;
+        }
+    }
+
+    return bestTop <= pageHeight;
+}
+
+// Raise the skyline over the placed rectangle, trimming the nodes it covers and merging nodes of the same height
+void AtlasPacker::addRect(size_t node, int x, int y, int width, int height)
+{
+    skyline.insert(skyline.begin() + node, { x, y + height, width });
+
+    for (size_t i = node + 1; i < skyline.size();)
+    {
+        int covered = x + width - skyline[i].x;
+
+        if (covered <= 0)
+            break;
+
+        if (covered < skyline[i].width)
+        {
+            skyline[i].x += covered;
+            skyline[i].width -= covered;
+            break;
+        }
+
+        skyline.erase(skyline.begin() + i);
+    }
+
+    for (size_t i = 0; i + 1 < skyline.size();)
+    {
+        if (skyline[i].y == skyline[i + 1].y)
+        {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+        }
+        else
+            i++;
+    }
+}
\ No newline at end of file
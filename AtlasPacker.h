@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#ifndef ATLAS_PACKER_H
+#define ATLAS_PACKER_H
+
+using namespace std;
+
+// A rectangle to place in an atlas page; the packer fills in its position
+struct AtlasRect {
+    int width;
+    int height;
+    int x = 0;
+    int y = 0;
+};
+
+class AtlasPacker {
+public:
+    bool pack(vector<AtlasRect>& rects, int pageWidth, int pageHeight);
+
+private:
+    // One horizontal segment of the skyline: the top of everything packed below it
+    struct SkylineNode {
+        int x;
+        int y;
+        int width;
+    };
+
+    bool findPosition(int width, int height, int& x, int& y, size_t& node) const;
+    void addRect(size_t node, int x, int y, int width, int height);
+
+    vector<SkylineNode> skyline;
+    int pageWidth = 0;
+    int pageHeight = 0;
+};
+
+#endif
\ No newline at end of file
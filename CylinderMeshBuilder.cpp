@@ -1,5 +1,10 @@
 #include "CylinderMeshBuilder.h"
 
+#include <thread>       // Batch building across threads
+#include <algorithm>    // min
+#include <functional>   // cref
+#include <xmmintrin.h>  // SSE intrinsics
+
 // Builds the vertices for the sides of an n-prism mesh (without the bottom and top faces)
 // Example: 4 slices results in a rectangular prism, 6 slices results in a hexagonal prism, 60 slices will virtually result in a cylinder
 void CylinderMeshBuilder::buildSideMesh(vector<GLfloat>& vertices, int slices, float radius, float height)
@@ -185,4 +190,264 @@ void CylinderMeshBuilder::buildFaceMesh(vector<GLfloat>& vertices, bool isTopFac
         // Center Vertex: Texture Coordinate - Center of texture
         vertices.push_back(0.5f), vertices.push_back(0.5f);
     }
+}
+
+// Builds the vertices for a complete capped cylinder: the side with the top face at the given height and the bottom face at the origin
+// Either face can be left out when it is hidden by another mesh
+void CylinderMeshBuilder::buildCappedMesh(vector<GLfloat>& vertices, int slices, float radius, float height, bool hasTopFace, bool hasBottomFace)
+{
+    // Floats per vertex: Position (X, Y, Z) - Normal (nX, nY, nZ) - Texture Coordinate (tX, tY)
+    const size_t floatsPerVertex = 8;
+
+    // Build the side of the cylinder
+    buildSideMesh(vertices, slices, radius, height);
+
+    // Build the top face and move it from the origin up to the top of the side
+    if (hasTopFace)
+    {
+        size_t topStart = vertices.size();
+        buildFaceMesh(vertices, true, slices, radius);
+
+        for (size_t i = topStart; i < vertices.size(); i += floatsPerVertex)
+            vertices[i + 1] += height;
+    }
+
+    // Build the bottom face at the origin
+    if (hasBottomFace)
+        buildFaceMesh(vertices, false, slices, radius);
+}
+
+// Builds the vertices for capped cylinders stacked on top of each other along the +Y axis as one mesh
+// Every vertex carries the texture array layer of its part and the layer of its decal (-1 for no decal) after its texture coordinate
+void CylinderMeshBuilder::buildStackedMesh(vector<GLfloat>& vertices, const vector<CylinderStackPart>& parts, int slices)
+{
+    // Floats per vertex: Position (X, Y, Z) - Normal (nX, nY, nZ) - Texture Coordinate (tX, tY)
+    const size_t floatsPerVertex = 8;
+
+    // Each part starts where the part below it ends
+    float baseHeight = 0.0f;
+
+    for (const CylinderStackPart& part : parts)
+    {
+        // Build each face of the part separately so its vertices can be tagged with the matching texture layers
+        vector<GLfloat> side, top, bottom;
+        buildSideMesh(side, slices, part.radius, part.height);
+
+        if (part.hasTopFace)
+            buildFaceMesh(top, true, slices, part.radius);
+
+        if (part.hasBottomFace)
+            buildFaceMesh(bottom, false, slices, part.radius);
+
+        const vector<GLfloat>* faces[] = { &side, &top, &bottom };
+        float faceHeights[] = { baseHeight, baseHeight + part.height, baseHeight }; // The top face sits on top of the side
+        float layers[] = { part.sideLayer, part.topLayer, part.bottomLayer };
+        float decalLayers[] = { part.decalLayer, -1.0f, -1.0f }; // Decals are only applied to the side
+
+        for (int face = 0; face < 3; face++)
+        {
+            for (size_t i = 0; i < faces[face]->size(); i += floatsPerVertex)
+            {
+                // Vertex: Position (X, Y, Z) - Normal (nX, nY, nZ) - Texture Coordinate (tX, tY) - Texture Layers (layer, decal layer)
+                vertices.insert(vertices.end(), faces[face]->begin() + i, faces[face]->begin() + i + floatsPerVertex);
+                vertices[vertices.size() - floatsPerVertex + 1] += faceHeights[face];
+                vertices.push_back(layers[face]), vertices.push_back(decalLayers[face]);
+            }
+        }
+
+        baseHeight += part.height;
+    }
+}
+
+// Number of cylinders whose positions are computed together in one SSE register
+const int BATCH_LANES = 4;
+
+// Floats per vertex: Position (X, Y, Z) - Normal (nX, nY, nZ) - Texture Coordinate (tX, tY)
+const int BATCH_FLOATS_PER_VERTEX = 8;
+
+// Each slice of a cylinder side is two triangles
+const int BATCH_VERTICES_PER_SLICE = 6;
+
+// Batches with fewer vertices than this are built on the calling thread
+const GLuint BATCH_THREAD_THRESHOLD = 1 << 18;
+
+// Writes one interleaved vertex of a cylinder side
+static inline GLfloat* writeSideVertex(GLfloat* out, float x, float y, float z, float nX, float nZ, float tX, float tY)
+{
+    out[0] = x, out[1] = y, out[2] = z;
+    out[3] = nX, out[4] = 0.0f, out[5] = nZ;
+    out[6] = tX, out[7] = tY;
+
+    return out + BATCH_FLOATS_PER_VERTEX;
+}
+
+// Builds the side meshes of many cylinders with individual slice counts, radii, and heights in one call
+// The parameters are parallel arrays, but the output is interleaved per vertex like every other builder's; cylinder i occupies
+// vertices [offsets[i], offsets[i + 1]) of the one contiguous vertex vector
+// Each cylinder's vertices are identical to the output of buildSideMesh for the same parameters; a cylinder with no slices has no vertices
+// Returns false without building anything when the parameter arrays differ in length
+bool CylinderMeshBuilder::buildSideMeshBatch(vector<GLfloat>& vertices, vector<GLuint>& offsets, const vector<int>& slices,
+    const vector<float>& radii, const vector<float>& heights)
+{
+    if (radii.size() != slices.size() || heights.size() != slices.size())
+        return false;
+
+    int count = (int)slices.size();
+
+    // Build the offset table so every cylinder knows where its vertices start before anything is written
+    offsets.assign(count + 1, 0);
+
+    for (int i = 0; i < count; i++)
+        offsets[i + 1] = offsets[i] + max(slices[i], 0) * BATCH_VERTICES_PER_SLICE;
+
+    // Size the output once; the cylinders are written in place instead of appended
+    size_t firstFloat = vertices.size();
+    vertices.resize(firstFloat + (size_t)offsets[count] * BATCH_FLOATS_PER_VERTEX);
+
+    // Compute the unit circle once for each distinct slice count; cos and sin of (i * theta) for i = 0 to slices
+    map<int, vector<float>> trigTables;
+
+    for (int i = 0; i < count; i++)
+    {
+        // A cylinder with no slices has no angle between them
+        if (slices[i] < 1)
+            continue;
+
+        vector<float>& table = trigTables[slices[i]];
+
+        if (!table.empty())
+            continue;
+
+        // The vertex angle for each triangle slice in radians, calculated exactly as buildSideMesh does
+        float theta = (360.0 / slices[i]) * (M_PI / 180.0f);
+
+        table.resize(2 * (slices[i] + 1));
+
+        for (int j = 0; j <= slices[i]; j++)
+            table[2 * j] = cos(j * theta), table[2 * j + 1] = sin(j * theta);
+    }
+
+    // Group consecutive cylinders that share a slice count so they can be processed in SIMD lanes
+    // Cylinders with no slices share a group with the cylinders around them only when those have no slices either
+    vector<int> groupStarts;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (groupStarts.empty() || i - groupStarts.back() == BATCH_LANES || max(slices[i], 0) != max(slices[groupStarts.back()], 0))
+            groupStarts.push_back(i);
+    }
+
+    int groupCount = (int)groupStarts.size();
+    groupStarts.push_back(count);
+
+    GLfloat* output = vertices.data() + firstFloat;
+
+    // Small batches are not worth the cost of starting threads
+    unsigned int threadCount = thread::hardware_concurrency();
+
+    if (offsets[count] < BATCH_THREAD_THRESHOLD || threadCount < 2 || groupCount < 2)
+    {
+        buildSideMeshGroups(output, offsets, slices, radii, heights, trigTables, groupStarts, 0, groupCount);
+        return true;
+    }
+
+    threadCount = min(threadCount, (unsigned int)groupCount);
+
+    // Split the groups into contiguous ranges holding roughly the same number of vertices
+    vector<thread> workers;
+    GLuint verticesPerThread = offsets[count] / threadCount;
+    int firstGroup = 0;
+
+    for (unsigned int t = 0; t < threadCount && firstGroup < groupCount; t++)
+    {
+        int lastGroup = firstGroup + 1;
+
+        if (t == threadCount - 1)
+            lastGroup = groupCount;
+        else
+        {
+            while (lastGroup < groupCount && offsets[groupStarts[lastGroup]] < (t + 1) * verticesPerThread)
+                lastGroup++;
+        }
+
+        // Every range writes to its own slice of the output, so the threads need no synchronization
+        workers.emplace_back(&CylinderMeshBuilder::buildSideMeshGroups, this, output, cref(offsets), cref(slices), cref(radii),
+            cref(heights), cref(trigTables), cref(groupStarts), firstGroup, lastGroup);
+
+        firstGroup = lastGroup;
+    }
+
+    for (thread& worker : workers)
+        worker.join();
+
+    return true;
+}
+
+// Builds the side meshes for the cylinder groups [firstGroup, lastGroup) of a batch
+// The positions of up to four cylinders in a group are computed together, one cylinder per SSE lane
+void CylinderMeshBuilder::buildSideMeshGroups(GLfloat* vertices, const vector<GLuint>& offsets, const vector<int>& slices, const vector<float>& radii,
+    const vector<float>& heights, const map<int, vector<float>>& trigTables, const vector<int>& groupStarts, int firstGroup, int lastGroup)
+{
+    // Per-slice X and Z coordinates of every lane; reused between groups
+    vector<float> ringX, ringZ;
+
+    for (int group = firstGroup; group < lastGroup; group++)
+    {
+        int first = groupStarts[group];
+        int lanes = groupStarts[group + 1] - first;
+        int groupSlices = slices[first];
+
+        // Nothing to write for cylinders without slices
+        if (groupSlices < 1)
+            continue;
+
+        const vector<float>& table = trigTables.at(groupSlices);
+
+        // Unused lanes get a zero radius and are never written out
+        alignas(16) float laneRadii[BATCH_LANES] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+        for (int lane = 0; lane < lanes; lane++)
+            laneRadii[lane] = radii[first + lane];
+
+        __m128 radius = _mm_load_ps(laneRadii);
+
+        ringX.resize((size_t)(groupSlices + 1) * BATCH_LANES);
+        ringZ.resize((size_t)(groupSlices + 1) * BATCH_LANES);
+
+        // Scale the unit circle by the radius of every lane at once
+        for (int i = 0; i <= groupSlices; i++)
+        {
+            _mm_storeu_ps(&ringX[i * BATCH_LANES], _mm_mul_ps(radius, _mm_set1_ps(table[2 * i])));
+            _mm_storeu_ps(&ringZ[i * BATCH_LANES], _mm_mul_ps(radius, _mm_set1_ps(table[2 * i + 1])));
+        }
+
+        // Divide the texture into vertical sections corresponding to the number of slices
+        float textureSectionLength = 1.0f / groupSlices;
+
+        for (int lane = 0; lane < lanes; lane++)
+        {
+            float height = heights[first + lane];
+            GLfloat* out = vertices + (size_t)offsets[first + lane] * BATCH_FLOATS_PER_VERTEX;
+
+            // Build a rectangle for each side of the prism with the same vertex order as buildSideMesh
+            for (int i = 0; i < groupSlices; i++)
+            {
+                float x0 = ringX[i * BATCH_LANES + lane], z0 = ringZ[i * BATCH_LANES + lane];
+                float x1 = ringX[(i + 1) * BATCH_LANES + lane], z1 = ringZ[(i + 1) * BATCH_LANES + lane];
+                float nX0 = table[2 * i], nZ0 = table[2 * i + 1];
+                float nX1 = table[2 * (i + 1)], nZ1 = table[2 * (i + 1) + 1];
+                float tX0 = i * textureSectionLength, tX1 = (i + 1) * textureSectionLength;
+
+                // Side Triangle One: Vertex i top, vertex i bottom, vertex (i + 1) top
+                out = writeSideVertex(out, x0, height, z0, nX0, nZ0, tX0, 1.0f);
+                out = writeSideVertex(out, x0, 0.0f, z0, nX0, nZ0, tX0, 0.0f);
+                out = writeSideVertex(out, x1, height, z1, nX1, nZ1, tX1, 1.0f);
+
+                // Side Triangle Two: Vertex i bottom, vertex (i + 1) top, vertex (i + 1) bottom
+                out = writeSideVertex(out, x0, 0.0f, z0, nX0, nZ0, tX0, 0.0f);
+                out = writeSideVertex(out, x1, height, z1, nX1, nZ1, tX1, 1.0f);
+                out = writeSideVertex(out, x1, 0.0f, z1, nX1, nZ1, tX1, 0.0f);
+            }
+        }
+    }
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #define _USE_MATH_DEFINES
 
 #include <vector>
+#include <map>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
@@ -11,10 +12,30 @@
 
 using namespace std;
 
+// One capped cylinder of a stacked mesh and the texture array layers used by each of its parts
+struct CylinderStackPart {
+    float radius;
+    float height;
+    bool hasTopFace;
+    bool hasBottomFace;
+    float sideLayer;
+    float topLayer;
+    float bottomLayer;
+    float decalLayer; // Texture array layer of the side decal; -1 for no decal
+};
+
 class CylinderMeshBuilder {
     public:
         void buildSideMesh(vector<GLfloat>& vertices, int slices, float radius, float height);
         void buildFaceMesh(vector<GLfloat>& vertices, bool isTopFace, int slices, float radius);
+        void buildCappedMesh(vector<GLfloat>& vertices, int slices, float radius, float height, bool hasTopFace = true, bool hasBottomFace = true);
+        void buildStackedMesh(vector<GLfloat>& vertices, const vector<CylinderStackPart>& parts, int slices);
+        bool buildSideMeshBatch(vector<GLfloat>& vertices, vector<GLuint>& offsets, const vector<int>& slices,
+            const vector<float>& radii, const vector<float>& heights);
+
+    private:
+        void buildSideMeshGroups(GLfloat* vertices, const vector<GLuint>& offsets, const vector<int>& slices, const vector<float>& radii,
+            const vector<float>& heights, const map<int, vector<float>>& trigTables, const vector<int>& groupStarts, int firstGroup, int lastGroup);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,32 @@
+#include "DecalCompositor.h"
+
+#include <cstring>
+#include <emmintrin.h>  // SSE2
+
+// Replace every RGBA8 texel of the base image whose decal texel has an alpha above the threshold with the decal texel
+// This is the decal test the object shader used to run per fragment, done once over the pixels: four texels per SSE2 register,
+// the alpha of each shifted down to compare as a 32-bit integer, then a mask selecting between the decal and the base texel
+void DecalCompositor::composite(uint8_t* base, const uint8_t* decal, size_t texelCount, uint8_t alphaThreshold)
+{
+    const __m128i threshold = _mm_set1_epi32(alphaThreshold);
+    size_t i = 0;
+
+    for (; i + 4 <= texelCount; i += 4)
+    {
+        __m128i baseTexels = _mm_loadu_si128((const __m128i*)(base + i * 4));
+        __m128i decalTexels = _mm_loadu_si128((const __m128i*)(decal + i * 4));
+
+        // Alpha is the high byte of each little-endian texel
+        __m128i useDecal = _mm_cmpgt_epi32(_mm_srli_epi32(decalTexels, 24), threshold);
+        __m128i blended = _mm_or_si128(_mm_and_si128(useDecal, decalTexels), _mm_andnot_si128(useDecal, baseTexels));
+
+        _mm_storeu_si128((__m128i*)(base + i * 4), blended);
+    }
+
+    // The last few texels of an image whose size is not a multiple of four
+    for (; i < texelCount; i++)
+    {
+        if (decal[i * 4 + 3] > alphaThreshold)
+            memcpy(base + i * 4, decal + i * 4, 4);
+    }
+}
\ No newline at end of file
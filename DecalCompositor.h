@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#ifndef DECAL_COMPOSITOR_H
+#define DECAL_COMPOSITOR_H
+
+using namespace std;
+
+class DecalCompositor {
+public:
+    void composite(uint8_t* base, const uint8_t* decal, size_t texelCount, uint8_t alphaThreshold);
+};
+
+#endif
\ No newline at end of file
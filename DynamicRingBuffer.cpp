@@ -0,0 +1,137 @@
+#include "DynamicRingBuffer.h"
+
+#include <chrono>       // Fence wait timing
+#include <cstring>      // memcpy
+#include <algorithm>    // max
+
+// Create a persistently mapped buffer split into one region per frame in flight (three by default)
+// The CPU writes one region while the GPU still reads the others; a fence per region keeps the CPU from overwriting data in use
+bool DynamicRingBuffer::create(GLsizeiptr frameSize, int frameCount)
+{
+    // Every write starts on the uniform and shader storage buffer offset alignments so it can be bound with glBindBufferRange as either
+    GLint storageAlignment = 1;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+    alignment = max(alignment, storageAlignment);
+
+    regionSize = (frameSize + alignment - 1) / alignment * alignment;
+    regionCount = frameCount;
+    region = 0;
+    regionUsed = 0;
+    fences.assign(frameCount, nullptr);
+
+    // Immutable storage that stays mapped for the lifetime of the buffer; coherent writes need no explicit flush
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glGenBuffers(1, &bufferId);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bufferId);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, regionSize * regionCount, NULL, flags);
+    mappedData = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, regionSize * regionCount, flags);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    return mappedData != nullptr;
+}
+
+// Release the fences and the buffer
+void DynamicRingBuffer::destroy()
+{
+    for (GLsync& fence : fences)
+    {
+        if (fence)
+            glDeleteSync(fence);
+
+        fence = nullptr;
+    }
+
+    if (bufferId != 0)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, bufferId);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &bufferId);
+    }
+
+    bufferId = 0;
+    mappedData = nullptr;
+}
+
+// Start writing the next frame's region, waiting until the GPU has finished reading it
+void DynamicRingBuffer::beginFrame()
+{
+    GLsync& fence = fences[region];
+    stats.lastFenceWaitMilliseconds = 0.0;
+
+    if (fence)
+    {
+        auto waitStart = chrono::steady_clock::now();
+
+        // Poll without blocking first; only frames that actually stall are counted as waits
+        GLenum result = glClientWaitSync(fence, 0, 0);
+
+        if (result == GL_TIMEOUT_EXPIRED)
+        {
+            stats.framesWaited++;
+
+            // Wait in one millisecond steps, flushing so the fence is guaranteed to be signaled eventually
+            while (result == GL_TIMEOUT_EXPIRED)
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        }
+
+        stats.lastFenceWaitMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - waitStart).count();
+        stats.totalFenceWaitMilliseconds += stats.lastFenceWaitMilliseconds;
+
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    regionUsed = 0;
+}
+
+// Fence the region written this frame and move on to the next region
+void DynamicRingBuffer::endFrame()
+{
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    stats.bytesUsed = regionUsed;
+    stats.peakBytesUsed = max(stats.peakBytesUsed, regionUsed);
+    stats.frames++;
+
+    region = (region + 1) % regionCount;
+}
+
+// Copy data into the current frame's region and return its offset in the buffer for glBindBufferRange
+// Returns false without writing when the region is full
+bool DynamicRingBuffer::write(const void* data, GLsizeiptr size, GLintptr& offset)
+{
+    if (regionUsed + size > regionSize)
+    {
+        stats.overflows++;
+        return false;
+    }
+
+    offset = region * regionSize + regionUsed;
+    memcpy(mappedData + offset, data, size);
+
+    // Keep the next write aligned
+    regionUsed += (size + alignment - 1) / alignment * alignment;
+
+    return true;
+}
+
+// The buffer handle for binding ranges of the ring
+GLuint DynamicRingBuffer::buffer() const
+{
+    return bufferId;
+}
+
+// Fraction of a frame region used during the most recent frame
+float DynamicRingBuffer::occupancy() const
+{
+    return regionSize > 0 ? (float)stats.bytesUsed / regionSize : 0.0f;
+}
+
+// Usage and fence wait counters
+const RingBufferCounters& DynamicRingBuffer::counters() const
+{
+    return stats;
+}
\ No newline at end of file
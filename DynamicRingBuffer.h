@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#ifndef DYNAMIC_RING_BUFFER_H
+#define DYNAMIC_RING_BUFFER_H
+
+using namespace std;
+
+// Usage and synchronization counters of a dynamic ring buffer
+struct RingBufferCounters {
+    GLsizeiptr bytesUsed = 0;               // Bytes written during the most recent frame
+    GLsizeiptr peakBytesUsed = 0;           // Most bytes written during any frame
+    double lastFenceWaitMilliseconds = 0.0; // Time spent waiting for the GPU at the start of the most recent frame
+    double totalFenceWaitMilliseconds = 0.0;
+    unsigned long frames = 0;
+    unsigned long framesWaited = 0;         // Frames that had to wait for the GPU to release their region
+    unsigned long overflows = 0;            // Writes rejected because the frame region was full
+};
+
+class DynamicRingBuffer {
+public:
+    bool create(GLsizeiptr frameSize, int frameCount = 3);
+    void destroy();
+    void beginFrame();
+    void endFrame();
+    bool write(const void* data, GLsizeiptr size, GLintptr& offset);
+    GLuint buffer() const;
+    float occupancy() const;
+    const RingBufferCounters& counters() const;
+
+private:
+    GLuint bufferId = 0;
+    unsigned char* mappedData = nullptr;
+    GLsizeiptr regionSize = 0;
+    int regionCount = 0;
+    int region = 0;
+    GLsizeiptr regionUsed = 0;
+    GLint alignment = 256;
+    vector<GLsync> fences;
+    RingBufferCounters stats;
+};
+
+#endif
\ No newline at end of file
@@ -7,6 +7,23 @@
 #include <iostream>         // Console output
 #include <cstdlib>          // Exit status
 #include <vector>           // Mesh building
+#include <algorithm>        // Min and max
+#include <thread>           // Resource loader thread
+#include <atomic>           // Resource loader signaling
+#include <queue>            // Decoded texture completion order
+#include <mutex>            // Decoded texture completion order
+#include <chrono>           // Texture decode timing
+#include <cstring>          // Command line arguments
+#include <string>           // Cooked texture paths
+#include <map>              // Captured meshes for the asset archive
+#include <memory>           // Light clustering thread pool
+#include <random>           // Benchmark light placement
+
+#ifdef _WIN32
+#include <direct.h>         // Cooked texture directory creation
+#else
+#include <sys/stat.h>       // Cooked texture directory creation
+#endif
 
 // GLM Math Header inclusions
 #include <glm/glm.hpp>
@@ -19,6 +36,38 @@
 #include "CuboidMeshBuilder.h"
 #include "PlaneMeshBuilder.h"
 
+// Mesh utility inclusions
+#include "MeshWelder.h"
+
+// Buffer utility inclusions
+#include "DynamicRingBuffer.h"
+
+// Threading utility inclusions
+#include "ThreadPool.h"
+
+// Texture utility inclusions
+#include "TextureCooker.h"
+#include "MipGenerator.h"
+#include "TextureStreamer.h"
+#include "AtlasPacker.h"
+#include "DecalCompositor.h"
+
+// Asset utility inclusions
+#include "AssetArchive.h"
+
+// Lighting utility inclusions
+#include "LightClusterer.h"
+#include "LightmapBaker.h"
+
+// Shader utility inclusions
+#include "ProgramCache.h"
+
+// Render pass timing inclusions
+#include "GpuPassTimer.h"
+
+// Visibility buffer inclusions
+#include "MeshArena.h"
+
 using namespace std; // Standard namespace
 
 /*Shader program Macro*/
@@ -26,6 +75,11 @@ using namespace std; // Standard namespace
 #define GLSL(Version, Source) "#version " #Version " core \n" #Source
 #endif
 
+/*Shader source part Macro; appended to a shader source that already has its version line*/
+#ifndef GLSL_PART
+#define GLSL_PART(Source) #Source
+#endif
+
 // The following variables can only be used in this file
 namespace
 {
@@ -108,6 +162,9 @@ namespace
     float gLightIntenRight = 0.9f; // 90 percent light intensity
 
     // Lighting variables
+    const int WINDOW_LIGHT_COUNT = 3; // The back, left, and right windows, which light every fragment and are not clustered
+    int gLightCount = WINDOW_LIGHT_COUNT; // "--lights <count>" adds small colored lights around the table up to the count
+    vector<ClusterLight> gLights; // Every clustered point light of the scene
     float gAmbientLightStrength = 0.12f; // Brighten unlit areas
     float gSpecularHighlightSize = WINDOW_MESH_SCALE;
     float gSpecularIntensity;
@@ -115,12 +172,48 @@ namespace
     // Main GLFW window
     GLFWwindow* gWindow = nullptr;
 
-    // No decal texture identifier
-    GLuint gNoDecal = -1;
+    // Hidden window whose context shares buffers and textures with the main window for the resource loader thread
+    GLFWwindow* gLoaderWindow = nullptr;
+    thread gLoaderThread;
+    atomic<bool> gResourceLoadFailed(false);
+
+    // Create buffers with immutable storage and set up vertex arrays without binding them (OpenGL 4.5 direct state access)
+    bool gUseDirectStateAccess = false;
+
+    // Ring buffer holding the per-frame and per-draw uniform blocks; one region per frame in flight
+    DynamicRingBuffer gUniformRing;
+    const GLsizeiptr UNIFORM_RING_FRAME_SIZE = 64 * 1024; // Room for the frame block and a few hundred draw blocks per frame
+    const GLuint FRAME_UNIFORM_BINDING = 0; // Uniform buffer binding of the FrameData block
+
+    // Clustered forward shading: the view frustum is split into screen tiles by depth slices, and every frame a CPU job lists the lights
+    // that reach each cluster, so a fragment only loops over the lights of its own cluster however many lights the scene has
+    LightClusterer lightClusterer;
+    unique_ptr<ThreadPool> gClusterPool;
+    DynamicRingBuffer gLightRing; // The lights, the cluster table and the light index list of every frame in flight
+    const int CLUSTER_TILES_X = 16;
+    const int CLUSTER_TILES_Y = 9;
+    const int CLUSTER_SLICES = 24;
+    const unsigned MAX_LIGHTS_PER_CLUSTER = 128;
+    const GLuint LIGHT_STORAGE_BINDING = 3; // Shader storage buffer binding of the LightData block
+    const GLuint CLUSTER_STORAGE_BINDING = 4; // Shader storage buffer binding of the ClusterData block
+    const GLuint LIGHT_INDEX_STORAGE_BINDING = 5; // Shader storage buffer binding of the LightIndexData block
+    double gClusterBuildMilliseconds = 0.0; // Summed over the frames since the last report
+    unsigned gClusterBuilds = 0;
+    bool gDroppedLightsReported = false; // Lights dropped at the per-cluster cap are reported the first time it happens
+
+    // Perspective and orthographic depth range
+    const float CAMERA_NEAR = 0.1f;
+    const float CAMERA_FAR = 100.0f;
+    const GLuint DRAW_UNIFORM_BINDING = 1; // Uniform buffer binding of the DrawData block
 
     // Shader programs
-    GLuint gObjectProgramId;
     GLuint gLampProgramId;
+    GLuint gDepthProgramId;
+
+    // Cache of linked program binaries, so programs whose sources and driver have not changed skip compilation on later runs
+    ProgramCache programCache;
+    const char* const PROGRAM_CACHE_DIRECTORY = "resources/shadercache";
+    bool gUseProgramCache = true; // Compile every program from source when "--no-program-cache" is given
 
     // Mesh builders
     CylinderMeshBuilder cylinderMeshBuilder;
@@ -128,6 +221,89 @@ namespace
     CuboidMeshBuilder cuboidMeshBuilder;
     PlaneMeshBuilder planeMeshBuilder;
 
+    // Texture cooker for block compressing textures offline and reading the cooked files at startup
+    TextureCooker textureCooker;
+    const char* const COOKED_TEXTURE_DIRECTORY = "resources/cooked";
+
+    // Mip generator for precomputing the mip chains of uncooked textures on the CPU
+    MipGenerator mipGenerator;
+
+    // Decal compositor for baking decals into the texture they sit on when the texture is loaded
+    DecalCompositor decalCompositor;
+    const uint8_t DECAL_ALPHA_THRESHOLD = 102; // Decal texels with an alpha above 0.4 replace the texel below them
+
+    // Texture streamer that uploads the smallest mips of each texture first and streams in the larger ones as draws need them
+    TextureStreamer textureStreamer;
+    size_t gTextureBudget = 64 * 1024 * 1024; // Texture memory kept resident before unused mips are evicted; set with "--texture-budget <MB>"
+    float gPixelsPerUnit = 0.0f; // Screen pixels covered by one world unit, at a distance of one in perspective, for the current projection
+
+    // Packed archive of GPU-ready textures, meshes and shaders, mapped for the lifetime of the program
+    AssetArchive gAssetArchive;
+    const char* const ASSET_ARCHIVE_PATH = "resources/assets.pak";
+    bool gUseAssetArchive = true; // Load from the archive when it exists; "--no-archive" loads the loose files
+
+    // Texture atlas baked offline from the small textures that clamp to their edges, so most objects share one texture binding
+    // Every region is padded and placed on a multiple of the alignment, so each kept mip level halves it exactly and keeps a gutter
+    AtlasPacker atlasPacker;
+    AssetArchive gAtlasArchive;
+    const char* const ATLAS_PATH = "resources/atlas.pak";
+    bool gUseAtlas = true; // Use the atlas when it exists; "--no-atlas" loads its textures on their own
+    const int ATLAS_ALIGNMENT = 16; // Region placement and size granularity in texels, and the width of the gutter around each region
+    const int ATLAS_LEVELS = 5; // Mip levels kept in the atlas; the gutter is still one texel wide in the last one
+    const int ATLAS_MAX_TEXTURE_SIZE = 1024; // Larger textures keep their own texture
+    const int ATLAS_MAX_PAGE_SIZE = 4096;
+    GLuint gTextureAtlas = 0;
+    map<const GLuint*, glm::vec4> gAtlasRegions; // Offset and scale of each atlased texture's region, by the texture variable it replaces
+
+    // Texture arrays whose layers clamp to their edges pack every layer at its own size into one slice laid out like the atlas
+    // instead of stretching each layer to the largest one; the shaders find each layer's region and slice in the layer table
+    struct TextureLayerRegion
+    {
+        glm::vec4 region; // Offset and scale of the layer's region in its slice
+        float slice;
+        float padding[3];
+    };
+
+    const int MAX_TEXTURE_LAYERS = 16; // Layers of every texture array together
+    const GLuint TEXTURE_LAYER_UNIFORM_BINDING = 2; // Uniform buffer binding of the TextureLayerData block
+    TextureLayerRegion gTextureLayerRegions[MAX_TEXTURE_LAYERS];
+    int gTextureLayerCount = 0;
+    map<GLuint, GLint> gFirstTextureLayers; // First entry of each texture array in the layer table
+
+    // Texture binding state of the object draws; the streamer binds textures between frames, so it is forgotten every frame
+    GLuint gBoundTexture = 0;
+    GLuint gBoundTextureArray = 0;
+    unsigned gFrameTextureBinds = 0;
+    unsigned gFrameObjectDraws = 0;
+    unsigned gFrameProgramSwitches = 0;
+    bool gTextureBindsReported = false;
+
+    // Object shader variants: the features a draw needs are compiled into its own program instead of branching on uniforms
+    // Only the variants the scene draws are compiled, the first time a draw needs each one
+    map<int, GLuint> gObjectPrograms; // Linked program of every variant compiled so far by variant key; zero if it failed
+    string gObjectVertexSource;
+    string gObjectFragmentSource; // Completed by the bound or the bindless texture sampling source
+
+    // Bindless textures: every texture gets a resident handle in a material table indexed per draw, so draws bind no textures
+    // Without ARB_bindless_texture, or with "--no-bindless", textures are bound per draw from the atlas and the texture arrays
+    bool gAllowBindless = true;
+    bool gUseBindless = false;
+    const GLuint MATERIAL_STORAGE_BINDING = 2; // Shader storage buffer binding of the MaterialData block
+
+    // Mesh welder for converting the unindexed builder output to indexed meshes
+    MeshWelder meshWelder;
+    bool gWeldMeshes = true; // Weld every unindexed mesh when it is created
+    unsigned gMeshesWelded = 0; // Meshes welded since the last report, and their vertices before and after welding
+    size_t gWeldInputVertices = 0, gWeldOutputVertices = 0;
+    bool gSplitVertexStreams = true; // Store positions in their own buffer so depth-only passes fetch 12 bytes per vertex
+
+    // Depth prepass variables
+    bool gDepthPrepass = true; // Lay down depth with the position stream before shading so every pixel is shaded once; "--no-depth-prepass" skips it
+    bool gDepthOnlyPass = false; // The object draw calls are currently writing depth only
+    bool gCompareDepthStreams = false; // "--compare-depth-streams" draws every other depth prepass from the interleaved vertices and times both
+    bool gDepthPassInterleaved = false; // The current depth prepass reads the interleaved vertices instead of the position streams
+    unsigned gDepthPrepasses = 0;
+
     // Stores the GL data relative to a given mesh
     struct GLMesh
     {
@@ -135,6 +311,14 @@ namespace
         GLuint vao;         // Handle for the vertex array object
         GLuint vbo;         // Handle for the vertex buffer object
         GLuint nVertices;   // Number of vertices of the mesh
+        GLuint ebo = 0;     // Handle for the element buffer object once the mesh is welded
+        GLuint nIndices = 0; // Number of indices once the mesh is welded; zero draws the vertices directly
+        GLenum indexType = GL_UNSIGNED_SHORT; // Type of the welded indices
+        GLuint attributeVbo = 0; // Handle for the attribute stream when positions are stored in their own stream
+        GLuint positionVao = 0;  // Handle for the position-only vertex array object used by depth-only passes
+        GLuint vertexStride = 0; // Size of one interleaved vertex in bytes
+        bool decalLayers = false; // Some vertices sample a decal layer of the texture array
+        GLuint lightmapSize = 0;  // Texels across the square the mesh's lightmap charts are packed into; zero without lightmap coordinates
     };
 
     // Stores the GL data relative to a given mesh
@@ -144,8 +328,364 @@ namespace
         GLuint vao;         // Handle for the vertex array object
         GLuint vbos[2];     // Handles for the vertex buffer objects
         GLuint nIndices;    // Number of indices of the mesh
+        GLuint nVertices;   // Number of vertices of the mesh
+        GLuint attributeVbo = 0; // Handle for the attribute stream when positions are stored in their own stream
+        GLuint positionVao = 0;  // Handle for the position-only vertex array object used by depth-only passes
+        GLuint vertexStride = 0; // Size of one interleaved vertex in bytes
+    };
+
+    // Per-frame shader data matching the std140 FrameData block; each vec3 shares its 16 bytes with the float after it
+    // Light terms that are the same for every fragment are folded together here once per frame
+    struct FrameUniforms
+    {
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::vec3 viewPosition;
+        float specSize;
+        glm::vec3 ambientColor; // Ambient strength times the color and intensity of every window, summed
+        float padding0;
+        glm::uvec4 clusterCounts; // Tiles across, tiles up, depth slices, and the number of clustered lights
+        glm::vec4 clusterParams;  // Framebuffer width and height, then the scale and bias that turn log(depth) into a slice
+        glm::vec4 windowPositions[WINDOW_LIGHT_COUNT];
+        glm::vec4 windowColors[WINDOW_LIGHT_COUNT]; // Color times intensity
+    };
+
+    // Features of one object shader variant; each is injected into the object shader sources as a #define
+    struct ShaderVariant
+    {
+        bool textureArray;  // TEXTURE_ARRAY: sample the texture array layers stored in the mesh vertices
+        bool hasDecal;      // HAS_DECAL: replace texels with the decal layer stored in the mesh vertices
+        bool hasSpecular;   // HAS_SPECULAR: add specular highlights
+        bool clusteredLights; // CLUSTERED_LIGHTS: add the clustered lights of the fragment's cluster to the windows
+        bool gBufferPass;   // GBUFFER_PASS: write the albedo, specular intensity, and normal into the G-buffer instead of lighting
+        bool visibilityResolve; // Shade the pixels of a resolve group from the visibility buffer instead of rasterized fragments
+        bool hasLightmap;   // HAS_LIGHTMAP: read the ambient and window diffuse light from the lightmap instead of lighting them
+    };
+
+    // An object draw recorded by the draw functions; the queue is sorted by shader variant and texture before anything is drawn
+    struct QueuedDraw
+    {
+        GLMesh* mesh;
+        GLMeshIndexed* meshIndexed;
+        GLuint* texture;
+        glm::vec2 uvScale;
+        glm::mat4 model;
+        float specularIntensity;
+        GLenum textureTarget;
+        ShaderVariant variant;
+        glm::vec4 lightmapRegion;
+    };
+
+    // A shader program submitted for compilation whose compile and link status have not been checked yet
+    // Checking the status waits for the driver, so it is left until the program is ready or a draw needs it
+    struct PendingProgram
+    {
+        GLuint programId = 0;
+        GLuint vertexShaderId = 0;
+        GLuint fragmentShaderId = 0;
+        uint64_t cacheKey = 0;
+        bool fromCache = false;         // Created from a cached binary; there is nothing to wait for
+        double blockedMilliseconds = 0.0; // Time the render thread spent in the program's GL calls
+        chrono::steady_clock::time_point submitted;
+    };
+
+    // An object shader variant submitted at startup
+    struct PendingVariant
+    {
+        ShaderVariant variant;
+        PendingProgram program;
+    };
+
+    // Parallel shader compilation: every program is submitted at startup and its status is only checked once the driver reports it
+    // complete, so drivers with compiler threads compile while the rest of startup runs
+    // Without KHR_parallel_shader_compile the programs are still submitted up front, and each is waited for when it is first needed
+    // or, for the variants no draw has needed yet, one per frame once the resource loader is done
+    bool gParallelShaderCompile = false;
+    PendingProgram gPendingLampProgram;
+    PendingProgram gPendingDepthProgram;
+    map<int, PendingVariant> gPendingObjectPrograms; // Object shader variants submitted but not finished yet, by variant key
+    chrono::steady_clock::time_point gShaderSubmitTime;
+    bool gShaderProgramsReported = false;
+
+    // Render paths selected at startup with "--render-path forward|deferred|visibility"; the forward path is the default
+    enum RenderPath
+    {
+        RENDER_PATH_FORWARD,
+        RENDER_PATH_DEFERRED,
+        RENDER_PATH_VISIBILITY
+    };
+
+    const char* const RENDER_PATH_NAMES[] = { "forward", "deferred", "visibility" };
+    RenderPath gRenderPath = RENDER_PATH_FORWARD;
+
+    // Deferred shading: the objects write their albedo, specular intensity, normal, and depth into the G-buffer, then one full-screen
+    // pass lights every pixel from the cluster light lists, so the light loop runs once per pixel instead of once per shaded fragment
+    bool gGBufferPass = false; // The object draw calls are currently writing the G-buffer
+    GLuint gGBufferFramebuffer = 0;
+    GLuint gGBufferAlbedo = 0; // RGBA8 albedo with the specular intensity in alpha
+    GLuint gGBufferNormal = 0; // RG16 octahedral normal
+    GLuint gGBufferDepth = 0;  // 32-bit float depth, passed on to the default framebuffer by the lighting pass
+    int gGBufferWidth = 0, gGBufferHeight = 0;
+    const GLuint GBUFFER_ALBEDO_UNIT = 3; // Texture units the lighting pass samples the G-buffer from
+    const GLuint GBUFFER_NORMAL_UNIT = 4;
+    const GLuint GBUFFER_DEPTH_UNIT = 5;
+    GLuint gFullScreenVertexArray = 0; // Vertex array without attributes for the full-screen lighting and resolve triangles
+    GLuint gDeferredLightingProgramId = 0;
+    PendingProgram gPendingDeferredLightingProgram;
+
+    // Where a mesh's buffers were copied into the mesh arena, in 32-bit words; matches the mesh fields of the std430 VisibilityDraw struct
+    struct ArenaMesh
+    {
+        GLuint positionOffset, positionStride;   // Positions, in their own stream or at the start of each interleaved vertex
+        GLuint attributeOffset, attributeStride; // Normals, each followed by the texture coordinate and texture array layers
+        GLuint indexOffset, indexBits;           // Indices of 16 or 32 bits, or 0 bits for a mesh drawn without indices
+        GLuint triangleStrip, padding;
+    };
+
+    // A draw of the visibility pass matching the std430 VisibilityDraw struct
+    struct VisibilityDraw
+    {
+        glm::mat4 model;
+        glm::mat4 normalMatrix;
+        glm::vec4 uvRegion;
+        glm::vec2 uvScale;
+        float specInten;
+        GLint materialId;
+        ArenaMesh mesh;
+        GLint firstTextureLayer;
+        GLint padding[3];
+    };
+
+    // Draws of the visibility pass resolved together: they share a shader variant, and a texture unless textures are bindless
+    struct ResolveGroup
+    {
+        ShaderVariant variant;
+        GLuint texture;
+        GLenum textureTarget;
+    };
+
+    // Visibility buffer: the objects write only their draw and triangle index and depth, then one full-screen pass per resolve group
+    // fetches each pixel's triangle from the mesh arena and shades it, so every covered pixel runs the lighting exactly once
+    // The stencil buffer holds each pixel's resolve group, so the resolve passes skip the other groups' pixels before shading them
+    bool gVisibilityPass = false; // The object draw calls are currently writing the visibility buffer
+    GLuint gVisibilityFramebuffer = 0;
+    GLuint gVisibilityIds = 0; // R32UI draw and triangle index of the visible surface
+    GLuint gVisibilityDepthStencil = 0; // Depth, and the resolve group of the visible surface plus one in stencil
+    int gVisibilityWidth = 0, gVisibilityHeight = 0;
+    const int VISIBILITY_TRIANGLE_BITS = 23; // Up to 8 million triangles per draw and 512 draws per frame
+    const size_t MAX_RESOLVE_GROUPS = 255; // Stencil values left after zero, which marks pixels without an object
+    const GLuint VISIBILITY_UNIT = 6; // Texture unit the resolve passes read the visibility buffer from
+    const GLuint MESH_ARENA_STORAGE_BINDING = 6; // Shader storage buffer binding of the MeshArena block
+    const GLuint VISIBILITY_DRAW_STORAGE_BINDING = 7; // Shader storage buffer binding of the VisibilityDrawData block
+    const GLsizeiptr MESH_ARENA_INITIAL_SIZE = 4 * 1024 * 1024;
+    MeshArena meshArena;
+    map<const void*, ArenaMesh> gArenaMeshes; // Where each mesh record's buffers are in the arena, copied the first time it is drawn
+    vector<VisibilityDraw> gVisibilityDraws; // Draws of this frame's visibility pass, by draw index
+    vector<ResolveGroup> gResolveGroups;     // Resolve groups of this frame's visibility pass, by stencil value minus one
+    string gResolveFragmentSource; // Completed by the bound or the bindless texture sampling source like the object fragment shader
+    GLuint gVisibilityProgramId = 0;
+    PendingProgram gPendingVisibilityProgram;
+
+    // The region of the lightmap a draw of the forward pass reads its baked light from
+    struct LightmapDraw
+    {
+        const void* mesh;   // Mesh record of the draw, to check the draw recorded at the same place in a later pass is the same one
+        glm::vec4 region;   // Offset and scale of the region in the lightmap; zero scale for a draw without one
+    };
+
+    // Baked lighting: the windows and every object never move, so the ambient and window diffuse light of the static draws is baked
+    // once on the CPU into a lightmap, and only their specular highlights and the clustered lights are shaded per fragment
+    // Each triangle list mesh gets a second texture coordinate into its own square of charts, and each static draw a region of the lightmap;
+    // the marble is drawn in place too, but as an indexed triangle strip it is never unwrapped and keeps its per-fragment window lighting
+    LightmapBaker lightmapBaker;
+    bool gUseLightmaps = true; // Bake the static lighting on the forward path; "--no-lightmaps" lights every fragment from every window
+    bool gBakedShadows = true; // Trace shadow rays to the windows while baking; "--no-baked-shadows" bakes unshadowed diffuse light
+    bool gLightmapBaked = false; // The bake ran, or found nothing to bake, once every resource group was ready
+    const float LIGHTMAP_UNWRAP_TEXELS_PER_UNIT = 64.0f; // Chart texels per mesh unit in each mesh's square
+    const float LIGHTMAP_TEXELS_PER_WORLD_UNIT = 16.0f; // Texel density each draw's region is scaled towards
+    const int LIGHTMAP_MAX_SIZE = 4096;
+    const GLuint LIGHTMAP_UNIT = 7; // Texture unit the object shader reads the lightmap from
+    GLuint gLightmap = 0; // RGB16F ambient and window diffuse light, which can be brighter than one
+    vector<LightmapDraw> gLightmapDraws; // Region of each draw of the forward pass, by its place in the pass
+
+    // GPU time of each render pass, read back a few frames late so the timer never waits on the GPU
+    enum RenderPass
+    {
+        PASS_DEPTH_PREPASS,
+        PASS_DEPTH_PREPASS_INTERLEAVED, // The depth prepass drawn from the interleaved vertices to compare it with the position streams
+        PASS_FORWARD_SHADING,
+        PASS_GBUFFER,
+        PASS_DEFERRED_LIGHTING,
+        PASS_VISIBILITY,
+        PASS_VISIBILITY_RESOLVE,
+        PASS_COUNT
+    };
+
+    const char* const RENDER_PASS_NAMES[PASS_COUNT] = { "depth prepass", "interleaved depth prepass", "forward shading", "G-buffer", "deferred lighting", "visibility", "visibility resolve" };
+    GpuPassTimer gpuPassTimer;
+
+    // Object draws of the current pass, drawn together once every object has been recorded
+    vector<QueuedDraw> gDrawQueue;
+
+    // Per-draw shader data matching the std140 DrawData block
+    struct DrawUniforms
+    {
+        glm::mat4 model;
+        glm::vec2 uvScale;
+        float specInten;
+        GLint materialId;
+        glm::vec4 uvRegion; // Offset and scale of the texture's region in the texture atlas
+        glm::vec4 lightmapRegion; // Offset and scale of the draw's region in the lightmap
+        GLint firstTextureLayer; // First entry of the draw's texture array in the layer table
+        GLint padding[3];
+    };
+
+    // Describes one float vertex attribute and the vertex buffer binding it is read from
+    struct VertexAttributeLayout
+    {
+        GLuint location;    // Vertex attribute location in the shaders
+        GLint size;         // Number of floats in the attribute
+        GLuint binding;     // Vertex buffer binding the attribute reads from
+        GLuint offset;      // Offset of the attribute within a vertex of that binding in bytes
+    };
+
+    // A vertex array object to create on the render thread; vertex array objects are not shared between contexts
+    struct PendingVertexArray
+    {
+        GLuint* vao;        // Handle to fill in once the vertex array object is created
+        vector<VertexAttributeLayout> layout;
+        vector<GLuint> buffers;
+        vector<GLsizei> strides;
+        GLuint elementBuffer;
+    };
+
+    // GPU-ready buffers of a mesh: what UCreateMesh uploads after welding and splitting, or what the asset archive stores
+    struct MeshBuffers
+    {
+        GLuint floatsPerLayers = 0;     // 2 for meshes that carry texture array layers per vertex
+        GLuint lightmapSize = 0;        // Texels across the square of lightmap charts; every vertex ends with 2 lightmap coordinate floats unless zero
+        GLuint nVertices = 0;           // Number of vertices in the vertex data
+        GLuint nIndices = 0;            // Number of indices in the index data; zero draws the vertices directly
+        bool splitStreams = false;      // Positions are stored in their own stream ahead of the remaining attributes
+        GLenum indexType = GL_UNSIGNED_SHORT;
+        const void* vertexData = nullptr;    // Interleaved vertices, or the position stream when the streams are split
+        GLsizeiptr vertexBytes = 0;
+        const void* attributeData = nullptr; // Remaining attributes when the streams are split
+        GLsizeiptr attributeBytes = 0;
+        const void* indexData = nullptr;
+        GLsizeiptr indexBytes = 0;
+    };
+
+    // Header of a mesh blob in the asset archive; the vertex, attribute, and index data follow it in that order
+    struct ArchivedMeshHeader
+    {
+        uint32_t floatsPerLayers, nVertices, nIndices, splitStreams, indexType, vertexBytes, attributeBytes, indexBytes, lightmapSize;
+    };
+
+    // Header of a shader blob in the asset archive; the source and its terminating null follow it
+    struct ArchivedShaderHeader
+    {
+        uint64_t sourceHash; // Hash of the built-in source the blob was packed from
+    };
+
+    // Header of a texture blob in the asset archive; the level table follows it and the level data starts on the next 64 bytes
+    struct ArchivedTextureHeader
+    {
+        uint32_t internalFormat, compressed, width, height, layers, levelCount;
+    };
+
+    struct ArchivedTextureLevel
+    {
+        uint32_t width, height;
+        uint64_t offset, size; // Relative to the start of the level data
+    };
+
+    // One material of the bindless material table matching the std430 Material struct
+    struct MaterialData
+    {
+        GLuint64 handle;    // Resident bindless texture handle
+        float minLod;       // Finest level the texture streamer has uploaded
+    };
+
+    vector<MaterialData> gMaterials;
+    vector<GLuint> gMaterialTextures; // Texture of each material
+    map<GLuint, GLint> gMaterialIds; // Material of each texture
+
+    // Region of one texture in the texture atlas as stored in the atlas file, in normalized atlas coordinates
+    struct AtlasRegion
+    {
+        char name[48];
+        float offsetX, offsetY, scaleX, scaleY;
+    };
+
+    // Mesh buffers captured instead of uploaded while packing the asset archive, by the mesh they were built for
+    map<const void*, vector<uint8_t>>* gMeshCapture = nullptr;
+
+    // Objects that are loaded together and become visible together
+    enum ResourceGroup
+    {
+        GROUP_BATTERY,
+        GROUP_AMP,
+        GROUP_MARBLE,
+        GROUP_PHONE_BOX,
+        GROUP_TABLE,
+        GROUP_WINDOW,
+        GROUP_COUNT
+    };
+
+    // Loading state of a resource group
+    struct ResourceGroupState
+    {
+        vector<PendingVertexArray> vertexArrays; // Vertex array objects to create once the uploads complete
+        vector<pair<GLuint, vector<TextureLayerRegion>>> textureLayers; // Layer regions of the group's texture arrays, added to the layer table with them
+        GLsync fence = nullptr;         // Signaled when the GPU has completed the group's buffer and texture uploads
+        atomic<bool> uploaded{ false }; // The loader has issued every upload of the group and its fence
+        bool ready = false;             // The vertex array objects exist and the group can be drawn
+    };
+
+    ResourceGroupState gResourceGroups[GROUP_COUNT];
+
+    // Decoded pixels of one texture file
+    struct TextureImage
+    {
+        unsigned char* pixels = nullptr;
+        int width = 0, height = 0, channels = 0;
+        vector<MipLevel> mipLevels; // Precomputed mip chain including level 0; the levels its region keeps for a packed texture array layer
+        bool fallback = false;      // The file could not be loaded and the pixels are the fallback checkerboard
+    };
+
+    // A texture built from its decoded images by the decode job that finished its last file, for the loader thread to upload
+    struct BuiltTexture
+    {
+        StreamedTextureData data;
+        vector<TextureLayerRegion> layerRegions; // Region of every layer of a texture array
+        size_t stretchedBytes = 0; // Video memory a texture array's layers would take stretched to the largest layer
+        bool built = false;
+    };
+
+    // A texture to load and the resource group that waits on it; texture arrays list one file per layer
+    struct TextureLoad
+    {
+        vector<const char*> filenames;
+        GLuint* texture;
+        int wrapType;
+        bool isArray;
+        ResourceGroup group;
+        int decalFile = -1; // File that is a decal for the file before it; baked into that file at load instead of becoming a layer
+    };
+
+    // A mesh stored in the asset archive and the mesh it is loaded into; the marble is the only indexed mesh
+    struct ArchivedMesh
+    {
+        const char* name;
+        GLMesh* mesh;
+        GLMeshIndexed* meshIndexed;
+        ResourceGroup group;
     };
 
+    // Vertex array objects of the meshes created since the last resource group was finished; only used by the loader
+    vector<PendingVertexArray> gPendingVertexArrays;
+
     // Placeholder meshes
     // ------------------
 
@@ -155,27 +695,23 @@ namespace
     // Battery Meshes
     // --------------
 
-    // Triangle mesh data for the battery
-    GLMesh gMeshBatteryCaseSide;
-    GLMesh gMeshBatteryCaseTop;
-    GLMesh gMeshBatteryCaseBottom;
-    GLMesh gMeshBatteryTerminalSide;
-    GLMesh gMeshBatteryTerminalTop;
-
-    // Texture IDs for the battery
-    GLuint gTextureBatteryCaseSide;
-    GLuint gTextureBatteryCaseSideDecal;
-    GLuint gTextureBatteryCaseTop;
-    GLuint gTextureBatteryCaseBottom;
-    GLuint gTextureBatteryTerminalSide;
-    GLuint gTextureBatteryTerminalTop;
-
-    // Texture scales for the battery
-    glm::vec2 gUVScaleBatteryCaseSide(1.0f, 1.0f);
-    glm::vec2 gUVScaleBatteryCaseTop(1.0f, 1.0f);
-    glm::vec2 gUVScaleBatteryCaseBottom(1.0f, 1.0f);
-    glm::vec2 gUVScaleBatteryTerminalSide(1.0f, 1.0f);
-    glm::vec2 gUVScaleBatteryTerminalTop(1.0f, 1.0f);
+    // Triangle mesh data for the whole battery; the case and terminal are stacked capped cylinders in one mesh
+    GLMesh gMeshBattery;
+
+    // Texture array ID for the battery; each part of the battery samples its own layer
+    GLuint gTextureBatteryArray;
+
+    // Texture array layers for the battery
+    // The case side decal is baked into the case side layer when it is loaded, so no part samples a decal layer
+    const float BATTERY_LAYER_CASE_SIDE = 0.0f;
+    const float BATTERY_LAYER_CASE_TOP = 1.0f;
+    const float BATTERY_LAYER_CASE_BOTTOM = 2.0f;
+    const float BATTERY_LAYER_TERMINAL_SIDE = 3.0f;
+    const float BATTERY_LAYER_TERMINAL_TOP = 4.0f;
+    const float BATTERY_LAYER_NONE = -1.0f;
+
+    // Texture scale for the battery
+    glm::vec2 gUVScaleBattery(1.0f, 1.0f);
 
     // Amp Meshes
     // --------------
@@ -241,20 +777,45 @@ void UScrollWheelCallback(GLFWwindow* window, double xoffset, double yoffset);
 
 // Mesh creation functions
 // -----------------------
-void UCreateMesh(GLMesh& gMesh, GLMeshIndexed& gMeshIndexed, vector<GLfloat>& vertices, vector<GLushort>& indices);
+void UCreateMesh(GLMesh& gMesh, GLMeshIndexed& gMeshIndexed, vector<GLfloat>& vertices, vector<GLushort>& indices, GLuint floatsPerLayers = 0);
+void UUploadMesh(GLMesh& gMesh, GLMeshIndexed& gMeshIndexed, const MeshBuffers& buffers);
+void USplitVertexStreams(const vector<GLfloat>& vertices, GLuint floatsPerAttributes, vector<GLfloat>& positions, vector<GLfloat>& attributes);
+GLuint UCreateStaticBuffer(GLsizeiptr size, const void* data);
+void UCreateVertexArray(GLuint& vao, const vector<VertexAttributeLayout>& layout, const vector<GLuint>& buffers, const vector<GLsizei>& strides, GLuint elementBuffer);
 void UCreateBatteryMeshes();
 void UCreateAmpMeshes();
 void UCreateCylinderSideMesh(GLMesh& gMesh, int slices, float height, float radius);
+void UCreateCylinderSideMeshes(vector<GLMesh*> gMeshes, vector<int> slices, vector<float> radii, vector<float> heights);
 void UCreateCylinderFaceMesh(GLMesh& gMesh, bool isTopFace, int slices, float radius);
 void UCreateSphereMesh(GLMeshIndexed& gMeshIndexed, unsigned int segments);
 void UCreateCuboidMesh(GLMesh& gMesh, float width, float height, float length);
 void UCreatePlaneMesh(GLMesh& gMesh, float length, float width);
+void UReportMeshWelding();
+
+// Resource loading functions
+// --------------------------
+void ULoaderThread();
+bool ULoadResources();
+void UTakePendingVertexArrays(ResourceGroup group);
+void UFinishResourceGroup(ResourceGroup group);
+void UPollResourceGroups();
+void UCreateFallbackImage(TextureImage& image);
+void UBakeDecal(const TextureLoad& load, vector<TextureImage>& images);
+bool UCompositeDecal(TextureImage& base, TextureImage& decal);
+bool UFinishDecodedFile(const TextureLoad& load, vector<TextureImage>& images, size_t file, atomic<int>& decalFilesRemaining, double& bakeMilliseconds);
 
 // Draw functions
 // --------------
 void URender();
-void UDrawObjectMesh(GLMesh& gMesh, GLMeshIndexed& gMeshIndexed, GLuint& gTexture, GLuint& gTextureDecal, glm::vec2& gUVScale,
-    float posX, float posY, float posZ, float rotAngle, float rotX, float rotY, float rotZ, float scaleX, float scaleY, float scaleZ);
+void UComputeViewProjection(glm::mat4& view, glm::mat4& projection);
+bool UBindDrawUniforms(const glm::mat4& model, const glm::vec2& uvScale, float specularIntensity, const glm::vec4& uvRegion = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f),
+    GLint materialId = 0, const glm::vec4& lightmapRegion = glm::vec4(0.0f), GLint firstTextureLayer = 0);
+float UTextureScreenPixels(const glm::mat4& model, const glm::vec2& uvScale);
+void UDrawObjects(bool loadedOnly = true);
+void UDrawQueuedObjects();
+void UDrawObjectMesh(GLMesh& gMesh, GLMeshIndexed& gMeshIndexed, GLuint& gTexture, glm::vec2& gUVScale,
+    float posX, float posY, float posZ, float rotAngle, float rotX, float rotY, float rotZ, float scaleX, float scaleY, float scaleZ,
+    GLenum textureTarget = GL_TEXTURE_2D);
 void UDrawLightMesh(GLMesh& gMesh, glm::vec3 lightPos, glm::vec3 lightColor, float lightIntensity,
     float rotAngle, float rotX, float rotY, float rotZ, float scaleX, float scaleY, float scaleZ);
 void UDrawBattery(float x, float y, float z);
@@ -268,8 +829,102 @@ void UDrawTable(float x, float y, float z);
 bool UInitialize(int, char* [], GLFWwindow** window);
 void UResizeWindow(GLFWwindow* window, int width, int height);
 bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
-int ULoadTextures();
-bool UCreateTexture(const char* filename, GLuint& gTexture, int textureWrapType);
+void USubmitShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, PendingProgram& pending);
+bool UShaderProgramReady(const PendingProgram& pending);
+bool UFinishShaderProgram(PendingProgram& pending, GLuint& programId);
+string UInsertShaderLines(const char* source, const char* lines);
+int UShaderVariantKey(const ShaderVariant& variant);
+string UShaderVariantDefines(const ShaderVariant& variant);
+void UShaderVariantSources(const ShaderVariant& variant, string& vertexSource, string& fragmentSource);
+GLuint UObjectProgram(const ShaderVariant& variant);
+void USubmitObjectPrograms();
+GLuint UFinishObjectProgram(int key, PendingVariant& pending);
+void UPollShaderPrograms();
+vector<TextureLoad> UTextureLoads();
+bool UDecodeTexture(const char* filename, TextureImage& image, int desiredChannels);
+bool UBuildDecodedTexture(const TextureLoad& load, vector<TextureImage>& images, BuiltTexture& texture);
+bool UCreateTexture(BuiltTexture& texture, const TextureLoad& load, size_t& textureBytes);
+bool UCreateCompressedTexture(CookedTexture& cooked, const TextureLoad& load, size_t& textureBytes);
+GLuint UAddTexture(StreamedTextureData&& data, int textureWrapType, const string& name, size_t& textureBytes);
+bool UBuildTextureData(const TextureImage& decodedImage, StreamedTextureData& data);
+size_t UBuildTextureArrayData(vector<TextureImage>& images, int textureWrapType, StreamedTextureData& data, vector<TextureLayerRegion>& regions);
+void UBuildCompressedTextureData(CookedTexture& cooked, StreamedTextureData& data);
+void UCompactTextureData(StreamedTextureData& data);
+const char* UTextureFormatName(GLenum internalFormat);
+void UResizeImage(const unsigned char* image, int width, int height, unsigned char* resized, int resizedWidth, int resizedHeight);
+
+// Texture cooking functions
+// -------------------------
+int UCookTextures(int argc, char* argv[]);
+string UCookedTexturePath(const TextureLoad& load);
+int UCookedTextureLayers(const TextureLoad& load);
+bool UCookedFormatSupported(CookedFormat format);
+void UCreateDirectory(const char* path);
+
+// Asset archive functions
+// -----------------------
+int UPackAssets();
+int UBenchmarkLoad();
+vector<ArchivedMesh> UArchivedMeshes();
+vector<pair<const char*, const char*>> UShaderSources();
+const char* UShaderSource(const char* name, const char* builtInSource);
+uint64_t UHashShaderSource(const char* source);
+string UTextureAssetName(const TextureLoad& load);
+void UCaptureMeshes(map<const void*, vector<uint8_t>>& capturedMeshes);
+vector<uint8_t> USerializeMesh(const MeshBuffers& buffers);
+bool UDeserializeMesh(const uint8_t* blob, size_t size, MeshBuffers& buffers);
+vector<uint8_t> USerializeTexture(const StreamedTextureData& data);
+bool UDeserializeTexture(const uint8_t* blob, size_t size, StreamedTextureData& data);
+bool UCreateArchivedMeshes(ResourceGroup group);
+bool UCreateArchivedTexture(const TextureLoad& load, size_t& textureBytes);
+
+// Texture atlas functions
+// -----------------------
+int UBakeAtlas();
+bool UCreateAtlasTexture(vector<TextureLoad>& textures, size_t& textureBytes);
+void UCopyAtlasRegion(const vector<MipLevel>& sourceLevels, const AtlasRect& rect, StreamedTextureData& page);
+
+// Texture array layer functions
+// -----------------------------
+void UBuildPackedLayerMipChain(TextureImage& image);
+bool UPackTextureLayers(vector<TextureImage>& images, StreamedTextureData& data, vector<TextureLayerRegion>& regions);
+vector<TextureLayerRegion> UStretchedTextureLayers(int layers);
+void UAddTextureLayers(const TextureLoad& load, vector<TextureLayerRegion>&& regions);
+void UCreateTextureLayers(ResourceGroup group);
+void UBindTextureLayers();
+
+// Bindless material functions
+// ---------------------------
+void UCreateMaterials(ResourceGroup group);
+void UBindMaterials();
+void UDestroyMaterials();
+
+// Lighting functions
+// ------------------
+void UCreateLights();
+void UBindLightClusters(FrameUniforms& frame);
+
+// Deferred shading functions
+// --------------------------
+bool UCreateGBuffer(int width, int height);
+void UDestroyGBuffer();
+void UDrawGBuffer();
+void UDrawDeferredLighting(const FrameUniforms& frame);
+
+// Visibility buffer functions
+// ---------------------------
+bool UCreateVisibilityBuffer(int width, int height);
+void UDestroyVisibilityBuffer();
+bool UAddArenaMesh(GLMesh& gMesh, GLMeshIndexed& gMeshIndexed, ArenaMesh& arenaMesh);
+bool URecordVisibilityDraw(const QueuedDraw& queued, const glm::vec4& uvRegion, GLint materialId, GLint firstTextureLayer);
+void UDrawVisibilityBuffer();
+void UDrawVisibilityResolve();
+
+// Lightmap functions
+// ------------------
+void UBakeLightmap(const glm::vec3* windowPositions, const glm::vec3* windowColors, const glm::vec3& ambientColor);
+GLuint UReadMeshTriangles(GLMesh& gMesh, GLMeshIndexed& gMeshIndexed, vector<GLfloat>& vertices, vector<GLuint>& triangles);
+vector<uint8_t> UReadBuffer(GLuint buffer);
 
 // Destruction functions
 // ---------------------
@@ -285,10 +940,17 @@ void UDestroyTexture(GLuint gTexture);
 const GLchar* lampVertexShaderSource = GLSL(440,
     layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
 
-    // Global variables for the transform matrices
-    uniform mat4 model;
-    uniform mat4 view;
-    uniform mat4 projection;
+    // Transform matrices from the per-frame and per-draw uniform blocks
+    layout(std140, binding = 0) uniform FrameData
+    {
+        mat4 view;
+        mat4 projection;
+    };
+
+    layout(std140, binding = 1) uniform DrawData
+    {
+        mat4 model;
+    };
 
     void main()
     {
@@ -308,20 +970,93 @@ const GLchar* lampFragmentShaderSource = GLSL(440,
     }
 );
 
+/* Depth Shader Source Code*/
+const GLchar* depthVertexShaderSource = GLSL(440,
+    layout(location = 0) in vec3 position; // VAP position 0 for vertex position data; the only attribute a depth-only pass reads
+
+    // Transform matrices from the per-frame and per-draw uniform blocks
+    layout(std140, binding = 0) uniform FrameData
+    {
+        mat4 view;
+        mat4 projection;
+    };
+
+    layout(std140, binding = 1) uniform DrawData
+    {
+        mat4 model;
+    };
+
+    // The object shader must produce exactly the same depth for the shading pass to pass the depth test
+    invariant gl_Position;
+
+    void main()
+    {
+        gl_Position = projection * view * model * vec4(position, 1.0f); // Transforms vertices into clip coordinates
+    }
+);
+
+/* Depth Fragment Shader Source Code*/
+const GLchar* depthFragmentShaderSource = GLSL(440,
+    void main()
+    {
+        // Only depth is written
+    }
+);
+
+/* Visibility Fragment Shader Source Code; drawn with the depth vertex shader*/
+const GLchar* visibilityFragmentShaderSource = GLSL(440,
+    layout(location = 0) out uint visibility; // For the outgoing draw and triangle index of the fragment
+
+    layout(location = 0) uniform uint drawIndex; // Index of the draw's record in the visibility draw records
+
+    void main()
+    {
+        visibility = (drawIndex << VISIBILITY_TRIANGLE_BITS) | uint(gl_PrimitiveID);
+    }
+);
+
 /* Object Shader Source Code*/
 const GLchar* objectVertexShaderSource = GLSL(440,
     layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
     layout(location = 1) in vec3 normal; // VAP position 1 for normals
     layout(location = 2) in vec2 textureCoordinate;
+    layout(location = 3) in vec2 textureLayers; // VAP position 3 for texture array layers (layer, decal layer)
+    layout(location = 4) in vec2 lightmapCoordinate; // VAP position 4 for the coordinate in the mesh's square of lightmap charts
 
     out vec3 vertexNormal; // For outgoing normals to fragment shader
     out vec3 vertexFragmentPos; // For outgoing color / pixels to fragment shader
     out vec2 vertexTextureCoordinate;
+    flat out vec2 vertexTextureLayers; // For outgoing texture array layers to fragment shader
+    out vec2 vertexLightmapCoordinate; // For the outgoing coordinate in the lightmap to fragment shader
 
-    // Global variables for the transform matrices
-    uniform mat4 model;
-    uniform mat4 view;
-    uniform mat4 projection;
+    // Per-frame data written once per frame into the uniform ring buffer
+    layout(std140, binding = 0) uniform FrameData
+    {
+        mat4 view;
+        mat4 projection;
+        vec3 viewPosition; // Camera position
+        float specSize;
+        vec3 ambientColor; // Ambient light of every window, summed on the CPU
+        uvec4 clusterCounts; // Tiles across, tiles up, depth slices, and the number of clustered lights
+        vec4 clusterParams; // Framebuffer size, then the scale and bias that turn log(depth) into a depth slice
+        vec4 windowPositions[WINDOW_LIGHT_COUNT]; // Back, left, and right windows
+        vec4 windowColors[WINDOW_LIGHT_COUNT]; // Color times intensity of each window
+    };
+
+    // Per-draw data written for every draw into the uniform ring buffer
+    layout(std140, binding = 1) uniform DrawData
+    {
+        mat4 model;
+        vec2 uvScale;
+        float specInten;
+        int materialId; // Index of the draw's material with bindless textures
+        vec4 uvRegion; // Offset and scale of the texture's region in the texture atlas
+        vec4 lightmapRegion; // Offset and scale of the draw's region in the lightmap
+        int firstTextureLayer; // First entry of the draw's texture array in the layer table
+    };
+
+    // Match the depth prepass exactly
+    invariant gl_Position;
 
     void main()
     {
@@ -331,6 +1066,8 @@ const GLchar* objectVertexShaderSource = GLSL(440,
 
         vertexNormal = mat3(transpose(inverse(model))) * normal; // Get normal vectors in world space only and exclude normal translation properties
         vertexTextureCoordinate = textureCoordinate;
+        vertexTextureLayers = textureLayers;
+        vertexLightmapCoordinate = lightmapRegion.xy + lightmapCoordinate * lightmapRegion.zw; // Move the coordinate into the draw's region
     }
 );
 
@@ -339,1167 +1076,5237 @@ const GLchar* objectFragmentShaderSource = GLSL(440,
     in vec3 vertexNormal; // For incoming normals
     in vec3 vertexFragmentPos; // For incoming fragment position
     in vec2 vertexTextureCoordinate; // For incoming texture coordinates
+    flat in vec2 vertexTextureLayers; // For incoming texture array layers
+    in vec2 vertexLightmapCoordinate; // For incoming lightmap coordinates
 
-    out vec4 fragmentColor; // For outgoing object color to the GPU
+    layout(location = 0) out vec4 fragmentColor; // For outgoing object color to the GPU; albedo and specular intensity in the G-buffer pass
+    layout(location = 1) out vec2 gBufferNormal; // For the outgoing packed normal of the G-buffer pass
 
-    // Camera position
-    uniform vec3 viewPosition;
+    // Per-frame data written once per frame into the uniform ring buffer
+    layout(std140, binding = 0) uniform FrameData
+    {
+        mat4 view;
+        mat4 projection;
+        vec3 viewPosition; // Camera position
+        float specSize;
+        vec3 ambientColor; // Ambient light of every window, summed on the CPU
+        uvec4 clusterCounts; // Tiles across, tiles up, depth slices, and the number of clustered lights
+        vec4 clusterParams; // Framebuffer size, then the scale and bias that turn log(depth) into a depth slice
+        vec4 windowPositions[WINDOW_LIGHT_COUNT]; // Back, left, and right windows
+        vec4 windowColors[WINDOW_LIGHT_COUNT]; // Color times intensity of each window
+    };
 
-    // Texture variables
-    uniform sampler2D uTexture;
-    uniform sampler2D uTextureDecal;
-    uniform vec2 uvScale;
-    uniform bool useDecal;
+    // Per-draw data written for every draw into the uniform ring buffer
+    layout(std140, binding = 1) uniform DrawData
+    {
+        mat4 model;
+        vec2 uvScale;
+        float specInten;
+        int materialId; // Index of the draw's material with bindless textures
+        vec4 uvRegion; // Offset and scale of the texture's region in the texture atlas
+        vec4 lightmapRegion; // Offset and scale of the draw's region in the lightmap
+        int firstTextureLayer; // First entry of the draw's texture array in the layer table
+    };
 
-    // Back window variables
-    uniform vec3 lightPosBack;
-    uniform vec3 lightColorBack;
-    uniform float lightIntenBack;
+    // Ambient and window diffuse light baked for the static draws
+    uniform sampler2D uLightmap;
 
-    // Left window variables
-    uniform vec3 lightPosLeft;
-    uniform vec3 lightColorLeft;
-    uniform float lightIntenLeft;
+    // Lighting function prototypes; defined by the lighting source appended to this one
+    vec3 ShadeFragment(vec3 fragmentPos, vec3 norm, float specularIntensity);
+    vec3 ShadeBakedFragment(vec3 fragmentPos, vec3 norm, float specularIntensity, vec3 bakedLight);
+    vec2 EncodeNormal(vec3 norm);
 
-    // Right window variables
-    uniform vec3 lightPosRight;
-    uniform vec3 lightColorRight;
-    uniform float lightIntenRight;
+    // Texture sampling function prototype; defined by the bound or the bindless texture sampling source appended after the lighting source
+    vec4 SampleTexture(vec2 textureCoordinate, vec2 textureLayers);
 
-    // Lighting variables
-    uniform float ambStren;
-    uniform float specInten;
-    uniform float specSize;
+    void main()
+    {
+        vec3 norm = normalize(vertexNormal); // Normalize vectors to 1 unit
+
+        // Scale the coordinates for tiling, then move them into the texture's region of the atlas; the whole texture otherwise
+        vec2 textureCoordinate = uvRegion.xy + vertexTextureCoordinate * uvScale * uvRegion.zw;
+
+        // Texture holds the color to be used for all three components of every light
+        vec4 textureColor = SampleTexture(textureCoordinate, vertexTextureLayers);
+
+        // The G-buffer pass stores what the deferred lighting pass needs and leaves the lighting to it
+        if (GBUFFER_PASS)
+        {
+            fragmentColor = vec4(textureColor.xyz, specInten);
+            gBufferNormal = EncodeNormal(norm);
+            return;
+        }
+
+        // Static draws start from their baked light and only add the light that depends on the view or moves
+        if (HAS_LIGHTMAP)
+        {
+            vec3 bakedLight = texture(uLightmap, vertexLightmapCoordinate).rgb;
+            fragmentColor = vec4(ShadeBakedFragment(vertexFragmentPos, norm, specInten, bakedLight) * textureColor.xyz, 1.0);
+            return;
+        }
 
-    // Point light function prototype
-    vec3 CalcPointLight(vec3 lightPos, vec3 lightColor, float intensity);
+        fragmentColor = vec4(ShadeFragment(vertexFragmentPos, norm, specInten) * textureColor.xyz, 1.0); // Send lighting results to GPU
+    }
+);
 
+/* Full-Screen Triangle Shader Source Code; draws the deferred lighting and the visibility resolve passes*/
+const GLchar* fullScreenVertexShaderSource = GLSL(440,
+    // One triangle covering the whole screen, made from the vertex index without any vertex data
     void main()
     {
-        // Calculate overall lighting from the three windows
-        vec3 result = CalcPointLight(lightPosBack, lightColorBack, lightIntenBack) +
-            CalcPointLight(lightPosLeft, lightColorLeft, lightIntenLeft) +
-            CalcPointLight(lightPosRight, lightColorRight, lightIntenRight);
-
-        fragmentColor = vec4(result, 1.0); // Send lighting results to GPU
+        gl_Position = vec4(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1), 1.0, 1.0);
     }
+);
 
-    // Calculates the color when using a point light
-    vec3 CalcPointLight(vec3 lightPos, vec3 lightColor, float intensity)
+/* Deferred Lighting Fragment Shader Source Code*/
+const GLchar* deferredLightingFragmentShaderSource = GLSL(440,
+    out vec4 fragmentColor; // For outgoing lit color to the GPU
+
+    // Per-frame data written once per frame into the uniform ring buffer
+    layout(std140, binding = 0) uniform FrameData
     {
-        /*Phong lighting model calculations to generate ambient, diffuse, and specular components*/
+        mat4 view;
+        mat4 projection;
+        vec3 viewPosition; // Camera position
+        float specSize;
+        vec3 ambientColor; // Ambient light of every window, summed on the CPU
+        uvec4 clusterCounts; // Tiles across, tiles up, depth slices, and the number of clustered lights
+        vec4 clusterParams; // Framebuffer size, then the scale and bias that turn log(depth) into a depth slice
+        vec4 windowPositions[WINDOW_LIGHT_COUNT]; // Back, left, and right windows
+        vec4 windowColors[WINDOW_LIGHT_COUNT]; // Color times intensity of each window
+    };
 
-        // Calculate Ambient lighting
-        float ambientStrength = ambStren; // Set ambient or global lighting strength
-        vec3 ambient = ambientStrength * lightColor; // Generate ambient light color
+    // G-buffer written by the object draws
+    layout(binding = 3) uniform sampler2D gBufferAlbedo; // Albedo, with the specular intensity in alpha
+    layout(binding = 4) uniform sampler2D gBufferNormal; // Octahedral packed normal
+    layout(binding = 5) uniform sampler2D gBufferDepth;
 
-        // Calculate Diffuse lighting
-        vec3 norm = normalize(vertexNormal); // Normalize vectors to 1 unit
-        vec3 lightDirection = normalize(lightPos - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
-        float impact = max(dot(norm, lightDirection), 0.0);// Calculate diffuse impact by generating dot product of normal and light
-        vec3 diffuse = impact * lightColor; // Generate diffuse light color
+    uniform mat4 inverseViewProjection; // Turns a pixel's position and depth back into its world position
 
-        // Calculate Specular lighting
-        float specularIntensity = specInten; // Set specular light strength
-        float highlightSize = specSize; // Set specular highlight size
-        vec3 viewDir = normalize(viewPosition - vertexFragmentPos); // Calculate view direction
-        vec3 reflectDir = reflect(-lightDirection, norm); // Calculate reflection vector
+    // Lighting function prototypes; defined by the lighting source appended to this one
+    vec3 ShadeFragment(vec3 fragmentPos, vec3 norm, float specularIntensity);
+    vec3 DecodeNormal(vec2 stored);
 
-        // Calculate specular component
-        float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), highlightSize);
-        vec3 specular = specularIntensity * specularComponent * lightColor;
+    void main()
+    {
+        ivec2 pixel = ivec2(gl_FragCoord.xy);
+        float depth = texelFetch(gBufferDepth, pixel, 0).r;
 
-        // Texture holds the color to be used for all three components
-        vec4 textureColor = texture(uTexture, vertexTextureCoordinate * uvScale);
+        // Pixels without an object keep the background color
+        if (depth == 1.0)
+            discard;
 
-        if (useDecal)
-        {
-            vec4 decalTextureColor = texture(uTextureDecal, vertexTextureCoordinate * uvScale);
+        vec4 albedoSpecular = texelFetch(gBufferAlbedo, pixel, 0);
+        vec3 norm = DecodeNormal(texelFetch(gBufferNormal, pixel, 0).xy);
 
-            if (decalTextureColor.a > 0.4)
-                textureColor = decalTextureColor;
-        }
+        // Rebuild the fragment's world position from its depth
+        vec4 worldPos = inverseViewProjection * vec4(gl_FragCoord.xy / clusterParams.xy * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+        vec3 fragmentPos = worldPos.xyz / worldPos.w;
 
-        // Apply light intensity to the phong model
-        ambient *= intensity;
-        diffuse *= intensity;
-        specular *= intensity;
+        // Pass the object depth on to the default framebuffer, so the lamps drawn after this are hidden behind the objects
+        gl_FragDepth = depth;
 
-        // Calculate and return the phong result
-        return ((ambient + diffuse + specular) * textureColor.xyz);
+        fragmentColor = vec4(ShadeFragment(fragmentPos, norm, albedoSpecular.a) * albedoSpecular.rgb, 1.0);
     }
 );
 
-// ------------------------------------------------------------------------------------------------------------------------
-// Main program function
-// ------------------------------------------------------------------------------------------------------------------------
-
-int main(int argc, char* argv[])
-{
-    // Create the application window
-    if (!UInitialize(argc, argv, &gWindow))
-        return EXIT_FAILURE;
+/* Visibility Resolve Fragment Shader Source Code*/
+const GLchar* visibilityResolveFragmentShaderSource = GLSL(440,
+    // The stencil test keeps each resolve group to its own pixels before the shader runs, so every covered pixel is shaded once
+    layout(early_fragment_tests) in;
 
-    // Create the object shader program
-    if (!UCreateShaderProgram(objectVertexShaderSource, objectFragmentShaderSource, gObjectProgramId))
-        return EXIT_FAILURE;
+    out vec4 fragmentColor; // For outgoing object color to the GPU
 
-    // Create the lamp shader program
-    if (!UCreateShaderProgram(lampVertexShaderSource, lampFragmentShaderSource, gLampProgramId))
-        return EXIT_FAILURE;
+    // Per-frame data written once per frame into the uniform ring buffer
+    layout(std140, binding = 0) uniform FrameData
+    {
+        mat4 view;
+        mat4 projection;
+        vec3 viewPosition; // Camera position
+        float specSize;
+        vec3 ambientColor; // Ambient light of every window, summed on the CPU
+        uvec4 clusterCounts; // Tiles across, tiles up, depth slices, and the number of clustered lights
+        vec4 clusterParams; // Framebuffer size, then the scale and bias that turn log(depth) into a depth slice
+        vec4 windowPositions[WINDOW_LIGHT_COUNT]; // Back, left, and right windows
+        vec4 windowColors[WINDOW_LIGHT_COUNT]; // Color times intensity of each window
+    };
 
-    // Load all textures from their corresponding files
-    int exitStatus = ULoadTextures();
+    // One record per draw of the visibility pass: the draw's uniforms, and where its mesh was copied into the mesh arena
+    struct VisibilityDraw
+    {
+        mat4 model;
+        mat4 normalMatrix; // Inverse transpose of the model matrix
+        vec4 uvRegion; // Offset and scale of the texture's region in the texture atlas
+        vec2 uvScale;
+        float specInten;
+        int materialId;
+        uint positionOffset; // Offset of the first position in 32-bit words, and the words from one position to the next
+        uint positionStride;
+        uint attributeOffset; // Offset of the first normal, each followed by its texture coordinate and texture array layers
+        uint attributeStride;
+        uint indexOffset; // Offset of the first index in 32-bit words
+        uint indexBits; // 16 or 32 bit indices, or 0 for a mesh drawn without indices
+        uint triangleStrip; // The indices form a triangle strip instead of separate triangles
+        uint padding;
+        int firstTextureLayer; // First entry of the draw's texture array in the layer table
+    };
 
-    // If one of the textures does not load, exit the program with exit status 1
-    if (exitStatus == EXIT_FAILURE)
-        return EXIT_FAILURE;
+    layout(std430, binding = 6) readonly buffer MeshArena
+    {
+        uint arena[]; // Vertices and indices of every mesh drawn so far; vertex data is read back as floats
+    };
 
-    // Tell OpenGL for each sampler which texture unit it belongs to
-    glUseProgram(gObjectProgramId);
+    layout(std430, binding = 7) readonly buffer VisibilityDrawData
+    {
+        VisibilityDraw draws[];
+    };
 
-    // Set the main texture as texture unit 0
-    glUniform1i(glGetUniformLocation(gObjectProgramId, "uTexture"), 0);
+    // Draw index in the high bits and triangle index in the low bits of the surface visible in each pixel
+    layout(binding = 6) uniform usampler2D visibilityBuffer;
 
-    // Set the decal texture as texture unit 1
-    glUniform1i(glGetUniformLocation(gObjectProgramId, "uTextureDecal"), 1);
+    // Material and texture array layers of the pixel's draw for the texture sampling sources
+    int materialId;
+    int firstTextureLayer;
 
-    // Disable placeholder meshes for the draw object function calls
-    gMesh.enabled = false;
-    gMeshIndexed.enabled = false;
+    // Lighting function prototype; defined by the lighting source appended to this one
+    vec3 ShadeFragment(vec3 fragmentPos, vec3 norm, float specularIntensity);
 
-    // Create object meshes
-    UCreateBatteryMeshes();
-    UCreateAmpMeshes();
-    UCreateSphereMesh(gMeshMarble, SPHERE_SEGMENTS);
-    UCreateCuboidMesh(gMeshPhoneBox, PHONE_BOX_WIDTH, PHONE_BOX_HEIGHT, PHONE_BOX_LENGTH);
-    UCreatePlaneMesh(gMeshTable, TABLE_LENGTH, TABLE_WIDTH);
-    UCreatePlaneMesh(gMeshWindow, WINDOW_MESH_LENGTH, WINDOW_MESH_WIDTH);
+    // Texture sampling function prototype; defined by the bound or the bindless texture sampling source appended after the lighting source
+    vec4 SampleTextureGrad(vec2 textureCoordinate, vec2 textureLayers, vec2 gradientX, vec2 gradientY);
 
-    // Render loop
-    while (!glfwWindowShouldClose(gWindow))
+    // Vertex index of the given corner of a mesh's triangles
+    uint FetchIndex(VisibilityDraw draw, uint index)
     {
-        // Process keyboard events
-        UProcessInput(gWindow);
-
-        // Reset firstMouse if the mouse cursor leaves the content area of the window
-        UMouseOffWindow(gWindow);
+        if (draw.indexBits == 0u)
+            return index;
 
-        // Render this frame
-        URender();
+        if (draw.indexBits == 32u)
+            return arena[draw.indexOffset + index];
 
-        glfwPollEvents();
+        return (arena[draw.indexOffset + index / 2u] >> (index % 2u * 16u)) & 0xFFFFu;
     }
 
-    // Release mesh data
-    UDestroyMesh(gMeshBatteryCaseSide, gMeshIndexed);
-    UDestroyMesh(gMeshBatteryCaseTop, gMeshIndexed);
-    UDestroyMesh(gMeshBatteryCaseBottom, gMeshIndexed);
-    UDestroyMesh(gMeshBatteryTerminalSide, gMeshIndexed);
-    UDestroyMesh(gMeshBatteryTerminalTop, gMeshIndexed);
-    UDestroyMesh(gMeshAmp, gMeshIndexed);
-    UDestroyMesh(gMeshAmpSide, gMeshIndexed);
-    UDestroyMesh(gMeshAmpSideBack, gMeshIndexed);
-    UDestroyMesh(gMeshAmpSideFront, gMeshIndexed);
-    UDestroyMesh(gMesh, gMeshMarble);
-    UDestroyMesh(gMeshPhoneBox, gMeshIndexed);
-    UDestroyMesh(gMeshTable, gMeshIndexed);
+    vec3 FetchVec3(uint offset)
+    {
+        return uintBitsToFloat(uvec3(arena[offset], arena[offset + 1u], arena[offset + 2u]));
+    }
 
-    // Release texture data
-    UDestroyTexture(gTextureBatteryCaseSide);
-    UDestroyTexture(gTextureBatteryCaseSideDecal);
-    UDestroyTexture(gTextureBatteryCaseTop);
-    UDestroyTexture(gTextureBatteryCaseBottom);
-    UDestroyTexture(gTextureBatteryTerminalSide);
-    UDestroyTexture(gTextureBatteryTerminalTop);
-    UDestroyTexture(gTextureAmp);
-    UDestroyTexture(gTextureAmpSide);
-    UDestroyTexture(gTextureAmpSideFace);
-    UDestroyTexture(gTextureMarble);
-    UDestroyTexture(gTexturePhoneBox);
-    UDestroyTexture(gTextureTable);
+    vec2 FetchVec2(uint offset)
+    {
+        return uintBitsToFloat(uvec2(arena[offset], arena[offset + 1u]));
+    }
 
-    // Release shader programs
-    UDestroyShaderProgram(gObjectProgramId);
-    UDestroyShaderProgram(gLampProgramId);
+    // Perspective-correct weights of a triangle's corners at a position on the screen, from the corners' clip space positions
+    vec3 Barycentrics(vec4 clip0, vec4 clip1, vec4 clip2, vec2 screenPos)
+    {
+        vec2 corner0 = clip0.xy / clip0.w;
+        vec2 edge1 = clip1.xy / clip1.w - corner0;
+        vec2 edge2 = clip2.xy / clip2.w - corner0;
+        vec2 offset = screenPos - corner0;
+        float area = edge1.x * edge2.y - edge1.y * edge2.x;
+        float weight1 = (offset.x * edge2.y - offset.y * edge2.x) / area;
+        float weight2 = (edge1.x * offset.y - edge1.y * offset.x) / area;
+
+        // Attributes divided by w are linear on the screen, so the screen weights are divided by w and normalized again
+        vec3 weights = vec3(1.0 - weight1 - weight2, weight1, weight2) / vec3(clip0.w, clip1.w, clip2.w);
+
+        return weights / (weights.x + weights.y + weights.z);
+    }
 
-    exit(EXIT_SUCCESS); // Terminates the program successfully
-}
+    void main()
+    {
+        uint visibility = texelFetch(visibilityBuffer, ivec2(gl_FragCoord.xy), 0).r;
+        VisibilityDraw draw = draws[visibility >> VISIBILITY_TRIANGLE_BITS];
+        uint triangle = visibility & ((1u << VISIBILITY_TRIANGLE_BITS) - 1u);
+        materialId = draw.materialId;
+        firstTextureLayer = draw.firstTextureLayer;
+
+        // Find the corners of the pixel's triangle; each triangle of a strip starts one index after the last
+        uint firstIndex = draw.triangleStrip != 0u ? triangle : triangle * 3u;
+        uvec3 corners = uvec3(FetchIndex(draw, firstIndex), FetchIndex(draw, firstIndex + 1u), FetchIndex(draw, firstIndex + 2u));
+
+        // Transform the corners the way the object vertex shader does
+        vec4 world0 = draw.model * vec4(FetchVec3(draw.positionOffset + corners.x * draw.positionStride), 1.0);
+        vec4 world1 = draw.model * vec4(FetchVec3(draw.positionOffset + corners.y * draw.positionStride), 1.0);
+        vec4 world2 = draw.model * vec4(FetchVec3(draw.positionOffset + corners.z * draw.positionStride), 1.0);
+        mat4 viewProjection = projection * view;
+        vec4 clip0 = viewProjection * world0;
+        vec4 clip1 = viewProjection * world1;
+        vec4 clip2 = viewProjection * world2;
+
+        // Weights of the corners at the pixel, and one pixel right and up for the texture coordinate gradients
+        vec2 pixelSize = 2.0 / clusterParams.xy;
+        vec2 screenPos = gl_FragCoord.xy * pixelSize - 1.0;
+        vec3 weights = Barycentrics(clip0, clip1, clip2, screenPos);
+        vec3 weightsX = Barycentrics(clip0, clip1, clip2, screenPos + vec2(pixelSize.x, 0.0));
+        vec3 weightsY = Barycentrics(clip0, clip1, clip2, screenPos + vec2(0.0, pixelSize.y));
+
+        // Interpolate the position, normal, and texture coordinate the rasterizer would have
+        vec3 fragmentPos = (world0 * weights.x + world1 * weights.y + world2 * weights.z).xyz;
+        uvec3 attributes = draw.attributeOffset + corners * draw.attributeStride;
+        vec3 normal = FetchVec3(attributes.x) * weights.x + FetchVec3(attributes.y) * weights.y + FetchVec3(attributes.z) * weights.z;
+        vec3 norm = normalize(mat3(draw.normalMatrix) * normal);
+
+        mat3x2 cornerCoordinates = mat3x2(FetchVec2(attributes.x + 3u), FetchVec2(attributes.y + 3u), FetchVec2(attributes.z + 3u));
+        vec2 uvScale = draw.uvScale * draw.uvRegion.zw;
+        vec2 textureCoordinate = draw.uvRegion.xy + cornerCoordinates * weights * uvScale;
+        vec2 gradientX = cornerCoordinates * (weightsX - weights) * uvScale;
+        vec2 gradientY = cornerCoordinates * (weightsY - weights) * uvScale;
+
+        // Texture array layers are flat, so they come from the triangle's last corner as they do for the object vertex shader
+        vec2 textureLayers = TEXTURE_ARRAY ? FetchVec2(attributes.z + 5u) : vec2(0.0);
+
+        vec4 textureColor = SampleTextureGrad(textureCoordinate, textureLayers, gradientX, gradientY);
+
+        fragmentColor = vec4(ShadeFragment(fragmentPos, norm, draw.specInten) * textureColor.xyz, 1.0);
+    }
+);
 
-// ------------------------------------------------------------------------------------------------------------------------
-// Input processing functions
-// ------------------------------------------------------------------------------------------------------------------------
+/* Lighting Shader Source Code; appended to the object, deferred lighting, and visibility resolve fragment shaders, which declare the FrameData block*/
+const GLchar* lightingSource = GLSL_PART(
+    // Every clustered point light of the scene, and for every cluster the range of the light index list holding the lights that reach it
+    struct PointLight
+    {
+        vec4 positionRange; // Position, then the distance where the light fades out
+        vec4 color; // Color times intensity
+    };
 
-// Process keyboard input
-void UProcessInput(GLFWwindow* window)
-{
-    // Updata delta time
-    float currentFrame = glfwGetTime();
-    deltaTime = currentFrame - lastFrame;
-    lastFrame = currentFrame;
+    layout(std430, binding = 3) readonly buffer LightData
+    {
+        PointLight lights[];
+    };
 
-    // Enable a consistent camera speed with delta time.
-    float cameraSpeed = moveSpeed * deltaTime;
+    layout(std430, binding = 4) readonly buffer ClusterData
+    {
+        uvec2 clusters[]; // Offset into the light index list and light count
+    };
 
-    // Move camera forward while using perspective projection; zoom camera in while using orthographic projection
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+    layout(std430, binding = 5) readonly buffer LightIndexData
     {
-        if (perspective)
-            cameraPos += cameraSpeed * cameraFront;
-        else
+        uint lightIndices[];
+    };
+
+    // Point light function prototypes
+    void AddClusteredLights(inout vec3 result, vec3 fragmentPos, vec3 norm, vec3 viewDir, float specularIntensity);
+    vec3 CalcPointLight(vec3 lightPos, vec3 lightColor, vec3 fragmentPos, vec3 norm, vec3 viewDir, float specularIntensity);
+    vec3 CalcSpecularLight(vec3 lightPos, vec3 lightColor, vec3 fragmentPos, vec3 norm, vec3 viewDir, float specularIntensity);
+    float RangeAttenuation(vec4 lightPositionRange, vec3 fragmentPos);
+
+    // Light a fragment with the ambient light, each window, and the clustered lights of the fragment's cluster
+    vec3 ShadeFragment(vec3 fragmentPos, vec3 norm, float specularIntensity)
+    {
+        /*Terms shared by every light are computed once per fragment*/
+
+        vec3 viewDir = normalize(viewPosition - fragmentPos); // Calculate view direction
+
+        // Start from the ambient light of all windows and add the diffuse and specular light of each window
+        // Folding the ambient light and the intensities on the CPU reorders the float math of the original per-window function, so
+        // a channel here and there rounds one step differently from it; tools/ShaderCompare.cpp measures the difference
+        vec3 result = ambientColor;
+
+        for (int i = 0; i < WINDOW_LIGHT_COUNT; i++)
+            result += CalcPointLight(windowPositions[i].xyz, windowColors[i].rgb, fragmentPos, norm, viewDir, specularIntensity);
+
+        AddClusteredLights(result, fragmentPos, norm, viewDir, specularIntensity);
+
+        return result;
+    }
+
+    // Light a fragment whose ambient and window diffuse light was baked into the lightmap; only the specular highlights of the windows,
+    // which depend on the view, and the clustered lights are added per fragment
+    vec3 ShadeBakedFragment(vec3 fragmentPos, vec3 norm, float specularIntensity, vec3 bakedLight)
+    {
+        vec3 viewDir = normalize(viewPosition - fragmentPos); // Calculate view direction
+
+        vec3 result = bakedLight;
+
+        for (int i = 0; i < WINDOW_LIGHT_COUNT; i++)
+            result += CalcSpecularLight(windowPositions[i].xyz, windowColors[i].rgb, fragmentPos, norm, viewDir, specularIntensity);
+
+        AddClusteredLights(result, fragmentPos, norm, viewDir, specularIntensity);
+
+        return result;
+    }
+
+    // Add the light of each clustered light that reaches the fragment's cluster, fading out towards its range
+    void AddClusteredLights(inout vec3 result, vec3 fragmentPos, vec3 norm, vec3 viewDir, float specularIntensity)
+    {
+        if (CLUSTERED_LIGHTS)
         {
-            if (orthoTop - cameraSpeed > 0) // Don't flip the image when zooming in all the way while using orthographic projection
-                orthoTop -= cameraSpeed, orthoRight -= cameraSpeed * ASPECT_RATIO; // Maintain aspect ratio while zooming in
+            // Find the fragment's cluster: its screen tile, and the depth slice of its distance along the view direction
+            float viewDepth = -(view * vec4(fragmentPos, 1.0)).z;
+            uvec3 cluster = uvec3(gl_FragCoord.xy / clusterParams.xy * vec2(clusterCounts.xy), max(log(viewDepth) * clusterParams.z + clusterParams.w, 0.0));
+            cluster = min(cluster, clusterCounts.xyz - 1u);
+            uvec2 clusterLights = clusters[cluster.x + clusterCounts.x * (cluster.y + clusterCounts.y * cluster.z)];
+
+            for (uint i = 0u; i < clusterLights.y; i++)
+            {
+                PointLight light = lights[lightIndices[clusterLights.x + i]];
+                result += CalcPointLight(light.positionRange.xyz, light.color.rgb, fragmentPos, norm, viewDir, specularIntensity) * RangeAttenuation(light.positionRange, fragmentPos);
+            }
         }
     }
 
-    // Move camera backward while using perspective projection; zoom camera out while using orthographic perspective
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+    // Calculates the diffuse and specular light of a point light whose color is already scaled by its intensity
+    // The variant defines are constants, so the compiler drops the branches a variant does not take
+    vec3 CalcPointLight(vec3 lightPos, vec3 lightColor, vec3 fragmentPos, vec3 norm, vec3 viewDir, float specularIntensity)
     {
-        if (perspective)
-            cameraPos -= cameraSpeed * cameraFront;
-        else
-            orthoTop += cameraSpeed, orthoRight += cameraSpeed * ASPECT_RATIO; // Maintain aspect ratio while zooming out
+        /*Phong lighting model calculations to generate diffuse and specular components*/
+
+        // Calculate Diffuse lighting
+        vec3 lightDirection = normalize(lightPos - fragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
+        float impact = max(dot(norm, lightDirection), 0.0);// Calculate diffuse impact by generating dot product of normal and light
+
+        // Calculate Specular lighting
+        if (HAS_SPECULAR)
+        {
+            vec3 reflectDir = reflect(-lightDirection, norm); // Calculate reflection vector
+            float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), specSize);
+            impact += specularIntensity * specularComponent;
+        }
+
+        // Calculate and return the diffuse and specular result
+        return impact * lightColor;
     }
 
-    // Move camera left
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+    // Calculates only the specular light of a point light whose diffuse light is baked
+    vec3 CalcSpecularLight(vec3 lightPos, vec3 lightColor, vec3 fragmentPos, vec3 norm, vec3 viewDir, float specularIntensity)
     {
-        if (perspective)
-            cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+        if (!HAS_SPECULAR)
+            return vec3(0.0);
+
+        vec3 lightDirection = normalize(lightPos - fragmentPos);
+        vec3 reflectDir = reflect(-lightDirection, norm);
+        float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), specSize);
+
+        return specularIntensity * specularComponent * lightColor;
+    }
+
+    // Fades a clustered light smoothly from full strength at its position to nothing at its range
+    float RangeAttenuation(vec4 lightPositionRange, vec3 fragmentPos)
+    {
+        float distanceRatio = length(lightPositionRange.xyz - fragmentPos) / lightPositionRange.w;
+        float attenuation = clamp(1.0 - distanceRatio * distanceRatio * distanceRatio * distanceRatio, 0.0, 1.0);
+
+        return attenuation * attenuation;
+    }
+
+    // Pack a unit normal into two components from 0 to 1 by folding the octahedron it projects onto into a square
+    vec2 EncodeNormal(vec3 norm)
+    {
+        vec2 encoded = norm.xy / (abs(norm.x) + abs(norm.y) + abs(norm.z));
+
+        // Fold the lower half over the diagonals
+        if (norm.z < 0.0)
+            encoded = (1.0 - abs(encoded.yx)) * vec2(encoded.x >= 0.0 ? 1.0 : -1.0, encoded.y >= 0.0 ? 1.0 : -1.0);
+
+        return encoded * 0.5 + 0.5;
+    }
+
+    // Unpack a normal packed by EncodeNormal
+    vec3 DecodeNormal(vec2 stored)
+    {
+        vec2 encoded = stored * 2.0 - 1.0;
+        vec3 norm = vec3(encoded.xy, 1.0 - abs(encoded.x) - abs(encoded.y));
+        float fold = max(-norm.z, 0.0);
+
+        norm.x += norm.x >= 0.0 ? -fold : fold;
+        norm.y += norm.y >= 0.0 ? -fold : fold;
+
+        return normalize(norm);
+    }
+);
+
+/* Bound Texture Sampling Shader Source Code*/
+const GLchar* boundTextureSamplingSource = GLSL_PART(
+    // Texture variables
+    uniform sampler2D uTexture;
+    uniform sampler2DArray uTextureArray;
+
+    // Region and slice of every layer of the texture arrays, whose layers are packed into their slices like the atlas
+    struct TextureLayerRegion
+    {
+        vec4 region; // Offset and scale of the layer's region in its slice
+        float slice;
+    };
+
+    layout(std140, binding = 2) uniform TextureLayerData
+    {
+        TextureLayerRegion layerRegions[MAX_TEXTURE_LAYERS];
+    };
+
+    // Texture array coordinate of a layer of the draw's texture array: the texture coordinate moved into the layer's region,
+    // whose gutter keeps filtering and mipmapping off its neighbors, and the slice holding it
+    vec3 TextureLayerCoordinate(vec2 textureCoordinate, float layer)
+    {
+        TextureLayerRegion layerRegion = layerRegions[firstTextureLayer + int(layer)];
+
+        return vec3(layerRegion.region.xy + textureCoordinate * layerRegion.region.zw, layerRegion.slice);
+    }
+
+    // Scale of a layer's region in its slice, which scales the texture coordinate gradients of the layer
+    vec2 TextureLayerScale(float layer)
+    {
+        return layerRegions[firstTextureLayer + int(layer)].region.zw;
+    }
+
+    // Sample the textures bound for the draw; texture array variants sample the texture array instead of the texture
+    vec4 SampleTexture(vec2 textureCoordinate, vec2 textureLayers)
+    {
+        vec4 textureColor;
+
+        if (TEXTURE_ARRAY)
+        {
+            // The texture layer and decal layer come from the mesh vertices
+            textureColor = texture(uTextureArray, TextureLayerCoordinate(textureCoordinate, textureLayers.x));
+
+            if (HAS_DECAL && textureLayers.y >= 0.0)
+            {
+                vec4 decalTextureColor = texture(uTextureArray, TextureLayerCoordinate(textureCoordinate, textureLayers.y));
+
+                if (decalTextureColor.a > 0.4)
+                    textureColor = decalTextureColor;
+            }
+        }
         else
-            cameraPosOrtho.x += cameraSpeed;
+            textureColor = texture(uTexture, textureCoordinate);
+
+        return textureColor;
     }
 
-    // Move camera right
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+    // Sample the textures bound for the draw with the given texture coordinate gradients instead of the rasterized fragments'
+    // Passes that shade pixels of different triangles together, like the visibility resolve, compute the gradients themselves
+    vec4 SampleTextureGrad(vec2 textureCoordinate, vec2 textureLayers, vec2 gradientX, vec2 gradientY)
     {
-        if (perspective)
-            cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+        vec4 textureColor;
+
+        if (TEXTURE_ARRAY)
+        {
+            // The texture layer and decal layer come from the mesh vertices
+            vec2 layerScale = TextureLayerScale(textureLayers.x);
+            textureColor = textureGrad(uTextureArray, TextureLayerCoordinate(textureCoordinate, textureLayers.x), gradientX * layerScale,
+                gradientY * layerScale);
+
+            if (HAS_DECAL && textureLayers.y >= 0.0)
+            {
+                vec2 decalLayerScale = TextureLayerScale(textureLayers.y);
+                vec4 decalTextureColor = textureGrad(uTextureArray, TextureLayerCoordinate(textureCoordinate, textureLayers.y),
+                    gradientX * decalLayerScale, gradientY * decalLayerScale);
+
+                if (decalTextureColor.a > 0.4)
+                    textureColor = decalTextureColor;
+            }
+        }
         else
-            cameraPosOrtho.x -= cameraSpeed;
+            textureColor = textureGrad(uTexture, textureCoordinate, gradientX, gradientY);
+
+        return textureColor;
     }
+);
 
-    // Move camera down
-    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
+/* Bindless Texture Sampling Shader Source Code*/
+const GLchar* bindlessTextureSamplingSource = GLSL_PART(
+    // One material per texture: its resident bindless handle and the finest level the texture streamer has uploaded
+    struct Material
     {
-        if (perspective)
-            cameraPos -= cameraUp * cameraSpeed;
+        uvec2 handle;
+        float minLod;
+    };
+
+    // Material table written once per frame into the uniform ring buffer
+    layout(std430, binding = 2) readonly buffer MaterialData
+    {
+        Material materials[];
+    };
+
+    // Region and slice of every layer of the texture arrays, whose layers are packed into their slices like the atlas
+    struct TextureLayerRegion
+    {
+        vec4 region; // Offset and scale of the layer's region in its slice
+        float slice;
+    };
+
+    layout(std140, binding = 2) uniform TextureLayerData
+    {
+        TextureLayerRegion layerRegions[MAX_TEXTURE_LAYERS];
+    };
+
+    // Texture array coordinate of a layer of the draw's texture array: the texture coordinate moved into the layer's region,
+    // whose gutter keeps filtering and mipmapping off its neighbors, and the slice holding it
+    vec3 TextureLayerCoordinate(vec2 textureCoordinate, float layer)
+    {
+        TextureLayerRegion layerRegion = layerRegions[firstTextureLayer + int(layer)];
+
+        return vec3(layerRegion.region.xy + textureCoordinate * layerRegion.region.zw, layerRegion.slice);
+    }
+
+    // Scale of a layer's region in its slice, which scales the texture coordinate gradients of the layer
+    vec2 TextureLayerScale(float layer)
+    {
+        return layerRegions[firstTextureLayer + int(layer)].region.zw;
+    }
+
+    // Sample the draw's material; the streamer can not move the base level of a texture with a handle,
+    // so the level of detail is clamped to the uploaded levels here
+    vec4 SampleTexture(vec2 textureCoordinate, vec2 textureLayers)
+    {
+        Material material = materials[materialId];
+        vec4 textureColor;
+
+        if (TEXTURE_ARRAY)
+        {
+            sampler2DArray materialTextureArray = sampler2DArray(material.handle);
+            vec3 layerCoordinate = TextureLayerCoordinate(textureCoordinate, textureLayers.x);
+            float lod = max(textureQueryLod(materialTextureArray, layerCoordinate.xy).y, material.minLod);
+
+            // The texture layer and decal layer come from the mesh vertices
+            textureColor = textureLod(materialTextureArray, layerCoordinate, lod);
+
+            if (HAS_DECAL && textureLayers.y >= 0.0)
+            {
+                vec4 decalTextureColor = textureLod(materialTextureArray, TextureLayerCoordinate(textureCoordinate, textureLayers.y), lod);
+
+                if (decalTextureColor.a > 0.4)
+                    textureColor = decalTextureColor;
+            }
+        }
         else
-            cameraPosOrtho.y += cameraSpeed;
+        {
+            sampler2D materialTexture = sampler2D(material.handle);
+            float lod = max(textureQueryLod(materialTexture, textureCoordinate).y, material.minLod);
+            textureColor = textureLod(materialTexture, textureCoordinate, lod);
+        }
+
+        return textureColor;
     }
 
-    // Move camera up
-    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
+    // Level of detail of the given texture coordinate gradients on a texture of the given size
+    float TextureLod(vec2 textureSize, vec2 gradientX, vec2 gradientY)
     {
-        if (perspective)
-            cameraPos += cameraUp * cameraSpeed;
+        return log2(max(length(gradientX * textureSize), length(gradientY * textureSize)));
+    }
+
+    // Sample the draw's material with the given texture coordinate gradients instead of the rasterized fragments', clamped the same way
+    vec4 SampleTextureGrad(vec2 textureCoordinate, vec2 textureLayers, vec2 gradientX, vec2 gradientY)
+    {
+        Material material = materials[materialId];
+        vec4 textureColor;
+
+        if (TEXTURE_ARRAY)
+        {
+            sampler2DArray materialTextureArray = sampler2DArray(material.handle);
+            vec2 layerSize = vec2(textureSize(materialTextureArray, 0).xy) * TextureLayerScale(textureLayers.x);
+            float lod = max(TextureLod(layerSize, gradientX, gradientY), material.minLod);
+
+            // The texture layer and decal layer come from the mesh vertices
+            textureColor = textureLod(materialTextureArray, TextureLayerCoordinate(textureCoordinate, textureLayers.x), lod);
+
+            if (HAS_DECAL && textureLayers.y >= 0.0)
+            {
+                vec4 decalTextureColor = textureLod(materialTextureArray, TextureLayerCoordinate(textureCoordinate, textureLayers.y), lod);
+
+                if (decalTextureColor.a > 0.4)
+                    textureColor = decalTextureColor;
+            }
+        }
         else
-            cameraPosOrtho.y -= cameraSpeed;
+        {
+            sampler2D materialTexture = sampler2D(material.handle);
+            float lod = max(TextureLod(vec2(textureSize(materialTexture, 0)), gradientX, gradientY), material.minLod);
+            textureColor = textureLod(materialTexture, textureCoordinate, lod);
+        }
+
+        return textureColor;
     }
+);
 
-    // Toggle the projection type
-    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)
+// ------------------------------------------------------------------------------------------------------------------------
+// Main program function
+// ------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    // Cook the textures into block compressed KTX2 files instead of running the scene
+    if (argc > 1 && strcmp(argv[1], "--cook") == 0)
+        return UCookTextures(argc, argv);
+
+    // Pack the textures, meshes, and shaders into the asset archive instead of running the scene
+    if (argc > 1 && strcmp(argv[1], "--pack") == 0)
+        return UPackAssets();
+
+    // Time preparing the assets from the loose files against mapping the asset archive
+    if (argc > 1 && strcmp(argv[1], "--benchmark-load") == 0)
+        return UBenchmarkLoad();
+
+    // Bake the small textures into the texture atlas instead of running the scene
+    if (argc > 1 && strcmp(argv[1], "--bake-atlas") == 0)
+        return UBakeAtlas();
+
+    for (int i = 1; i < argc; i++)
     {
-        // Only change the projection type once per key press
-        if (!projectionKeyDown)
+        // Read the texture memory budget in megabytes
+        if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+            gTextureBudget = (size_t)max(atoi(argv[i + 1]), 1) * 1024 * 1024;
+
+        // Load the loose files even when the asset archive exists
+        if (strcmp(argv[i], "--no-archive") == 0)
+            gUseAssetArchive = false;
+
+        // Load the atlased textures on their own even when the texture atlas exists
+        if (strcmp(argv[i], "--no-atlas") == 0)
+            gUseAtlas = false;
+
+        // Bind textures per draw even when bindless textures are available
+        if (strcmp(argv[i], "--no-bindless") == 0)
+            gAllowBindless = false;
+
+        // Compile every shader program from source even when its binary is cached
+        if (strcmp(argv[i], "--no-program-cache") == 0)
+            gUseProgramCache = false;
+
+        // Light the scene with this many point lights, the three windows included
+        if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc)
+            gLightCount = max(atoi(argv[i + 1]), WINDOW_LIGHT_COUNT);
+
+        // Shade with the forward, the deferred, or the visibility buffer render path; any other name is an error
+        if (strcmp(argv[i], "--render-path") == 0)
         {
-            perspective = !perspective;
-            firstMouse = true; // Avoid sudden camera jumps after re-entering the 3D perspective
-            projectionKeyDown = true;
+            const char* name = i + 1 < argc ? argv[i + 1] : "";
+            int path = RENDER_PATH_FORWARD;
+
+            while (path <= RENDER_PATH_VISIBILITY && strcmp(name, RENDER_PATH_NAMES[path]) != 0)
+                path++;
+
+            if (path > RENDER_PATH_VISIBILITY)
+            {
+                cout << "ERROR: Unknown render path \"" << name << "\"; use forward, deferred, or visibility" << endl;
+                return EXIT_FAILURE;
+            }
+
+            gRenderPath = (RenderPath)path;
         }
+
+        // Light every fragment from every window instead of baking the static lighting into a lightmap
+        if (strcmp(argv[i], "--no-lightmaps") == 0)
+            gUseLightmaps = false;
+
+        // Bake the window light without tracing shadow rays
+        if (strcmp(argv[i], "--no-baked-shadows") == 0)
+            gBakedShadows = false;
+
+        // Shade the forward path without laying down depth first
+        if (strcmp(argv[i], "--no-depth-prepass") == 0)
+            gDepthPrepass = false;
+
+        // Time the depth prepass from the position streams against the same pass from the interleaved vertices
+        if (strcmp(argv[i], "--compare-depth-streams") == 0)
+            gCompareDepthStreams = true;
     }
 
-    // Once the key to change the projection type is released, it is no longer held down
-    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_RELEASE)
-        projectionKeyDown = false;
+    // Only the forward path reads the lightmap; the deferred and visibility paths light every pixel from the windows
+    gUseLightmaps = gUseLightmaps && gRenderPath == RENDER_PATH_FORWARD;
 
-    // Close the OpenGL window
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, true);
-}
+    // Create the application window
+    if (!UInitialize(argc, argv, &gWindow))
+        return EXIT_FAILURE;
 
-// Reset the firstMouse variable if the mouse cursor leaves the content area of the window
-void UMouseOffWindow(GLFWwindow* window) {
-    // Get mouse postition relative to the content area of the window
-    double mousePosX;
-    double mousePosY;
-    glfwGetCursorPos(window, &mousePosX, &mousePosY);
+    // Map the asset archive; without one every asset is loaded from its loose files
+    if (gUseAssetArchive && gAssetArchive.open(ASSET_ARCHIVE_PATH))
+        cout << "INFO: Mapped " << ASSET_ARCHIVE_PATH << " (" << gAssetArchive.entryCount() << " assets, " << gAssetArchive.size() / 1048576.0 << " MB)" << endl;
 
-    // Reset firstMouse if the cursor leaves the content area of the window
-    if (mousePosX < 0.0f || mousePosX >(float)WINDOW_WIDTH || mousePosY < 0 || mousePosY >(float)WINDOW_HEIGHT)
+    // Sample textures through bindless handles when the driver has them; the streamer then clamps levels in the shader
+    gUseBindless = gAllowBindless && GLEW_ARB_bindless_texture;
+    textureStreamer.clampLevelsInShader(gUseBindless);
+    cout << "INFO: " << (gUseBindless ? "Sampling textures through bindless handles" : "Binding textures per draw") << endl;
+
+    // The object and visibility resolve fragment shaders are completed by the lighting source they share with the deferred lighting
+    // pass, then by the bound or the bindless texture sampling source
+    // The object shader variants are compiled from these sources the first time a draw needs each one
+    gObjectVertexSource = UShaderSource("shader/object.vert", objectVertexShaderSource);
+
+    if (gUseBindless)
     {
-        firstMouse = true;
+        gObjectFragmentSource = UInsertShaderLines(UShaderSource("shader/object.frag", objectFragmentShaderSource), "#extension GL_ARB_bindless_texture : require\n")
+            + UShaderSource("shader/lighting.frag", lightingSource) + UShaderSource("shader/texture_bindless.frag", bindlessTextureSamplingSource);
+        gResolveFragmentSource = UInsertShaderLines(UShaderSource("shader/visibility_resolve.frag", visibilityResolveFragmentShaderSource), "#extension GL_ARB_bindless_texture : require\n")
+            + UShaderSource("shader/lighting.frag", lightingSource) + UShaderSource("shader/texture_bindless.frag", bindlessTextureSamplingSource);
+    }
+    else
+    {
+        gObjectFragmentSource = string(UShaderSource("shader/object.frag", objectFragmentShaderSource))
+            + UShaderSource("shader/lighting.frag", lightingSource) + UShaderSource("shader/texture_bound.frag", boundTextureSamplingSource);
+        gResolveFragmentSource = string(UShaderSource("shader/visibility_resolve.frag", visibilityResolveFragmentShaderSource))
+            + UShaderSource("shader/lighting.frag", lightingSource) + UShaderSource("shader/texture_bound.frag", boundTextureSamplingSource);
+    }
+
+    // Load shader programs from their cached binaries when the driver can return them
+    if (gUseProgramCache)
+    {
+        UCreateDirectory(PROGRAM_CACHE_DIRECTORY);
+
+        if (!programCache.open(PROGRAM_CACHE_DIRECTORY))
+            cout << "INFO: The driver has no program binary formats; shader programs are compiled from source" << endl;
+    }
+
+    // Create the clustered lights first; whether there are any selects the object shader variants
+    UCreateLights();
+
+    // Disable placeholder meshes for the draw object function calls, which also collect the object shader variants to submit
+    gMesh.enabled = false;
+    gMeshIndexed.enabled = false;
+
+    // Let the driver compile on as many threads as it likes
+    gParallelShaderCompile = GLEW_KHR_parallel_shader_compile;
+
+    if (gParallelShaderCompile)
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
+    // Submit every shader program for compilation; their status is checked once the rest of startup has run
+    gShaderSubmitTime = chrono::steady_clock::now();
+
+    USubmitShaderProgram(UShaderSource("shader/lamp.vert", lampVertexShaderSource),
+        UShaderSource("shader/lamp.frag", lampFragmentShaderSource), gPendingLampProgram);
+    USubmitShaderProgram(UShaderSource("shader/depth.vert", depthVertexShaderSource),
+        UShaderSource("shader/depth.frag", depthFragmentShaderSource), gPendingDepthProgram);
+    USubmitObjectPrograms();
+
+    // The deferred lighting pass lights every pixel with specular highlights, the G-buffer holding each object's specular intensity
+    if (gRenderPath == RENDER_PATH_DEFERRED)
+    {
+        ShaderVariant lightingVariant = { false, false, true, !gLights.empty(), false, false, false };
+        string defines = UShaderVariantDefines(lightingVariant);
+        string fragmentSource = UInsertShaderLines(UShaderSource("shader/deferred_lighting.frag", deferredLightingFragmentShaderSource), defines.c_str())
+            + UShaderSource("shader/lighting.frag", lightingSource);
+
+        USubmitShaderProgram(UShaderSource("shader/fullscreen.vert", fullScreenVertexShaderSource), fragmentSource.c_str(),
+            gPendingDeferredLightingProgram);
+    }
+
+    // The visibility pass draws positions only, like the depth prepass, and writes each fragment's draw and triangle index
+    if (gRenderPath == RENDER_PATH_VISIBILITY)
+    {
+        string fragmentSource = UInsertShaderLines(UShaderSource("shader/visibility.frag", visibilityFragmentShaderSource),
+            ("#define VISIBILITY_TRIANGLE_BITS " + to_string(VISIBILITY_TRIANGLE_BITS) + "\n").c_str());
+
+        USubmitShaderProgram(UShaderSource("shader/depth.vert", depthVertexShaderSource), fragmentSource.c_str(), gPendingVisibilityProgram);
+    }
+
+    cout << "INFO: Submitted " << gPendingObjectPrograms.size() + (gRenderPath == RENDER_PATH_FORWARD ? 2 : 3) << " shader programs in "
+        << chrono::duration<double, milli>(chrono::steady_clock::now() - gShaderSubmitTime).count() << " ms"
+        << (gParallelShaderCompile ? " for parallel compilation" : "") << endl;
+
+    // Create the uniform ring buffer for the per-frame and per-draw data
+    if (!gUniformRing.create(UNIFORM_RING_FRAME_SIZE))
+    {
+        cout << "ERROR: Failed to map the uniform ring buffer" << endl;
+        return EXIT_FAILURE;
+    }
+
+    // Create the cluster grid and the light ring sized for the most light indices the clusters can hold
+    lightClusterer.create(CLUSTER_TILES_X, CLUSTER_TILES_Y, CLUSTER_SLICES, CAMERA_NEAR, CAMERA_FAR, MAX_LIGHTS_PER_CLUSTER);
+    gClusterPool.reset(new ThreadPool());
+
+    GLsizeiptr lightRingFrameSize = (GLsizeiptr)((gLights.size() + 1) * sizeof(ClusterLight) + lightClusterer.clusterCount() * sizeof(uint32_t) * 2 +
+        lightClusterer.clusterCount() * sizeof(uint32_t) * MAX_LIGHTS_PER_CLUSTER + 3 * 256);
+
+    if (!gLightRing.create(lightRingFrameSize))
+    {
+        cout << "ERROR: Failed to map the light ring buffer" << endl;
+        return EXIT_FAILURE;
+    }
+
+    cout << "INFO: Clustered " << RENDER_PATH_NAMES[gRenderPath] << " shading with " << WINDOW_LIGHT_COUNT << " windows and " << gLights.size() << " clustered lights in " << CLUSTER_TILES_X << "x" << CLUSTER_TILES_Y << "x"
+        << CLUSTER_SLICES << " clusters on " << gClusterPool->size() << " threads" << endl;
+
+    // Create the texture streamer before the loader starts adding textures to it
+    if (!textureStreamer.create(gTextureBudget))
+    {
+        cout << "ERROR: Failed to map the texture streaming buffer" << endl;
+        return EXIT_FAILURE;
+    }
+
+    // Create the object meshes and load the textures on the loader thread while the render loop starts
+    // Without a shared context everything is loaded here before the first frame
+    if (gLoaderWindow != nullptr)
+        gLoaderThread = thread(ULoaderThread);
+    else if (!ULoadResources())
+        return EXIT_FAILURE;
+
+    // Create the G-buffer or the visibility buffer at the framebuffer size, and the vertex array the full-screen triangles are drawn with
+    if (gRenderPath != RENDER_PATH_FORWARD)
+    {
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(gWindow, &framebufferWidth, &framebufferHeight);
+
+        if (gRenderPath == RENDER_PATH_DEFERRED && !UCreateGBuffer(framebufferWidth, framebufferHeight))
+            return EXIT_FAILURE;
+
+        if (gRenderPath == RENDER_PATH_VISIBILITY && !UCreateVisibilityBuffer(framebufferWidth, framebufferHeight))
+            return EXIT_FAILURE;
+
+        glGenVertexArrays(1, &gFullScreenVertexArray);
+    }
+
+    // Create the mesh arena the visibility resolve fetches vertices from; meshes are copied into it the first time they are drawn
+    if (gRenderPath == RENDER_PATH_VISIBILITY && !meshArena.create(MESH_ARENA_INITIAL_SIZE))
+    {
+        cout << "ERROR: Failed to create the mesh arena" << endl;
+        return EXIT_FAILURE;
+    }
+
+    // Create the timestamp queries that time each render pass
+    if (!gpuPassTimer.create(PASS_COUNT))
+        cout << "ERROR: Failed to create the render pass timer queries" << endl;
+
+    // The first frame draws with the lamp and depth programs, and the deferred lighting or visibility program of the render path,
+    // so wait for them now that the rest of startup has overlapped their compilation
+    if (!UFinishShaderProgram(gPendingLampProgram, gLampProgramId) || !UFinishShaderProgram(gPendingDepthProgram, gDepthProgramId))
+        return EXIT_FAILURE;
+
+    if (gRenderPath == RENDER_PATH_DEFERRED && !UFinishShaderProgram(gPendingDeferredLightingProgram, gDeferredLightingProgramId))
+        return EXIT_FAILURE;
+
+    if (gRenderPath == RENDER_PATH_VISIBILITY && !UFinishShaderProgram(gPendingVisibilityProgram, gVisibilityProgramId))
+        return EXIT_FAILURE;
+
+    // Render loop
+    while (!glfwWindowShouldClose(gWindow) && !gResourceLoadFailed)
+    {
+        // Create the vertex arrays of the resource groups whose uploads have completed
+        UPollResourceGroups();
+
+        // Upload the texture levels streamed in since the last frame and start streaming the ones last frame's draws asked for
+        textureStreamer.update();
+
+        // Check the object shader variants the driver has finished compiling
+        UPollShaderPrograms();
+
+        // Process keyboard events
+        UProcessInput(gWindow);
+
+        // Reset firstMouse if the mouse cursor leaves the content area of the window
+        UMouseOffWindow(gWindow);
+
+        // Render this frame
+        URender();
+
+        glfwPollEvents();
+    }
+
+    // Wait for the loader thread before releasing anything it may still be creating
+    if (gLoaderThread.joinable())
+        gLoaderThread.join();
+
+    // If one of the resources does not load, exit the program with exit status 1
+    if (gResourceLoadFailed)
+        return EXIT_FAILURE;
+
+    // Report the uniform ring buffer counters
+    const RingBufferCounters& ringCounters = gUniformRing.counters();
+    cout << "INFO: Uniform ring buffer peak occupancy " << 100.0f * ringCounters.peakBytesUsed / UNIFORM_RING_FRAME_SIZE << "%, "
+        << ringCounters.framesWaited << " of " << ringCounters.frames << " frames waited " << ringCounters.totalFenceWaitMilliseconds
+        << " ms in total on fences, " << ringCounters.overflows << " draws skipped on overflow" << endl;
+
+    // Release the uniform ring buffer
+    gUniformRing.destroy();
+
+    // Report the light clustering counters of the last frame, and release the light ring buffer and the clustering threads
+    const LightClustererCounters& clusterCounters = lightClusterer.counters();
+    cout << "INFO: Light clusters held " << clusterCounters.lightIndices << " light indices for " << gLights.size() << " clustered lights (at most "
+        << clusterCounters.maxClusterLights << " in one cluster, " << clusterCounters.droppedLights << " dropped), built in "
+        << gClusterBuildMilliseconds / max(gClusterBuilds, 1u) << " ms per frame on average" << endl;
+
+    gLightRing.destroy();
+    gClusterPool.reset();
+
+    // Report the average GPU time and fragment shader invocations of every render pass the render path ran
+    for (int pass = 0; pass < PASS_COUNT; pass++)
+    {
+        if (gpuPassTimer.counters(pass).samples > 0)
+        {
+            cout << "INFO: GPU time of the " << RENDER_PASS_NAMES[pass] << " pass " << gpuPassTimer.averageMilliseconds(pass)
+                << " ms per frame on average over " << gpuPassTimer.counters(pass).samples << " frames";
+
+            if (gpuPassTimer.countsFragments())
+                cout << ", " << gpuPassTimer.averageFragmentInvocations(pass) << " fragment shader invocations per frame";
+
+            cout << endl;
+        }
+    }
+
+    // The two vertex layouts of the depth prepass drew the same triangles on alternate frames
+    if (gpuPassTimer.counters(PASS_DEPTH_PREPASS).samples > 0 && gpuPassTimer.counters(PASS_DEPTH_PREPASS_INTERLEAVED).samples > 0)
+    {
+        double positionMilliseconds = gpuPassTimer.averageMilliseconds(PASS_DEPTH_PREPASS);
+        double interleavedMilliseconds = gpuPassTimer.averageMilliseconds(PASS_DEPTH_PREPASS_INTERLEAVED);
+
+        cout << "INFO: Depth prepass from the position streams " << positionMilliseconds << " ms against " << interleavedMilliseconds
+            << " ms from the interleaved vertices (" << (positionMilliseconds > 0.0 ? interleavedMilliseconds / positionMilliseconds : 0.0)
+            << "x)" << endl;
+    }
+
+    // Every fragment the visibility pass rasterized is one forward shading without a depth prepass would have lit, while the
+    // resolve passes light each covered pixel once
+    if (gRenderPath == RENDER_PATH_VISIBILITY && gpuPassTimer.countsFragments() && gpuPassTimer.counters(PASS_VISIBILITY_RESOLVE).samples > 0)
+    {
+        double rasterized = gpuPassTimer.averageFragmentInvocations(PASS_VISIBILITY);
+        double shaded = gpuPassTimer.averageFragmentInvocations(PASS_VISIBILITY_RESOLVE);
+
+        cout << "INFO: Visibility resolve shaded " << shaded << " fragments per frame where forward shading would shade " << rasterized
+            << " (" << (shaded > 0.0 ? rasterized / shaded : 0.0) << "x)" << endl;
+    }
+
+    if (gpuPassTimer.missedFrames() > 0)
+        cout << "INFO: " << gpuPassTimer.missedFrames() << " frames of render pass timings were not ready in time and were dropped" << endl;
+
+    // Report the mesh arena counters
+    if (gRenderPath == RENDER_PATH_VISIBILITY)
+    {
+        const MeshArenaCounters& arenaCounters = meshArena.counters();
+        cout << "INFO: Mesh arena holds " << arenaCounters.bytesUsed / 1048576.0 << " MB of " << arenaCounters.capacity / 1048576.0 << " MB from "
+            << gArenaMeshes.size() << " meshes (" << arenaCounters.buffersAdded << " buffers), grown " << arenaCounters.grows << " times" << endl;
+    }
+
+    // Release the timer queries, the G-buffer, the visibility buffer, the mesh arena, and the lightmap
+    gpuPassTimer.destroy();
+    UDestroyGBuffer();
+    UDestroyVisibilityBuffer();
+    meshArena.destroy();
+    glDeleteVertexArrays(1, &gFullScreenVertexArray);
+    glDeleteTextures(1, &gLightmap);
+
+    // Report the texture streaming counters
+    const TextureStreamerCounters& streamCounters = textureStreamer.counters();
+    cout << "INFO: Texture streaming " << streamCounters.residentBytes / 1048576.0 << " MB resident of " << streamCounters.allocatedBytes / 1048576.0
+        << " MB allocated (peak " << streamCounters.peakResidentBytes / 1048576.0 << " MB, budget " << gTextureBudget / 1048576.0 << " MB), "
+        << streamCounters.levelsStreamed << " levels streamed in (" << streamCounters.streamedBytes / 1048576.0 << " MB), "
+        << streamCounters.levelsEvicted << " evicted, " << streamCounters.budgetStalls << " budget stalls" << endl;
+
+    // Upload throughput while levels were on their way through the staging ring
+    if (streamCounters.uploadMilliseconds > 0.0)
+        cout << "INFO: Texture upload throughput " << streamCounters.streamedBytes / 1048576.0 / (streamCounters.uploadMilliseconds / 1000.0)
+            << " MB/s over " << streamCounters.uploadMilliseconds << " ms with uploads in flight" << endl;
+
+    // Release the texture streaming buffer and sources, then unmap the archives they may point into
+    textureStreamer.destroy();
+    gAssetArchive.close();
+    gAtlasArchive.close();
+
+    // Release mesh data
+    UDestroyMesh(gMeshBattery, gMeshIndexed);
+    UDestroyMesh(gMeshAmp, gMeshIndexed);
+    UDestroyMesh(gMeshAmpSide, gMeshIndexed);
+    UDestroyMesh(gMeshAmpSideBack, gMeshIndexed);
+    UDestroyMesh(gMeshAmpSideFront, gMeshIndexed);
+    UDestroyMesh(gMesh, gMeshMarble);
+    UDestroyMesh(gMeshPhoneBox, gMeshIndexed);
+    UDestroyMesh(gMeshTable, gMeshIndexed);
+
+    // Release the bindless handles, then the texture data
+    UDestroyMaterials();
+    UDestroyTexture(gTextureBatteryArray);
+    UDestroyTexture(gTextureAmp);
+    UDestroyTexture(gTextureAmpSide);
+    UDestroyTexture(gTextureAmpSideFace);
+    UDestroyTexture(gTextureMarble);
+    UDestroyTexture(gTexturePhoneBox);
+    UDestroyTexture(gTextureTable);
+
+    // Release shader programs, including the variants that were never needed before the program exited
+    for (auto& pending : gPendingObjectPrograms)
+    {
+        glDeleteShader(pending.second.program.vertexShaderId);
+        glDeleteShader(pending.second.program.fragmentShaderId);
+        UDestroyShaderProgram(pending.second.program.programId);
+    }
+
+    for (auto& program : gObjectPrograms)
+    {
+        if (program.second != 0)
+            UDestroyShaderProgram(program.second);
+    }
+
+    UDestroyShaderProgram(gLampProgramId);
+    UDestroyShaderProgram(gDepthProgramId);
+
+    if (gRenderPath == RENDER_PATH_DEFERRED)
+        UDestroyShaderProgram(gDeferredLightingProgramId);
+
+    if (gRenderPath == RENDER_PATH_VISIBILITY)
+        UDestroyShaderProgram(gVisibilityProgramId);
+
+    exit(EXIT_SUCCESS); // Terminates the program successfully
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+// Input processing functions
+// ------------------------------------------------------------------------------------------------------------------------
+
+// Process keyboard input
+void UProcessInput(GLFWwindow* window)
+{
+    // Updata delta time
+    float currentFrame = glfwGetTime();
+    deltaTime = currentFrame - lastFrame;
+    lastFrame = currentFrame;
+
+    // Enable a consistent camera speed with delta time.
+    float cameraSpeed = moveSpeed * deltaTime;
+
+    // Move camera forward while using perspective projection; zoom camera in while using orthographic projection
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+    {
+        if (perspective)
+            cameraPos += cameraSpeed * cameraFront;
+        else
+        {
+            if (orthoTop - cameraSpeed > 0) // Don't flip the image when zooming in all the way while using orthographic projection
+                orthoTop -= cameraSpeed, orthoRight -= cameraSpeed * ASPECT_RATIO; // Maintain aspect ratio while zooming in
+        }
+    }
+
+    // Move camera backward while using perspective projection; zoom camera out while using orthographic perspective
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+    {
+        if (perspective)
+            cameraPos -= cameraSpeed * cameraFront;
+        else
+            orthoTop += cameraSpeed, orthoRight += cameraSpeed * ASPECT_RATIO; // Maintain aspect ratio while zooming out
+    }
+
+    // Move camera left
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+    {
+        if (perspective)
+            cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+        else
+            cameraPosOrtho.x += cameraSpeed;
+    }
+
+    // Move camera right
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+    {
+        if (perspective)
+            cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+        else
+            cameraPosOrtho.x -= cameraSpeed;
+    }
+
+    // Move camera down
+    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
+    {
+        if (perspective)
+            cameraPos -= cameraUp * cameraSpeed;
+        else
+            cameraPosOrtho.y += cameraSpeed;
+    }
+
+    // Move camera up
+    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
+    {
+        if (perspective)
+            cameraPos += cameraUp * cameraSpeed;
+        else
+            cameraPosOrtho.y -= cameraSpeed;
+    }
+
+    // Toggle the projection type
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)
+    {
+        // Only change the projection type once per key press
+        if (!projectionKeyDown)
+        {
+            perspective = !perspective;
+            firstMouse = true; // Avoid sudden camera jumps after re-entering the 3D perspective
+            projectionKeyDown = true;
+        }
+    }
+
+    // Once the key to change the projection type is released, it is no longer held down
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_RELEASE)
+        projectionKeyDown = false;
+
+    // Close the OpenGL window
+    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+}
+
+// Reset the firstMouse variable if the mouse cursor leaves the content area of the window
+void UMouseOffWindow(GLFWwindow* window) {
+    // Get mouse postition relative to the content area of the window
+    double mousePosX;
+    double mousePosY;
+    glfwGetCursorPos(window, &mousePosX, &mousePosY);
+
+    // Reset firstMouse if the cursor leaves the content area of the window
+    if (mousePosX < 0.0f || mousePosX >(float)WINDOW_WIDTH || mousePosY < 0 || mousePosY >(float)WINDOW_HEIGHT)
+    {
+        firstMouse = true;
+    }
+}
+
+// GLFW callback for mouse movement events
+void UMouseCallback(GLFWwindow* window, double xpos, double ypos)
+{
+    // Only process mouse events while using the 3D perspective projection
+    if (perspective)
+    {
+        // Avoid sudden camera jumps
+        if (firstMouse)
+        {
+            mouseLastX = xpos;
+            mouseLastY = ypos;
+            firstMouse = false;
+        }
+
+        // Calculate the X and Y offset values for the mouse position
+        float xoffset = xpos - mouseLastX;
+        float yoffset = mouseLastY - ypos;
+
+        // Update the previous mouse position
+        mouseLastX = xpos;
+        mouseLastY = ypos;
+
+        // Apply the look sensitivy multiplier to the mouse position offsets
+        float sensitivity = 0.1f;
+        xoffset *= sensitivity;
+        yoffset *= sensitivity;
+
+        // Update the yaw and pitch based on the mouse position offsets
+        yaw += xoffset;
+        pitch += yoffset;
+
+        // Constrain the camera pitch to prevent LookAt flip
+        if (pitch > 89.0f)
+            pitch = 89.0f;
+        if (pitch < -89.0f)
+            pitch = -89.0f;
+
+        // Update where the camera is looking based on the new direction
+        glm::vec3 direction;
+        direction.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
+        direction.y = sin(glm::radians(pitch));
+        direction.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
+        cameraFront = glm::normalize(direction);
+    }
+}
+
+// GLFW callback for scroll wheel events
+void UScrollWheelCallback(GLFWwindow* window, double xoffset, double yoffset)
+{
+    // Adjust the camera movement speed if the offset would not make it negative
+    if (moveSpeed + (float)yoffset > 0.0f)
+        moveSpeed += (float)yoffset;
+    else
+        moveSpeed = 0; // Do not allow a negative movement speed
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+// Mesh creation functions
+// ------------------------------------------------------------------------------------------------------------------------
+
+// Create a mesh with the given vertices and indices; floatsPerLayers is 2 for meshes that carry texture array layers per vertex
+void UCreateMesh(GLMesh& gMesh, GLMeshIndexed& gMeshIndexed, vector<GLfloat>& vertices, vector<GLushort>& indices, GLuint floatsPerLayers)
+{
+    const GLuint floatsPerVertex = 3;
+    const GLuint floatsPerNormal = 3;
+    const GLuint floatsPerUV = 2;
+
+    // Floats per vertex: 8 (X, Y, Z, nX, nY, nZ, tX, tY), or 10 with texture array layers, then 2 more with lightmap coordinates
+    GLuint floatsPerAttributes = floatsPerVertex + floatsPerNormal + floatsPerUV + floatsPerLayers;
+
+    // Vertex data to upload; unwrapping appends the lightmap coordinates, and welding replaces the result with unique vertices
+    const vector<GLfloat>* meshVertices = &vertices;
+    vector<GLfloat> unwrappedVertices, weldedVertices;
+    vector<GLuint> weldedIndices;
+
+    MeshBuffers buffers;
+    buffers.floatsPerLayers = floatsPerLayers;
+
+    if (gMesh.enabled == true && gUseLightmaps)
+    {
+        // Give every vertex of the triangle list a second texture coordinate into a square of charts for the baked lighting
+        LightmapUnwrapStats unwrapStats = lightmapBaker.unwrap(vertices, floatsPerAttributes, LIGHTMAP_UNWRAP_TEXELS_PER_UNIT, unwrappedVertices);
+
+        cout << "INFO: Unwrapped mesh into " << unwrapStats.charts << " lightmap charts in a " << unwrapStats.layoutSize << "x"
+            << unwrapStats.layoutSize << " texel square" << endl;
+
+        meshVertices = &unwrappedVertices;
+        floatsPerAttributes += 2;
+        buffers.lightmapSize = unwrapStats.layoutSize;
+    }
+
+    buffers.nVertices = meshVertices->size() / floatsPerAttributes;
+
+    if (gMesh.enabled == true && gWeldMeshes)
+    {
+        // Weld the duplicated vertices of the triangle list into unique vertices and indices
+        MeshWeldStats stats = meshWelder.weld(*meshVertices, floatsPerAttributes, weldedVertices, weldedIndices);
+
+        // Summed up and reported once every mesh is created
+        gMeshesWelded++;
+        gWeldInputVertices += stats.inputVertices;
+        gWeldOutputVertices += stats.outputVertices;
+
+        meshVertices = &weldedVertices;
+        buffers.nVertices = stats.outputVertices;
+        buffers.nIndices = weldedIndices.size();
+    }
+
+    vector<GLfloat> positions, attributes;
+
+    if (gSplitVertexStreams)
+    {
+        // Separate the tightly packed positions from the rest of the vertex attributes
+        USplitVertexStreams(*meshVertices, floatsPerAttributes, positions, attributes);
+
+        buffers.splitStreams = true;
+        buffers.vertexData = &positions[0], buffers.vertexBytes = positions.size() * sizeof(GLfloat);
+        buffers.attributeData = &attributes[0], buffers.attributeBytes = attributes.size() * sizeof(GLfloat);
+    }
+    else
+    {
+        buffers.vertexData = &(*meshVertices)[0], buffers.vertexBytes = meshVertices->size() * sizeof(GLfloat);
+    }
+
+    vector<GLushort> shortIndices;
+
+    if (gMesh.enabled == true && buffers.nIndices > 0)
+    {
+        // Use 16-bit indices whenever every vertex can be addressed by them
+        if (buffers.nVertices <= 65536)
+        {
+            shortIndices.assign(weldedIndices.begin(), weldedIndices.end());
+            buffers.indexType = GL_UNSIGNED_SHORT;
+            buffers.indexData = &shortIndices[0], buffers.indexBytes = shortIndices.size() * sizeof(GLushort);
+        }
+        else
+        {
+            buffers.indexType = GL_UNSIGNED_INT;
+            buffers.indexData = &weldedIndices[0], buffers.indexBytes = weldedIndices.size() * sizeof(GLuint);
+        }
+    }
+    else if (gMesh.enabled == false && gMeshIndexed.enabled == true)
+    {
+        buffers.nIndices = indices.size();
+        buffers.indexData = &indices[0], buffers.indexBytes = indices.size() * sizeof(GLushort);
+    }
+
+    // While the asset archive is packed the buffers are kept instead of uploaded
+    if (gMeshCapture != nullptr)
+    {
+        (*gMeshCapture)[gMesh.enabled ? (const void*)&gMesh : (const void*)&gMeshIndexed] = USerializeMesh(buffers);
+        return;
+    }
+
+    UUploadMesh(gMesh, gMeshIndexed, buffers);
+}
+
+// Upload the buffers of a mesh and queue its vertex array objects
+// The data can point anywhere, including straight into the mapped asset archive, since it is only read while the buffers are created
+void UUploadMesh(GLMesh& gMesh, GLMeshIndexed& gMeshIndexed, const MeshBuffers& buffers)
+{
+    const GLuint floatsPerVertex = 3;
+    const GLuint floatsPerNormal = 3;
+    const GLuint floatsPerUV = 2;
+    const GLuint floatsPerLayers = buffers.floatsPerLayers;
+    const GLuint floatsPerLightmap = buffers.lightmapSize > 0 ? 2 : 0;
+    const GLuint floatsPerAttributes = floatsPerVertex + floatsPerNormal + floatsPerUV + floatsPerLayers + floatsPerLightmap;
+
+    // Initialize the number of mesh vertices
+    gMesh.nVertices = buffers.nVertices;
+    gMeshIndexed.nVertices = buffers.nVertices;
+
+    // Handles of whichever mesh is being created
+    GLuint& vao = gMesh.enabled ? gMesh.vao : gMeshIndexed.vao;
+    GLuint& vbo = gMesh.enabled ? gMesh.vbo : gMeshIndexed.vbos[0];
+    GLuint& attributeVbo = gMesh.enabled ? gMesh.attributeVbo : gMeshIndexed.attributeVbo;
+    GLuint& positionVao = gMesh.enabled ? gMesh.positionVao : gMeshIndexed.positionVao;
+    GLuint& vertexStride = gMesh.enabled ? gMesh.vertexStride : gMeshIndexed.vertexStride;
+
+    // Stride between vertex coordinates is 8 (X, Y, Z, nX, nY, nZ, tX, tY), or 10 with texture array layers, plus 2 with lightmap coordinates
+    GLsizei stride = sizeof(float) * floatsPerAttributes;
+    vertexStride = stride;
+
+    if (gMesh.enabled)
+        gMesh.lightmapSize = buffers.lightmapSize;
+
+    // Vertex buffer bindings and the attributes read from them
+    vector<GLuint> vertexBuffers;
+    vector<GLsizei> strides;
+    vector<VertexAttributeLayout> layout;
+
+    if (buffers.splitStreams)
+    {
+        // Create and send buffers for the position stream and the attribute stream
+        vbo = UCreateStaticBuffer(buffers.vertexBytes, buffers.vertexData);
+        attributeVbo = UCreateStaticBuffer(buffers.attributeBytes, buffers.attributeData);
+
+        // Binding 0 is the position stream; binding 1 holds 5 attribute floats (nX, nY, nZ, tX, tY), or 7 with texture array layers,
+        // and the lightmap coordinates after them
+        vertexBuffers = { vbo, attributeVbo };
+        strides = { (GLsizei)(sizeof(float) * floatsPerVertex), (GLsizei)(sizeof(float) * (floatsPerAttributes - floatsPerVertex)) };
+        layout = {
+            { 0, floatsPerVertex, 0, 0 }, // Position
+            { 1, floatsPerNormal, 1, 0 }, // Normal
+            { 2, floatsPerUV, 1, sizeof(float) * floatsPerNormal } // Texture Coordinate
+        };
+
+        if (floatsPerLayers > 0)
+            layout.push_back({ 3, (GLint)floatsPerLayers, 1, sizeof(float) * (floatsPerNormal + floatsPerUV) }); // Texture Layers
+
+        if (floatsPerLightmap > 0)
+            layout.push_back({ 4, (GLint)floatsPerLightmap, 1, (GLuint)(sizeof(float) * (floatsPerNormal + floatsPerUV + floatsPerLayers)) }); // Lightmap Coordinate
+    }
+    else
+    {
+        // Create and send buffer for the interleaved vertex data
+        vbo = UCreateStaticBuffer(buffers.vertexBytes, buffers.vertexData);
+
+        // Binding 0 holds every attribute of a vertex
+        vertexBuffers = { vbo };
+        strides = { stride };
+        layout = {
+            { 0, floatsPerVertex, 0, 0 }, // Position
+            { 1, floatsPerNormal, 0, sizeof(float) * floatsPerVertex }, // Normal
+            { 2, floatsPerUV, 0, sizeof(float) * (floatsPerVertex + floatsPerNormal) } // Texture Coordinate
+        };
+
+        if (floatsPerLayers > 0)
+            layout.push_back({ 3, (GLint)floatsPerLayers, 0, sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV) }); // Texture Layers
+
+        if (floatsPerLightmap > 0)
+            layout.push_back({ 4, (GLint)floatsPerLightmap, 0, (GLuint)(sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV + floatsPerLayers)) }); // Lightmap Coordinate
+    }
+
+    // Remember whether any vertex samples a decal layer so the mesh's draws pick a shader variant with decals
+    if (gMesh.enabled && floatsPerLayers == 2)
+    {
+        const GLfloat* layerData = (const GLfloat*)(buffers.splitStreams ? buffers.attributeData : buffers.vertexData);
+        GLuint layerStride = buffers.splitStreams ? floatsPerAttributes - floatsPerVertex : floatsPerAttributes;
+        GLuint decalLayer = layerStride - floatsPerLightmap - 1;
+        gMesh.decalLayers = false;
+
+        for (GLuint i = 0; i < buffers.nVertices && !gMesh.decalLayers; i++)
+            gMesh.decalLayers = layerData[i * layerStride + decalLayer] >= 0.0f;
+    }
+
+    // Create and send buffer for the indices
+    GLuint elementBuffer = 0;
+
+    if (gMesh.enabled == true && buffers.nIndices > 0)
+    {
+        gMesh.nIndices = buffers.nIndices;
+        gMesh.indexType = buffers.indexType;
+        gMesh.ebo = UCreateStaticBuffer(buffers.indexBytes, buffers.indexData);
+        elementBuffer = gMesh.ebo;
+    }
+    else if (gMesh.enabled == false && gMeshIndexed.enabled == true)
+    {
+        gMeshIndexed.nIndices = buffers.nIndices;
+        gMeshIndexed.vbos[1] = UCreateStaticBuffer(buffers.indexBytes, buffers.indexData);
+        elementBuffer = gMeshIndexed.vbos[1];
+    }
+
+    // Queue the vertex array object; it is created on the render thread once the buffers are uploaded
+    gPendingVertexArrays.push_back({ &vao, layout, vertexBuffers, strides, elementBuffer });
+
+    // Queue a second vertex array object that only reads the position stream for depth-only passes
+    if (buffers.splitStreams)
+        gPendingVertexArrays.push_back({ &positionVao, { layout[0] }, { vertexBuffers[0] }, { strides[0] }, elementBuffer });
+}
+
+// Create a buffer holding the given data that is never modified after it is created
+// Uses immutable storage through direct state access when available so the driver can place the buffer optimally
+GLuint UCreateStaticBuffer(GLsizeiptr size, const void* data)
+{
+    GLuint buffer;
+
+    if (gUseDirectStateAccess)
+    {
+        glCreateBuffers(1, &buffer);
+        glNamedBufferStorage(buffer, size, data, 0);
+    }
+    else
+    {
+        // Any target can be used to fill a buffer; the array buffer target does not disturb the bound vertex array object
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    return buffer;
+}
+
+// Create a vertex array object reading the given float attributes from the given buffer bindings and indices from the element buffer
+void UCreateVertexArray(GLuint& vao, const vector<VertexAttributeLayout>& layout, const vector<GLuint>& buffers, const vector<GLsizei>& strides, GLuint elementBuffer)
+{
+    if (gUseDirectStateAccess)
+    {
+        glCreateVertexArrays(1, &vao);
+
+        // Attach each buffer to its binding
+        for (GLuint binding = 0; binding < buffers.size(); binding++)
+            glVertexArrayVertexBuffer(vao, binding, buffers[binding], 0, strides[binding]);
+
+        // Describe each attribute and the binding it reads from
+        for (const VertexAttributeLayout& attribute : layout)
+        {
+            glEnableVertexArrayAttrib(vao, attribute.location);
+            glVertexArrayAttribFormat(vao, attribute.location, attribute.size, GL_FLOAT, GL_FALSE, attribute.offset);
+            glVertexArrayAttribBinding(vao, attribute.location, attribute.binding);
+        }
+
+        if (elementBuffer != 0)
+            glVertexArrayElementBuffer(vao, elementBuffer);
+    }
+    else
+    {
+        // Create and activate the vertex array object
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+
+        // Create vertex attribute pointers
+        for (const VertexAttributeLayout& attribute : layout)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, buffers[attribute.binding]);
+            glVertexAttribPointer(attribute.location, attribute.size, GL_FLOAT, GL_FALSE, strides[attribute.binding], (void*)(size_t)attribute.offset);
+            glEnableVertexAttribArray(attribute.location);
+        }
+
+        if (elementBuffer != 0)
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+}
+
+// Split interleaved vertices into a tightly packed position stream (X, Y, Z) and a stream with the remaining attributes
+void USplitVertexStreams(const vector<GLfloat>& vertices, GLuint floatsPerAttributes, vector<GLfloat>& positions, vector<GLfloat>& attributes)
+{
+    const GLuint floatsPerVertex = 3;
+    size_t vertexCount = vertices.size() / floatsPerAttributes;
+
+    positions.reserve(vertexCount * floatsPerVertex);
+    attributes.reserve(vertexCount * (floatsPerAttributes - floatsPerVertex));
+
+    for (size_t i = 0; i < vertices.size(); i += floatsPerAttributes)
+    {
+        positions.insert(positions.end(), vertices.begin() + i, vertices.begin() + i + floatsPerVertex);
+        attributes.insert(attributes.end(), vertices.begin() + i + floatsPerVertex, vertices.begin() + i + floatsPerAttributes);
+    }
+}
+
+// Create the mesh for all parts of a battery
+void UCreateBatteryMeshes()
+{
+    // Floats per vertex for the texture array layers (layer, decal layer)
+    const GLuint floatsPerLayers = 2;
+
+    // The battery case is capped on both ends; the terminal sits on the case top so it has no bottom face
+    vector<CylinderStackPart> parts = {
+        { BATTERY_CASE_RADIUS, BATTERY_CASE_HEIGHT, true, true,
+            BATTERY_LAYER_CASE_SIDE, BATTERY_LAYER_CASE_TOP, BATTERY_LAYER_CASE_BOTTOM, BATTERY_LAYER_NONE },
+        { BATTERY_TERMINAL_RADIUS, BATTERY_TERMINAL_HEIGHT, true, false,
+            BATTERY_LAYER_TERMINAL_SIDE, BATTERY_LAYER_TERMINAL_TOP, BATTERY_LAYER_NONE, BATTERY_LAYER_NONE }
+    };
+
+    // Create vectors to hold the vertices for the battery mesh
+    vector<GLfloat> vertices;
+    vector<GLushort> indices; // Not used for a battery mesh
+
+    // Build the vertices vector for the case and terminal stacked into one mesh
+    cylinderMeshBuilder.buildStackedMesh(vertices, parts, CYLINDER_SLICES);
+
+    // Create the battery mesh
+    UCreateMesh(gMeshBattery, gMeshIndexed, vertices, indices, floatsPerLayers);
+}
+
+// Create the meshes for all parts of the amp
+void UCreateAmpMeshes()
+{
+    // Create the mesh for the body of the amp
+    UCreateCuboidMesh(gMeshAmp, AMP_WIDTH, AMP_HEIGHT, AMP_LENGTH);
+
+    // Create the meshes for the sides of the amp body for rounded sides and the side of the volume knob in one batch
+    UCreateCylinderSideMeshes({ &gMeshAmpSide, &gMeshVolumeKnobSide }, { CYLINDER_SLICES, CYLINDER_SLICES },
+        { VOLUME_KNOB_RADIUS, VOLUME_KNOB_RADIUS }, { AMP_LENGTH, VOLUME_KNOB_HEIGHT });
+
+    // Create the mesh for the front face of the rounded side of the amp
+    UCreateCylinderFaceMesh(gMeshAmpSideFront, true, CYLINDER_SLICES, VOLUME_KNOB_RADIUS);
+
+    // Create the mesh for the back face of the rounded side of the amp
+    UCreateCylinderFaceMesh(gMeshAmpSideBack, false, CYLINDER_SLICES, VOLUME_KNOB_RADIUS);
+
+    // Create the mesh for the front of the volume knob for the amp
+    UCreateCylinderFaceMesh(gMeshVolumeKnobFront, true, CYLINDER_SLICES, VOLUME_KNOB_RADIUS);
+}
+
+// Create a mesh for a cylinder side
+void UCreateCylinderSideMesh(GLMesh& gMesh, int slices, float radius, float height)
+{
+    // Create a vector to hold the vertices for the cylinder side mesh
+    vector<GLfloat> vertices;
+    vector<GLushort> indices; // Not used for a cylinder mesh
+
+    // Build the vertices vector for the cylinder side mesh
+    cylinderMeshBuilder.buildSideMesh(vertices, slices, radius, height);
+
+    // Create the cylinder side mesh
+    UCreateMesh(gMesh, gMeshIndexed, vertices, indices);
+}
+
+// Create a mesh for each cylinder side from a single batched build of all of them
+void UCreateCylinderSideMeshes(vector<GLMesh*> gMeshes, vector<int> slices, vector<float> radii, vector<float> heights)
+{
+    // Floats per vertex: Position (X, Y, Z) - Normal (nX, nY, nZ) - Texture Coordinate (tX, tY)
+    const GLuint floatsPerVertex = 8;
+
+    // Create vectors to hold the vertices of all cylinder sides and where each one starts
+    vector<GLfloat> batchVertices;
+    vector<GLuint> offsets;
+    vector<GLushort> indices; // Not used for a cylinder mesh
+
+    // Build the vertices of every cylinder side in one call; every mesh needs its own slice count, radius, and height
+    if (gMeshes.size() != slices.size() || !cylinderMeshBuilder.buildSideMeshBatch(batchVertices, offsets, slices, radii, heights))
+    {
+        cout << "ERROR: " << gMeshes.size() << " cylinder side meshes with " << slices.size() << " slice counts, " << radii.size()
+            << " radii, and " << heights.size() << " heights" << endl;
+        return;
+    }
+
+    // Create each cylinder side mesh from its range of the batch
+    for (size_t i = 0; i < gMeshes.size(); i++)
+    {
+        vector<GLfloat> vertices(batchVertices.begin() + offsets[i] * floatsPerVertex, batchVertices.begin() + offsets[i + 1] * floatsPerVertex);
+        UCreateMesh(*gMeshes[i], gMeshIndexed, vertices, indices);
+    }
+}
+
+// Create a mesh for a cylinder face
+void UCreateCylinderFaceMesh(GLMesh& gMesh, bool isTopFace, int slices, float radius)
+{
+    // Create a vector to hold the vertices for the cylinder face mesh
+    vector<GLfloat> vertices;
+    vector<GLushort> indices; // Not used for a cylinder mesh
+
+    // Build the vertices vector for the cylinder face mesh
+    cylinderMeshBuilder.buildFaceMesh(vertices, isTopFace, slices, radius);
+
+    // Create the cylinder face mesh
+    UCreateMesh(gMesh, gMeshIndexed, vertices, indices);
+}
+
+// Create a mesh for a sphere
+void UCreateSphereMesh(GLMeshIndexed& gMeshIndexed, unsigned int segments)
+{
+    // Create vectors to hold the vertices and indices for the sphere mesh
+    vector<GLfloat> vertices;
+    vector<GLushort> indices;
+
+    // Build the vertices and indices vectors for the sphere mesh
+    sphereMeshBuilder.buildMesh(vertices, indices, segments);
+
+    // Create the sphere mesh
+    UCreateMesh(gMesh, gMeshIndexed, vertices, indices);
+}
+
+// Create a mesh for a cuboid
+void UCreateCuboidMesh(GLMesh& gMesh, float width, float height, float length)
+{
+    // Create a vector to hold the vertices for the cuboid mesh
+    vector<GLfloat> vertices;
+    vector<GLushort> indices; // Not used for a cuboid mesh
+
+    // Build the vertices vector for the cuboid mesh
+    cuboidMeshBuilder.buildMesh(vertices, width, height, length);
+
+    // Create the cuboid mesh
+    UCreateMesh(gMesh, gMeshIndexed, vertices, indices);
+}
+
+// Create a mesh for a plane
+void UCreatePlaneMesh(GLMesh& gMesh, float length, float width)
+{
+    // Create a vector to hold the vertices for the plane mesh
+    vector<GLfloat> vertices;
+    vector<GLushort> indices; // Not used for a plane mesh
+
+    // Build the vertices vector for the plane mesh
+    planeMeshBuilder.buildMesh(vertices, length, width);
+
+    // Create the plane mesh
+    UCreateMesh(gMesh, gMeshIndexed, vertices, indices);
+}
+
+// Report the meshes welded since the last report in one line, then start counting again
+void UReportMeshWelding()
+{
+    if (gMeshesWelded == 0)
+        return;
+
+    cout << "INFO: Welded " << gMeshesWelded << " meshes from " << gWeldInputVertices << " to " << gWeldOutputVertices << " vertices ("
+        << (float)gWeldInputVertices / gWeldOutputVertices << "x reduction)" << endl;
+
+    gMeshesWelded = 0;
+    gWeldInputVertices = gWeldOutputVertices = 0;
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+// Resource loading functions
+// ------------------------------------------------------------------------------------------------------------------------
+
+// Load every resource group with the shared loader context current on this thread
+void ULoaderThread()
+{
+    glfwMakeContextCurrent(gLoaderWindow);
+
+    if (!ULoadResources())
+        gResourceLoadFailed = true;
+
+    glfwMakeContextCurrent(NULL);
+}
+
+// Create the meshes and load the textures of every resource group, finishing each group as soon as its uploads are issued
+// Texture files are decoded and built into textures on a thread pool while this thread uploads the meshes, then each texture is uploaded
+// here as soon as it is built
+bool ULoadResources()
+{
+    vector<TextureLoad> textures = UTextureLoads();
+
+    // Decoded images of every texture file and the number of files or textures each texture and group still waits on
+    // A texture with a usable cooked file reads that one file instead of decoding its images
+    vector<vector<TextureImage>> images(textures.size());
+    vector<CookedTexture> cookedTextures(textures.size());
+    vector<bool> useCooked(textures.size());
+    vector<size_t> filesRemaining(textures.size());
+    int texturesRemaining[GROUP_COUNT] = {};
+    size_t totalFiles = 0;
+    size_t textureBytes = 0;
+
+    // Decal and base files of each texture with a decal that are still decoding; the last one of the pair bakes the decal
+    vector<atomic<int>> decalFilesRemaining(textures.size());
+
+    // Files of each texture the decode jobs have not finished, and the texture the job that finishes the last one builds
+    vector<atomic<int>> decodeFilesRemaining(textures.size());
+    vector<BuiltTexture> builtTextures(textures.size());
+
+    // Decoded files in the order they finish, with what the loader reports about each and when the job finished; the job may
+    // release the image itself once it is baked into another, so the record keeps its size
+    struct DecodedFile
+    {
+        size_t texture, file;
+        double milliseconds;
+        int width, height;
+        bool decoded, fallback, bakedDecal;
+        double bakeMilliseconds;
+        chrono::steady_clock::time_point finished;
+    };
+    queue<DecodedFile> decodedFiles;
+    mutex decodedFilesMutex;
+    condition_variable fileDecoded;
+
+    auto loadStart = chrono::steady_clock::now();
+
+    // Declared after the shared state so the pool finishes its jobs before that state is destroyed
+    ThreadPool decodePool;
+
+    // Time this thread spends handing textures to the streamer, which uploads their smallest levels
+    double uploadMilliseconds = 0.0;
+    auto uploadStart = chrono::steady_clock::now();
+
+    // Textures baked into the atlas share its one texture and are not loaded on their own
+    UCreateAtlasTexture(textures, textureBytes);
+    uploadMilliseconds += chrono::duration<double, milli>(chrono::steady_clock::now() - uploadStart).count();
+
+    // Decode every texture file as RGBA on the thread pool, building its mip chain in the same job, and build each texture in the
+    // job that finishes its last file
+    for (size_t t = 0; t < textures.size(); t++)
+    {
+        // Textures in the asset archive are uploaded straight from the mapping; nothing is decoded
+        uploadStart = chrono::steady_clock::now();
+        bool archived = UCreateArchivedTexture(textures[t], textureBytes);
+        uploadMilliseconds += chrono::duration<double, milli>(chrono::steady_clock::now() - uploadStart).count();
+
+        if (archived)
+            continue;
+
+        texturesRemaining[textures[t].group]++;
+
+        // Prefer the cooked texture when one exists in a format the driver can sample, with a layer for every file but the decal;
+        // one cooked before decals were baked in has a layer too many and is decoded from its files instead
+        CookedFormat cookedFormat;
+        int cookedLayers = 0;
+        string cookedPath = UCookedTexturePath(textures[t]);
+        useCooked[t] = textureCooker.readKtx2Format(cookedPath.c_str(), cookedFormat, cookedLayers) && UCookedFormatSupported(cookedFormat);
+
+        if (useCooked[t] && cookedLayers != UCookedTextureLayers(textures[t]))
+        {
+            cout << "INFO: Ignoring " << cookedPath << " with " << cookedLayers << " layers instead of " << UCookedTextureLayers(textures[t])
+                << "; cook the textures again" << endl;
+            useCooked[t] = false;
+        }
+
+        if (useCooked[t])
+        {
+            filesRemaining[t] = 1;
+            totalFiles++;
+
+            decodePool.submit([&, t, cookedPath] {
+                auto readStart = chrono::steady_clock::now();
+
+                DecodedFile decoded = { t, 0, 0.0, 0, 0, false, false, false, 0.0, chrono::steady_clock::time_point() };
+
+                if (!textureCooker.readKtx2(cookedPath.c_str(), cookedTextures[t]))
+                    cookedTextures[t].data.clear();
+
+                decoded.finished = chrono::steady_clock::now();
+                decoded.milliseconds = chrono::duration<double, milli>(decoded.finished - readStart).count();
+
+                {
+                    lock_guard<mutex> lock(decodedFilesMutex);
+                    decodedFiles.push(decoded);
+                }
+
+                fileDecoded.notify_one();
+            });
+
+            continue;
+        }
+
+        images[t].resize(textures[t].filenames.size());
+        filesRemaining[t] = textures[t].filenames.size();
+        totalFiles += textures[t].filenames.size();
+        decalFilesRemaining[t] = textures[t].decalFile > 0 ? 2 : 0;
+        decodeFilesRemaining[t] = (int)textures[t].filenames.size();
+
+        for (size_t f = 0; f < textures[t].filenames.size(); f++)
+        {
+            decodePool.submit([&, t, f] {
+                auto decodeStart = chrono::steady_clock::now();
+                TextureImage& image = images[t][f];
+                DecodedFile decoded = { t, f, 0.0, 0, 0, false, false, false, 0.0, chrono::steady_clock::time_point() };
+
+                // A missing or unreadable file is replaced by the fallback texture so the rest of the scene still loads
+                if (!UDecodeTexture(textures[t].filenames[f], image, 4))
+                    UCreateFallbackImage(image);
+
+                decoded.width = image.width, decoded.height = image.height;
+                decoded.decoded = image.pixels != nullptr, decoded.fallback = image.fallback;
+
+                // Bake the decal once both files of its pair are decoded and build the mip chains of the final images
+                decoded.bakedDecal = UFinishDecodedFile(textures[t], images[t], f, decalFilesRemaining[t], decoded.bakeMilliseconds);
+
+                // The job that finishes the texture's last file builds it, so the loader thread only uploads it
+                if (--decodeFilesRemaining[t] == 0)
+                    UBuildDecodedTexture(textures[t], images[t], builtTextures[t]);
+
+                decoded.finished = chrono::steady_clock::now();
+                decoded.milliseconds = chrono::duration<double, milli>(decoded.finished - decodeStart).count();
+
+                {
+                    lock_guard<mutex> lock(decodedFilesMutex);
+                    decodedFiles.push(decoded);
+                }
+
+                fileDecoded.notify_one();
+            });
+        }
+    }
+
+    // Build and upload the meshes while the textures decode; meshes in the asset archive are uploaded from the mapping instead
+    if (!UCreateArchivedMeshes(GROUP_BATTERY))
+        UCreateBatteryMeshes();
+
+    UTakePendingVertexArrays(GROUP_BATTERY);
+
+    if (!UCreateArchivedMeshes(GROUP_AMP))
+        UCreateAmpMeshes();
+
+    UTakePendingVertexArrays(GROUP_AMP);
+
+    if (!UCreateArchivedMeshes(GROUP_MARBLE))
+        UCreateSphereMesh(gMeshMarble, SPHERE_SEGMENTS);
+
+    UTakePendingVertexArrays(GROUP_MARBLE);
+
+    if (!UCreateArchivedMeshes(GROUP_PHONE_BOX))
+        UCreateCuboidMesh(gMeshPhoneBox, PHONE_BOX_WIDTH, PHONE_BOX_HEIGHT, PHONE_BOX_LENGTH);
+
+    UTakePendingVertexArrays(GROUP_PHONE_BOX);
+
+    if (!UCreateArchivedMeshes(GROUP_TABLE))
+        UCreatePlaneMesh(gMeshTable, TABLE_LENGTH, TABLE_WIDTH);
+
+    UTakePendingVertexArrays(GROUP_TABLE);
+
+    if (!UCreateArchivedMeshes(GROUP_WINDOW))
+        UCreatePlaneMesh(gMeshWindow, WINDOW_MESH_LENGTH, WINDOW_MESH_WIDTH);
+
+    UTakePendingVertexArrays(GROUP_WINDOW);
+
+    // Groups without textures are finished as soon as their meshes are uploaded
+    for (int group = 0; group < GROUP_COUNT; group++)
+    {
+        if (texturesRemaining[group] == 0)
+            UFinishResourceGroup((ResourceGroup)group);
+    }
+
+    bool loaded = true;
+    double decodeMilliseconds = 0.0;
+    auto decodeEnd = loadStart;
+
+    // Upload each texture as soon as all of its files are decoded, in the order they finish
+    for (size_t i = 0; i < totalFiles; i++)
+    {
+        DecodedFile decoded;
+
+        {
+            unique_lock<mutex> lock(decodedFilesMutex);
+            fileDecoded.wait(lock, [&] { return !decodedFiles.empty(); });
+            decoded = decodedFiles.front();
+            decodedFiles.pop();
+        }
+
+        TextureLoad& load = textures[decoded.texture];
+        decodeMilliseconds += decoded.milliseconds;
+        decodeEnd = max(decodeEnd, decoded.finished);
+
+        // A cooked texture is complete with its one file and is uploaded with its stored mip chain
+        if (useCooked[decoded.texture])
+        {
+            CookedTexture& cooked = cookedTextures[decoded.texture];
+            string cookedPath = UCookedTexturePath(load);
+
+            if (cooked.data.empty())
+            {
+                cout << "Failed to load cooked texture " << cookedPath << endl;
+                loaded = false;
+                continue;
+            }
+
+            cout << "INFO: Read " << cookedPath << " (" << cooked.width << "x" << cooked.height << " "
+                << textureCooker.formatName(cooked.format) << ") in " << decoded.milliseconds << " ms" << endl;
+
+            if (!loaded)
+                continue;
+
+            uploadStart = chrono::steady_clock::now();
+            loaded = UCreateCompressedTexture(cooked, load, textureBytes);
+            uploadMilliseconds += chrono::duration<double, milli>(chrono::steady_clock::now() - uploadStart).count();
+            cooked = CookedTexture();
+
+            if (loaded && --texturesRemaining[load.group] == 0)
+                UFinishResourceGroup(load.group);
+
+            continue;
+        }
+
+        // If the file could not be loaded, keep draining the decoded files so every image is released
+        if (!decoded.decoded)
+        {
+            cout << "Failed to load texture " << load.filenames[decoded.file] << endl;
+            loaded = false;
+            continue;
+        }
+
+        if (decoded.fallback)
+            cout << "Failed to load texture " << load.filenames[decoded.file] << "; drawing it with the fallback texture" << endl;
+        else
+            cout << "INFO: Decoded " << load.filenames[decoded.file] << " (" << decoded.width << "x" << decoded.height << ") in "
+                << decoded.milliseconds << " ms" << endl;
+
+        if (decoded.bakedDecal)
+            cout << "INFO: Baked decal " << load.filenames[load.decalFile] << " into " << load.filenames[load.decalFile - 1] << " in "
+                << decoded.bakeMilliseconds << " ms" << endl;
+
+        if (--filesRemaining[decoded.texture] > 0 || !loaded)
+            continue;
+
+        // Every file of the texture is decoded, and the job that finished the last one has built it and released its images
+        uploadStart = chrono::steady_clock::now();
+        loaded = UCreateTexture(builtTextures[decoded.texture], load, textureBytes);
+        uploadMilliseconds += chrono::duration<double, milli>(chrono::steady_clock::now() - uploadStart).count();
+
+        // The group can be drawn once its last texture is uploaded
+        if (loaded && --texturesRemaining[load.group] == 0)
+            UFinishResourceGroup(load.group);
+    }
+
+    // The decoding wall time ends with the last decode job; the uploads on this thread are reported on their own
+    double wallMilliseconds = chrono::duration<double, milli>(decodeEnd - loadStart).count();
+    cout << "INFO: Decoded " << totalFiles << " texture files on " << decodePool.size() << " threads in " << wallMilliseconds
+        << " ms wall time (" << decodeMilliseconds << " ms of decoding and building)" << endl;
+    cout << "INFO: Uploaded the textures in " << uploadMilliseconds << " ms on the loader thread" << endl;
+    cout << "INFO: Texture memory " << textureBytes / 1048576.0 << " MB" << endl;
+    UReportMeshWelding();
+
+    return loaded;
+}
+
+// Give the vertex array objects of the meshes created since the last call to the given group
+void UTakePendingVertexArrays(ResourceGroup group)
+{
+    gResourceGroups[group].vertexArrays = move(gPendingVertexArrays);
+    gPendingVertexArrays.clear();
+}
+
+// Hand the group to the render thread with a fence that signals when its uploads have completed
+void UFinishResourceGroup(ResourceGroup group)
+{
+    ResourceGroupState& state = gResourceGroups[group];
+
+    // Flush so the fence reaches the GPU; the render thread waits on it from its own context
+    state.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+
+    state.uploaded.store(true, memory_order_release);
+}
+
+// Create the vertex array objects of every resource group whose uploads have completed so it is drawn from this frame on
+void UPollResourceGroups()
+{
+    static int readyGroups = 0;
+
+    for (int group = 0; group < GROUP_COUNT; group++)
+    {
+        ResourceGroupState& state = gResourceGroups[group];
+
+        if (state.ready || !state.uploaded.load(memory_order_acquire))
+            continue;
+
+        // Check the fence without waiting; the group stays hidden until the GPU has the data
+        GLenum result = glClientWaitSync(state.fence, 0, 0);
+
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+            continue;
+
+        glDeleteSync(state.fence);
+        state.fence = nullptr;
+
+        for (PendingVertexArray& pending : state.vertexArrays)
+            UCreateVertexArray(*pending.vao, pending.layout, pending.buffers, pending.strides, pending.elementBuffer);
+
+        state.vertexArrays.clear();
+        UCreateTextureLayers((ResourceGroup)group);
+        state.ready = true;
+
+        // Give the group's textures their bindless handles now that their uploads have completed
+        if (gUseBindless)
+            UCreateMaterials((ResourceGroup)group);
+
+        if (++readyGroups == GROUP_COUNT)
+            cout << "INFO: All resources ready " << glfwGetTime() << " seconds after startup" << endl;
+    }
+}
+
+// Fill the image with a magenta and gray checkerboard that makes a missing texture obvious without stopping the program
+// The pixels are allocated the same way stb_image allocates them so they are released like any decoded image
+void UCreateFallbackImage(TextureImage& image)
+{
+    const int size = 64, checkerSize = 8;
+
+    image.width = size, image.height = size, image.channels = 4;
+    image.pixels = (unsigned char*)STBI_MALLOC(size * size * 4);
+    image.fallback = true;
+
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            bool magenta = (x / checkerSize + y / checkerSize) % 2 == 0;
+            unsigned char* pixel = &image.pixels[(y * size + x) * 4];
+
+            pixel[0] = magenta ? 255 : 64;
+            pixel[1] = magenta ? 0 : 64;
+            pixel[2] = magenta ? 255 : 64;
+            pixel[3] = 255;
+        }
+    }
+}
+
+// Bake the load's decal file into the file before it, then remove the decal image so the remaining images match the texture's layers
+// Used by the offline tools, which decode every file before baking; the loader bakes each decal in its decode jobs instead
+void UBakeDecal(const TextureLoad& load, vector<TextureImage>& images)
+{
+    if (load.decalFile <= 0 || load.decalFile >= (int)images.size())
+        return;
+
+    auto bakeStart = chrono::steady_clock::now();
+
+    if (UCompositeDecal(images[load.decalFile - 1], images[load.decalFile]))
+    {
+        double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - bakeStart).count();
+        cout << "INFO: Baked decal " << load.filenames[load.decalFile] << " into " << load.filenames[load.decalFile - 1] << " in "
+            << milliseconds << " ms" << endl;
+    }
+
+    images.erase(images.begin() + load.decalFile);
+}
+
+// Composite a decal into its base image with the same alpha test the object shader used to run per fragment, then release the
+// decal's pixels; returns whether anything was baked
+// The decal is stretched to the base image when their sizes differ; a decal that could not be loaded is left out
+// Safe to call from any thread since it makes no GL calls
+bool UCompositeDecal(TextureImage& base, TextureImage& decal)
+{
+    bool baked = base.pixels && decal.pixels && !decal.fallback;
+
+    if (baked)
+    {
+        const unsigned char* decalPixels = decal.pixels;
+        vector<unsigned char> resized;
+
+        if (decal.width != base.width || decal.height != base.height)
+        {
+            resized.resize((size_t)base.width * base.height * 4);
+            UResizeImage(decal.pixels, decal.width, decal.height, resized.data(), base.width, base.height);
+            decalPixels = resized.data();
+        }
+
+        decalCompositor.composite(base.pixels, decalPixels, (size_t)base.width * base.height, DECAL_ALPHA_THRESHOLD);
+    }
+
+    if (decal.pixels)
+        stbi_image_free(decal.pixels);
+
+    decal.pixels = nullptr;
+
+    return baked;
+}
+
+// Finish a file of a texture on the pool thread that decoded it, once its image is in images[file]
+// A file of a decal pair leaves its image to whichever of the pair is decoded last, which bakes the decal into the base;
+// every image that is then final gets its mip chain, or the levels its packed region keeps for a layer of a texture array that
+// clamps to its edges; repeating array layers are stretched to the largest layer, so their chains wait for every layer
+// Returns whether a decal was baked, with the time it took in bakeMilliseconds
+bool UFinishDecodedFile(const TextureLoad& load, vector<TextureImage>& images, size_t file, atomic<int>& decalFilesRemaining, double& bakeMilliseconds)
+{
+    bool baked = false;
+
+    if (load.decalFile > 0 && ((int)file == load.decalFile || (int)file == load.decalFile - 1))
+    {
+        if (--decalFilesRemaining > 0)
+            return false;
+
+        auto bakeStart = chrono::steady_clock::now();
+        baked = UCompositeDecal(images[load.decalFile - 1], images[load.decalFile]);
+        bakeMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - bakeStart).count();
+
+        file = load.decalFile - 1;
+    }
+
+    // The mip generator runs single threaded here since this job is already on a pool thread
+    TextureImage& image = images[file];
+
+    if (!load.isArray && image.pixels)
+        mipGenerator.generate(image.pixels, image.width, image.height, load.wrapType == GL_REPEAT, nullptr, image.mipLevels);
+    else if (load.wrapType != GL_REPEAT && image.pixels)
+        UBuildPackedLayerMipChain(image);
+
+    return baked;
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+// Draw functions
+// ------------------------------------------------------------------------------------------------------------------------
+
+// Render a frame with all of the objects
+void URender()
+{
+    // Enable z-depth
+    glEnable(GL_DEPTH_TEST);
+
+    // Enable alpha blending for decal textures
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    // Clear the frame and z buffers
+    glClearColor(0.20f, 0.50f, 0.64f, 1.0f); // Dark blue background
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // Wait until the GPU has finished reading the ring regions this frame writes
+    gUniformRing.beginFrame();
+    gLightRing.beginFrame();
+
+    // Read back the pass times of an earlier frame whose queries this frame reuses
+    gpuPassTimer.beginFrame();
+
+    // Write the per-frame data once and bind it for every draw of the frame
+    FrameUniforms frame;
+    UComputeViewProjection(frame.view, frame.projection);
+    gPixelsPerUnit = frame.projection[1][1] * WINDOW_HEIGHT / 2.0f;
+    frame.viewPosition = cameraPos;
+    frame.specSize = gSpecularHighlightSize;
+    frame.padding0 = 0.0f;
+
+    // Scale each window's color by its intensity and sum the ambient light of all of them, which does not depend on the fragment
+    // The clustered lights only add direct light
+    glm::vec3 windowPositions[WINDOW_LIGHT_COUNT] = { gLightPosBack, gLightPosLeft, gLightPosRight };
+    glm::vec3 windowColors[WINDOW_LIGHT_COUNT] = { gLightColorBack * gLightIntenBack, gLightColorLeft * gLightIntenLeft, gLightColorRight * gLightIntenRight };
+    frame.ambientColor = glm::vec3(0.0f);
+
+    for (int i = 0; i < WINDOW_LIGHT_COUNT; i++)
+    {
+        frame.windowPositions[i] = glm::vec4(windowPositions[i], 1.0f);
+        frame.windowColors[i] = glm::vec4(windowColors[i], 1.0f);
+        frame.ambientColor += gAmbientLightStrength * windowColors[i];
+    }
+
+    // List the lights of every cluster for this frame's view
+    UBindLightClusters(frame);
+
+    GLintptr frameOffset;
+    gUniformRing.write(&frame, sizeof(frame), frameOffset);
+    glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, gUniformRing.buffer(), frameOffset, sizeof(frame));
+
+    // Write the material table with the levels the streamer has uploaded so far
+    if (gUseBindless)
+        UBindMaterials();
+
+    UBindTextureLayers();
+
+    // Count the texture binds, draws, and program switches of the frame's shading pass, binding each texture only when it changes
+    gBoundTexture = 0, gBoundTextureArray = 0;
+    gFrameTextureBinds = 0, gFrameObjectDraws = 0, gFrameProgramSwitches = 0;
+
+    if (gRenderPath == RENDER_PATH_DEFERRED)
+    {
+        // Draw the objects into the G-buffer, then light every pixel of it once into the default framebuffer
+        gpuPassTimer.begin(PASS_GBUFFER);
+        UDrawGBuffer();
+        gpuPassTimer.end(PASS_GBUFFER);
+
+        gpuPassTimer.begin(PASS_DEFERRED_LIGHTING);
+        UDrawDeferredLighting(frame);
+        gpuPassTimer.end(PASS_DEFERRED_LIGHTING);
+    }
+    else if (gRenderPath == RENDER_PATH_VISIBILITY)
+    {
+        // Draw the draw and triangle index of every object into the visibility buffer, then shade every covered pixel once
+        gpuPassTimer.begin(PASS_VISIBILITY);
+        UDrawVisibilityBuffer();
+        gpuPassTimer.end(PASS_VISIBILITY);
+
+        gpuPassTimer.begin(PASS_VISIBILITY_RESOLVE);
+        UDrawVisibilityResolve();
+        gpuPassTimer.end(PASS_VISIBILITY_RESOLVE);
+    }
+    else
+    {
+        // Bake the static lighting the first frame every object is loaded, and read it from its own texture unit
+        if (gUseLightmaps && !gLightmapBaked && all_of(begin(gResourceGroups), end(gResourceGroups), [](const ResourceGroupState& state) { return state.ready; }))
+            UBakeLightmap(windowPositions, windowColors, frame.ambientColor);
+
+        if (gLightmap != 0)
+        {
+            glActiveTexture(GL_TEXTURE0 + LIGHTMAP_UNIT);
+            glBindTexture(GL_TEXTURE_2D, gLightmap);
+        }
+
+        if (gDepthPrepass)
+        {
+            // Lay down the depth of every object from the position streams only, without writing color; when comparing the vertex
+            // layouts, every other frame draws the pass from the interleaved vertices under its own timer
+            gDepthPassInterleaved = gCompareDepthStreams && gDepthPrepasses++ % 2 == 1;
+            int depthPass = gDepthPassInterleaved ? PASS_DEPTH_PREPASS_INTERLEAVED : PASS_DEPTH_PREPASS;
+
+            gpuPassTimer.begin(depthPass);
+            gDepthOnlyPass = true;
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+            UDrawObjects();
+            UDrawQueuedObjects();
+
+            gDepthOnlyPass = false;
+            gDepthPassInterleaved = false;
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            gpuPassTimer.end(depthPass);
+
+            // Only the nearest surface of each pixel passes the shading pass
+            glDepthFunc(GL_LEQUAL);
+        }
+
+        // Draw and light the objects
+        gpuPassTimer.begin(PASS_FORWARD_SHADING);
+        UDrawObjects();
+        UDrawQueuedObjects();
+        gpuPassTimer.end(PASS_FORWARD_SHADING);
+    }
+
+    // Report the texture binds of a frame once every object is drawn
+    if (!gTextureBindsReported && all_of(begin(gResourceGroups), end(gResourceGroups), [](const ResourceGroupState& state) { return state.ready; }))
+    {
+        cout << "INFO: " << gFrameTextureBinds << " texture binds for " << gFrameObjectDraws << " object draws per frame"
+            << (gUseBindless ? " with bindless textures" : gTextureAtlas != 0 ? " with the texture atlas" : "") << endl;
+        cout << "INFO: " << gFrameProgramSwitches << " object program switches per frame across " << gObjectPrograms.size()
+            << " compiled shader variants" << endl;
+
+        const ProgramCacheCounters& programs = programCache.counters();
+        cout << "INFO: Shader programs: " << programs.loaded << " loaded from cached binaries in " << programs.loadMilliseconds << " ms, "
+            << programs.compiled << " compiled from source in " << programs.compileMilliseconds << " ms";
+
+        if (programs.rejected > 0)
+            cout << " (" << programs.rejected << " cached binaries rejected by the driver)";
+
+        cout << endl;
+        gTextureBindsReported = true;
+    }
+
+    // Restore the default depth test
+    glDepthFunc(GL_LESS);
+
+    // Draw the light source meshes once they are loaded
+    if (gResourceGroups[GROUP_WINDOW].ready)
+    {
+        UDrawLightMesh(gMeshWindow, gLightPosBack, gLightColorBack, gLightIntenBack,
+            90.0f, 1.0f, 0.0f, 0.0f, WINDOW_MESH_SCALE, WINDOW_MESH_SCALE, WINDOW_MESH_SCALE); // Back window
+
+        UDrawLightMesh(gMeshWindow, gLightPosLeft, gLightColorLeft, gLightIntenLeft,
+            90.0f, 0.0f, 0.0f, 1.0f, WINDOW_MESH_SCALE, WINDOW_MESH_SCALE, WINDOW_MESH_SCALE); // Left window
+
+        UDrawLightMesh(gMeshWindow, gLightPosRight, gLightColorRight, gLightIntenRight,
+            90.0f, 0.0f, 0.0f, 1.0f, WINDOW_MESH_SCALE, WINDOW_MESH_SCALE, WINDOW_MESH_SCALE); // Right window
+    }
+
+    // Fence this frame's ring region so it is not overwritten while the GPU reads it
+    gUniformRing.endFrame();
+    gLightRing.endFrame();
+
+    // Swap buffers and poll IO events
+    glfwSwapBuffers(gWindow);
+}
+
+// Compute the view and projection matrices of the current camera mode
+void UComputeViewProjection(glm::mat4& view, glm::mat4& projection)
+{
+    if (perspective) // If the user is in 3D mode
+    {
+        // Move the camera in 3D space
+        view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+
+        // Creates a perspective projection
+        projection = glm::perspective(45.0f, (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, CAMERA_NEAR, CAMERA_FAR);
+    }
+    else // If the user is in 2D mode
+    {
+        // Move the camera in 2D space
+        view = glm::translate(glm::vec3(cameraPosOrtho.x, cameraPosOrtho.y, 0.0f));
+
+        // Creates an orthogonal projection
+        projection = glm::ortho(-orthoRight, orthoRight, -orthoTop, orthoTop, CAMERA_NEAR, CAMERA_FAR);
+    }
+}
+
+// Write the per-draw data into the uniform ring buffer and bind it for the next draw
+// Returns false when this frame's ring region is full and the draw has to be skipped
+bool UBindDrawUniforms(const glm::mat4& model, const glm::vec2& uvScale, float specularIntensity, const glm::vec4& uvRegion, GLint materialId,
+    const glm::vec4& lightmapRegion, GLint firstTextureLayer)
+{
+    DrawUniforms draw;
+    draw.model = model;
+    draw.uvScale = uvScale;
+    draw.specInten = specularIntensity;
+    draw.uvRegion = uvRegion;
+    draw.materialId = materialId;
+    draw.lightmapRegion = lightmapRegion;
+    draw.firstTextureLayer = firstTextureLayer;
+
+    GLintptr drawOffset;
+
+    if (!gUniformRing.write(&draw, sizeof(draw), drawOffset))
+        return false;
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_UNIFORM_BINDING, gUniformRing.buffer(), drawOffset, sizeof(draw));
+
+    return true;
+}
+
+// Estimate the screen pixels one repeat of a texture covers on a mesh drawn with the given model matrix
+// The meshes are built around unit size, so the largest axis scale stands in for the size of the mesh
+float UTextureScreenPixels(const glm::mat4& model, const glm::vec2& uvScale)
+{
+    float meshSize = max(glm::length(glm::vec3(model[0])), max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    float pixels = meshSize * gPixelsPerUnit;
+
+    // Perspective shrinks the mesh with the distance to its nearest side
+    if (perspective)
+        pixels /= max(glm::distance(cameraPos, glm::vec3(model[3])) - meshSize / 2.0f, 0.1f);
+
+    return pixels / max(uvScale.x, uvScale.y);
+}
+
+// Draw every object in the scene whose resources have finished loading, or every object when loadedOnly is false
+void UDrawObjects(bool loadedOnly)
+{
+    if (!loadedOnly || gResourceGroups[GROUP_BATTERY].ready)
+    {
+        UDrawBattery(3.0f, 0.0f, -11.5f);
+        UDrawBattery(4.0f, 0.0f, -11.5f);
+    }
+
+    if (!loadedOnly || gResourceGroups[GROUP_AMP].ready)
+        UDrawAmp(0.3f, 0.0f, -8.5f);
+
+    if (!loadedOnly || gResourceGroups[GROUP_MARBLE].ready)
+        UDrawMarble(1.1f, 0.0f, -7.5f);
+
+    if (!loadedOnly || gResourceGroups[GROUP_PHONE_BOX].ready)
+        UDrawPhoneBox(-4.0f, 0.0f, -7.0f);
+
+    if (!loadedOnly || gResourceGroups[GROUP_TABLE].ready)
+        UDrawTable(0.0f, -0.0001f, -10.0f);
+}
+
+// Record a draw of a mesh with the given texture, texture scale, coordinates, rotation angle, axis rotation scalars, and size scalars
+// A texture target of GL_TEXTURE_2D_ARRAY samples the layers stored in the mesh vertices instead of a single texture
+// Nothing is drawn until UDrawQueuedObjects, which sorts the draws of the pass by shader variant first
+void UDrawObjectMesh(GLMesh& gMesh, GLMeshIndexed& gMeshIndexed, GLuint& gTexture, glm::vec2& gUVScale,
+    float posX, float posY, float posZ, float rotAngle, float rotX, float rotY, float rotZ, float scaleX, float scaleY, float scaleZ,
+    GLenum textureTarget)
+{
+    // Place object at the given coordinates
+    glm::mat4 translation = glm::translate(glm::vec3(posX, posY, posZ));
+
+    // Rotates the mesh by a given number of degrees along the specified axes
+    glm::mat4 rotation = glm::rotate(glm::radians(rotAngle), glm::vec3(rotX, rotY, rotZ));
+
+    // Scales the object by a given matrix scalar
+    glm::mat4 scale = glm::scale(glm::vec3(scaleX, scaleY, scaleZ));
+
+    // Model matrix transformations are applied right-to-left order
+    glm::mat4 model = translation * rotation * scale;
+
+    // The features the draw needs select its shader variant
+    ShaderVariant variant;
+    variant.textureArray = textureTarget == GL_TEXTURE_2D_ARRAY;
+    variant.hasDecal = variant.textureArray && gMesh.enabled && gMesh.decalLayers;
+    variant.hasSpecular = gSpecularIntensity > 0.0f;
+    variant.clusteredLights = !gLights.empty();
+    variant.gBufferPass = gGBufferPass;
+    variant.visibilityResolve = gVisibilityPass;
+
+    // Static draws read their ambient and window diffuse light from their region of the lightmap once it is baked
+    // UDrawObjects records the same draws in the same order every pass, so the draw's place in the pass finds its region
+    glm::vec4 lightmapRegion(0.0f);
+    const void* meshKey = gMesh.enabled ? (const void*)&gMesh : (const void*)&gMeshIndexed;
+
+    if (gDrawQueue.size() < gLightmapDraws.size() && gLightmapDraws[gDrawQueue.size()].mesh == meshKey)
+        lightmapRegion = gLightmapDraws[gDrawQueue.size()].region;
+
+    variant.hasLightmap = lightmapRegion.z > 0.0f;
+
+    gDrawQueue.push_back({ &gMesh, &gMeshIndexed, &gTexture, gUVScale, model, gSpecularIntensity, textureTarget, variant, lightmapRegion });
+}
+
+// Draw the recorded object draws of the pass and empty the queue
+// The shading pass sorts the draws by shader variant, then texture, so each program is made current once and textures change least
+// The depth prepass and the visibility pass draw positions only, with one program, so their draws are left in order
+void UDrawQueuedObjects()
+{
+    bool positionOnlyPass = gDepthOnlyPass || gVisibilityPass;
+
+    if (!positionOnlyPass)
+    {
+        stable_sort(gDrawQueue.begin(), gDrawQueue.end(), [](const QueuedDraw& a, const QueuedDraw& b) {
+            int keyA = UShaderVariantKey(a.variant), keyB = UShaderVariantKey(b.variant);
+            return keyA != keyB ? keyA < keyB : *a.texture < *b.texture;
+        });
+    }
+
+    GLuint currentProgram = 0;
+
+    for (QueuedDraw& queued : gDrawQueue)
+    {
+        GLMesh& gMesh = *queued.mesh;
+        GLMeshIndexed& gMeshIndexed = *queued.meshIndexed;
+        GLuint& gTexture = *queued.texture;
+
+        // Set the shader to be used; depth-only passes use the depth shader and the visibility pass the visibility shader
+        GLuint programId = gDepthOnlyPass ? gDepthProgramId : gVisibilityPass ? gVisibilityProgramId : UObjectProgram(queued.variant);
+
+        if (programId == 0)
+            continue;
+
+        if (programId != currentProgram)
+        {
+            glUseProgram(programId);
+            currentProgram = programId;
+
+            if (!positionOnlyPass)
+                gFrameProgramSwitches++;
+        }
+
+        // Textures baked into the atlas sample their region of it
+        glm::vec4 uvRegion(0.0f, 0.0f, 1.0f, 1.0f);
+        auto atlasRegion = gAtlasRegions.find(&gTexture);
+
+        if (atlasRegion != gAtlasRegions.end())
+            uvRegion = atlasRegion->second;
+
+        // Bindless draws find their texture in the material table
+        GLint materialId = 0;
+        auto material = gMaterialIds.find(gTexture);
+
+        if (gUseBindless && material != gMaterialIds.end())
+            materialId = material->second;
+
+        // Texture arrays find their layers' regions in the layer table
+        GLint firstTextureLayer = 0;
+        auto textureLayers = gFirstTextureLayers.find(gTexture);
+
+        if (textureLayers != gFirstTextureLayers.end())
+            firstTextureLayer = textureLayers->second;
+
+        // Ask the texture streamer for the mip levels this draw needs; the visibility pass asks for the resolve passes that sample them
+        if (!gDepthOnlyPass)
+        {
+            float texturePixels = UTextureScreenPixels(queued.model, queued.uvScale * glm::vec2(uvRegion.z, uvRegion.w));
+            textureStreamer.request(gTexture, texturePixels);
+        }
+
+        // Write the model matrix, texture scale, specular intensity, atlas region, material, lightmap region, and first texture layer
+        // into the ring buffer
+        if (!UBindDrawUniforms(queued.model, queued.uvScale, queued.specularIntensity, uvRegion, materialId, queued.lightmapRegion,
+            firstTextureLayer))
+            continue;
+
+        // Record the draw for the visibility resolve, which needs its mesh in the mesh arena
+        if (gVisibilityPass)
+        {
+            if (!URecordVisibilityDraw(queued, uvRegion, materialId, firstTextureLayer))
+                continue;
+
+            gFrameObjectDraws++;
+        }
+
+        if (positionOnlyPass)
+        {
+            // Draw the triangles from the position stream only; meshes without one, and the interleaved depth prepass of the
+            // comparison, draw from the interleaved vertices
+            if (gMesh.enabled == true)
+            {
+                glBindVertexArray(gMesh.positionVao != 0 && !gDepthPassInterleaved ? gMesh.positionVao : gMesh.vao);
+
+                if (gMesh.nIndices > 0)
+                    glDrawElements(GL_TRIANGLES, gMesh.nIndices, gMesh.indexType, NULL);
+                else
+                    glDrawArrays(GL_TRIANGLES, 0, gMesh.nVertices);
+            }
+            else if (gMeshIndexed.enabled == true)
+            {
+                glBindVertexArray(gMeshIndexed.positionVao != 0 && !gDepthPassInterleaved ? gMeshIndexed.positionVao : gMeshIndexed.vao);
+                glDrawElements(GL_TRIANGLE_STRIP, gMeshIndexed.nIndices, GL_UNSIGNED_SHORT, NULL);
+            }
+
+            continue;
+        }
+
+        if (gUseBindless)
+        {
+            // The material holds the texture; nothing is bound
+        }
+        else if (queued.textureTarget == GL_TEXTURE_2D_ARRAY)
+        {
+            // Activate and bind the texture array unless it is still bound from the last draw
+            if (gTexture != gBoundTextureArray)
+            {
+                glActiveTexture(GL_TEXTURE2);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, gTexture);
+                gBoundTextureArray = gTexture;
+                gFrameTextureBinds++;
+            }
+        }
+        else if (gTexture != gBoundTexture)
+        {
+            // Activate and bind the texture unless it is still bound from the last draw, as it is for draws sharing the atlas
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, gTexture);
+            gBoundTexture = gTexture;
+            gFrameTextureBinds++;
+        }
+
+        gFrameObjectDraws++;
+
+        if (gMesh.enabled == true)
+        {
+            // Activate the VBOs contained within the mesh's VAO
+            glBindVertexArray(gMesh.vao);
+
+            // Draws the triangles
+            if (gMesh.nIndices > 0)
+                glDrawElements(GL_TRIANGLES, gMesh.nIndices, gMesh.indexType, NULL);
+            else
+                glDrawArrays(GL_TRIANGLES, 0, gMesh.nVertices);
+        }
+        else if (gMeshIndexed.enabled == true)
+        {
+            // Activate the VBOs contained within the mesh's VAO
+            glBindVertexArray(gMeshIndexed.vao);
+
+            // Draws the triangles
+            glDrawElements(GL_TRIANGLE_STRIP, gMeshIndexed.nIndices, GL_UNSIGNED_SHORT, NULL);
+        }
+    }
+
+    gDrawQueue.clear();
+
+    // Deactivate the VAO and shader
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
+
+// Draw a light source mesh with the given coordinates, color, intensity, rotation angle, axis rotation scalars, and size scalars
+void UDrawLightMesh(GLMesh& gMesh, glm::vec3 lightPos, glm::vec3 lightColor, float lightIntensity,
+    float rotAngle, float rotX, float rotY, float rotZ, float scaleX, float scaleY, float scaleZ)
+{
+    // Set the shader to be used
+    glUseProgram(gLampProgramId);
+
+    // Place object at the given coordinates
+    glm::mat4 translation = glm::translate(lightPos);
+
+    // Rotates the mesh by a given number of degrees along the specified axes
+    glm::mat4 rotation = glm::rotate(glm::radians(rotAngle), glm::vec3(rotX, rotY, rotZ));
+
+    // Scales the object by a given matrix scalar
+    glm::mat4 scale = glm::scale(glm::vec3(scaleX, scaleY, scaleZ));
+
+    // Model matrix transformations are applied right-to-left order
+    glm::mat4 model = translation * rotation * scale;
+
+    // Write the model matrix into the ring buffer; the lamp shader only reads the model matrix
+    if (!UBindDrawUniforms(model, glm::vec2(1.0f, 1.0f), 0.0f))
+    {
+        glUseProgram(0);
+        return;
+    }
+
+    // Set light mesh color uniform with the given color and intensity
+    GLint lightColorBackLoc = glGetUniformLocation(gLampProgramId, "lightColor");
+    glUniform3f(lightColorBackLoc, lightColor.r * lightIntensity, lightColor.g * lightIntensity, lightColor.b * lightIntensity);
+
+    // Activate the VBOs contained within the mesh's VAO
+    glBindVertexArray(gMesh.vao);
+
+    // Draws the triangles
+    if (gMesh.nIndices > 0)
+        glDrawElements(GL_TRIANGLES, gMesh.nIndices, gMesh.indexType, NULL);
+    else
+        glDrawArrays(GL_TRIANGLES, 0, gMesh.nVertices);
+
+    // Deactivate the VAO and shader
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
+
+// Draw the battery mesh at the given coordinates
+void UDrawBattery(float x, float y, float z)
+{
+    // Set the shininess for the battery
+    gSpecularIntensity = BATTERY_SPECULAR_INTENSITY;
+
+    // Rotate the battery side so the "Duracell" label is facing the front
+    float batteryRotationDegrees = 116.0f;
+
+    // Make the battery larger
+    float batteryScale = 2.0f;
+
+    // Draw the whole battery mesh at the given coordinates with rotation along the Y-axis and defined scale; every part samples its own texture array layer
+    UDrawObjectMesh(gMeshBattery, gMeshIndexed, gTextureBatteryArray, gUVScaleBattery,
+        x, y, z, batteryRotationDegrees, 0.0f, 1.0f, 0.0f, batteryScale, batteryScale, batteryScale, GL_TEXTURE_2D_ARRAY);
+}
+
+// Draw the amp meshes at the given coordinates
+void UDrawAmp(float x, float y, float z)
+{
+    // Set the shininess for the amp
+    gSpecularIntensity = AMP_SPECULAR_INTENSITY;
+
+    // Make the amp larger
+    float ampScale = 5.0;
+
+    // Move the volume knob to the right on the amp's front face
+    float volumeKnobOffset = AMP_WIDTH * ampScale;
+
+    // Create a very small Z-axis offset to avoid texture Z-fighting from the faces of the amp sides and the main body
+    float zOffset = 0.0001f;
+    
+    // Draw the amp body mesh at the given coordinates with no rotation and the defined scale
+    UDrawObjectMesh(gMeshAmp, gMeshIndexed, gTextureAmp, gUVScaleAmp,
+        x, y, z, 0.0f, 1.0f, 1.0f, 1.0f, ampScale, ampScale, ampScale);
+
+    // Draw the volume knob side mesh at the given coordinates with 90 degree rotation along the X-axis and the defined scale
+    UDrawObjectMesh(gMeshVolumeKnobSide, gMeshIndexed, gTextureVolumeKnobSide, gUVScaleVolumeKnobSide,
+        x + volumeKnobOffset, y + VOLUME_KNOB_RADIUS * ampScale, z, 90.0f, 1.0f, 0.0f, 0.0f, ampScale, ampScale, ampScale);
+
+    // Draw the volume knob front mesh directly on top of the side mesh with 90 degree rotation along the X-axis and the defined scale
+    UDrawObjectMesh(gMeshVolumeKnobFront, gMeshIndexed, gTextureVolumeKnobFront, gUVScaleVolumeKnobFront,
+        x + volumeKnobOffset, y + VOLUME_KNOB_RADIUS * ampScale, z + VOLUME_KNOB_HEIGHT * ampScale, 90.0f, 1.0f, 0.0f, 0.0f, ampScale, ampScale, ampScale);
+
+    // Draw the amp side mesh on the right side of body with 90 degree rotation along the X-axis and the defined scale
+    UDrawObjectMesh(gMeshAmpSide, gMeshIndexed, gTextureAmpSide, gUVScaleAmpSide,
+        x + volumeKnobOffset, y + VOLUME_KNOB_RADIUS * ampScale, z - AMP_LENGTH * ampScale, 90.0f, 1.0f, 0.0f, 0.0f, ampScale, ampScale, ampScale);
+
+    // Draw the amp side back face mesh at the back of the right rounded side with 90 degree rotation along the X-axis and the defined scale
+    UDrawObjectMesh(gMeshAmpSideBack, gMeshIndexed, gTextureAmpSideFace, gUVScaleAmpSide,
+        x + volumeKnobOffset, y + VOLUME_KNOB_RADIUS * ampScale, z + zOffset - AMP_LENGTH * ampScale, 90.0f, 1.0f, 0.0f, 0.0f, ampScale, ampScale, ampScale);
+
+    // Draw the amp side mesh on the left side of body with 90 degree rotation along the X-axis and the defined scale
+    UDrawObjectMesh(gMeshAmpSide, gMeshIndexed, gTextureAmpSide, gUVScaleAmpSide,
+        x , y + VOLUME_KNOB_RADIUS * ampScale, z - AMP_LENGTH * ampScale, 90.0f, 1.0f, 0.0f, 0.0f, ampScale, ampScale, ampScale);
+
+    // Draw the amp side back face mesh at the back of the left rounded side with 90 degree rotation along the X-axis and the defined scale
+    UDrawObjectMesh(gMeshAmpSideBack, gMeshIndexed, gTextureAmpSideFace, gUVScaleAmpSide,
+        x, y + VOLUME_KNOB_RADIUS * ampScale, z + zOffset - AMP_LENGTH * ampScale, 90.0f, 1.0f, 0.0f, 0.0f, ampScale, ampScale, ampScale);
+
+    // Draw the amp side front face mesh at the front of the left rounded side with 90 degree rotation along the X-axis and the defined scale
+    UDrawObjectMesh(gMeshAmpSideFront, gMeshIndexed, gTextureAmpSideFace, gUVScaleAmpSide,
+        x, y + VOLUME_KNOB_RADIUS * ampScale, z - zOffset, 90.0f, 1.0f, 0.0f, 0.0f, ampScale, ampScale, ampScale);
+}
+
+// Draw the marble mesh at the given coordinates
+void UDrawMarble(float x, float y, float z)
+{
+    // Set the shininess for the marble
+    gSpecularIntensity = MARBLE_SPECULAR_INTENSITY;
+
+    // Make the marble smaller
+    float marbleScale = 0.25f;
+
+    // Draw the marble mesh at the given coordinates with no rotation and the defined scale
+    UDrawObjectMesh(gMesh, gMeshMarble, gTextureMarble, gUVScaleMarble,
+        x, y + marbleScale, z, 0.0f, 1.0f, 1.0f, 1.0f, marbleScale, marbleScale, marbleScale);
+}
+
+// Draw the phone box mesh at the given coordinates
+void UDrawPhoneBox(float x, float y, float z)
+{
+    // Set the shininess for the phone box
+    gSpecularIntensity = PHONE_BOX_SPECULAR_INTENSITY;
+
+    // Make the phone box larger
+    float phoneBoxScale = 11.5f;
+
+    // Draw the phone box mesh at the given coordinates with no rotation and the defined scale
+    UDrawObjectMesh(gMeshPhoneBox, gMeshIndexed, gTexturePhoneBox, gUVScalePhoneBox,
+        x, y, z, 0.0f, 1.0f, 1.0f, 1.0f, phoneBoxScale, phoneBoxScale, phoneBoxScale);
+}
+
+// Draw the table surface mesh at the given coordinates
+void UDrawTable(float x, float y, float z)
+{
+    // Set the shininess for the table
+    gSpecularIntensity = TABLE_SPECULAR_INTENSITY;
+
+    // Make the table larger
+    float tableScale = 10.0f;
+
+    // Draw the table surface mesh at the given coordinates with no rotation and default scale
+    UDrawObjectMesh(gMeshTable, gMeshIndexed, gTextureTable, gUVScaleTable,
+        x, y, z, 0.0f, 1.0f, 1.0f, 1.0f, tableScale, tableScale, tableScale);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+// Setup functions
+// ------------------------------------------------------------------------------------------------------------------------
+
+// Initialize GLFW, GLEW, and create a window
+bool UInitialize(int argc, char* argv[], GLFWwindow** window)
+{
+    // GLFW: initialize and configure
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    #ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    #endif
+
+    // GLFW: window creation
+    * window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_TITLE, NULL, NULL);
+    if (*window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return false;
+    }
+    glfwMakeContextCurrent(*window);
+    glfwSetFramebufferSizeCallback(*window, UResizeWindow);
+
+    // GLFW: create a hidden window sharing the main context's objects for the resource loader thread
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    gLoaderWindow = glfwCreateWindow(1, 1, WINDOW_TITLE, NULL, *window);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+    if (gLoaderWindow == NULL)
+        cout << "INFO: No shared context for the resource loader; resources load before the first frame" << endl;
+
+    // GLFW: enable mouse and scrollwheel input
+    glfwSetInputMode(gWindow, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+    glfwSetCursorPosCallback(gWindow, UMouseCallback);
+    glfwSetScrollCallback(gWindow, UScrollWheelCallback);
+
+    // GLEW: initialize
+    glewExperimental = GL_TRUE;
+    GLenum GlewInitResult = glewInit();
+
+    if (GLEW_OK != GlewInitResult)
+    {
+        std::cerr << glewGetErrorString(GlewInitResult) << std::endl;
+        return false;
+    }
+
+    // Displays GPU OpenGL version
+    cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << endl;
+
+    // Use direct state access for mesh uploads when the driver supports it, otherwise bind to edit
+    gUseDirectStateAccess = GLEW_VERSION_4_5 || GLEW_ARB_direct_state_access;
+    cout << "INFO: Mesh uploads use " << (gUseDirectStateAccess ? "direct state access with immutable buffers" : "bound buffers") << endl;
+
+    return true;
+}
+
+// GLFW: whenever the window size changed (by OS or user resize) this callback function executes
+void UResizeWindow(GLFWwindow* window, int width, int height)
+{
+    glViewport(0, 0, width, height);
+}
+
+// Create a shader program from the given vertex shader and fragment shader sources, waiting for it to compile
+bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId)
+{
+    PendingProgram pending;
+
+    USubmitShaderProgram(vtxShaderSource, fragShaderSource, pending);
+
+    return UFinishShaderProgram(pending, programId);
+}
+
+// Submit a shader program for compilation without waiting for the result
+// The program is created from its cached binary when the program cache has one the driver accepts; otherwise both shaders are
+// compiled and the program linked right away, with no status checked in between, so the driver can work on them in the background
+void USubmitShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, PendingProgram& pending)
+{
+    auto submitStart = chrono::steady_clock::now();
+
+    // Create a Shader program object
+    pending.programId = glCreateProgram();
+    pending.cacheKey = programCache.key(vtxShaderSource, fragShaderSource);
+    pending.submitted = submitStart;
+    pending.fromCache = programCache.load(pending.cacheKey, pending.programId);
+
+    if (!pending.fromCache)
+    {
+        // Create the vertex and fragment shader objects
+        pending.vertexShaderId = glCreateShader(GL_VERTEX_SHADER);
+        pending.fragmentShaderId = glCreateShader(GL_FRAGMENT_SHADER);
+
+        // Retrive the shader source
+        glShaderSource(pending.vertexShaderId, 1, &vtxShaderSource, NULL);
+        glShaderSource(pending.fragmentShaderId, 1, &fragShaderSource, NULL);
+
+        // Compile the vertex and fragment shaders
+        glCompileShader(pending.vertexShaderId);
+        glCompileShader(pending.fragmentShaderId);
+
+        // Attached compiled shaders to the shader program
+        glAttachShader(pending.programId, pending.vertexShaderId);
+        glAttachShader(pending.programId, pending.fragmentShaderId);
+
+        // Link the shader program, keeping its binary retrievable for the program cache
+        glProgramParameteri(pending.programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(pending.programId);
+    }
+
+    pending.blockedMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - submitStart).count();
+}
+
+// Whether checking the status of a submitted program would return without waiting for the driver
+// Without KHR_parallel_shader_compile there is no way to ask, so a program only counts as ready when it came from the cache
+bool UShaderProgramReady(const PendingProgram& pending)
+{
+    if (pending.fromCache)
+        return true;
+
+    if (!gParallelShaderCompile)
+        return false;
+
+    GLint complete = GL_FALSE;
+    glGetProgramiv(pending.programId, GL_COMPLETION_STATUS_KHR, &complete);
+
+    return complete == GL_TRUE;
+}
+
+// Check the compile and link status of a submitted program, waiting for the driver if it is not done yet
+// A program that compiled is saved to the program cache and made current
+bool UFinishShaderProgram(PendingProgram& pending, GLuint& programId)
+{
+    auto finishStart = chrono::steady_clock::now();
+    ProgramCacheCounters& programs = programCache.counters();
+
+    programId = pending.programId;
+
+    if (pending.fromCache)
+    {
+        programs.loaded++;
+        programs.loadMilliseconds += pending.blockedMilliseconds;
+        glUseProgram(programId); // Uses the shader program
+
+        return true;
+    }
+
+    // Compilation and linkage error reporting
+    int success = 0;
+    char infoLog[512];
+    bool compiled = false;
+
+    // Check for shader compile errors
+    glGetShaderiv(pending.vertexShaderId, GL_COMPILE_STATUS, &success);
+
+    // If the vertex shader successfully compiled
+    if (!success)
+    {
+        glGetShaderInfoLog(pending.vertexShaderId, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+    }
+    else
+    {
+        glGetShaderiv(pending.fragmentShaderId, GL_COMPILE_STATUS, &success);
+
+        // If the fragment shader successfully compiled
+        if (!success)
+        {
+            glGetShaderInfoLog(pending.fragmentShaderId, sizeof(infoLog), NULL, infoLog);
+            std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+        }
+        else
+        {
+            // Check for linking errors
+            glGetProgramiv(pending.programId, GL_LINK_STATUS, &success);
+
+            // If the shader was successfully linked
+            if (!success)
+            {
+                glGetProgramInfoLog(pending.programId, sizeof(infoLog), NULL, infoLog);
+                std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+            }
+            else
+                compiled = true;
+        }
+    }
+
+    // The shaders are only needed again if the program is relinked; flag them to be deleted with the program
+    glDeleteShader(pending.vertexShaderId);
+    glDeleteShader(pending.fragmentShaderId);
+    pending.vertexShaderId = pending.fragmentShaderId = 0;
+
+    if (!compiled)
+        return false;
+
+    programCache.save(pending.cacheKey, programId);
+    programs.compiled++;
+    programs.compileMilliseconds += pending.blockedMilliseconds + chrono::duration<double, milli>(chrono::steady_clock::now() - finishStart).count();
+
+    glUseProgram(programId); // Uses the shader program
+
+    return true;
+}
+
+// Insert lines such as extension directives right after the version line of a shader source
+string UInsertShaderLines(const char* source, const char* lines)
+{
+    string inserted = source;
+    size_t versionEnd = inserted.find('\n');
+
+    inserted.insert(versionEnd == string::npos ? inserted.size() : versionEnd + 1, lines);
+
+    return inserted;
+}
+
+// Key of a shader variant in the program cache; variants that sort together share their texture target and lighting
+int UShaderVariantKey(const ShaderVariant& variant)
+{
+    return (variant.textureArray ? 1 : 0) | (variant.hasDecal ? 2 : 0) | (variant.hasSpecular ? 4 : 0) | (variant.clusteredLights ? 8 : 0) | (variant.gBufferPass ? 16 : 0)
+        | (variant.visibilityResolve ? 32 : 0) | (variant.hasLightmap ? 64 : 0);
+}
+
+// The #define lines of a shader variant, inserted after the version line of both object shader sources
+// The window count and the size of the layer table are the same for every variant; the switches are defined as true or false so the shaders test them in plain if statements, which the compiler folds away
+string UShaderVariantDefines(const ShaderVariant& variant)
+{
+    string defines = "#define WINDOW_LIGHT_COUNT " + to_string(WINDOW_LIGHT_COUNT) + "\n";
+    defines += "#define MAX_TEXTURE_LAYERS " + to_string(MAX_TEXTURE_LAYERS) + "\n";
+    defines += string("#define TEXTURE_ARRAY ") + (variant.textureArray ? "true" : "false") + "\n";
+    defines += string("#define HAS_DECAL ") + (variant.hasDecal ? "true" : "false") + "\n";
+    defines += string("#define HAS_SPECULAR ") + (variant.hasSpecular ? "true" : "false") + "\n";
+    defines += string("#define CLUSTERED_LIGHTS ") + (variant.clusteredLights ? "true" : "false") + "\n";
+    defines += string("#define GBUFFER_PASS ") + (variant.gBufferPass ? "true" : "false") + "\n";
+    defines += string("#define HAS_LIGHTMAP ") + (variant.hasLightmap ? "true" : "false") + "\n";
+
+    if (variant.visibilityResolve)
+        defines += "#define VISIBILITY_TRIANGLE_BITS " + to_string(VISIBILITY_TRIANGLE_BITS) + "\n";
+
+    return defines;
+}
+
+// The vertex and fragment shader sources of a variant with its #define lines inserted
+// Visibility resolve variants draw a full-screen triangle and shade from the visibility buffer instead of the object's vertices
+void UShaderVariantSources(const ShaderVariant& variant, string& vertexSource, string& fragmentSource)
+{
+    string defines = UShaderVariantDefines(variant);
+
+    if (variant.visibilityResolve)
+    {
+        vertexSource = UInsertShaderLines(UShaderSource("shader/fullscreen.vert", fullScreenVertexShaderSource), defines.c_str());
+        fragmentSource = UInsertShaderLines(gResolveFragmentSource.c_str(), defines.c_str());
+    }
+    else
+    {
+        vertexSource = UInsertShaderLines(gObjectVertexSource.c_str(), defines.c_str());
+        fragmentSource = UInsertShaderLines(gObjectFragmentSource.c_str(), defines.c_str());
+    }
+}
+
+// Get the object shader program of a variant, compiling it the first time a draw needs it
+// A variant submitted at startup is finished here, waiting for the driver if it is still compiling
+// Returns zero for a variant that failed to compile; the failure is only reported once and its draws are skipped
+GLuint UObjectProgram(const ShaderVariant& variant)
+{
+    int key = UShaderVariantKey(variant);
+    auto cached = gObjectPrograms.find(key);
+
+    if (cached != gObjectPrograms.end())
+        return cached->second;
+
+    auto pending = gPendingObjectPrograms.find(key);
+
+    if (pending == gPendingObjectPrograms.end())
+    {
+        string vertexSource, fragmentSource;
+        UShaderVariantSources(variant, vertexSource, fragmentSource);
+
+        pending = gPendingObjectPrograms.emplace(key, PendingVariant{ variant, PendingProgram() }).first;
+        USubmitShaderProgram(vertexSource.c_str(), fragmentSource.c_str(), pending->second.program);
+    }
+
+    GLuint programId = UFinishObjectProgram(key, pending->second);
+    gPendingObjectPrograms.erase(pending);
+
+    return programId;
+}
+
+// Submit the object shader variants the scene's draws ask for, so they compile alongside the rest of startup
+// The draws of every object are recorded as a frame records them once the scene is loaded, and their variants collected from the
+// queue for the chosen render path; a draw of a triangle list mesh switches to its lightmap variant once the lightmap is baked
+// The meshes are not created yet, so a mesh whose vertices turn out to sample a decal layer compiles its decal variant on its first draw
+void USubmitObjectPrograms()
+{
+    UDrawObjects(false);
+
+    map<int, ShaderVariant> variants;
+
+    for (const QueuedDraw& queued : gDrawQueue)
+    {
+        ShaderVariant variant = queued.variant;
+        variant.gBufferPass = gRenderPath == RENDER_PATH_DEFERRED;
+        variant.visibilityResolve = gRenderPath == RENDER_PATH_VISIBILITY;
+        variants[UShaderVariantKey(variant)] = variant;
+
+        // UBakeLightmap gives a region to every draw of a mesh with lightmap coordinates, which the loader unwraps for every triangle list
+        if (gUseLightmaps && queued.mesh->enabled)
+        {
+            variant.hasLightmap = true;
+            variants[UShaderVariantKey(variant)] = variant;
+        }
+    }
+
+    gDrawQueue.clear();
+
+    for (const auto& variant : variants)
+    {
+        string vertexSource, fragmentSource;
+        UShaderVariantSources(variant.second, vertexSource, fragmentSource);
+
+        PendingVariant& pending = gPendingObjectPrograms[variant.first];
+        pending.variant = variant.second;
+        USubmitShaderProgram(vertexSource.c_str(), fragmentSource.c_str(), pending.program);
+    }
+}
+
+// Check the status of a submitted object shader variant and add it to the program cache of the variants
+GLuint UFinishObjectProgram(int key, PendingVariant& pending)
+{
+    const ShaderVariant& variant = pending.variant;
+    GLuint programId = 0;
+
+    if (UFinishShaderProgram(pending.program, programId))
+    {
+        // Tell OpenGL for each sampler which texture unit it belongs to: the main texture is unit 0, the texture array unit 2,
+        // and the lightmap its own unit
+        glUniform1i(glGetUniformLocation(programId, "uTexture"), 0);
+        glUniform1i(glGetUniformLocation(programId, "uTextureArray"), 2);
+        glUniform1i(glGetUniformLocation(programId, "uLightmap"), LIGHTMAP_UNIT);
+
+        double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - pending.program.submitted).count();
+        cout << "INFO: Object shader variant " << key << " (" << (variant.textureArray ? "texture array" : "texture")
+            << (variant.hasDecal ? ", decal" : "") << (variant.hasSpecular ? ", specular" : "") << (variant.clusteredLights ? ", clustered lights" : "")
+            << (variant.gBufferPass ? ", G-buffer" : "") << (variant.visibilityResolve ? ", visibility resolve" : "") << (variant.hasLightmap ? ", lightmap" : "") << ") "
+            << (pending.program.fromCache ? "loaded" : "compiled") << " " << milliseconds << " ms after submission" << endl;
+    }
+    else
+    {
+        cout << "ERROR: Object shader variant " << key << " failed to compile; its draws are skipped" << endl;
+        glDeleteProgram(programId);
+        programId = 0;
+    }
+
+    gObjectPrograms[key] = programId;
+
+    return programId;
+}
+
+// Finish the submitted object shader variants the driver has completed, without waiting on any that are still compiling
+// Without KHR_parallel_shader_compile the driver can not say which are complete, so once every resource group is ready and
+// waiting no longer holds back the scene, one variant no draw has needed yet is finished per frame, waiting if it has to,
+// which spreads the compiles over the frames instead of stalling a single one
+void UPollShaderPrograms()
+{
+    bool waitForOne = !gParallelShaderCompile;
+
+    for (const ResourceGroupState& state : gResourceGroups)
+        waitForOne = waitForOne && state.ready;
+
+    for (auto pending = gPendingObjectPrograms.begin(); pending != gPendingObjectPrograms.end();)
+    {
+        if (UShaderProgramReady(pending->second.program) || waitForOne)
+        {
+            UFinishObjectProgram(pending->first, pending->second);
+            pending = gPendingObjectPrograms.erase(pending);
+            waitForOne = false;
+        }
+        else
+            ++pending;
+    }
+
+    // Report how long startup took to have every program ready once the last one completes
+    if (!gShaderProgramsReported && gPendingObjectPrograms.empty())
+    {
+        const ProgramCacheCounters& programs = programCache.counters();
+        cout << "INFO: All shader programs ready " << chrono::duration<double, milli>(chrono::steady_clock::now() - gShaderSubmitTime).count()
+            << " ms after submission (" << programs.loaded << " from cached binaries, " << programs.compiled << " compiled)" << endl;
+        gShaderProgramsReported = true;
+    }
+}
+
+// Every texture of the scene; the battery files are listed in the order of the battery texture array layers,
+// with the case side decal right after the case side it is baked into
+vector<TextureLoad> UTextureLoads()
+{
+    return {
+        { {
+            "resources/textures/battery_case_side.png",
+            "resources/textures/battery_case_side_decal.png", // Decal for the positive and negative pole indicators
+            "resources/textures/battery_case_top.png",
+            "resources/textures/battery_case_bottom.png",
+            "resources/textures/battery_terminal_side.png",
+            "resources/textures/battery_terminal_top.png"
+        }, &gTextureBatteryArray, GL_CLAMP_TO_EDGE, true, GROUP_BATTERY, 1 },
+        { { "resources/textures/amp.png" }, &gTextureAmp, GL_CLAMP_TO_EDGE, false, GROUP_AMP },
+        { { "resources/textures/amp_side.png" }, &gTextureAmpSide, GL_CLAMP_TO_EDGE, false, GROUP_AMP },
+        { { "resources/textures/amp_side_face.png" }, &gTextureAmpSideFace, GL_CLAMP_TO_EDGE, false, GROUP_AMP },
+        { { "resources/textures/volume_knob_side.png" }, &gTextureVolumeKnobSide, GL_REPEAT, false, GROUP_AMP },
+        { { "resources/textures/volume_knob_front.png" }, &gTextureVolumeKnobFront, GL_CLAMP_TO_EDGE, false, GROUP_AMP },
+        { { "resources/textures/marble.png" }, &gTextureMarble, GL_CLAMP_TO_EDGE, false, GROUP_MARBLE },
+        { { "resources/textures/phone_box.png" }, &gTexturePhoneBox, GL_CLAMP_TO_EDGE, false, GROUP_PHONE_BOX },
+        { { "resources/textures/table_tile.png" }, &gTextureTable, GL_REPEAT, false, GROUP_TABLE }
+    };
+}
+
+// Decode an image file; a desired channel count of zero keeps the channels stored in the file
+// Safe to call from any thread since it makes no GL calls
+bool UDecodeTexture(const char* filename, TextureImage& image, int desiredChannels)
+{
+    image.pixels = stbi_load(filename, &image.width, &image.height, &image.channels, desiredChannels);
+
+    if (desiredChannels != 0)
+        image.channels = desiredChannels;
+
+    return image.pixels != nullptr;
+}
+
+// Build a texture from the decoded images of every file of it, with the mip chains the decode jobs built, so the loader thread
+// only uploads it; the decal image the decode jobs released is dropped first so the remaining images match the texture's layers
+// Every image is released whether or not the texture is built; returns false when one of them has no pixels
+// Safe to call from any thread since it makes no GL calls
+bool UBuildDecodedTexture(const TextureLoad& load, vector<TextureImage>& images, BuiltTexture& texture)
+{
+    if (load.decalFile > 0 && load.decalFile < (int)images.size())
+        images.erase(images.begin() + load.decalFile);
+
+    bool decoded = !images.empty() && all_of(images.begin(), images.end(), [](const TextureImage& image) { return image.pixels != nullptr; });
+
+    if (decoded && load.isArray)
+        texture.stretchedBytes = UBuildTextureArrayData(images, load.wrapType, texture.data, texture.layerRegions);
+    else if (decoded)
+        decoded = UBuildTextureData(images[0], texture.data);
+
+    for (TextureImage& image : images)
+    {
+        stbi_image_free(image.pixels);
+        image.pixels = nullptr;
+        image.mipLevels.clear();
+        image.mipLevels.shrink_to_fit();
+    }
+
+    texture.built = decoded;
+
+    return decoded;
+}
+
+// Create a texture the decode jobs have built and release the built data; returns false for one that could not be built
+// The streamer allocates every level but only uploads the smallest ones; the rest stream in once the texture is drawn up close
+// Texture arrays hand their layer regions to the render thread and log the video memory their layers take against what they
+// took stretched to the largest layer
+bool UCreateTexture(BuiltTexture& texture, const TextureLoad& load, size_t& textureBytes)
+{
+    if (!texture.built)
+        return false;
+
+    size_t bytes = texture.data.levels.back().offset + texture.data.levels.back().size;
+    size_t layers = texture.layerRegions.size();
+    int slices = texture.data.layers;
+
+    *load.texture = UAddTexture(move(texture.data), load.wrapType, UTextureAssetName(load), textureBytes);
+
+    if (load.isArray)
+    {
+        UAddTextureLayers(load, move(texture.layerRegions));
+
+        cout << "INFO: Texture " << UTextureAssetName(load) << " holds " << layers << " layers in " << slices << (slices == 1 ? " slice, " : " slices, ")
+            << bytes / 1024.0 << " KB instead of " << texture.stretchedBytes / 1024.0 << " KB with every layer stretched to the largest" << endl;
+    }
+
+    texture = BuiltTexture();
+
+    return true;
+}
+
+// Create a texture, or texture array, from a cooked block compressed texture with its stored mip chain
+// The cooked data is moved into the streamer, which uploads the smallest levels now and streams in the rest
+bool UCreateCompressedTexture(CookedTexture& cooked, const TextureLoad& load, size_t& textureBytes)
+{
+    StreamedTextureData data;
+    UBuildCompressedTextureData(cooked, data);
+    int layers = data.layers;
+
+    *load.texture = UAddTexture(move(data), load.wrapType, UTextureAssetName(load), textureBytes);
+
+    // Cooked texture arrays keep a slice for every layer
+    if (layers > 0)
+        UAddTextureLayers(load, UStretchedTextureLayers(layers));
+
+    return true;
+}
+
+// Hand a texture to the streamer and log the video memory its format takes with every level; returns the texture name
+GLuint UAddTexture(StreamedTextureData&& data, int textureWrapType, const string& name, size_t& textureBytes)
+{
+    size_t bytes = data.levels.back().offset + data.levels.back().size;
+    textureBytes += bytes;
+
+    cout << "INFO: Texture " << name << " " << data.width << "x" << data.height;
+
+    if (data.layers > 0)
+        cout << "x" << data.layers;
+
+    cout << " " << UTextureFormatName(data.internalFormat) << ", " << bytes / 1024.0 << " KB of video memory" << endl;
+
+    return textureStreamer.add(move(data), textureWrapType);
+}
+
+// Gather the precomputed mip chain of a decoded image into one block of RGBA8 levels, compacted when the content allows
+bool UBuildTextureData(const TextureImage& decodedImage, StreamedTextureData& data)
+{
+    const vector<MipLevel>& mipLevels = decodedImage.mipLevels;
+
+    if (!decodedImage.pixels || mipLevels.empty())
+        return false;
+
+    data = StreamedTextureData();
+    data.internalFormat = GL_RGBA8, data.compressed = false;
+    data.width = decodedImage.width, data.height = decodedImage.height, data.layers = 0;
+
+    for (const MipLevel& level : mipLevels)
+    {
+        data.levels.push_back({ level.width, level.height, data.data.size(), level.pixels.size() });
+        data.data.insert(data.data.end(), level.pixels.begin(), level.pixels.end());
+    }
+
+    UCompactTextureData(data);
+
+    return true;
+}
+
+// Build a texture array from one decoded RGBA image per layer, compacted when the content allows, with the region of every layer
+// Layers that clamp to their edges are packed at their own sizes into one slice; repeating layers tile past their edges, so they,
+// and layers too large to pack, are resized to the largest width and height so each fills a slice of its own
+// Returns the video memory the layers would take stretched to the largest layer, in the format the array was compacted to
+size_t UBuildTextureArrayData(vector<TextureImage>& images, int textureWrapType, StreamedTextureData& data, vector<TextureLayerRegion>& regions)
+{
+    int layerWidth = 0, layerHeight = 0;
+
+    for (const TextureImage& image : images)
+        layerWidth = max(layerWidth, image.width), layerHeight = max(layerHeight, image.height);
+
+    if (textureWrapType == GL_REPEAT || !UPackTextureLayers(images, data, regions))
+    {
+        // Every level holds all of its layers back to back
+        data = StreamedTextureData();
+        data.internalFormat = GL_RGBA8, data.compressed = false;
+        data.width = layerWidth, data.height = layerHeight, data.layers = (int)images.size();
+        regions = UStretchedTextureLayers(data.layers);
+
+        vector<unsigned char> resized((size_t)layerWidth * layerHeight * 4);
+        vector<MipLevel> mipLevels;
+
+        for (size_t layer = 0; layer < images.size(); layer++)
+        {
+            const unsigned char* pixels = images[layer].pixels;
+
+            // Stretch images smaller than the layer size; texture coordinates are normalized so the mapping is unchanged
+            if (images[layer].width != layerWidth || images[layer].height != layerHeight)
+            {
+                UResizeImage(images[layer].pixels, images[layer].width, images[layer].height, resized.data(), layerWidth, layerHeight);
+                pixels = resized.data();
+            }
+
+            // Build the layer's mip chain on this thread
+            mipGenerator.generate(pixels, layerWidth, layerHeight, textureWrapType == GL_REPEAT, nullptr, mipLevels);
+
+            // The first layer's chain gives the size of every level
+            if (layer == 0)
+            {
+                for (const MipLevel& level : mipLevels)
+                {
+                    data.levels.push_back({ level.width, level.height, data.data.size(), level.pixels.size() * images.size() });
+                    data.data.resize(data.data.size() + data.levels.back().size);
+                }
+            }
+
+            for (size_t level = 0; level < mipLevels.size(); level++)
+            {
+                size_t layerSize = mipLevels[level].pixels.size();
+                memcpy(&data.data[data.levels[level].offset + layer * layerSize], mipLevels[level].pixels.data(), layerSize);
+            }
+        }
+    }
+
+    UCompactTextureData(data);
+
+    // Texels of the array as built and of a full mip chain of every layer stretched to the largest layer
+    size_t texels = 0, stretchedTexels = 0;
+
+    for (const StreamedLevel& level : data.levels)
+        texels += (size_t)level.width * level.height * data.layers;
+
+    for (int width = layerWidth, height = layerHeight; ; width = max(width / 2, 1), height = max(height / 2, 1))
+    {
+        stretchedTexels += (size_t)width * height * images.size();
+
+        if (width == 1 && height == 1)
+            break;
+    }
+
+    size_t bytes = data.levels.back().offset + data.levels.back().size;
+
+    return (size_t)((double)bytes / texels * stretchedTexels);
+}
+
+// Describe the levels of a cooked texture for the streamer and move its data over
+void UBuildCompressedTextureData(CookedTexture& cooked, StreamedTextureData& data)
+{
+    data = StreamedTextureData();
+    data.internalFormat = textureCooker.glInternalFormat(cooked.format), data.compressed = true;
+    data.width = cooked.width, data.height = cooked.height, data.layers = cooked.layers;
+
+    for (const CookedLevel& level : cooked.levels)
+        data.levels.push_back({ level.width, level.height, level.offset, level.size });
+
+    data.data = move(cooked.data);
+}
+
+// Repack RGBA8 levels into the smallest uncompressed format that holds every texel exactly: R8 for opaque gray, RG8 for gray
+// with alpha, RGB565 for opaque colors that survive the round trip through 5 and 6 bits, and RGB8 for the other opaque colors
+// The streamer swizzles the missing channels back so shaders sample the same colors as before
+void UCompactTextureData(StreamedTextureData& data)
+{
+    if (data.compressed || data.internalFormat != GL_RGBA8 || data.levels.empty())
+        return;
+
+    size_t texelCount = data.data.size() / 4;
+    const uint8_t* texels = data.data.data();
+    bool gray = true, opaque = true, exact565 = true;
+
+    for (size_t i = 0; i < texelCount && (gray || opaque); i++)
+    {
+        const uint8_t* texel = texels + i * 4;
+        gray = gray && texel[0] == texel[1] && texel[1] == texel[2];
+        opaque = opaque && texel[3] == 255;
+
+        // A channel is exact when expanding its 5 or 6 bit value back to 8 bits gives the original value
+        for (int c = 0; c < 3 && exact565; c++)
+        {
+            int maximum = c == 1 ? 63 : 31;
+            int quantized = (texel[c] * maximum + 127) / 255;
+            exact565 = (quantized * 255 + maximum / 2) / maximum == texel[c];
+        }
+    }
+
+    GLenum internalFormat;
+    size_t texelBytes;
+
+    if (gray && opaque)
+        internalFormat = GL_R8, texelBytes = 1;
+    else if (gray)
+        internalFormat = GL_RG8, texelBytes = 2;
+    else if (opaque && exact565)
+        internalFormat = GL_RGB565, texelBytes = 2;
+    else if (opaque)
+        internalFormat = GL_RGB8, texelBytes = 3;
+    else
+        return;
+
+    // Levels hold whole texels back to back, so every offset and size scales by the same amount
+    vector<uint8_t> compacted(texelCount * texelBytes);
+
+    for (size_t i = 0; i < texelCount; i++)
+    {
+        const uint8_t* texel = texels + i * 4;
+        uint8_t* packed = &compacted[i * texelBytes];
+
+        if (internalFormat == GL_R8)
+            packed[0] = texel[0];
+        else if (internalFormat == GL_RG8)
+            packed[0] = texel[0], packed[1] = texel[3];
+        else if (internalFormat == GL_RGB8)
+            packed[0] = texel[0], packed[1] = texel[1], packed[2] = texel[2];
+        else
+        {
+            uint16_t texel565 = (uint16_t)(((texel[0] * 31 + 127) / 255) << 11 | ((texel[1] * 63 + 127) / 255) << 5 | (texel[2] * 31 + 127) / 255);
+            memcpy(packed, &texel565, 2);
+        }
+    }
+
+    for (StreamedLevel& level : data.levels)
+    {
+        level.offset = level.offset / 4 * texelBytes;
+        level.size = level.size / 4 * texelBytes;
+    }
+
+    data.internalFormat = internalFormat;
+    data.data = move(compacted);
+}
+
+// Short name of a texture format for the log
+const char* UTextureFormatName(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+        case GL_R8: return "R8";
+        case GL_RG8: return "RG8";
+        case GL_RGB8: return "RGB8";
+        case GL_RGB565: return "RGB565";
+        case GL_RGBA8: return "RGBA8";
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return "BC1";
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: return "BC1";
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return "BC3";
+        case GL_COMPRESSED_RGBA_BPTC_UNORM: return "BC7";
+        default: return "unknown";
+    }
+}
+
+// Resize an RGBA image with bilinear filtering
+void UResizeImage(const unsigned char* image, int width, int height, unsigned char* resized, int resizedWidth, int resizedHeight)
+{
+    for (int y = 0; y < resizedHeight; y++)
+    {
+        // Map the center of the resized pixel back to the source image
+        float sourceY = max((y + 0.5f) * height / resizedHeight - 0.5f, 0.0f);
+        int y0 = min((int)sourceY, height - 1), y1 = min(y0 + 1, height - 1);
+        float weightY = sourceY - y0;
+
+        for (int x = 0; x < resizedWidth; x++)
+        {
+            float sourceX = max((x + 0.5f) * width / resizedWidth - 0.5f, 0.0f);
+            int x0 = min((int)sourceX, width - 1), x1 = min(x0 + 1, width - 1);
+            float weightX = sourceX - x0;
+
+            for (int channel = 0; channel < 4; channel++)
+            {
+                float top = image[(y0 * width + x0) * 4 + channel] * (1.0f - weightX) + image[(y0 * width + x1) * 4 + channel] * weightX;
+                float bottom = image[(y1 * width + x0) * 4 + channel] * (1.0f - weightX) + image[(y1 * width + x1) * 4 + channel] * weightX;
+                resized[((size_t)y * resizedWidth + x) * 4 + channel] = (unsigned char)(top * (1.0f - weightY) + bottom * weightY + 0.5f);
+            }
+        }
+    }
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+// Texture cooking functions
+// ------------------------------------------------------------------------------------------------------------------------
+
+// Encode every texture into a block compressed KTX2 file with its full mip chain and report the texture memory saved
+// Opaque textures use BC1; textures with alpha use BC7 unless "--cook bc3" is given
+int UCookTextures(int argc, char* argv[])
+{
+    CookedFormat alphaFormat = (argc > 2 && strcmp(argv[2], "bc3") == 0) ? COOKED_BC3 : COOKED_BC7;
+    size_t uncompressedBytes = 0, cookedBytes = 0;
+    int exitStatus = EXIT_SUCCESS;
+
+    UCreateDirectory(COOKED_TEXTURE_DIRECTORY);
+
+    // The encoders split every mip level across the pool
+    ThreadPool cookPool;
+    auto cookStart = chrono::steady_clock::now();
+
+    for (const TextureLoad& load : UTextureLoads())
+    {
+        // Decode every file as RGBA
+        vector<TextureImage> images(load.filenames.size());
+        bool decoded = true;
+
+        for (size_t f = 0; f < load.filenames.size(); f++)
+        {
+            if (!UDecodeTexture(load.filenames[f], images[f], 4))
+            {
+                cout << "Failed to load texture " << load.filenames[f] << endl;
+                decoded = false;
+            }
+        }
+
+        if (decoded)
+        {
+            // Decals are baked in before cooking, the same way the loader bakes them
+            UBakeDecal(load, images);
+
+            // Cooked array layers are resized to the largest layer with a slice each, since the cooked file has no place for the
+            // regions of packed layers
+            int width = 0, height = 0;
+
+            for (const TextureImage& image : images)
+                width = max(width, image.width), height = max(height, image.height);
+
+            vector<vector<uint8_t>> resizedLayers(images.size());
+            vector<const uint8_t*> layers;
+            bool hasAlpha = false;
+
+            for (size_t layer = 0; layer < images.size(); layer++)
+            {
+                const uint8_t* pixels = images[layer].pixels;
+
+                if (images[layer].width != width || images[layer].height != height)
+                {
+                    resizedLayers[layer].resize((size_t)width * height * 4);
+                    UResizeImage(images[layer].pixels, images[layer].width, images[layer].height, resizedLayers[layer].data(), width, height);
+                    pixels = resizedLayers[layer].data();
+                }
+
+                for (size_t i = 3; i < (size_t)width * height * 4 && !hasAlpha; i += 4)
+                    hasAlpha = pixels[i] != 255;
+
+                layers.push_back(pixels);
+            }
+
+            // Encode the whole mip chain and write it
+            CookedTexture cooked;
+            textureCooker.cook(layers, width, height, load.isArray, load.wrapType == GL_REPEAT, hasAlpha ? alphaFormat : COOKED_BC1, cookPool,
+                cooked);
+
+            string cookedPath = UCookedTexturePath(load);
+
+            if (textureCooker.writeKtx2(cookedPath.c_str(), cooked))
+            {
+                // The same texture as uncompressed RGBA8 with a generated mip chain
+                size_t textureUncompressedBytes = 0;
+
+                for (const CookedLevel& level : cooked.levels)
+                    textureUncompressedBytes += (size_t)level.width * level.height * 4 * layers.size();
+
+                uncompressedBytes += textureUncompressedBytes, cookedBytes += cooked.data.size();
+
+                cout << "INFO: Cooked " << cookedPath << ": " << width << "x" << height << " " << textureCooker.formatName(cooked.format)
+                    << ", " << cooked.levels.size() << " levels, " << cooked.data.size() / 1024 << " KB (" << textureUncompressedBytes / 1024
+                    << " KB as RGBA8)" << endl;
+            }
+            else
+            {
+                cout << "ERROR: Failed to write " << cookedPath << endl;
+                exitStatus = EXIT_FAILURE;
+            }
+        }
+        else
+        {
+            exitStatus = EXIT_FAILURE;
+        }
+
+        for (TextureImage& image : images)
+        {
+            if (image.pixels)
+                stbi_image_free(image.pixels);
+        }
+    }
+
+    double cookMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - cookStart).count();
+    cout << "INFO: Texture VRAM " << uncompressedBytes / 1048576.0 << " MB as RGBA8 with mips, " << cookedBytes / 1048576.0
+        << " MB cooked; cooked on " << cookPool.size() << " threads in " << cookMilliseconds << " ms" << endl;
+
+    return exitStatus;
+}
+
+// Path of the cooked file of a texture, named after its first file
+string UCookedTexturePath(const TextureLoad& load)
+{
+    return string(COOKED_TEXTURE_DIRECTORY) + "/" + UTextureAssetName(load) + ".ktx2";
+}
+
+// Array layers of the cooked file of a texture: one for every file but a decal, which is baked into the file before it,
+// or none for a texture that is not an array
+int UCookedTextureLayers(const TextureLoad& load)
+{
+    if (!load.isArray)
+        return 0;
+
+    return (int)load.filenames.size() - (load.decalFile >= 0 ? 1 : 0);
+}
+
+// BC7 is core since OpenGL 4.2; BC1 and BC3 need the S3TC extension
+bool UCookedFormatSupported(CookedFormat format)
+{
+    if (format == COOKED_BC7)
+        return true;
+
+    return GLEW_EXT_texture_compression_s3tc;
+}
+
+// Create a directory if it does not exist yet
+void UCreateDirectory(const char* path)
+{
+    #ifdef _WIN32
+        _mkdir(path);
+    #else
+        mkdir(path, 0755);
+    #endif
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+// Asset archive functions
+// ------------------------------------------------------------------------------------------------------------------------
+
+// Pack every texture in the format it is sampled in, every mesh as its final GPU buffers, and every shader source into one archive
+// Cooked textures are packed as they are; the others are packed as RGBA8 with their precomputed mip chain
+int UPackAssets()
+{
+    vector<ArchiveEntry> entries;
+    auto packStart = chrono::steady_clock::now();
+
+    // Mip chains of single textures are split across the pool
+    ThreadPool packPool;
+
+    for (const TextureLoad& load : UTextureLoads())
+    {
+        StreamedTextureData data;
+        CookedTexture cooked;
+        string cookedPath = UCookedTexturePath(load);
+
+        if (textureCooker.readKtx2(cookedPath.c_str(), cooked) && cooked.layers == UCookedTextureLayers(load))
+        {
+            UBuildCompressedTextureData(cooked, data);
+        }
+        else
+        {
+            // Decode every file as RGBA; textures with a missing file are left out so the loader falls back to the loose files
+            vector<TextureImage> images(load.filenames.size());
+            bool decoded = true;
+
+            for (size_t f = 0; f < load.filenames.size(); f++)
+            {
+                if (!UDecodeTexture(load.filenames[f], images[f], 4))
+                {
+                    cout << "Failed to load texture " << load.filenames[f] << "; leaving it out of the archive" << endl;
+                    decoded = false;
+                }
+            }
+
+            if (decoded)
+                UBakeDecal(load, images);
+
+            // Packed texture arrays store the region of every layer next to the texture
+            if (decoded && load.isArray)
+            {
+                vector<TextureLayerRegion> regions;
+                UBuildTextureArrayData(images, load.wrapType, data, regions);
+                entries.push_back({ "layers/" + UTextureAssetName(load),
+                    vector<uint8_t>((const uint8_t*)regions.data(), (const uint8_t*)(regions.data() + regions.size())) });
+            }
+            else if (decoded)
+            {
+                mipGenerator.generate(images[0].pixels, images[0].width, images[0].height, load.wrapType == GL_REPEAT, &packPool, images[0].mipLevels);
+                UBuildTextureData(images[0], data);
+            }
+
+            for (TextureImage& image : images)
+            {
+                if (image.pixels)
+                    stbi_image_free(image.pixels);
+            }
+
+            if (!decoded)
+                continue;
+        }
+
+        entries.push_back({ "texture/" + UTextureAssetName(load), USerializeTexture(data) });
+    }
+
+    // Build the meshes the way the loader does, keeping their final buffers
+    map<const void*, vector<uint8_t>> capturedMeshes;
+    UCaptureMeshes(capturedMeshes);
+
+    for (const ArchivedMesh& mesh : UArchivedMeshes())
+    {
+        const void* key = mesh.mesh->enabled ? (const void*)mesh.mesh : (const void*)mesh.meshIndexed;
+        entries.push_back({ mesh.name, capturedMeshes[key] });
+    }
+
+    // Shader sources are stored with their terminating null so they can be compiled straight from the mapping, behind the hash of
+    // the source they were packed from so a program built with different sources ignores them
+    for (const pair<const char*, const char*>& shader : UShaderSources())
+    {
+        ArchivedShaderHeader header = { UHashShaderSource(shader.second) };
+        vector<uint8_t> blob(sizeof(header) + strlen(shader.second) + 1);
+
+        memcpy(blob.data(), &header, sizeof(header));
+        memcpy(blob.data() + sizeof(header), shader.second, blob.size() - sizeof(header));
+        entries.push_back({ shader.first, blob });
+    }
+
+    size_t entryCount = entries.size();
+
+    if (!AssetArchive::write(ASSET_ARCHIVE_PATH, entries))
+    {
+        cout << "ERROR: Failed to write " << ASSET_ARCHIVE_PATH << endl;
+        return EXIT_FAILURE;
+    }
+
+    AssetArchive archive;
+    archive.open(ASSET_ARCHIVE_PATH);
+
+    double packMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - packStart).count();
+    cout << "INFO: Packed " << entryCount << " assets into " << ASSET_ARCHIVE_PATH << " (" << archive.size() / 1048576.0 << " MB) in "
+        << packMilliseconds << " ms" << endl;
+
+    return EXIT_SUCCESS;
+}
+
+// Time preparing every asset for upload from the loose files against mapping the asset archive and reading every page of it
+// GPU uploads are the same for both and left out; a second run compares them with the files in the operating system's cache
+int UBenchmarkLoad()
+{
+    // Loose files: read the cooked files, or decode the images and build them into textures on a thread pool as the loader does,
+    // then build and weld every mesh
+    auto looseStart = chrono::steady_clock::now();
+    vector<TextureLoad> textures = UTextureLoads();
+    vector<vector<TextureImage>> images(textures.size());
+    vector<CookedTexture> cookedTextures(textures.size());
+    vector<atomic<int>> decalFilesRemaining(textures.size());
+    vector<atomic<int>> decodeFilesRemaining(textures.size());
+    vector<BuiltTexture> builtTextures(textures.size());
+
+    {
+        ThreadPool benchmarkPool;
+
+        for (size_t t = 0; t < textures.size(); t++)
+        {
+            string cookedPath = UCookedTexturePath(textures[t]);
+            CookedFormat cookedFormat;
+            int cookedLayers = 0;
+
+            if (textureCooker.readKtx2Format(cookedPath.c_str(), cookedFormat, cookedLayers) && cookedLayers == UCookedTextureLayers(textures[t]))
+            {
+                benchmarkPool.submit([&, t, cookedPath] { textureCooker.readKtx2(cookedPath.c_str(), cookedTextures[t]); });
+                continue;
+            }
+
+            images[t].resize(textures[t].filenames.size());
+            decalFilesRemaining[t] = textures[t].decalFile > 0 ? 2 : 0;
+            decodeFilesRemaining[t] = (int)textures[t].filenames.size();
+
+            for (size_t f = 0; f < textures[t].filenames.size(); f++)
+            {
+                benchmarkPool.submit([&, t, f] {
+                    double bakeMilliseconds;
+
+                    if (!UDecodeTexture(textures[t].filenames[f], images[t][f], 4))
+                        UCreateFallbackImage(images[t][f]);
+
+                    UFinishDecodedFile(textures[t], images[t], f, decalFilesRemaining[t], bakeMilliseconds);
+
+                    if (--decodeFilesRemaining[t] == 0)
+                        UBuildDecodedTexture(textures[t], images[t], builtTextures[t]);
+                });
+            }
+        }
+
+        benchmarkPool.wait();
+    }
+
+    map<const void*, vector<uint8_t>> capturedMeshes;
+    UCaptureMeshes(capturedMeshes);
+
+    double looseMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - looseStart).count();
+
+    // Archive: map it, parse every blob header, and read one byte of every page, which is all the loader does before handing pointers to GL
+    auto archiveStart = chrono::steady_clock::now();
+    AssetArchive archive;
+
+    if (!archive.open(ASSET_ARCHIVE_PATH))
+    {
+        cout << "ERROR: No asset archive at " << ASSET_ARCHIVE_PATH << "; run with --pack first" << endl;
+        return EXIT_FAILURE;
+    }
+
+    size_t blobSize;
+    size_t mappedAssets = 0;
+
+    for (const TextureLoad& load : textures)
+    {
+        StreamedTextureData data;
+        const uint8_t* blob = archive.find(("texture/" + UTextureAssetName(load)).c_str(), blobSize);
+        mappedAssets += blob != nullptr && UDeserializeTexture(blob, blobSize, data);
+    }
+
+    for (const ArchivedMesh& mesh : UArchivedMeshes())
+    {
+        MeshBuffers buffers;
+        const uint8_t* blob = archive.find(mesh.name, blobSize);
+        mappedAssets += blob != nullptr && UDeserializeMesh(blob, blobSize, buffers);
+    }
+
+    unsigned pageChecksum = 0;
+
+    for (size_t offset = 0; offset < archive.size(); offset += 4096)
+        pageChecksum += archive.data()[offset];
+
+    double archiveMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - archiveStart).count();
+
+    cout << "INFO: Load benchmark: loose files " << looseMilliseconds << " ms, asset archive " << archiveMilliseconds << " ms ("
+        << mappedAssets << " textures and meshes, " << archive.size() / 1048576.0 << " MB mapped, page checksum " << pageChecksum << ")" << endl;
+
+    return EXIT_SUCCESS;
+}
+
+// Every mesh stored in the asset archive with the resource group it belongs to
+vector<ArchivedMesh> UArchivedMeshes()
+{
+    return {
+        { "mesh/battery", &gMeshBattery, &gMeshIndexed, GROUP_BATTERY },
+        { "mesh/amp", &gMeshAmp, &gMeshIndexed, GROUP_AMP },
+        { "mesh/amp_side", &gMeshAmpSide, &gMeshIndexed, GROUP_AMP },
+        { "mesh/amp_side_front", &gMeshAmpSideFront, &gMeshIndexed, GROUP_AMP },
+        { "mesh/amp_side_back", &gMeshAmpSideBack, &gMeshIndexed, GROUP_AMP },
+        { "mesh/volume_knob_side", &gMeshVolumeKnobSide, &gMeshIndexed, GROUP_AMP },
+        { "mesh/volume_knob_front", &gMeshVolumeKnobFront, &gMeshIndexed, GROUP_AMP },
+        { "mesh/marble", &gMesh, &gMeshMarble, GROUP_MARBLE },
+        { "mesh/phone_box", &gMeshPhoneBox, &gMeshIndexed, GROUP_PHONE_BOX },
+        { "mesh/table", &gMeshTable, &gMeshIndexed, GROUP_TABLE },
+        { "mesh/window", &gMeshWindow, &gMeshIndexed, GROUP_WINDOW }
+    };
+}
+
+// Every shader source stored in the asset archive
+vector<pair<const char*, const char*>> UShaderSources()
+{
+    return {
+        { "shader/object.vert", objectVertexShaderSource },
+        { "shader/object.frag", objectFragmentShaderSource },
+        { "shader/lighting.frag", lightingSource },
+        { "shader/texture_bound.frag", boundTextureSamplingSource },
+        { "shader/texture_bindless.frag", bindlessTextureSamplingSource },
+        { "shader/lamp.vert", lampVertexShaderSource },
+        { "shader/lamp.frag", lampFragmentShaderSource },
+        { "shader/depth.vert", depthVertexShaderSource },
+        { "shader/depth.frag", depthFragmentShaderSource },
+        { "shader/fullscreen.vert", fullScreenVertexShaderSource },
+        { "shader/deferred_lighting.frag", deferredLightingFragmentShaderSource },
+        { "shader/visibility.frag", visibilityFragmentShaderSource },
+        { "shader/visibility_resolve.frag", visibilityResolveFragmentShaderSource }
+    };
+}
+
+// The shader source in the asset archive when it holds one packed from the source built into the program, otherwise the built-in source
+// An archive packed before the shaders were edited would otherwise compile the old sources against the new program
+const char* UShaderSource(const char* name, const char* builtInSource)
+{
+    size_t size = 0;
+    const uint8_t* blob = gAssetArchive.isOpen() ? gAssetArchive.find(name, size) : nullptr;
+    ArchivedShaderHeader header;
+
+    if (blob == nullptr || size <= sizeof(header) || blob[size - 1] != '\0')
+        return builtInSource;
+
+    memcpy(&header, blob, sizeof(header));
+
+    if (header.sourceHash != UHashShaderSource(builtInSource))
+        return builtInSource;
+
+    return (const char*)(blob + sizeof(header));
+}
+
+// 64-bit FNV-1a hash of a shader source
+uint64_t UHashShaderSource(const char* source)
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    for (; *source != '\0'; source++)
+        hash = (hash ^ (uint8_t)*source) * 1099511628211ull;
+
+    return hash;
+}
+
+// Name of a texture in the asset archive and the cooked directory, after its first file
+string UTextureAssetName(const TextureLoad& load)
+{
+    string filename = load.filenames[0];
+    size_t nameStart = filename.find_last_of("/\\") + 1;
+    string name = filename.substr(nameStart, filename.find_last_of('.') - nameStart);
+
+    return name + (load.isArray ? "_array" : "");
+}
+
+// Build every mesh the way the loader does, keeping the final buffers instead of uploading them; needs no GL context
+void UCaptureMeshes(map<const void*, vector<uint8_t>>& capturedMeshes)
+{
+    // The placeholder meshes are disabled as they are while the scene loads, which selects the indexed path for the marble
+    gMesh.enabled = false;
+    gMeshIndexed.enabled = false;
+    gMeshCapture = &capturedMeshes;
+
+    UCreateBatteryMeshes();
+    UCreateAmpMeshes();
+    UCreateSphereMesh(gMeshMarble, SPHERE_SEGMENTS);
+    UCreateCuboidMesh(gMeshPhoneBox, PHONE_BOX_WIDTH, PHONE_BOX_HEIGHT, PHONE_BOX_LENGTH);
+    UCreatePlaneMesh(gMeshTable, TABLE_LENGTH, TABLE_WIDTH);
+    UCreatePlaneMesh(gMeshWindow, WINDOW_MESH_LENGTH, WINDOW_MESH_WIDTH);
+
+    gMeshCapture = nullptr;
+
+    UReportMeshWelding();
+}
+
+// Store the buffers of a mesh as a header followed by the vertex, attribute, and index data
+vector<uint8_t> USerializeMesh(const MeshBuffers& buffers)
+{
+    ArchivedMeshHeader header = { buffers.floatsPerLayers, buffers.nVertices, buffers.nIndices, buffers.splitStreams, buffers.indexType,
+        (uint32_t)buffers.vertexBytes, (uint32_t)buffers.attributeBytes, (uint32_t)buffers.indexBytes, buffers.lightmapSize };
+
+    vector<uint8_t> blob(sizeof(header) + header.vertexBytes + header.attributeBytes + header.indexBytes);
+    uint8_t* write = blob.data();
+
+    memcpy(write, &header, sizeof(header));
+    write += sizeof(header);
+
+    if (header.vertexBytes > 0)
+        memcpy(write, buffers.vertexData, header.vertexBytes);
+
+    write += header.vertexBytes;
+
+    if (header.attributeBytes > 0)
+        memcpy(write, buffers.attributeData, header.attributeBytes);
+
+    write += header.attributeBytes;
+
+    if (header.indexBytes > 0)
+        memcpy(write, buffers.indexData, header.indexBytes);
+
+    return blob;
+}
+
+// Point the mesh buffers at the data of a stored mesh without copying it; returns false for a malformed blob
+bool UDeserializeMesh(const uint8_t* blob, size_t size, MeshBuffers& buffers)
+{
+    ArchivedMeshHeader header;
+
+    if (size < sizeof(header))
+        return false;
+
+    memcpy(&header, blob, sizeof(header));
+
+    if ((size_t)header.vertexBytes + header.attributeBytes + header.indexBytes > size - sizeof(header) || header.floatsPerLayers > 2)
+        return false;
+
+    // The counts must describe exactly the data that follows, or the upload would read past it or draw from outside the buffers
+    uint64_t floatsPerAttributes = 8 + header.floatsPerLayers + (header.lightmapSize > 0 ? 2 : 0);
+    uint64_t positionBytes = (uint64_t)header.nVertices * (header.splitStreams ? 3 : floatsPerAttributes) * sizeof(GLfloat);
+    uint64_t attributeBytes = header.splitStreams ? (uint64_t)header.nVertices * (floatsPerAttributes - 3) * sizeof(GLfloat) : 0;
+    uint64_t indexSize = header.indexType == GL_UNSIGNED_INT ? sizeof(GLuint) : sizeof(GLushort);
+
+    if (header.vertexBytes != positionBytes || header.attributeBytes != attributeBytes || header.indexBytes != header.nIndices * indexSize ||
+        (header.indexType != GL_UNSIGNED_SHORT && header.indexType != GL_UNSIGNED_INT))
+        return false;
+
+    buffers.floatsPerLayers = header.floatsPerLayers;
+    buffers.lightmapSize = header.lightmapSize;
+    buffers.nVertices = header.nVertices;
+    buffers.nIndices = header.nIndices;
+    buffers.splitStreams = header.splitStreams != 0;
+    buffers.indexType = header.indexType;
+    buffers.vertexData = blob + sizeof(header), buffers.vertexBytes = header.vertexBytes;
+    buffers.attributeData = blob + sizeof(header) + header.vertexBytes, buffers.attributeBytes = header.attributeBytes;
+    buffers.indexData = blob + sizeof(header) + header.vertexBytes + header.attributeBytes, buffers.indexBytes = header.indexBytes;
+
+    return true;
+}
+
+// Store a texture as a header and level table followed by the level data on the next 64 bytes
+vector<uint8_t> USerializeTexture(const StreamedTextureData& data)
+{
+    ArchivedTextureHeader header = { data.internalFormat, data.compressed, (uint32_t)data.width, (uint32_t)data.height, (uint32_t)data.layers,
+        (uint32_t)data.levels.size() };
+
+    size_t dataStart = (sizeof(header) + sizeof(ArchivedTextureLevel) * header.levelCount + 63) / 64 * 64;
+    size_t dataSize = data.levels.back().offset + data.levels.back().size;
+    vector<uint8_t> blob(dataStart + dataSize);
+
+    memcpy(blob.data(), &header, sizeof(header));
+
+    for (size_t level = 0; level < data.levels.size(); level++)
+    {
+        const StreamedLevel& streamedLevel = data.levels[level];
+        ArchivedTextureLevel archivedLevel = { (uint32_t)streamedLevel.width, (uint32_t)streamedLevel.height, streamedLevel.offset, streamedLevel.size };
+        memcpy(&blob[sizeof(header) + level * sizeof(archivedLevel)], &archivedLevel, sizeof(archivedLevel));
+    }
+
+    memcpy(&blob[dataStart], data.mapped != nullptr ? data.mapped : data.data.data(), dataSize);
+
+    return blob;
+}
+
+// Describe a stored texture with its level data left in place; returns false for a malformed blob
+bool UDeserializeTexture(const uint8_t* blob, size_t size, StreamedTextureData& data)
+{
+    ArchivedTextureHeader header;
+
+    if (size < sizeof(header))
+        return false;
+
+    memcpy(&header, blob, sizeof(header));
+
+    size_t dataStart = (sizeof(header) + sizeof(ArchivedTextureLevel) * (size_t)header.levelCount + 63) / 64 * 64;
+
+    if (header.levelCount == 0 || header.levelCount > 32 || dataStart > size)
+        return false;
+
+    data = StreamedTextureData();
+    data.internalFormat = header.internalFormat, data.compressed = header.compressed != 0;
+    data.width = (int)header.width, data.height = (int)header.height, data.layers = (int)header.layers;
+
+    for (uint32_t level = 0; level < header.levelCount; level++)
+    {
+        ArchivedTextureLevel archivedLevel;
+        memcpy(&archivedLevel, &blob[sizeof(header) + level * sizeof(archivedLevel)], sizeof(archivedLevel));
+
+        if (archivedLevel.offset > size - dataStart || archivedLevel.size > size - dataStart - archivedLevel.offset)
+            return false;
+
+        data.levels.push_back({ (int)archivedLevel.width, (int)archivedLevel.height, (size_t)archivedLevel.offset, (size_t)archivedLevel.size });
+    }
+
+    data.mapped = blob + dataStart;
+
+    return true;
+}
+
+// Upload every mesh of the group from the asset archive; returns false, uploading nothing, unless the archive holds all of them
+bool UCreateArchivedMeshes(ResourceGroup group)
+{
+    if (!gAssetArchive.isOpen())
+        return false;
+
+    vector<ArchivedMesh> meshes;
+    vector<MeshBuffers> meshBuffers;
+
+    for (const ArchivedMesh& mesh : UArchivedMeshes())
+    {
+        if (mesh.group != group)
+            continue;
+
+        size_t size;
+        MeshBuffers buffers;
+        const uint8_t* blob = gAssetArchive.find(mesh.name, size);
+
+        if (blob == nullptr || !UDeserializeMesh(blob, size, buffers))
+            return false;
+
+        meshes.push_back(mesh);
+        meshBuffers.push_back(buffers);
+    }
+
+    // The buffers are created straight from the mapping
+    for (size_t i = 0; i < meshes.size(); i++)
+        UUploadMesh(*meshes[i].mesh, *meshes[i].meshIndexed, meshBuffers[i]);
+
+    return !meshes.empty();
+}
+
+// Create a texture from the asset archive; the streamer reads its levels straight from the mapping
+// Returns false when the archive does not hold the texture or the driver can not sample its format
+bool UCreateArchivedTexture(const TextureLoad& load, size_t& textureBytes)
+{
+    if (!gAssetArchive.isOpen())
+        return false;
+
+    size_t size;
+    StreamedTextureData data;
+    const uint8_t* blob = gAssetArchive.find(("texture/" + UTextureAssetName(load)).c_str(), size);
+
+    if (blob == nullptr || !UDeserializeTexture(blob, size, data))
+        return false;
+
+    // Packed texture arrays store the region of every layer next to the texture; the layers of a texture array without them,
+    // cooked or packed before layers were packed, fill a slice each
+    vector<TextureLayerRegion> regions;
+
+    if (load.isArray)
+    {
+        size_t regionsSize;
+        const uint8_t* storedRegions = gAssetArchive.find(("layers/" + UTextureAssetName(load)).c_str(), regionsSize);
+
+        if (storedRegions != nullptr && regionsSize % sizeof(TextureLayerRegion) == 0)
+        {
+            regions.resize(regionsSize / sizeof(TextureLayerRegion));
+            memcpy(regions.data(), storedRegions, regionsSize);
+        }
+        else
+            regions = UStretchedTextureLayers(data.layers);
+    }
+    else if (data.layers != 0)
+        return false;
+
+    // A texture packed before decals were baked in has a layer too many; the loose files are loaded instead
+    if ((int)regions.size() != UCookedTextureLayers(load))
+        return false;
+
+    for (const TextureLayerRegion& region : regions)
+    {
+        if (region.slice < 0.0f || region.slice >= data.layers)
+            return false;
+    }
+
+    // BC7 is core since OpenGL 4.2; the S3TC formats need the extension
+    if (data.compressed && data.internalFormat != GL_COMPRESSED_RGBA_BPTC_UNORM && !GLEW_EXT_texture_compression_s3tc)
+        return false;
+
+    *load.texture = UAddTexture(move(data), load.wrapType, UTextureAssetName(load), textureBytes);
+
+    if (load.isArray)
+        UAddTextureLayers(load, move(regions));
+
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+// Texture atlas functions
+// ------------------------------------------------------------------------------------------------------------------------
+
+// Bake every small texture that clamps to its edges into one atlas page with its region table
+// Each texture is resized up to a multiple of the alignment and gets its own mip chain, which is copied into every atlas level
+// with its edge texels extended into a gutter, so neither filtering nor mipmapping ever reaches a neighboring region
+int UBakeAtlas()
+{
+    auto bakeStart = chrono::steady_clock::now();
+    ThreadPool bakePool;
+
+    // Repeating textures tile past their edges and texture arrays already share one binding, so both keep their own texture
+    vector<TextureLoad> loads = UTextureLoads();
+    vector<string> names;
+    vector<vector<MipLevel>> sourceLevels;
+    vector<AtlasRect> rects;
+    size_t sourceArea = 0;
+
+    for (const TextureLoad& load : loads)
+    {
+        if (load.isArray || load.wrapType == GL_REPEAT || load.decalFile >= 0)
+            continue;
+
+        TextureImage image;
+
+        if (!UDecodeTexture(load.filenames[0], image, 4))
+        {
+            cout << "Failed to load texture " << load.filenames[0] << "; leaving it out of the atlas" << endl;
+            continue;
+        }
+
+        if (image.width > ATLAS_MAX_TEXTURE_SIZE || image.height > ATLAS_MAX_TEXTURE_SIZE)
+        {
+            cout << "INFO: Leaving " << load.filenames[0] << " (" << image.width << "x" << image.height << ") out of the atlas" << endl;
+            stbi_image_free(image.pixels);
+            continue;
+        }
+
+        // Round the size up to the alignment so every kept mip level halves exactly
+        int width = (image.width + ATLAS_ALIGNMENT - 1) / ATLAS_ALIGNMENT * ATLAS_ALIGNMENT;
+        int height = (image.height + ATLAS_ALIGNMENT - 1) / ATLAS_ALIGNMENT * ATLAS_ALIGNMENT;
+        const unsigned char* pixels = image.pixels;
+        vector<unsigned char> resized;
+
+        if (width != image.width || height != image.height)
+        {
+            resized.resize((size_t)width * height * 4);
+            UResizeImage(image.pixels, image.width, image.height, resized.data(), width, height);
+            pixels = resized.data();
+        }
+
+        sourceLevels.emplace_back();
+        mipGenerator.generate(pixels, width, height, false, &bakePool, sourceLevels.back());
+        sourceLevels.back().resize(ATLAS_LEVELS);
+        stbi_image_free(image.pixels);
+
+        names.push_back(UTextureAssetName(load));
+        rects.push_back({ width + ATLAS_ALIGNMENT * 2, height + ATLAS_ALIGNMENT * 2 });
+        sourceArea += (size_t)width * height;
+    }
+
+    if (rects.size() < 2)
+    {
+        cout << "ERROR: Fewer than two textures to bake into the atlas" << endl;
+        return EXIT_FAILURE;
+    }
+
+    // Use the smallest page that holds every region, trying the half height page of each size first
+    int pageWidth = 0, pageHeight = 0;
+
+    for (int size = 256; size <= ATLAS_MAX_PAGE_SIZE && pageWidth == 0; size *= 2)
+    {
+        for (int height : { size / 2, size })
+        {
+            if (pageWidth == 0 && atlasPacker.pack(rects, size, height))
+                pageWidth = size, pageHeight = height;
+        }
+    }
+
+    if (pageWidth == 0)
+    {
+        cout << "ERROR: The atlas textures do not fit in a " << ATLAS_MAX_PAGE_SIZE << "x" << ATLAS_MAX_PAGE_SIZE << " page" << endl;
+        return EXIT_FAILURE;
+    }
+
+    StreamedTextureData data;
+    data.internalFormat = GL_RGBA8, data.compressed = false;
+    data.width = pageWidth, data.height = pageHeight, data.layers = 0;
+
+    for (int level = 0; level < ATLAS_LEVELS; level++)
+    {
+        int levelWidth = pageWidth >> level, levelHeight = pageHeight >> level;
+        data.levels.push_back({ levelWidth, levelHeight, data.data.size(), (size_t)levelWidth * levelHeight * 4 });
+        data.data.resize(data.data.size() + data.levels.back().size);
+    }
+
+    // Copy every level of every texture into its region
+    vector<ArchiveEntry> entries;
+    vector<AtlasRegion> regions(rects.size());
+
+    for (size_t r = 0; r < rects.size(); r++)
+    {
+        UCopyAtlasRegion(sourceLevels[r], rects[r], data);
+
+        memset(&regions[r], 0, sizeof(AtlasRegion));
+        strncpy(regions[r].name, names[r].c_str(), sizeof(regions[r].name) - 1);
+        regions[r].offsetX = (float)(rects[r].x + ATLAS_ALIGNMENT) / pageWidth;
+        regions[r].offsetY = (float)(rects[r].y + ATLAS_ALIGNMENT) / pageHeight;
+        regions[r].scaleX = (float)(rects[r].width - ATLAS_ALIGNMENT * 2) / pageWidth;
+        regions[r].scaleY = (float)(rects[r].height - ATLAS_ALIGNMENT * 2) / pageHeight;
+    }
+
+    // The atlas pages are stored in the smallest format that holds every region
+    UCompactTextureData(data);
+    entries.push_back({ "texture/atlas", USerializeTexture(data) });
+    entries.push_back({ "atlas/regions", vector<uint8_t>((const uint8_t*)regions.data(), (const uint8_t*)(regions.data() + regions.size())) });
+
+    if (!AssetArchive::write(ATLAS_PATH, entries))
+    {
+        cout << "ERROR: Failed to write " << ATLAS_PATH << endl;
+        return EXIT_FAILURE;
     }
+
+    double bakeMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - bakeStart).count();
+    cout << "INFO: Baked " << rects.size() << " textures into a " << pageWidth << "x" << pageHeight << " atlas in " << ATLAS_PATH << " ("
+        << 100.0 * sourceArea / ((double)pageWidth * pageHeight) << "% occupied) in " << bakeMilliseconds << " ms" << endl;
+
+    return EXIT_SUCCESS;
 }
 
-// GLFW callback for mouse movement events
-void UMouseCallback(GLFWwindow* window, double xpos, double ypos)
+// Create the atlas texture and point every texture baked into it at its region; those textures are removed from the loads
+// The atlas stays mapped so the streamer reads its levels straight from the file
+bool UCreateAtlasTexture(vector<TextureLoad>& textures, size_t& textureBytes)
 {
-    // Only process mouse events while using the 3D perspective projection
-    if (perspective)
-    {
-        // Avoid sudden camera jumps
-        if (firstMouse)
-        {
-            mouseLastX = xpos;
-            mouseLastY = ypos;
-            firstMouse = false;
-        }
-
-        // Calculate the X and Y offset values for the mouse position
-        float xoffset = xpos - mouseLastX;
-        float yoffset = mouseLastY - ypos;
+    if (!gUseAtlas || !gAtlasArchive.open(ATLAS_PATH))
+        return false;
 
-        // Update the previous mouse position
-        mouseLastX = xpos;
-        mouseLastY = ypos;
+    size_t atlasSize, regionsSize;
+    StreamedTextureData data;
+    const uint8_t* atlas = gAtlasArchive.find("texture/atlas", atlasSize);
+    const uint8_t* regions = gAtlasArchive.find("atlas/regions", regionsSize);
 
-        // Apply the look sensitivy multiplier to the mouse position offsets
-        float sensitivity = 0.1f;
-        xoffset *= sensitivity;
-        yoffset *= sensitivity;
+    if (atlas == nullptr || regions == nullptr || regionsSize % sizeof(AtlasRegion) != 0 || !UDeserializeTexture(atlas, atlasSize, data))
+    {
+        cout << "ERROR: " << ATLAS_PATH << " is damaged; loading its textures on their own" << endl;
+        gAtlasArchive.close();
+        return false;
+    }
 
-        // Update the yaw and pitch based on the mouse position offsets
-        yaw += xoffset;
-        pitch += yoffset;
+    gTextureAtlas = UAddTexture(move(data), GL_CLAMP_TO_EDGE, "atlas", textureBytes);
 
-        // Constrain the camera pitch to prevent LookAt flip
-        if (pitch > 89.0f)
-            pitch = 89.0f;
-        if (pitch < -89.0f)
-            pitch = -89.0f;
+    size_t atlasedTextures = 0;
 
-        // Update where the camera is looking based on the new direction
-        glm::vec3 direction;
-        direction.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
-        direction.y = sin(glm::radians(pitch));
-        direction.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
-        cameraFront = glm::normalize(direction);
+    for (size_t r = 0; r < regionsSize / sizeof(AtlasRegion); r++)
+    {
+        AtlasRegion region;
+        memcpy(&region, regions + r * sizeof(AtlasRegion), sizeof(AtlasRegion));
+        region.name[sizeof(region.name) - 1] = '\0';
+
+        // A texture that has since become a repeating one or a texture array is loaded on its own
+        auto load = find_if(textures.begin(), textures.end(), [&region](const TextureLoad& texture) {
+            return !texture.isArray && texture.wrapType != GL_REPEAT && UTextureAssetName(texture) == region.name;
+        });
+
+        if (load == textures.end())
+            continue;
+
+        *load->texture = gTextureAtlas;
+        gAtlasRegions[load->texture] = glm::vec4(region.offsetX, region.offsetY, region.scaleX, region.scaleY);
+        textures.erase(load);
+        atlasedTextures++;
     }
+
+    cout << "INFO: Loaded " << atlasedTextures << " textures from the texture atlas" << endl;
+
+    return true;
 }
 
-// GLFW callback for scroll wheel events
-void UScrollWheelCallback(GLFWwindow* window, double xoffset, double yoffset)
+// Copy the kept levels of a texture's mip chain into its padded rectangle of every level of an RGBA8 page, clamping the source
+// coordinates across the gutter so the edge texels extend into it
+void UCopyAtlasRegion(const vector<MipLevel>& sourceLevels, const AtlasRect& rect, StreamedTextureData& page)
 {
-    // Adjust the camera movement speed if the offset would not make it negative
-    if (moveSpeed + (float)yoffset > 0.0f)
-        moveSpeed += (float)yoffset;
-    else
-        moveSpeed = 0; // Do not allow a negative movement speed
+    for (int level = 0; level < ATLAS_LEVELS; level++)
+    {
+        const MipLevel& source = sourceLevels[level];
+        int gutter = ATLAS_ALIGNMENT >> level;
+        int regionX = rect.x >> level, regionY = rect.y >> level;
+        uint8_t* pageLevel = &page.data[page.levels[level].offset];
+
+        for (int y = 0; y < source.height + gutter * 2; y++)
+        {
+            int sourceY = min(max(y - gutter, 0), source.height - 1);
+
+            for (int x = 0; x < source.width + gutter * 2; x++)
+            {
+                int sourceX = min(max(x - gutter, 0), source.width - 1);
+                memcpy(&pageLevel[((size_t)(regionY + y) * page.levels[level].width + regionX + x) * 4],
+                    &source.pixels[((size_t)sourceY * source.width + sourceX) * 4], 4);
+            }
+        }
+    }
 }
 
 // ------------------------------------------------------------------------------------------------------------------------
-// Mesh creation functions
+// Texture array layer functions
 // ------------------------------------------------------------------------------------------------------------------------
 
-// Create a mesh with the given vertices and indices
-void UCreateMesh(GLMesh& gMesh, GLMeshIndexed& gMeshIndexed, vector<GLfloat>& vertices, vector<GLushort>& indices)
+// Round a texture array layer that clamps to its edges up to a multiple of the atlas alignment and build the mip levels its
+// region keeps, the same way UBakeAtlas prepares each texture
+// The mip generator runs single threaded; safe to call from any thread since it makes no GL calls
+void UBuildPackedLayerMipChain(TextureImage& image)
 {
-    const GLuint floatsPerVertex = 3;
-    const GLuint floatsPerNormal = 3;
-    const GLuint floatsPerUV = 2;
+    int width = (image.width + ATLAS_ALIGNMENT - 1) / ATLAS_ALIGNMENT * ATLAS_ALIGNMENT;
+    int height = (image.height + ATLAS_ALIGNMENT - 1) / ATLAS_ALIGNMENT * ATLAS_ALIGNMENT;
+    const unsigned char* pixels = image.pixels;
+    vector<unsigned char> resized;
 
-    // Initialize the number of mesh vertices
-    gMesh.nVertices = vertices.size();
+    if (width != image.width || height != image.height)
+    {
+        resized.resize((size_t)width * height * 4);
+        UResizeImage(image.pixels, image.width, image.height, resized.data(), width, height);
+        pixels = resized.data();
+    }
 
-    // Initialize the number of mesh indices
-    gMeshIndexed.nIndices = indices.size();
+    mipGenerator.generate(pixels, width, height, false, nullptr, image.mipLevels);
+    image.mipLevels.resize(ATLAS_LEVELS);
+}
 
-    if (gMesh.enabled == true)
-    {
-        // Create and activate the vertex array object
-        glGenVertexArrays(1, &gMesh.vao);
-        glBindVertexArray(gMesh.vao);
+// Pack the layers of a texture array that clamps to its edges into one slice laid out like the atlas, each layer at its own size
+// with a gutter around it, and give every layer its region; returns false, building nothing, when they do not fit in the largest
+// atlas page
+// Every slice width in steps of the alignment is tried with the lowest height that fits, and the slice with the fewest texels is kept
+bool UPackTextureLayers(vector<TextureImage>& images, StreamedTextureData& data, vector<TextureLayerRegion>& regions)
+{
+    vector<AtlasRect> rects;
+    int minWidth = 0, minHeight = 0, rowWidth = 0;
 
-        // Create, activate, and send buffer for the vertex data
-        glGenBuffers(1, &gMesh.vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, gMesh.vbo);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), &vertices[0], GL_STATIC_DRAW);
-    }
-    else if (gMeshIndexed.enabled == true)
+    for (TextureImage& image : images)
     {
-        // Create and activate the vertex array object
-        glGenVertexArrays(1, &gMeshIndexed.vao);
-        glBindVertexArray(gMeshIndexed.vao);
+        if (image.mipLevels.empty())
+            UBuildPackedLayerMipChain(image);
 
-        // Create, activate, and send buffers for the vertex data and indices
-        glGenBuffers(2, gMeshIndexed.vbos);
-        glBindBuffer(GL_ARRAY_BUFFER, gMeshIndexed.vbos[0]);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), &vertices[0], GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gMeshIndexed.vbos[1]);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), &indices[0], GL_STATIC_DRAW);
+        rects.push_back({ image.mipLevels[0].width + ATLAS_ALIGNMENT * 2, image.mipLevels[0].height + ATLAS_ALIGNMENT * 2 });
+        minWidth = max(minWidth, rects.back().width), minHeight = max(minHeight, rects.back().height);
+        rowWidth += rects.back().width;
     }
 
-    // Stride between vertex coordinates is 8 (X, Y, Z, nX, nY, nZ, tX, tY)
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);
-
-    // Create vertex attribute pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0); // Position
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (char*)(sizeof(float) * floatsPerVertex)); // Normal
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerNormal))); // Texture Coordinate
-    glEnableVertexAttribArray(2);
-}
-
-// Create the meshes for all parts of a battery
-void UCreateBatteryMeshes()
-{
-    // Create the mesh for the side of the battery case
-    UCreateCylinderSideMesh(gMeshBatteryCaseSide, CYLINDER_SLICES, BATTERY_CASE_RADIUS, BATTERY_CASE_HEIGHT);
+    // The decode jobs may pack arrays of different textures at once, so each packs with its own packer
+    AtlasPacker packer;
+    int sliceWidth = 0, sliceHeight = 0;
 
-    // Create the mesh for the top of the battery case
-    UCreateCylinderFaceMesh(gMeshBatteryCaseTop, true, CYLINDER_SLICES, BATTERY_CASE_RADIUS);
+    for (int width = minWidth; width <= min(rowWidth, ATLAS_MAX_PAGE_SIZE); width += ATLAS_ALIGNMENT)
+    {
+        if (!packer.pack(rects, width, ATLAS_MAX_PAGE_SIZE))
+            continue;
 
-    // Create the mesh for the bottom of the battery case
-    UCreateCylinderFaceMesh(gMeshBatteryCaseBottom, false, CYLINDER_SLICES, BATTERY_CASE_RADIUS);
+        // A taller slice holds everything a lower one does, so the lowest height is found by halving the range of heights
+        int low = minHeight / ATLAS_ALIGNMENT, high = ATLAS_MAX_PAGE_SIZE / ATLAS_ALIGNMENT;
 
-    // Create the mesh for the side of the battery terminal
-    UCreateCylinderSideMesh(gMeshBatteryTerminalSide, CYLINDER_SLICES, BATTERY_TERMINAL_RADIUS, BATTERY_TERMINAL_HEIGHT);
+        while (low < high)
+        {
+            int middle = (low + high) / 2;
 
-    // Create the mesh for the top of the battery terminal
-    UCreateCylinderFaceMesh(gMeshBatteryTerminalTop, true, CYLINDER_SLICES, BATTERY_TERMINAL_RADIUS);
-}
+            if (packer.pack(rects, width, middle * ATLAS_ALIGNMENT))
+                high = middle;
+            else
+                low = middle + 1;
+        }
 
-// Create the meshes for all parts of the amp
-void UCreateAmpMeshes()
-{
-    // Create the mesh for the body of the amp
-    UCreateCuboidMesh(gMeshAmp, AMP_WIDTH, AMP_HEIGHT, AMP_LENGTH);
+        if (sliceWidth == 0 || (size_t)width * high * ATLAS_ALIGNMENT < (size_t)sliceWidth * sliceHeight)
+            sliceWidth = width, sliceHeight = high * ATLAS_ALIGNMENT;
+    }
 
-    // Create the mesh for the sides of the amp body for rounded sides
-    UCreateCylinderSideMesh(gMeshAmpSide, CYLINDER_SLICES, VOLUME_KNOB_RADIUS, AMP_LENGTH);
+    if (sliceWidth == 0)
+        return false;
 
-    // Create the mesh for the front face of the rounded side of the amp
-    UCreateCylinderFaceMesh(gMeshAmpSideFront, true, CYLINDER_SLICES, VOLUME_KNOB_RADIUS);
+    packer.pack(rects, sliceWidth, sliceHeight);
 
-    // Create the mesh for the back face of the rounded side of the amp
-    UCreateCylinderFaceMesh(gMeshAmpSideBack, false, CYLINDER_SLICES, VOLUME_KNOB_RADIUS);
+    data = StreamedTextureData();
+    data.internalFormat = GL_RGBA8, data.compressed = false;
+    data.width = sliceWidth, data.height = sliceHeight, data.layers = 1;
 
-    // Create the mesh for the side of the volume knob for the amp
-    UCreateCylinderSideMesh(gMeshVolumeKnobSide, CYLINDER_SLICES, VOLUME_KNOB_RADIUS, VOLUME_KNOB_HEIGHT);
+    for (int level = 0; level < ATLAS_LEVELS; level++)
+    {
+        int levelWidth = sliceWidth >> level, levelHeight = sliceHeight >> level;
+        data.levels.push_back({ levelWidth, levelHeight, data.data.size(), (size_t)levelWidth * levelHeight * 4 });
+        data.data.resize(data.data.size() + data.levels.back().size);
+    }
 
-    // Create the mesh for the front of the volume knob for the amp
-    UCreateCylinderFaceMesh(gMeshVolumeKnobFront, true, CYLINDER_SLICES, VOLUME_KNOB_RADIUS);
-}
+    regions.assign(images.size(), TextureLayerRegion());
 
-// Create a mesh for a cylinder side
-void UCreateCylinderSideMesh(GLMesh& gMesh, int slices, float radius, float height)
-{
-    // Create a vector to hold the vertices for the cylinder side mesh
-    vector<GLfloat> vertices;
-    vector<GLushort> indices; // Not used for a cylinder mesh
+    for (size_t layer = 0; layer < images.size(); layer++)
+    {
+        UCopyAtlasRegion(images[layer].mipLevels, rects[layer], data);
 
-    // Build the vertices vector for the cylinder side mesh
-    cylinderMeshBuilder.buildSideMesh(vertices, slices, radius, height);
+        regions[layer].region = glm::vec4((float)(rects[layer].x + ATLAS_ALIGNMENT) / sliceWidth, (float)(rects[layer].y + ATLAS_ALIGNMENT) / sliceHeight,
+            (float)(rects[layer].width - ATLAS_ALIGNMENT * 2) / sliceWidth, (float)(rects[layer].height - ATLAS_ALIGNMENT * 2) / sliceHeight);
+        regions[layer].slice = 0.0f;
+    }
 
-    // Create the cylinder side mesh
-    UCreateMesh(gMesh, gMeshIndexed, vertices, indices);
+    return true;
 }
 
-// Create a mesh for a cylinder face
-void UCreateCylinderFaceMesh(GLMesh& gMesh, bool isTopFace, int slices, float radius)
+// Regions of a texture array whose layers each fill a slice of their own, as cooked texture arrays store them
+vector<TextureLayerRegion> UStretchedTextureLayers(int layers)
 {
-    // Create a vector to hold the vertices for the cylinder face mesh
-    vector<GLfloat> vertices;
-    vector<GLushort> indices; // Not used for a cylinder mesh
+    vector<TextureLayerRegion> regions(layers, TextureLayerRegion());
 
-    // Build the vertices vector for the cylinder face mesh
-    cylinderMeshBuilder.buildFaceMesh(vertices, isTopFace, slices, radius);
+    for (int layer = 0; layer < layers; layer++)
+        regions[layer].region = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f), regions[layer].slice = (float)layer;
 
-    // Create the cylinder face mesh
-    UCreateMesh(gMesh, gMeshIndexed, vertices, indices);
+    return regions;
 }
 
-// Create a mesh for a sphere
-void UCreateSphereMesh(GLMeshIndexed& gMeshIndexed, unsigned int segments)
+// Hand the layer regions of a texture array the loader has created to the render thread with the texture's resource group
+void UAddTextureLayers(const TextureLoad& load, vector<TextureLayerRegion>&& regions)
 {
-    // Create vectors to hold the vertices and indices for the sphere mesh
-    vector<GLfloat> vertices;
-    vector<GLushort> indices;
-
-    // Build the vertices and indices vectors for the sphere mesh
-    sphereMeshBuilder.buildMesh(vertices, indices, segments);
-
-    // Create the sphere mesh
-    UCreateMesh(gMesh, gMeshIndexed, vertices, indices);
+    gResourceGroups[load.group].textureLayers.emplace_back(*load.texture, move(regions));
 }
 
-// Create a mesh for a cuboid
-void UCreateCuboidMesh(GLMesh& gMesh, float width, float height, float length)
+// Add the layer regions of the group's texture arrays to the layer table once the group's uploads have completed
+void UCreateTextureLayers(ResourceGroup group)
 {
-    // Create a vector to hold the vertices for the cuboid mesh
-    vector<GLfloat> vertices;
-    vector<GLushort> indices; // Not used for a cuboid mesh
+    for (pair<GLuint, vector<TextureLayerRegion>>& textureLayers : gResourceGroups[group].textureLayers)
+    {
+        if (gTextureLayerCount + textureLayers.second.size() > (size_t)MAX_TEXTURE_LAYERS)
+        {
+            cout << "ERROR: The texture layer table has no room for the " << textureLayers.second.size() << " layers of texture "
+                << textureLayers.first << "; it samples the first layers of the table" << endl;
+            continue;
+        }
 
-    // Build the vertices vector for the cuboid mesh
-    cuboidMeshBuilder.buildMesh(vertices, width, height, length);
+        gFirstTextureLayers[textureLayers.first] = gTextureLayerCount;
+        copy(textureLayers.second.begin(), textureLayers.second.end(), gTextureLayerRegions + gTextureLayerCount);
+        gTextureLayerCount += (int)textureLayers.second.size();
+    }
 
-    // Create the cuboid mesh
-    UCreateMesh(gMesh, gMeshIndexed, vertices, indices);
+    gResourceGroups[group].textureLayers.clear();
 }
 
-// Create a mesh for a plane
-void UCreatePlaneMesh(GLMesh& gMesh, float length, float width)
+// Write the layer table into the uniform ring buffer and bind it for the frame
+void UBindTextureLayers()
 {
-    // Create a vector to hold the vertices for the plane mesh
-    vector<GLfloat> vertices;
-    vector<GLushort> indices; // Not used for a plane mesh
+    if (gTextureLayerCount == 0)
+        return;
 
-    // Build the vertices vector for the plane mesh
-    planeMeshBuilder.buildMesh(vertices, length, width);
+    GLintptr layerOffset;
 
-    // Create the plane mesh
-    UCreateMesh(gMesh, gMeshIndexed, vertices, indices);
+    if (gUniformRing.write(gTextureLayerRegions, sizeof(gTextureLayerRegions), layerOffset))
+        glBindBufferRange(GL_UNIFORM_BUFFER, TEXTURE_LAYER_UNIFORM_BINDING, gUniformRing.buffer(), layerOffset, sizeof(gTextureLayerRegions));
 }
 
 // ------------------------------------------------------------------------------------------------------------------------
-// Draw functions
+// Bindless material functions
 // ------------------------------------------------------------------------------------------------------------------------
 
-// Render a frame with all of the objects
-void URender()
+// Give every texture of the group a material with a resident bindless handle; textures shared through the atlas get one material
+// Handles are made resident on the render thread since residency belongs to the context that samples them
+void UCreateMaterials(ResourceGroup group)
 {
-    // Enable z-depth
-    glEnable(GL_DEPTH_TEST);
+    for (const TextureLoad& load : UTextureLoads())
+    {
+        GLuint texture = *load.texture;
 
-    // Enable alpha blending for decal textures
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        if (load.group != group || gMaterialIds.count(texture) > 0)
+            continue;
 
-    // Clear the frame and z buffers
-    glClearColor(0.20f, 0.50f, 0.64f, 1.0f); // Dark blue background
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // The texture's parameters can not change from here on; the streamer leaves its base level alone
+        GLuint64 handle = glGetTextureHandleARB(texture);
+        glMakeTextureHandleResidentARB(handle);
 
-    // Draw the objects
-    UDrawBattery(3.0f, 0.0f, -11.5f);
-    UDrawBattery(4.0f, 0.0f, -11.5f);
-    UDrawAmp(0.3f, 0.0f, -8.5f);
-    UDrawMarble(1.1f, 0.0f, -7.5f);
-    UDrawPhoneBox(-4.0f, 0.0f, -7.0f);
-    UDrawTable(0.0f, -0.0001f, -10.0f);
+        gMaterialIds[texture] = (GLint)gMaterials.size();
+        gMaterials.push_back({ handle, 0.0f });
+        gMaterialTextures.push_back(texture);
+    }
+}
 
-    // Draw the light source meshes
-    UDrawLightMesh(gMeshWindow, gLightPosBack, gLightColorBack, gLightIntenBack,
-        90.0f, 1.0f, 0.0f, 0.0f, WINDOW_MESH_SCALE, WINDOW_MESH_SCALE, WINDOW_MESH_SCALE); // Back window
+// Write the material table into the uniform ring buffer with each texture's finest uploaded level and bind it for the frame
+void UBindMaterials()
+{
+    if (gMaterials.empty())
+        return;
 
-    UDrawLightMesh(gMeshWindow, gLightPosLeft, gLightColorLeft, gLightIntenLeft,
-        90.0f, 0.0f, 0.0f, 1.0f, WINDOW_MESH_SCALE, WINDOW_MESH_SCALE, WINDOW_MESH_SCALE); // Left window
+    for (size_t m = 0; m < gMaterials.size(); m++)
+        gMaterials[m].minLod = (float)textureStreamer.residentLevel(gMaterialTextures[m]);
 
-    UDrawLightMesh(gMeshWindow, gLightPosRight, gLightColorRight, gLightIntenRight,
-        90.0f, 0.0f, 0.0f, 1.0f, WINDOW_MESH_SCALE, WINDOW_MESH_SCALE, WINDOW_MESH_SCALE); // Right window
+    GLsizeiptr materialBytes = (GLsizeiptr)(gMaterials.size() * sizeof(MaterialData));
+    GLintptr materialOffset;
 
-    // Swap buffers and poll IO events
-    glfwSwapBuffers(gWindow);
+    if (gUniformRing.write(gMaterials.data(), materialBytes, materialOffset))
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, MATERIAL_STORAGE_BINDING, gUniformRing.buffer(), materialOffset, materialBytes);
 }
 
-// Draw a mesh with the given textures, texture scale, coordinates, rotation angle, axis rotation scalars, and size scalars
-void UDrawObjectMesh(GLMesh& gMesh, GLMeshIndexed& gMeshIndexed, GLuint& gTexture, GLuint& gTextureDecal, glm::vec2& gUVScale,
-    float posX, float posY, float posZ, float rotAngle, float rotX, float rotY, float rotZ, float scaleX, float scaleY, float scaleZ)
+// Make every bindless handle non-resident so the textures can be deleted
+void UDestroyMaterials()
 {
-    // Set the shader to be used
-    glUseProgram(gObjectProgramId);
-
-    // Place object at the given coordinates
-    glm::mat4 translation = glm::translate(glm::vec3(posX, posY, posZ));
-
-    // Rotates the mesh by a given number of degrees along the specified axes
-    glm::mat4 rotation = glm::rotate(glm::radians(rotAngle), glm::vec3(rotX, rotY, rotZ));
+    for (const MaterialData& material : gMaterials)
+        glMakeTextureHandleNonResidentARB(material.handle);
 
-    // Scales the object by a given matrix scalar
-    glm::mat4 scale = glm::scale(glm::vec3(scaleX, scaleY, scaleZ));
+    gMaterials.clear();
+    gMaterialTextures.clear();
+    gMaterialIds.clear();
+}
 
-    // Model matrix transformations are applied right-to-left order
-    glm::mat4 model = translation * rotation * scale;
+// ------------------------------------------------------------------------------------------------------------------------
+// Lighting functions
+// ------------------------------------------------------------------------------------------------------------------------
 
-    // Define the view matrix
-    glm::mat4 view;
+// Fill the clustered light buffer with as many small colored lights scattered over and around the table as "--lights" asks for
+// beyond the windows; the lights use a fixed seed so every run with the same count lights the scene the same way
+void UCreateLights()
+{
+    gLights.clear();
 
-    // Define the projection matrix
-    glm::mat4 projection;
+    mt19937 random(330);
+    uniform_real_distribution<float> x(-6.0f, 6.0f), y(0.2f, 4.0f), z(-16.0f, -4.0f), range(1.5f, 4.0f), channel(0.1f, 1.0f);
 
-    if (perspective) // If the user is in 3D mode
+    while ((int)gLights.size() < gLightCount - WINDOW_LIGHT_COUNT)
     {
-        // Move the camera in 3D space
-        view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+        float lightX = x(random), lightY = y(random), lightZ = z(random), lightRange = range(random);
+        float red = channel(random), green = channel(random), blue = channel(random);
 
-        // Creates a perspective projection
-        projection = glm::perspective(45.0f, (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, 0.1f, 100.0f);
+        gLights.push_back({ { lightX, lightY, lightZ }, lightRange, { red * 0.6f, green * 0.6f, blue * 0.6f }, 0.0f });
     }
-    else // If the user is in 2D mode
-    {
-        // Move the camera in 2D space
-        view = glm::translate(glm::vec3(cameraPosOrtho.x, cameraPosOrtho.y, 0.0f));
-
-        // Creates an orthogonal projection
-        projection = glm::ortho(-orthoRight, orthoRight, -orthoTop, orthoTop, 0.1f, 100.0f);
-    }
-
-    // Set transform matrix uniforms
-    GLint modelLoc = glGetUniformLocation(gObjectProgramId, "model");
-    GLint viewLoc = glGetUniformLocation(gObjectProgramId, "view");
-    GLint projLoc = glGetUniformLocation(gObjectProgramId, "projection");
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-    // Set camera position uniform
-    GLint viewPositionLoc = glGetUniformLocation(gObjectProgramId, "viewPosition");
-    glUniform3f(viewPositionLoc, cameraPos.x, cameraPos.y, cameraPos.z);
-
-    // Set texture scale uniform
-    GLint UVScaleLoc = glGetUniformLocation(gObjectProgramId, "uvScale");
-    glUniform2fv(UVScaleLoc, 1, glm::value_ptr(gUVScale));
-
-    // Set back window uniforms
-    GLint lightPosBackLoc = glGetUniformLocation(gObjectProgramId, "lightPosBack");
-    GLint lightColorBackLoc = glGetUniformLocation(gObjectProgramId, "lightColorBack");
-    GLint lightIntenBackLoc = glGetUniformLocation(gObjectProgramId, "lightIntenBack");
-    glUniform3f(lightPosBackLoc, gLightPosBack.x, gLightPosBack.y, gLightPosBack.z);
-    glUniform3f(lightColorBackLoc, gLightColorBack.r, gLightColorBack.g, gLightColorBack.b);
-    glUniform1f(lightIntenBackLoc, gLightIntenBack);
-
-    // Set left window uniforms
-    GLint lightPosLeftLoc = glGetUniformLocation(gObjectProgramId, "lightPosLeft");
-    GLint lightColorLeftLoc = glGetUniformLocation(gObjectProgramId, "lightColorLeft");
-    GLint lightIntenLeftLoc = glGetUniformLocation(gObjectProgramId, "lightIntenLeft");
-    glUniform3f(lightPosLeftLoc, gLightPosLeft.x, gLightPosLeft.y, gLightPosLeft.z);
-    glUniform3f(lightColorLeftLoc, gLightColorLeft.r, gLightColorLeft.g, gLightColorLeft.b);
-    glUniform1f(lightIntenLeftLoc, gLightIntenLeft);
-
-    // Set right window uniforms
-    GLint lightPosRightLoc = glGetUniformLocation(gObjectProgramId, "lightPosRight");
-    GLint lightColorRightLoc = glGetUniformLocation(gObjectProgramId, "lightColorRight");
-    GLint lightIntenRightLoc = glGetUniformLocation(gObjectProgramId, "lightIntenRight");
-    glUniform3f(lightPosRightLoc, gLightPosRight.x, gLightPosRight.y, gLightPosRight.z);
-    glUniform3f(lightColorRightLoc, gLightColorRight.r, gLightColorRight.g, gLightColorRight.b);
-    glUniform1f(lightIntenRightLoc, gLightIntenRight);
-
-    // Set light property uniforms
-    GLint specIntenLoc = glGetUniformLocation(gObjectProgramId, "specInten");
-    GLint specSizeLoc = glGetUniformLocation(gObjectProgramId, "specSize");
-    GLint ambStrenLoc = glGetUniformLocation(gObjectProgramId, "ambStren");
-    glUniform1f(ambStrenLoc, gAmbientLightStrength);
-    glUniform1f(specIntenLoc, gSpecularIntensity);
-    glUniform1f(specSizeLoc, gSpecularHighlightSize);
-
-    // Get the use decal uniform location
-    GLuint useDecalLoc = glGetUniformLocation(gObjectProgramId, "useDecal");
-
-    // Activate and bind the textures
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, gTexture);
+}
 
-    // If a decal texture is used for the mesh, activate and bind the decal texture
-    if (gTextureDecal != gNoDecal)
-    {
-        // Activate decal texture rendering
-        glUniform1i(useDecalLoc, true);
+// Build the light lists of every cluster for the frame's view on the clustering thread pool, then write the lights, the cluster table
+// and the light index list into the light ring and bind them; fills in the cluster grid of the frame's uniform data
+void UBindLightClusters(FrameUniforms& frame)
+{
+    lightClusterer.build(gLights, glm::value_ptr(frame.view), glm::value_ptr(frame.projection), gClusterPool.get());
 
-        // Activate and bind the decal texture
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, gTextureDecal);
-    }
+    const LightClustererCounters& clusterCounters = lightClusterer.counters();
+    gClusterBuildMilliseconds += clusterCounters.buildMilliseconds;
+    gClusterBuilds++;
 
-    if (gMesh.enabled == true)
+    // A cluster holds at most MAX_LIGHTS_PER_CLUSTER lights, so the lights beyond that are missing from its fragments
+    if (clusterCounters.droppedLights > 0 && !gDroppedLightsReported)
     {
-        // Activate the VBOs contained within the mesh's VAO
-        glBindVertexArray(gMesh.vao);
-
-        // Draws the triangles
-        glDrawArrays(GL_TRIANGLES, 0, gMesh.nVertices);
+        cout << "WARNING: " << clusterCounters.droppedLights << " lights were left out of clusters that already held " << MAX_LIGHTS_PER_CLUSTER
+            << " lights; their light is missing where they overlap" << endl;
+        gDroppedLightsReported = true;
     }
-    else if (gMeshIndexed.enabled == true)
-    {
-        // Activate the VBOs contained within the mesh's VAO
-        glBindVertexArray(gMeshIndexed.vao);
 
-        // Draws the triangles
-        glDrawElements(GL_TRIANGLE_STRIP, gMeshIndexed.nIndices, GL_UNSIGNED_SHORT, NULL);
-    }
+    // The shaders find a fragment's tile from its framebuffer position
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(gWindow, &framebufferWidth, &framebufferHeight);
 
-    // Deactivate decal texture rendering
-    glUniform1i(useDecalLoc, false);
+    frame.clusterCounts = glm::uvec4(CLUSTER_TILES_X, CLUSTER_TILES_Y, CLUSTER_SLICES, (unsigned)gLights.size());
+    frame.clusterParams = glm::vec4((float)framebufferWidth, (float)framebufferHeight, lightClusterer.sliceScale(), lightClusterer.sliceBias());
 
-    // Deactivate the VAO and shader
-    glBindVertexArray(0);
-    glUseProgram(0);
+    const vector<uint32_t>& clusters = lightClusterer.clusters();
+    const vector<uint32_t>& lightIndices = lightClusterer.lightIndices();
+    // Storage buffer ranges can not be empty, so without clustered lights the cluster table stands in for the empty lists
+    GLsizeiptr lightBytes = (GLsizeiptr)(max(gLights.size(), (size_t)1) * sizeof(ClusterLight));
+    GLsizeiptr clusterBytes = (GLsizeiptr)(clusters.size() * sizeof(uint32_t));
+    GLsizeiptr indexBytes = (GLsizeiptr)(max(lightIndices.size(), (size_t)1) * sizeof(uint32_t));
+    GLintptr lightOffset, clusterOffset, indexOffset;
+
+    if (gLightRing.write(gLights.empty() ? (const void*)clusters.data() : gLights.data(), lightBytes, lightOffset) &&
+        gLightRing.write(clusters.data(), clusterBytes, clusterOffset) &&
+        gLightRing.write(lightIndices.empty() ? clusters.data() : lightIndices.data(), indexBytes, indexOffset))
+    {
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHT_STORAGE_BINDING, gLightRing.buffer(), lightOffset, lightBytes);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, CLUSTER_STORAGE_BINDING, gLightRing.buffer(), clusterOffset, clusterBytes);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHT_INDEX_STORAGE_BINDING, gLightRing.buffer(), indexOffset, indexBytes);
+    }
 }
 
-// Draw a light source mesh with the given coordinates, color, intensity, rotation angle, axis rotation scalars, and size scalars
-void UDrawLightMesh(GLMesh& gMesh, glm::vec3 lightPos, glm::vec3 lightColor, float lightIntensity,
-    float rotAngle, float rotX, float rotY, float rotZ, float scaleX, float scaleY, float scaleZ)
-{
-    // Set the shader to be used
-    glUseProgram(gLampProgramId);
+// ------------------------------------------------------------------------------------------------------------------------
+// Deferred shading functions
+// ------------------------------------------------------------------------------------------------------------------------
 
-    // Place object at the given coordinates
-    glm::mat4 translation = glm::translate(lightPos);
+// Create the G-buffer textures at the given size and attach them to the G-buffer framebuffer, replacing any earlier G-buffer
+// Every texture has a single level and is read texel by texel, so nothing is filtered
+bool UCreateGBuffer(int width, int height)
+{
+    UDestroyGBuffer();
 
-    // Rotates the mesh by a given number of degrees along the specified axes
-    glm::mat4 rotation = glm::rotate(glm::radians(rotAngle), glm::vec3(rotX, rotY, rotZ));
+    GLuint* textures[] = { &gGBufferAlbedo, &gGBufferNormal, &gGBufferDepth };
+    GLenum internalFormats[] = { GL_RGBA8, GL_RG16, GL_DEPTH_COMPONENT32F };
 
-    // Scales the object by a given matrix scalar
-    glm::mat4 scale = glm::scale(glm::vec3(scaleX, scaleY, scaleZ));
+    for (int i = 0; i < 3; i++)
+    {
+        glGenTextures(1, textures[i]);
+        glBindTexture(GL_TEXTURE_2D, *textures[i]);
+        glTexStorage2D(GL_TEXTURE_2D, 1, internalFormats[i], width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
 
-    // Model matrix transformations are applied right-to-left order
-    glm::mat4 model = translation * rotation * scale;
+    glBindTexture(GL_TEXTURE_2D, 0);
 
-    // Define the view matrix
-    glm::mat4 view;
+    // The object fragment shader writes the albedo to its first output and the normal to its second
+    glGenFramebuffers(1, &gGBufferFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, gGBufferFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gGBufferAlbedo, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gGBufferNormal, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gGBufferDepth, 0);
 
-    // Define the projection matrix
-    glm::mat4 projection;
+    GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
 
-    if (perspective) // If the user is in 3D mode
-    {
-        // Move the camera in 3D space
-        view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-        // Creates a perspective projection
-        projection = glm::perspective(45.0f, (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, 0.1f, 100.0f);
-    }
-    else // If the user is in 2D mode
+    if (status != GL_FRAMEBUFFER_COMPLETE)
     {
-        // Move the camera in 2D space
-        view = glm::translate(glm::vec3(cameraPosOrtho.x, cameraPosOrtho.y, 0.0f));
-
-        // Creates an orthogonal projection
-        projection = glm::ortho(-orthoRight, orthoRight, -orthoTop, orthoTop, 0.1f, 100.0f);
+        cout << "ERROR: The G-buffer framebuffer is incomplete (status 0x" << hex << status << dec << ")" << endl;
+        return false;
     }
 
-    // Set transform matrix uniforms
-    GLint modelLoc = glGetUniformLocation(gLampProgramId, "model");
-    GLint viewLoc = glGetUniformLocation(gLampProgramId, "view");
-    GLint projLoc = glGetUniformLocation(gLampProgramId, "projection");
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-    // Set light mesh color uniform with the given color and intensity
-    GLint lightColorBackLoc = glGetUniformLocation(gLampProgramId, "lightColor");
-    glUniform3f(lightColorBackLoc, lightColor.r * lightIntensity, lightColor.g * lightIntensity, lightColor.b * lightIntensity);
-
-    // Activate the VBOs contained within the mesh's VAO
-    glBindVertexArray(gMesh.vao);
+    gGBufferWidth = width;
+    gGBufferHeight = height;
 
-    // Draws the triangles
-    glDrawArrays(GL_TRIANGLES, 0, gMesh.nVertices);
+    cout << "INFO: Created a " << width << "x" << height << " G-buffer (" << width * height * 12 / 1048576.0 << " MB)" << endl;
 
-    // Deactivate the VAO and shader
-    glBindVertexArray(0);
-    glUseProgram(0);
+    return true;
 }
 
-// Draw the battery meshes at the given coordinates
-void UDrawBattery(float x, float y, float z)
+// Destroy the G-buffer framebuffer and its textures
+void UDestroyGBuffer()
 {
-    // Set the shininess for the battery
-    gSpecularIntensity = BATTERY_SPECULAR_INTENSITY;
+    glDeleteFramebuffers(1, &gGBufferFramebuffer);
+    glDeleteTextures(1, &gGBufferAlbedo);
+    glDeleteTextures(1, &gGBufferNormal);
+    glDeleteTextures(1, &gGBufferDepth);
 
-    // Rotate the battery side so the "Duracell" label is facing the front
-    float batteryRotationDegrees = 116.0f;
+    gGBufferFramebuffer = 0, gGBufferAlbedo = 0, gGBufferNormal = 0, gGBufferDepth = 0;
+    gGBufferWidth = 0, gGBufferHeight = 0;
+}
 
-    // Make the battery larger
-    float batteryScale = 2.0f;
+// Draw every object into the G-buffer, recreating it first when the framebuffer has changed size
+void UDrawGBuffer()
+{
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(gWindow, &framebufferWidth, &framebufferHeight);
 
-    // Draw the battery case side mesh at the given coordinates with rotation along the Y-axis and defined scale
-    UDrawObjectMesh(gMeshBatteryCaseSide, gMeshIndexed, gTextureBatteryCaseSide, gTextureBatteryCaseSideDecal, gUVScaleBatteryCaseSide,
-        x, y, z, batteryRotationDegrees, 0.0f, 1.0f, 0.0f, batteryScale, batteryScale, batteryScale);
+    // A minimized window has no framebuffer to match
+    if ((framebufferWidth != gGBufferWidth || framebufferHeight != gGBufferHeight) && framebufferWidth > 0 && framebufferHeight > 0)
+        UCreateGBuffer(framebufferWidth, framebufferHeight);
+
+    // The albedo's alpha holds the specular intensity, so nothing is blended into it
+    glBindFramebuffer(GL_FRAMEBUFFER, gGBufferFramebuffer);
+    glDisable(GL_BLEND);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    // Draw the battery case top face mesh directly above the case of the battery with rotation along the Y-axis and defined scale
-    UDrawObjectMesh(gMeshBatteryCaseTop, gMeshIndexed, gTextureBatteryCaseTop, gNoDecal, gUVScaleBatteryCaseTop,
-        x, y + BATTERY_CASE_HEIGHT * batteryScale, z, batteryRotationDegrees, 0.0f, 1.0f, 0.0f, batteryScale, batteryScale, batteryScale);
+    gGBufferPass = true;
 
-    // Draw the battery case bottom face mesh directly under the case of the battery with rotation along the Y-axis and defined scale
-    UDrawObjectMesh(gMeshBatteryCaseBottom, gMeshIndexed, gTextureBatteryCaseBottom, gNoDecal, gUVScaleBatteryCaseBottom,
-        x, y, z, batteryRotationDegrees, 0.0f, 1.0f, 0.0f, batteryScale, batteryScale, batteryScale);
+    UDrawObjects();
+    UDrawQueuedObjects();
 
-    // Draw the battery terminal side mesh directly above the case of the battery with rotation along the Y-axis and defined scale
-    UDrawObjectMesh(gMeshBatteryTerminalSide, gMeshIndexed, gTextureBatteryTerminalSide, gNoDecal, gUVScaleBatteryTerminalSide,
-        x, y + BATTERY_CASE_HEIGHT * batteryScale, z, batteryRotationDegrees, 0.0f, 1.0f, 0.0f, batteryScale, batteryScale, batteryScale);
+    gGBufferPass = false;
 
-    // Draw the battery terminal top mesh directly above the battery terminal side with rotation along the Y-axis and defined scale
-    UDrawObjectMesh(gMeshBatteryTerminalTop, gMeshIndexed, gTextureBatteryTerminalTop, gNoDecal, gUVScaleBatteryTerminalTop,
-        x, y + (BATTERY_CASE_HEIGHT + BATTERY_TERMINAL_HEIGHT) * batteryScale, z, batteryRotationDegrees, 0.0f, 1.0f, 0.0f, batteryScale, batteryScale, batteryScale);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-// Draw the amp meshes at the given coordinates
-void UDrawAmp(float x, float y, float z)
+// Light every pixel the G-buffer pass covered with one full-screen triangle, from the pixel's albedo, specular intensity, normal, and depth
+// The clustered lights come from the same cluster light lists the forward path uses, so each pixel only loops over the lights of its own cluster
+void UDrawDeferredLighting(const FrameUniforms& frame)
 {
-    // Set the shininess for the amp
-    gSpecularIntensity = AMP_SPECULAR_INTENSITY;
+    glUseProgram(gDeferredLightingProgramId);
 
-    // Make the amp larger
-    float ampScale = 5.0;
+    glm::mat4 inverseViewProjection = glm::inverse(frame.projection * frame.view);
+    glUniformMatrix4fv(glGetUniformLocation(gDeferredLightingProgramId, "inverseViewProjection"), 1, GL_FALSE, glm::value_ptr(inverseViewProjection));
 
-    // Move the volume knob to the right on the amp's front face
-    float volumeKnobOffset = AMP_WIDTH * ampScale;
+    glActiveTexture(GL_TEXTURE0 + GBUFFER_ALBEDO_UNIT);
+    glBindTexture(GL_TEXTURE_2D, gGBufferAlbedo);
+    glActiveTexture(GL_TEXTURE0 + GBUFFER_NORMAL_UNIT);
+    glBindTexture(GL_TEXTURE_2D, gGBufferNormal);
+    glActiveTexture(GL_TEXTURE0 + GBUFFER_DEPTH_UNIT);
+    glBindTexture(GL_TEXTURE_2D, gGBufferDepth);
+    glActiveTexture(GL_TEXTURE0);
 
-    // Create a very small Z-axis offset to avoid texture Z-fighting from the faces of the amp sides and the main body
-    float zOffset = 0.0001f;
-    
-    // Draw the amp body mesh at the given coordinates with no rotation and the defined scale
-    UDrawObjectMesh(gMeshAmp, gMeshIndexed, gTextureAmp, gNoDecal, gUVScaleAmp,
-        x, y, z, 0.0f, 1.0f, 1.0f, 1.0f, ampScale, ampScale, ampScale);
+    // Every pixel is lit whatever the default framebuffer's depth holds, and takes on the depth of the G-buffer
+    glDepthFunc(GL_ALWAYS);
 
-    // Draw the volume knob side mesh at the given coordinates with 90 degree rotation along the X-axis and the defined scale
-    UDrawObjectMesh(gMeshVolumeKnobSide, gMeshIndexed, gTextureVolumeKnobSide, gNoDecal, gUVScaleVolumeKnobSide,
-        x + volumeKnobOffset, y + VOLUME_KNOB_RADIUS * ampScale, z, 90.0f, 1.0f, 0.0f, 0.0f, ampScale, ampScale, ampScale);
+    glBindVertexArray(gFullScreenVertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
 
-    // Draw the volume knob front mesh directly on top of the side mesh with 90 degree rotation along the X-axis and the defined scale
-    UDrawObjectMesh(gMeshVolumeKnobFront, gMeshIndexed, gTextureVolumeKnobFront, gNoDecal, gUVScaleVolumeKnobFront,
-        x + volumeKnobOffset, y + VOLUME_KNOB_RADIUS * ampScale, z + VOLUME_KNOB_HEIGHT * ampScale, 90.0f, 1.0f, 0.0f, 0.0f, ampScale, ampScale, ampScale);
+    glBindVertexArray(0);
+    glUseProgram(0);
 
-    // Draw the amp side mesh on the right side of body with 90 degree rotation along the X-axis and the defined scale
-    UDrawObjectMesh(gMeshAmpSide, gMeshIndexed, gTextureAmpSide, gNoDecal, gUVScaleAmpSide,
-        x + volumeKnobOffset, y + VOLUME_KNOB_RADIUS * ampScale, z - AMP_LENGTH * ampScale, 90.0f, 1.0f, 0.0f, 0.0f, ampScale, ampScale, ampScale);
+    // Restore the state the rest of the frame draws with
+    glDepthFunc(GL_LESS);
+    glEnable(GL_BLEND);
+}
 
-    // Draw the amp side back face mesh at the back of the right rounded side with 90 degree rotation along the X-axis and the defined scale
-    UDrawObjectMesh(gMeshAmpSideBack, gMeshIndexed, gTextureAmpSideFace, gNoDecal, gUVScaleAmpSide,
-        x + volumeKnobOffset, y + VOLUME_KNOB_RADIUS * ampScale, z + zOffset - AMP_LENGTH * ampScale, 90.0f, 1.0f, 0.0f, 0.0f, ampScale, ampScale, ampScale);
+// ------------------------------------------------------------------------------------------------------------------------
+// Visibility buffer functions
+// ------------------------------------------------------------------------------------------------------------------------
 
-    // Draw the amp side mesh on the left side of body with 90 degree rotation along the X-axis and the defined scale
-    UDrawObjectMesh(gMeshAmpSide, gMeshIndexed, gTextureAmpSide, gNoDecal, gUVScaleAmpSide,
-        x , y + VOLUME_KNOB_RADIUS * ampScale, z - AMP_LENGTH * ampScale, 90.0f, 1.0f, 0.0f, 0.0f, ampScale, ampScale, ampScale);
+// Create the visibility buffer at the given size and attach it to the visibility framebuffer, replacing any earlier visibility buffer
+// The draw and triangle indices are read texel by texel, so nothing is filtered; the depth and stencil are only blitted, so they are a renderbuffer
+bool UCreateVisibilityBuffer(int width, int height)
+{
+    UDestroyVisibilityBuffer();
+
+    glGenTextures(1, &gVisibilityIds);
+    glBindTexture(GL_TEXTURE_2D, gVisibilityIds);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32UI, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Same format as the default framebuffer's depth and stencil, so they can be blitted into it
+    glGenRenderbuffers(1, &gVisibilityDepthStencil);
+    glBindRenderbuffer(GL_RENDERBUFFER, gVisibilityDepthStencil);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &gVisibilityFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, gVisibilityFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gVisibilityIds, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, gVisibilityDepthStencil);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        cout << "ERROR: The visibility framebuffer is incomplete (status 0x" << hex << status << dec << ")" << endl;
+        return false;
+    }
 
-    // Draw the amp side back face mesh at the back of the left rounded side with 90 degree rotation along the X-axis and the defined scale
-    UDrawObjectMesh(gMeshAmpSideBack, gMeshIndexed, gTextureAmpSideFace, gNoDecal, gUVScaleAmpSide,
-        x, y + VOLUME_KNOB_RADIUS * ampScale, z + zOffset - AMP_LENGTH * ampScale, 90.0f, 1.0f, 0.0f, 0.0f, ampScale, ampScale, ampScale);
+    gVisibilityWidth = width;
+    gVisibilityHeight = height;
 
-    // Draw the amp side front face mesh at the front of the left rounded side with 90 degree rotation along the X-axis and the defined scale
-    UDrawObjectMesh(gMeshAmpSideFront, gMeshIndexed, gTextureAmpSideFace, gNoDecal, gUVScaleAmpSide,
-        x, y + VOLUME_KNOB_RADIUS * ampScale, z - zOffset, 90.0f, 1.0f, 0.0f, 0.0f, ampScale, ampScale, ampScale);
+    cout << "INFO: Created a " << width << "x" << height << " visibility buffer (" << width * height * 8 / 1048576.0 << " MB)" << endl;
+
+    return true;
 }
 
-// Draw the marble mesh at the given coordinates
-void UDrawMarble(float x, float y, float z)
+// Destroy the visibility framebuffer, its texture, and its renderbuffer
+void UDestroyVisibilityBuffer()
 {
-    // Set the shininess for the marble
-    gSpecularIntensity = MARBLE_SPECULAR_INTENSITY;
+    glDeleteFramebuffers(1, &gVisibilityFramebuffer);
+    glDeleteTextures(1, &gVisibilityIds);
+    glDeleteRenderbuffers(1, &gVisibilityDepthStencil);
 
-    // Make the marble smaller
-    float marbleScale = 0.25f;
-
-    // Draw the marble mesh at the given coordinates with no rotation and the defined scale
-    UDrawObjectMesh(gMesh, gMeshMarble, gTextureMarble, gNoDecal, gUVScaleMarble,
-        x, y + marbleScale, z, 0.0f, 1.0f, 1.0f, 1.0f, marbleScale, marbleScale, marbleScale);
+    gVisibilityFramebuffer = 0, gVisibilityIds = 0, gVisibilityDepthStencil = 0;
+    gVisibilityWidth = 0, gVisibilityHeight = 0;
 }
 
-// Draw the phone box mesh at the given coordinates
-void UDrawPhoneBox(float x, float y, float z)
+// Copy the vertex and index buffers of the mesh record UCreateMesh made into the mesh arena, and describe where the resolve finds them
+// The offsets and strides are in 32-bit words; split meshes keep their position and attribute streams apart as they are in their buffers
+bool UAddArenaMesh(GLMesh& gMesh, GLMeshIndexed& gMeshIndexed, ArenaMesh& arenaMesh)
 {
-    // Set the shininess for the phone box
-    gSpecularIntensity = PHONE_BOX_SPECULAR_INTENSITY;
+    GLuint vbo = gMesh.enabled ? gMesh.vbo : gMeshIndexed.vbos[0];
+    GLuint attributeVbo = gMesh.enabled ? gMesh.attributeVbo : gMeshIndexed.attributeVbo;
+    GLuint ebo = gMesh.enabled ? gMesh.ebo : gMeshIndexed.vbos[1];
+    GLuint vertexWords = (gMesh.enabled ? gMesh.vertexStride : gMeshIndexed.vertexStride) / sizeof(GLfloat);
+    GLintptr positionOffset, attributeOffset, indexOffset;
 
-    // Make the phone box larger
-    float phoneBoxScale = 11.5f;
+    arenaMesh = ArenaMesh();
 
-    // Draw the phone box mesh at the given coordinates with no rotation and the defined scale
-    UDrawObjectMesh(gMeshPhoneBox, gMeshIndexed, gTexturePhoneBox, gNoDecal, gUVScalePhoneBox,
-        x, y, z, 0.0f, 1.0f, 1.0f, 1.0f, phoneBoxScale, phoneBoxScale, phoneBoxScale);
-}
+    if (!meshArena.add(vbo, positionOffset))
+        return false;
 
-// Draw the table surface mesh at the given coordinates
-void UDrawTable(float x, float y, float z)
-{
-    // Set the shininess for the table
-    gSpecularIntensity = TABLE_SPECULAR_INTENSITY;
+    arenaMesh.positionOffset = (GLuint)(positionOffset / sizeof(GLuint));
 
-    // Make the table larger
-    float tableScale = 10.0f;
+    if (attributeVbo != 0)
+    {
+        // Each vertex of the attribute stream holds everything after the position
+        if (!meshArena.add(attributeVbo, attributeOffset))
+            return false;
 
-    // Draw the table surface mesh at the given coordinates with no rotation and default scale
-    UDrawObjectMesh(gMeshTable, gMeshIndexed, gTextureTable, gNoDecal, gUVScaleTable,
-        x, y, z, 0.0f, 1.0f, 1.0f, 1.0f, tableScale, tableScale, tableScale);
-}
+        arenaMesh.positionStride = 3;
+        arenaMesh.attributeOffset = (GLuint)(attributeOffset / sizeof(GLuint));
+        arenaMesh.attributeStride = vertexWords - 3;
+    }
+    else
+    {
+        // The normal follows the position of each interleaved vertex
+        arenaMesh.positionStride = vertexWords;
+        arenaMesh.attributeOffset = arenaMesh.positionOffset + 3;
+        arenaMesh.attributeStride = vertexWords;
+    }
 
-// ------------------------------------------------------------------------------------------------------------------------
-// Setup functions
-// ------------------------------------------------------------------------------------------------------------------------
+    // Welded meshes have 16 or 32-bit indices, indexed meshes 16-bit triangle strip indices, and the rest none
+    if (ebo != 0)
+    {
+        if (!meshArena.add(ebo, indexOffset))
+            return false;
 
-// Initialize GLFW, GLEW, and create a window
-bool UInitialize(int argc, char* argv[], GLFWwindow** window)
+        arenaMesh.indexOffset = (GLuint)(indexOffset / sizeof(GLuint));
+        arenaMesh.indexBits = gMesh.enabled && gMesh.indexType == GL_UNSIGNED_INT ? 32 : 16;
+    }
+
+    arenaMesh.triangleStrip = gMesh.enabled ? 0 : 1;
+
+    return true;
+}
+
+// Record a draw of the visibility pass for the resolve, and mark its pixels with its resolve group as it is drawn
+// Returns false for a draw the visibility buffer has no room for, which is skipped
+bool URecordVisibilityDraw(const QueuedDraw& queued, const glm::vec4& uvRegion, GLint materialId, GLint firstTextureLayer)
 {
-    // GLFW: initialize and configure
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (gVisibilityDraws.size() >= (size_t)1 << (32 - VISIBILITY_TRIANGLE_BITS))
+        return false;
 
-    #ifdef __APPLE__
-        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-    #endif
+    // Copy the mesh into the arena the first time it is drawn; a mesh the arena has no room for is reported once and never drawn
+    const void* meshKey = queued.mesh->enabled ? (const void*)queued.mesh : (const void*)queued.meshIndexed;
+    auto arenaMesh = gArenaMeshes.find(meshKey);
 
-    // GLFW: window creation
-    * window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_TITLE, NULL, NULL);
-    if (*window == NULL)
+    if (arenaMesh == gArenaMeshes.end())
     {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return false;
+        ArenaMesh mesh;
+
+        if (!UAddArenaMesh(*queued.mesh, *queued.meshIndexed, mesh))
+        {
+            cout << "ERROR: The mesh arena has no room for a mesh; its draws are skipped" << endl;
+            mesh.positionStride = 0;
+        }
+
+        arenaMesh = gArenaMeshes.emplace(meshKey, mesh).first;
     }
-    glfwMakeContextCurrent(*window);
-    glfwSetFramebufferSizeCallback(*window, UResizeWindow);
 
-    // GLFW: enable mouse and scrollwheel input
-    glfwSetInputMode(gWindow, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-    glfwSetCursorPosCallback(gWindow, UMouseCallback);
-    glfwSetScrollCallback(gWindow, UScrollWheelCallback);
+    if (arenaMesh->second.positionStride == 0)
+        return false;
 
-    // GLEW: initialize
-    glewExperimental = GL_TRUE;
-    GLenum GlewInitResult = glewInit();
+    // Draws sharing a shader variant, and a texture unless textures are bindless, are resolved together
+    ResolveGroup group = { queued.variant, gUseBindless ? 0 : *queued.texture, gUseBindless ? (GLenum)0 : queued.textureTarget };
+    auto sameGroup = find_if(gResolveGroups.begin(), gResolveGroups.end(), [&group](const ResolveGroup& other) {
+        return UShaderVariantKey(other.variant) == UShaderVariantKey(group.variant) && other.texture == group.texture && other.textureTarget == group.textureTarget;
+    });
 
-    if (GLEW_OK != GlewInitResult)
+    if (sameGroup == gResolveGroups.end())
     {
-        std::cerr << glewGetErrorString(GlewInitResult) << std::endl;
-        return false;
+        if (gResolveGroups.size() == MAX_RESOLVE_GROUPS)
+            return false;
+
+        sameGroup = gResolveGroups.insert(gResolveGroups.end(), group);
     }
 
-    // Displays GPU OpenGL version
-    cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << endl;
+    glStencilFunc(GL_ALWAYS, (GLint)(sameGroup - gResolveGroups.begin()) + 1, 0xFF);
+    glUniform1ui(0, (GLuint)gVisibilityDraws.size());
+
+    VisibilityDraw draw;
+    draw.model = queued.model;
+    draw.normalMatrix = glm::transpose(glm::inverse(queued.model));
+    draw.uvRegion = uvRegion;
+    draw.uvScale = queued.uvScale;
+    draw.specInten = queued.specularIntensity;
+    draw.materialId = materialId;
+    draw.mesh = arenaMesh->second;
+    draw.firstTextureLayer = firstTextureLayer;
+    gVisibilityDraws.push_back(draw);
 
     return true;
 }
 
-// GLFW: whenever the window size changed (by OS or user resize) this callback function executes
-void UResizeWindow(GLFWwindow* window, int width, int height)
+// Draw the draw and triangle index of every object into the visibility buffer, recreating it first when the framebuffer has changed size
+// The stencil buffer takes the resolve group of each draw, so each pixel ends up with the group of its visible surface
+void UDrawVisibilityBuffer()
 {
-    glViewport(0, 0, width, height);
-}
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(gWindow, &framebufferWidth, &framebufferHeight);
 
-// Create a shader program from the given vertex shader and fragment shader sources
-bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId)
-{
-    // Compilation and linkage error reporting
-    int success = 0;
-    char infoLog[512];
+    // A minimized window has no framebuffer to match
+    if ((framebufferWidth != gVisibilityWidth || framebufferHeight != gVisibilityHeight) && framebufferWidth > 0 && framebufferHeight > 0)
+        UCreateVisibilityBuffer(framebufferWidth, framebufferHeight);
 
-    // Create a Shader program object
-    programId = glCreateProgram();
+    // Pixels without an object keep stencil zero and are never resolved, so their indices are not cleared
+    glBindFramebuffer(GL_FRAMEBUFFER, gVisibilityFramebuffer);
+    glDisable(GL_BLEND);
+    glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-    // Create the vertex and fragment shader objects
-    GLuint vertexShaderId = glCreateShader(GL_VERTEX_SHADER);
-    GLuint fragmentShaderId = glCreateShader(GL_FRAGMENT_SHADER);
+    glEnable(GL_STENCIL_TEST);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
 
-    // Retrive the shader source
-    glShaderSource(vertexShaderId, 1, &vtxShaderSource, NULL);
-    glShaderSource(fragmentShaderId, 1, &fragShaderSource, NULL);
+    gVisibilityDraws.clear();
+    gResolveGroups.clear();
+    gVisibilityPass = true;
 
-    // Compile the vertex shader
-    glCompileShader(vertexShaderId);
+    UDrawObjects();
+    UDrawQueuedObjects();
 
-    // Check for shader compile errors
-    glGetShaderiv(vertexShaderId, GL_COMPILE_STATUS, &success);
+    gVisibilityPass = false;
 
-    // If the vertex shader successfully compiled
-    if (!success)
-    {
-        glGetShaderInfoLog(vertexShaderId, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+    glDisable(GL_STENCIL_TEST);
+    glEnable(GL_BLEND);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
 
-        return false;
-    }
+// Shade every pixel the visibility pass covered exactly once, with one full-screen triangle per resolve group
+// The stencil test keeps each group's variant and texture to its own pixels; the pixel's draw record and the mesh arena give it the rest
+void UDrawVisibilityResolve()
+{
+    // Copy the depth and the resolve groups into the default framebuffer; the depth hides the lamps drawn after this behind the objects
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, gVisibilityFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, gVisibilityWidth, gVisibilityHeight, 0, 0, gVisibilityWidth, gVisibilityHeight,
+        GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    // Compile the fragment shader
-    glCompileShader(fragmentShaderId);
+    if (gVisibilityDraws.empty())
+        return;
 
-    // Check for shader compile errors
-    glGetShaderiv(fragmentShaderId, GL_COMPILE_STATUS, &success);
+    // Write the draw records into the uniform ring buffer and bind them with the mesh arena and the visibility buffer
+    GLsizeiptr drawBytes = (GLsizeiptr)(gVisibilityDraws.size() * sizeof(VisibilityDraw));
+    GLintptr drawOffset;
 
-    // If the fragment shader successfully compiled
-    if (!success)
-    {
-        glGetShaderInfoLog(fragmentShaderId, sizeof(infoLog), NULL, infoLog);
-        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+    if (!gUniformRing.write(gVisibilityDraws.data(), drawBytes, drawOffset))
+        return;
 
-        return false;
-    }
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, VISIBILITY_DRAW_STORAGE_BINDING, gUniformRing.buffer(), drawOffset, drawBytes);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESH_ARENA_STORAGE_BINDING, meshArena.buffer());
 
-    // Attached compiled shaders to the shader program
-    glAttachShader(programId, vertexShaderId);
-    glAttachShader(programId, fragmentShaderId);
+    glActiveTexture(GL_TEXTURE0 + VISIBILITY_UNIT);
+    glBindTexture(GL_TEXTURE_2D, gVisibilityIds);
 
-    // Link the shader program
-    glLinkProgram(programId);
+    // The depth is already final, so only the stencil is tested
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_STENCIL_TEST);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+    glBindVertexArray(gFullScreenVertexArray);
 
-    // Check for linking errors
-    glGetProgramiv(programId, GL_LINK_STATUS, &success);
+    GLuint currentProgram = 0;
 
-    // If the shader was successfully linked
-    if (!success)
+    for (size_t group = 0; group < gResolveGroups.size(); group++)
     {
-        glGetProgramInfoLog(programId, sizeof(infoLog), NULL, infoLog);
-        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        const ResolveGroup& resolveGroup = gResolveGroups[group];
+        GLuint programId = UObjectProgram(resolveGroup.variant);
 
-        return false;
+        if (programId == 0)
+            continue;
+
+        if (programId != currentProgram)
+        {
+            glUseProgram(programId);
+            currentProgram = programId;
+            gFrameProgramSwitches++;
+        }
+
+        // Bindless groups find their textures in the material table; the others bind the group's texture like the object draws do
+        if (gUseBindless)
+        {
+            // The material holds the texture; nothing is bound
+        }
+        else if (resolveGroup.textureTarget == GL_TEXTURE_2D_ARRAY)
+        {
+            if (resolveGroup.texture != gBoundTextureArray)
+            {
+                glActiveTexture(GL_TEXTURE2);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, resolveGroup.texture);
+                gBoundTextureArray = resolveGroup.texture;
+                gFrameTextureBinds++;
+            }
+        }
+        else if (resolveGroup.texture != gBoundTexture)
+        {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, resolveGroup.texture);
+            gBoundTexture = resolveGroup.texture;
+            gFrameTextureBinds++;
+        }
+
+        glStencilFunc(GL_EQUAL, (GLint)group + 1, 0xFF);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
     }
 
-    glUseProgram(programId); // Uses the shader program
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glActiveTexture(GL_TEXTURE0);
 
-    return true;
+    // Restore the state the rest of the frame draws with
+    glDisable(GL_STENCIL_TEST);
+    glEnable(GL_DEPTH_TEST);
 }
 
-// Load all textures from their corresponding files
-int ULoadTextures()
+// ------------------------------------------------------------------------------------------------------------------------
+// Lightmap functions
+// ------------------------------------------------------------------------------------------------------------------------
+
+// Bake the ambient and window diffuse light of the static draws into the lightmap on the cluster threads
+// The draws of a pass are recorded without drawing them, and each draw of a mesh with lightmap coordinates gets a region of the page;
+// every draw's triangles are then read back from its buffers into world space, so every object, the marble included, casts shadows
+// while only the draws with a region receive baked light
+void UBakeLightmap(const glm::vec3* windowPositions, const glm::vec3* windowColors, const glm::vec3& ambientColor)
 {
-    // Load battery case side texture
-    const char* texFilenameBatteryCaseSide = "resources/textures/battery_case_side.png";
-    if (!UCreateTexture(texFilenameBatteryCaseSide, gTextureBatteryCaseSide, GL_CLAMP_TO_EDGE))
-    {
-        cout << "Failed to load texture " << texFilenameBatteryCaseSide << endl;
-        return EXIT_FAILURE;
-    }
+    gLightmapBaked = true;
 
-    // Load battery case side texture decal for the positive and negative pole indicators
-    const char* texFilenameBatteryCaseSideDecal = "resources/textures/battery_case_side_decal.png";
-    if (!UCreateTexture(texFilenameBatteryCaseSideDecal, gTextureBatteryCaseSideDecal, GL_CLAMP_TO_EDGE))
-    {
-        cout << "Failed to load texture " << texFilenameBatteryCaseSideDecal << endl;
-        return EXIT_FAILURE;
-    }
+    // Record the draws of a pass in the order UDrawObjects records them every frame
+    UDrawObjects();
 
-    // Load battery case top texture
-    const char* texFilenameBatteryCaseTop = "resources/textures/battery_case_top.png";
-    if (!UCreateTexture(texFilenameBatteryCaseTop, gTextureBatteryCaseTop, GL_CLAMP_TO_EDGE))
-    {
-        cout << "Failed to load texture " << texFilenameBatteryCaseTop << endl;
-        return EXIT_FAILURE;
-    }
+    vector<QueuedDraw> draws;
+    draws.swap(gDrawQueue);
 
-    // Load battery case bottom texture
-    const char* texFilenameBatteryCaseBottom = "resources/textures/battery_case_bottom.png";
-    if (!UCreateTexture(texFilenameBatteryCaseBottom, gTextureBatteryCaseBottom, GL_CLAMP_TO_EDGE))
-    {
-        cout << "Failed to load texture " << texFilenameBatteryCaseBottom << endl;
-        return EXIT_FAILURE;
-    }
+    // A draw's region is its mesh's square of charts scaled by a whole factor towards the world texel density, so the padding
+    // between charts never gets narrower than it was unwrapped with
+    vector<AtlasRect> rects;
+    vector<int> drawRects(draws.size(), -1);
 
-    // Load battery terminal side texture
-    const char* texFilenameBatteryTerminalSide = "resources/textures/battery_terminal_side.png";
-    if (!UCreateTexture(texFilenameBatteryTerminalSide, gTextureBatteryTerminalSide, GL_CLAMP_TO_EDGE))
+    for (size_t i = 0; i < draws.size(); i++)
     {
-        cout << "Failed to load texture " << texFilenameBatteryTerminalSide << endl;
-        return EXIT_FAILURE;
-    }
+        const QueuedDraw& queued = draws[i];
 
-    // Load battery terminal top texture
-    const char* texFilenameBatteryTerminalTop = "resources/textures/battery_terminal_top.png";
-    if (!UCreateTexture(texFilenameBatteryTerminalTop, gTextureBatteryTerminalTop, GL_CLAMP_TO_EDGE))
-    {
-        cout << "Failed to load texture " << texFilenameBatteryTerminalTop << endl;
-        return EXIT_FAILURE;
-    }
+        if (!queued.mesh->enabled || queued.mesh->lightmapSize == 0)
+            continue;
 
-    // Load amp body texture
-    const char* texFilenameAmp = "resources/textures/amp.png";
-    if (!UCreateTexture(texFilenameAmp, gTextureAmp, GL_CLAMP_TO_EDGE))
-    {
-        cout << "Failed to load texture " << texFilenameAmp << endl;
-        return EXIT_FAILURE;
-    }
+        float drawScale = max(glm::length(glm::vec3(queued.model[0])), max(glm::length(glm::vec3(queued.model[1])), glm::length(glm::vec3(queued.model[2]))));
+        int regionScale = max((int)round(drawScale * LIGHTMAP_TEXELS_PER_WORLD_UNIT / LIGHTMAP_UNWRAP_TEXELS_PER_UNIT), 1);
+        int regionSize = (int)queued.mesh->lightmapSize * regionScale;
 
-    // Load amp side texture
-    const char* texFilenameAmpSide = "resources/textures/amp_side.png";
-    if (!UCreateTexture(texFilenameAmpSide, gTextureAmpSide, GL_CLAMP_TO_EDGE))
-    {
-        cout << "Failed to load texture " << texFilenameAmpSide << endl;
-        return EXIT_FAILURE;
+        drawRects[i] = (int)rects.size();
+        rects.push_back({ regionSize, regionSize });
     }
 
-    // Load amp side face texture
-    const char* texFilenameAmpSideFace = "resources/textures/amp_side_face.png";
-    if (!UCreateTexture(texFilenameAmpSideFace, gTextureAmpSideFace, GL_CLAMP_TO_EDGE))
+    if (rects.empty())
     {
-        cout << "Failed to load texture " << texFilenameAmpSideFace << endl;
-        return EXIT_FAILURE;
+        cout << "INFO: No static draw has lightmap coordinates; every window is lit per fragment" << endl;
+        return;
     }
 
-    // Load volume knob side texture
-    const char* texFilenameVolumeKnobSide = "resources/textures/volume_knob_side.png";
-    if (!UCreateTexture(texFilenameVolumeKnobSide, gTextureVolumeKnobSide, GL_REPEAT))
-    {
-        cout << "Failed to load texture " << texFilenameVolumeKnobSide << endl;
-        return EXIT_FAILURE;
-    }
+    // Pack the regions into the smallest power of two page that holds them
+    AtlasPacker regionPacker;
+    int pageSize = 256;
 
-    // Load volume knob front texture
-    const char* texFilenameVolumeKnobFront = "resources/textures/volume_knob_front.png";
-    if (!UCreateTexture(texFilenameVolumeKnobFront, gTextureVolumeKnobFront, GL_CLAMP_TO_EDGE))
-    {
-        cout << "Failed to load texture " << texFilenameVolumeKnobFront << endl;
-        return EXIT_FAILURE;
-    }
+    while (pageSize <= LIGHTMAP_MAX_SIZE && !regionPacker.pack(rects, pageSize, pageSize))
+        pageSize *= 2;
 
-    // Load marble texture
-    const char* texFilenameMarble = "resources/textures/marble.png";
-    if (!UCreateTexture(texFilenameMarble, gTextureMarble, GL_CLAMP_TO_EDGE))
+    if (pageSize > LIGHTMAP_MAX_SIZE)
     {
-        cout << "Failed to load texture " << texFilenameMarble << endl;
-        return EXIT_FAILURE;
+        cout << "ERROR: The static draws do not fit a " << LIGHTMAP_MAX_SIZE << "x" << LIGHTMAP_MAX_SIZE << " lightmap; every window is lit per fragment" << endl;
+        return;
     }
 
-    // Load phone box texture
-    const char* texFilenamePhoneBox = "resources/textures/phone_box.png";
-    if (!UCreateTexture(texFilenamePhoneBox, gTexturePhoneBox, GL_CLAMP_TO_EDGE))
+    // Move every draw's triangles into world space, reading each mesh back from its buffers once
+    map<const void*, pair<vector<GLfloat>, vector<GLuint>>> meshTriangles;
+    vector<LightmapSurface> surfaces;
+    vector<float> occluders;
+
+    gLightmapDraws.assign(draws.size(), { nullptr, glm::vec4(0.0f) });
+
+    for (size_t i = 0; i < draws.size(); i++)
     {
-        cout << "Failed to load texture " << texFilenamePhoneBox << endl;
-        return EXIT_FAILURE;
+        const QueuedDraw& queued = draws[i];
+        const void* meshKey = queued.mesh->enabled ? (const void*)queued.mesh : (const void*)queued.meshIndexed;
+        auto mesh = meshTriangles.find(meshKey);
+
+        if (mesh == meshTriangles.end())
+        {
+            mesh = meshTriangles.emplace(meshKey, pair<vector<GLfloat>, vector<GLuint>>()).first;
+            UReadMeshTriangles(*queued.mesh, *queued.meshIndexed, mesh->second.first, mesh->second.second);
+        }
+
+        const vector<GLfloat>& vertices = mesh->second.first;
+        GLuint floatsPerVertex = (queued.mesh->enabled ? queued.mesh->vertexStride : queued.meshIndexed->vertexStride) / sizeof(GLfloat);
+        glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(queued.model)));
+        const AtlasRect* rect = drawRects[i] >= 0 ? &rects[drawRects[i]] : nullptr;
+        LightmapSurface surface;
+
+        for (GLuint index : mesh->second.second)
+        {
+            const GLfloat* vertex = &vertices[(size_t)index * floatsPerVertex];
+            glm::vec3 position = glm::vec3(queued.model * glm::vec4(vertex[0], vertex[1], vertex[2], 1.0f));
+
+            occluders.insert(occluders.end(), { position.x, position.y, position.z });
+
+            if (rect == nullptr)
+                continue;
+
+            // The lightmap coordinate is the last two floats of every vertex
+            glm::vec3 normal = glm::normalize(normalMatrix * glm::vec3(vertex[3], vertex[4], vertex[5]));
+
+            surface.positions.insert(surface.positions.end(), { position.x, position.y, position.z });
+            surface.normals.insert(surface.normals.end(), { normal.x, normal.y, normal.z });
+            surface.texels.push_back(rect->x + vertex[floatsPerVertex - 2] * rect->width);
+            surface.texels.push_back(rect->y + vertex[floatsPerVertex - 1] * rect->height);
+        }
+
+        if (rect != nullptr)
+        {
+            gLightmapDraws[i] = { meshKey, glm::vec4(rect->x, rect->y, rect->width, rect->height) / (float)pageSize };
+            surfaces.push_back(move(surface));
+        }
     }
 
-    // Load table texture
-    const char* texFilenameTable = "resources/textures/table_tile.png";
-    if (!UCreateTexture(texFilenameTable, gTextureTable, GL_REPEAT))
+    // Bake the windows, whose colors are already scaled by their intensities, and the ambient light summed from them
+    vector<LightmapLight> lights(WINDOW_LIGHT_COUNT);
+
+    for (int i = 0; i < WINDOW_LIGHT_COUNT; i++)
     {
-        cout << "Failed to load texture " << texFilenameTable << endl;
-        return EXIT_FAILURE;
+        memcpy(lights[i].position, glm::value_ptr(windowPositions[i]), sizeof(lights[i].position));
+        memcpy(lights[i].color, glm::value_ptr(windowColors[i]), sizeof(lights[i].color));
     }
 
-    return 0;
+    vector<float> lightmap;
+    lightmapBaker.bake(surfaces, occluders, lights, glm::value_ptr(ambientColor), gBakedShadows, pageSize, pageSize, gClusterPool.get(), lightmap);
+
+    // Half floats keep the light brighter than one that the texture color is multiplied by; the lightmap stays bound to its own unit
+    glActiveTexture(GL_TEXTURE0 + LIGHTMAP_UNIT);
+    glGenTextures(1, &gLightmap);
+    glBindTexture(GL_TEXTURE_2D, gLightmap);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB16F, pageSize, pageSize);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, pageSize, pageSize, GL_RGB, GL_FLOAT, lightmap.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    const LightmapBakeCounters& counters = lightmapBaker.counters();
+    cout << "INFO: Baked " << surfaces.size() << " static draws into a " << pageSize << "x" << pageSize << " lightmap in " << counters.bakeMilliseconds
+        << " ms on " << gClusterPool->size() << " threads (" << counters.texelsLit << " texels lit, " << counters.texelsDilated << " dilated, "
+        << counters.shadowRays << " shadow rays against " << counters.occluderTriangles << " triangles)" << endl;
 }
 
-// Generate and bind the texture
-bool UCreateTexture(const char* filename, GLuint& gTexture, int textureWrapType)
+// Read the vertices of a mesh record back from its buffers as interleaved floats, with the three vertex indices of each triangle
+// Split streams are interleaved again, and the marble's triangle strip becomes a triangle list without its degenerate triangles
+// Returns the floats per vertex
+GLuint UReadMeshTriangles(GLMesh& gMesh, GLMeshIndexed& gMeshIndexed, vector<GLfloat>& vertices, vector<GLuint>& triangles)
 {
-    int width, height, channels;
-    unsigned char* image = stbi_load(filename, &width, &height, &channels, 0);
+    GLuint vbo = gMesh.enabled ? gMesh.vbo : gMeshIndexed.vbos[0];
+    GLuint attributeVbo = gMesh.enabled ? gMesh.attributeVbo : gMeshIndexed.attributeVbo;
+    GLuint ebo = gMesh.enabled ? gMesh.ebo : gMeshIndexed.vbos[1];
+    GLuint nVertices = gMesh.enabled ? gMesh.nVertices : gMeshIndexed.nVertices;
+    GLuint floatsPerVertex = (gMesh.enabled ? gMesh.vertexStride : gMeshIndexed.vertexStride) / sizeof(GLfloat);
+
+    vector<uint8_t> vertexData = UReadBuffer(vbo);
+    const GLfloat* positions = (const GLfloat*)vertexData.data();
 
-    // If the image could be loaded
-    if (image)
+    if (attributeVbo != 0)
     {
-        glGenTextures(1, &gTexture);
-        glBindTexture(GL_TEXTURE_2D, gTexture);
+        // Each vertex of the attribute stream holds everything after the position
+        vector<uint8_t> attributeData = UReadBuffer(attributeVbo);
+        const GLfloat* attributes = (const GLfloat*)attributeData.data();
+
+        vertices.resize((size_t)nVertices * floatsPerVertex);
+
+        for (GLuint i = 0; i < nVertices; i++)
+        {
+            memcpy(&vertices[(size_t)i * floatsPerVertex], positions + (size_t)i * 3, sizeof(GLfloat) * 3);
+            memcpy(&vertices[(size_t)i * floatsPerVertex + 3], attributes + (size_t)i * (floatsPerVertex - 3), sizeof(GLfloat) * (floatsPerVertex - 3));
+        }
+    }
+    else
+        vertices.assign(positions, positions + (size_t)nVertices * floatsPerVertex);
 
-        // Set the texture wrapping parameters to "clamp to edge" to prevent texture seams between meshes
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, textureWrapType);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, textureWrapType);
+    // Welded meshes have 16 or 32-bit indices, indexed meshes 16-bit triangle strip indices, and the rest draw their vertices in order
+    vector<GLuint> indices;
 
-        // Set texture parameters for trilinear filtering to reduce texture shimmer
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (ebo != 0)
+    {
+        vector<uint8_t> indexData = UReadBuffer(ebo);
 
-        if (channels == 3) // No Transparency
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-        else if (channels == 4) // Transparency
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
+        if (gMesh.enabled && gMesh.indexType == GL_UNSIGNED_INT)
+            indices.assign((const GLuint*)indexData.data(), (const GLuint*)indexData.data() + indexData.size() / sizeof(GLuint));
         else
+            indices.assign((const GLushort*)indexData.data(), (const GLushort*)indexData.data() + indexData.size() / sizeof(GLushort));
+    }
+    else
+    {
+        for (GLuint i = 0; i < nVertices; i++)
+            indices.push_back(i);
+    }
+
+    triangles.clear();
+
+    if (gMesh.enabled)
+        triangles = indices;
+    else
+    {
+        for (size_t i = 0; i + 2 < indices.size(); i++)
         {
-            cout << "Not implemented to handle image with " << channels << " channels" << endl;
-            return false;
+            if (indices[i] != indices[i + 1] && indices[i + 1] != indices[i + 2] && indices[i] != indices[i + 2])
+                triangles.insert(triangles.end(), { indices[i], indices[i + 1], indices[i + 2] });
         }
+    }
+
+    return floatsPerVertex;
+}
 
-        glGenerateMipmap(GL_TEXTURE_2D);
+// Copy the whole contents of a buffer back into memory
+vector<uint8_t> UReadBuffer(GLuint buffer)
+{
+    GLint size = 0;
 
-        stbi_image_free(image);
-        glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture.
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
 
-        return true;
-    }
+    vector<uint8_t> data((size_t)size);
 
-    // Error loading the image
-    return false;
+    if (size > 0)
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, size, data.data());
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    return data;
 }
 
 // ------------------------------------------------------------------------------------------------------------------------
@@ -1519,6 +6326,16 @@ void UDestroyMesh(GLMesh& gMesh, GLMeshIndexed& gMeshIndexed)
     glDeleteVertexArrays(1, &gMesh.vao);
     glDeleteBuffers(1, &gMesh.vbo);
 
+    // Delete the position-only vertex array object and the attribute stream
+    glDeleteVertexArrays(1, &gMesh.positionVao);
+    glDeleteBuffers(1, &gMesh.attributeVbo);
+    glDeleteVertexArrays(1, &gMeshIndexed.positionVao);
+    glDeleteBuffers(1, &gMeshIndexed.attributeVbo);
+
+    // Delete the indices of a welded mesh
+    if (gMesh.ebo != 0)
+        glDeleteBuffers(1, &gMesh.ebo);
+
     // Delete the indexed mesh
     glDeleteVertexArrays(1, &gMeshIndexed.vao);
     glDeleteBuffers(2, gMeshIndexed.vbos);
@@ -0,0 +1,136 @@
+#include "GpuPassTimer.h"
+
+// Create the timestamp queries for the given number of passes and frames in flight, and the fragment shader invocation queries
+// when the driver has pipeline statistics queries
+// The queries of a frame are only read back frameCount frames later, so reading them does not wait for the GPU
+bool GpuPassTimer::create(int passCount, int frameCount)
+{
+    passTotal = passCount;
+    frameTotal = frameCount;
+    frame = 0;
+    missed = 0;
+    countFragments = GLEW_ARB_pipeline_statistics_query;
+
+    queries.assign((size_t)passCount * frameCount * 2, 0);
+    issued.assign((size_t)passCount * frameCount, false);
+    passes.assign((size_t)passCount, GpuPassCounters());
+
+    glGenQueries((GLsizei)queries.size(), queries.data());
+
+    if (countFragments)
+    {
+        fragmentQueries.assign((size_t)passCount * frameCount, 0);
+        glGenQueries((GLsizei)fragmentQueries.size(), fragmentQueries.data());
+    }
+
+    return glGetError() == GL_NO_ERROR;
+}
+
+void GpuPassTimer::destroy()
+{
+    if (!queries.empty())
+        glDeleteQueries((GLsizei)queries.size(), queries.data());
+
+    if (!fragmentQueries.empty())
+        glDeleteQueries((GLsizei)fragmentQueries.size(), fragmentQueries.data());
+
+    queries.clear();
+    fragmentQueries.clear();
+    issued.clear();
+}
+
+// Move on to the next frame's queries, first reading back the results they still hold from frameCount frames ago
+void GpuPassTimer::beginFrame()
+{
+    frame = (frame + 1) % frameTotal;
+    collect(frame);
+}
+
+// Record the GPU time when the commands issued so far have run
+// Only one pass can count fragment shader invocations at a time, so passes must not overlap
+void GpuPassTimer::begin(int pass)
+{
+    glQueryCounter(queries[((size_t)frame * passTotal + pass) * 2], GL_TIMESTAMP);
+
+    if (countFragments)
+        glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB, fragmentQueries[(size_t)frame * passTotal + pass]);
+}
+
+void GpuPassTimer::end(int pass)
+{
+    if (countFragments)
+        glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB);
+
+    glQueryCounter(queries[((size_t)frame * passTotal + pass) * 2 + 1], GL_TIMESTAMP);
+    issued[(size_t)frame * passTotal + pass] = true;
+}
+
+double GpuPassTimer::averageMilliseconds(int pass) const
+{
+    return passes[pass].samples > 0 ? passes[pass].totalMilliseconds / passes[pass].samples : 0.0;
+}
+
+double GpuPassTimer::averageFragmentInvocations(int pass) const
+{
+    return passes[pass].samples > 0 ? (double)passes[pass].totalFragmentInvocations / passes[pass].samples : 0.0;
+}
+
+bool GpuPassTimer::countsFragments() const
+{
+    return countFragments;
+}
+
+const GpuPassCounters& GpuPassTimer::counters(int pass) const
+{
+    return passes[pass];
+}
+
+unsigned long GpuPassTimer::missedFrames() const
+{
+    return missed;
+}
+
+// Add the pass times of a frame to the counters; a frame that is somehow still not finished is dropped rather than waited for
+void GpuPassTimer::collect(int collectFrame)
+{
+    bool frameMissed = false;
+
+    for (int pass = 0; pass < passTotal; pass++)
+    {
+        size_t slot = (size_t)collectFrame * passTotal + pass;
+
+        if (!issued[slot])
+            continue;
+
+        issued[slot] = false;
+
+        GLint available = 0;
+        glGetQueryObjectiv(queries[slot * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+
+        if (!available)
+        {
+            frameMissed = true;
+            continue;
+        }
+
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(queries[slot * 2], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(queries[slot * 2 + 1], GL_QUERY_RESULT, &end);
+
+        GpuPassCounters& counters = passes[pass];
+        counters.lastMilliseconds = (end - start) / 1000000.0;
+        counters.totalMilliseconds += counters.lastMilliseconds;
+        counters.samples++;
+
+        // The invocation count ended before the pass's closing timestamp was written, so reading it does not wait in practice
+        if (countFragments)
+        {
+            GLuint64 invocations = 0;
+            glGetQueryObjectui64v(fragmentQueries[slot], GL_QUERY_RESULT, &invocations);
+            counters.totalFragmentInvocations += invocations;
+        }
+    }
+
+    if (frameMissed)
+        missed++;
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#ifndef GPU_PASS_TIMER_H
+#define GPU_PASS_TIMER_H
+
+using namespace std;
+
+// GPU time and fragment shader invocations of one render pass, averaged over every frame whose queries have been read back
+struct GpuPassCounters {
+    double totalMilliseconds = 0.0;
+    double lastMilliseconds = 0.0;
+    unsigned long long totalFragmentInvocations = 0; // Only counted with ARB_pipeline_statistics_query
+    unsigned long samples = 0;
+};
+
+class GpuPassTimer {
+public:
+    bool create(int passCount, int frameCount = 4);
+    void destroy();
+    void beginFrame();
+    void begin(int pass);
+    void end(int pass);
+    double averageMilliseconds(int pass) const;
+    double averageFragmentInvocations(int pass) const;
+    bool countsFragments() const;
+    const GpuPassCounters& counters(int pass) const;
+    unsigned long missedFrames() const;
+
+private:
+    void collect(int frame);
+
+    // Two timestamp queries per pass for every frame in flight; each frame's results are read back when its queries are reused
+    vector<GLuint> queries;
+    vector<GLuint> fragmentQueries; // One fragment shader invocation query per pass for every frame in flight
+    bool countFragments = false;
+    vector<bool> issued;
+    vector<GpuPassCounters> passes;
+    int passTotal = 0;
+    int frameTotal = 0;
+    int frame = 0;
+    unsigned long missed = 0; // Frames whose results were not ready when their queries came around again, and were dropped
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,202 @@
+#include "LightClusterer.h"
+
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+// Smallest number of depth slices handed to one thread pool job
+const int MIN_SLICES_PER_JOB = 2;
+
+// Set up a grid of screen tiles by depth slices; the slices are spaced logarithmically between the near and far planes
+// so clusters far from the camera are about as deep as they are wide
+void LightClusterer::create(int tilesX, int tilesY, int slices, float nearPlane, float farPlane, unsigned maxLightsPerCluster)
+{
+    tileCountX = tilesX;
+    tileCountY = tilesY;
+    sliceCount = slices;
+    nearDepth = nearPlane;
+    farDepth = farPlane;
+    maxClusterLights = maxLightsPerCluster;
+
+    clusterLights.assign((size_t)clusterCount(), vector<uint32_t>());
+    clusterRanges.assign((size_t)clusterCount() * 2, 0);
+}
+
+// Assign every light to the clusters its sphere reaches for the given column-major view and projection matrices
+// Each job handles a range of depth slices, so no two jobs touch the same cluster; the lists are then packed into one index list
+void LightClusterer::build(const vector<ClusterLight>& lights, const float* view, const float* projection, ThreadPool* pool)
+{
+    auto buildStart = chrono::steady_clock::now();
+
+    // Move the lights into view space and find the slices each one reaches
+    viewLights.resize(lights.size());
+
+    for (size_t i = 0; i < lights.size(); i++)
+    {
+        const float* p = lights[i].position;
+        ViewLight& light = viewLights[i];
+
+        for (int row = 0; row < 3; row++)
+            light.center[row] = view[row] * p[0] + view[4 + row] * p[1] + view[8 + row] * p[2] + view[12 + row];
+
+        light.radius = lights[i].range;
+
+        // The camera looks down negative z, so depths are the negated view space z
+        float depth = -light.center[2];
+
+        if (depth + light.radius < nearDepth || depth - light.radius > farDepth)
+            light.firstSlice = 1, light.lastSlice = 0;
+        else
+            light.firstSlice = slice(depth - light.radius), light.lastSlice = slice(depth + light.radius);
+    }
+
+    dropped = 0;
+
+    if (pool == nullptr || sliceCount < MIN_SLICES_PER_JOB * 2)
+        assignSlices(projection, 0, sliceCount);
+    else
+    {
+        int slicesPerJob = max(sliceCount / (int)pool->size(), MIN_SLICES_PER_JOB);
+
+        for (int firstSlice = 0; firstSlice < sliceCount; firstSlice += slicesPerJob)
+        {
+            int lastSlice = min(firstSlice + slicesPerJob, sliceCount);
+            pool->submit([this, projection, firstSlice, lastSlice] { assignSlices(projection, firstSlice, lastSlice); });
+        }
+
+        pool->wait();
+    }
+
+    // Pack the lists of every cluster into one light index list
+    indices.clear();
+    stats.maxClusterLights = 0;
+
+    for (size_t c = 0; c < clusterLights.size(); c++)
+    {
+        clusterRanges[c * 2] = (uint32_t)indices.size();
+        clusterRanges[c * 2 + 1] = (uint32_t)clusterLights[c].size();
+        indices.insert(indices.end(), clusterLights[c].begin(), clusterLights[c].end());
+        stats.maxClusterLights = max(stats.maxClusterLights, (unsigned)clusterLights[c].size());
+    }
+
+    stats.lightIndices = indices.size();
+    stats.droppedLights = dropped;
+    stats.buildMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - buildStart).count();
+}
+
+// Fill the light lists of every cluster in the given slices
+// Within each slice a light only reaches the tiles covered by the part of its sphere between the slice's near and far depths
+void LightClusterer::assignSlices(const float* projection, int firstSlice, int lastSlice)
+{
+    for (int s = firstSlice; s < lastSlice; s++)
+    {
+        size_t sliceStart = (size_t)s * tileCountX * tileCountY;
+
+        for (size_t c = sliceStart; c < sliceStart + (size_t)tileCountX * tileCountY; c++)
+            clusterLights[c].clear();
+
+        for (size_t i = 0; i < viewLights.size(); i++)
+        {
+            const ViewLight& light = viewLights[i];
+
+            if (s < light.firstSlice || s > light.lastSlice)
+                continue;
+
+            float depth = -light.center[2];
+            int tiles[4];
+
+            if (!tileBounds(light, max(depth - light.radius, sliceDepth(s)), min(depth + light.radius, sliceDepth(s + 1)), projection, tiles))
+                continue;
+
+            for (int y = tiles[2]; y <= tiles[3]; y++)
+            {
+                for (int x = tiles[0]; x <= tiles[1]; x++)
+                {
+                    vector<uint32_t>& cluster = clusterLights[sliceStart + (size_t)y * tileCountX + x];
+
+                    if (cluster.size() < maxClusterLights)
+                        cluster.push_back((uint32_t)i);
+                    else
+                        dropped++;
+                }
+            }
+        }
+    }
+}
+
+// Screen tiles covered by the box around a light's sphere between two depths, as first and last tile in x, then in y
+// The box is projected corner by corner; a corner's screen position only moves one way with its depth, so the corners bound it
+// Returns false when the box is off the screen
+bool LightClusterer::tileBounds(const ViewLight& light, float nearBoxDepth, float farBoxDepth, const float* projection, int* tiles) const
+{
+    float minX = 1e9f, maxX = -1e9f, minY = 1e9f, maxY = -1e9f;
+
+    for (int corner = 0; corner < 8; corner++)
+    {
+        float x = light.center[0] + ((corner & 1) ? light.radius : -light.radius);
+        float y = light.center[1] + ((corner & 2) ? light.radius : -light.radius);
+        float z = -((corner & 4) ? farBoxDepth : max(nearBoxDepth, nearDepth));
+
+        float clipX = projection[0] * x + projection[4] * y + projection[8] * z + projection[12];
+        float clipY = projection[1] * x + projection[5] * y + projection[9] * z + projection[13];
+        float clipW = projection[3] * x + projection[7] * y + projection[11] * z + projection[15];
+
+        minX = min(minX, clipX / clipW), maxX = max(maxX, clipX / clipW);
+        minY = min(minY, clipY / clipW), maxY = max(maxY, clipY / clipW);
+    }
+
+    if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+        return false;
+
+    // Normalized device coordinates to tiles, counting rows from the bottom like gl_FragCoord
+    tiles[0] = max((int)floor((minX * 0.5f + 0.5f) * tileCountX), 0);
+    tiles[1] = min((int)floor((maxX * 0.5f + 0.5f) * tileCountX), tileCountX - 1);
+    tiles[2] = max((int)floor((minY * 0.5f + 0.5f) * tileCountY), 0);
+    tiles[3] = min((int)floor((maxY * 0.5f + 0.5f) * tileCountY), tileCountY - 1);
+
+    return true;
+}
+
+// Depth slice of a view space depth, clamped to the grid
+int LightClusterer::slice(float depth) const
+{
+    return min(max((int)floor(log(max(depth, nearDepth)) * sliceScale() + sliceBias()), 0), sliceCount - 1);
+}
+
+// Depth where a slice starts
+float LightClusterer::sliceDepth(int slice) const
+{
+    return nearDepth * pow(farDepth / nearDepth, (float)slice / sliceCount);
+}
+
+// Offset into the light index list and light count of every cluster, slice by slice, row by row
+const vector<uint32_t>& LightClusterer::clusters() const
+{
+    return clusterRanges;
+}
+
+const vector<uint32_t>& LightClusterer::lightIndices() const
+{
+    return indices;
+}
+
+int LightClusterer::clusterCount() const
+{
+    return tileCountX * tileCountY * sliceCount;
+}
+
+// The slice of a depth is floor(log(depth) * sliceScale + sliceBias), which the shaders compute the same way
+float LightClusterer::sliceScale() const
+{
+    return sliceCount / log(farDepth / nearDepth);
+}
+
+float LightClusterer::sliceBias() const
+{
+    return -sliceCount * log(nearDepth) / log(farDepth / nearDepth);
+}
+
+const LightClustererCounters& LightClusterer::counters() const
+{
+    return stats;
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+#include "ThreadPool.h"
+
+#ifndef LIGHT_CLUSTERER_H
+#define LIGHT_CLUSTERER_H
+
+using namespace std;
+
+// A point light as stored in the std430 light buffer; the light fades to nothing at its range
+struct ClusterLight {
+    float position[3];
+    float range;
+    float color[3];     // Color times intensity
+    float padding;
+};
+
+// Sizes and timing of the most recent cluster build
+struct LightClustererCounters {
+    size_t lightIndices = 0;        // Entries of the light index list, one per light per cluster it reaches
+    unsigned maxClusterLights = 0;  // Most lights in one cluster
+    unsigned droppedLights = 0;     // Lights left out of clusters that already held the most lights a cluster may hold
+    double buildMilliseconds = 0.0;
+};
+
+class LightClusterer {
+public:
+    void create(int tilesX, int tilesY, int slices, float nearPlane, float farPlane, unsigned maxLightsPerCluster);
+    void build(const vector<ClusterLight>& lights, const float* view, const float* projection, ThreadPool* pool);
+    const vector<uint32_t>& clusters() const;
+    const vector<uint32_t>& lightIndices() const;
+    int clusterCount() const;
+    float sliceScale() const;
+    float sliceBias() const;
+    const LightClustererCounters& counters() const;
+
+private:
+    // A light moved into view space, with the depth slices its sphere reaches
+    struct ViewLight {
+        float center[3];
+        float radius;
+        int firstSlice;
+        int lastSlice;
+    };
+
+    void assignSlices(const float* projection, int firstSlice, int lastSlice);
+    bool tileBounds(const ViewLight& light, float nearBoxDepth, float farBoxDepth, const float* projection, int* tiles) const;
+    int slice(float depth) const;
+    float sliceDepth(int slice) const;
+
+    int tileCountX = 0;
+    int tileCountY = 0;
+    int sliceCount = 0;
+    float nearDepth = 0.1f;
+    float farDepth = 100.0f;
+    unsigned maxClusterLights = 0;
+    vector<ViewLight> viewLights;
+    vector<vector<uint32_t>> clusterLights; // Lights of every cluster, filled by the slice jobs
+    vector<uint32_t> clusterRanges;         // Offset into the light index list and light count of every cluster
+    vector<uint32_t> indices;
+    atomic<unsigned> dropped{ 0 };
+    LightClustererCounters stats;
+};
+
+#endif
\ No newline at end of file
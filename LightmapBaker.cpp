@@ -0,0 +1,571 @@
+#include "LightmapBaker.h"
+
+#include <cmath>
+#include <chrono>
+#include <map>
+#include <array>
+#include <numeric>
+#include <algorithm>
+
+// Triangles facing further than this from the first triangle of a chart start a chart of their own
+// The scene's meshes are convex, so a chart within this cone projects onto the plane of its first triangle without folding over
+const float CHART_NORMAL_LIMIT = 0.866f; // cos(30 degrees)
+
+// Empty texels around each chart; filtering reads one texel beyond the edge of a chart, and dilation fills them from the chart
+const int CHART_PADDING = 2;
+
+// Most triangles in a leaf of the bounding volume hierarchy
+const uint32_t BVH_LEAF_TRIANGLES = 4;
+
+// Distance shadow rays start off the surface so they do not hit the surface they start on
+const float SHADOW_RAY_OFFSET = 0.005f;
+
+// Smallest number of texels handed to one thread pool job
+const size_t MIN_TEXELS_PER_JOB = 1024;
+
+// Vector helpers for the three floats of positions and normals
+static float Dot(const float* a, const float* b)
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void Cross(const float* a, const float* b, float* result)
+{
+    result[0] = a[1] * b[2] - a[2] * b[1];
+    result[1] = a[2] * b[0] - a[0] * b[2];
+    result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static void Normalize(float* v)
+{
+    float length = sqrt(Dot(v, v));
+
+    if (length > 0.0f)
+        v[0] /= length, v[1] /= length, v[2] /= length;
+}
+
+// Give every vertex of a triangle list a second texture coordinate into a square of texels in which no two charts overlap
+// Edge-connected triangles facing within a cone of a chart's first triangle form the chart, projected onto that triangle's plane
+// at the given texels per mesh unit; the charts are then packed with the skyline packer into the smallest square they fit
+// The two coordinates, from 0 to 1 across the square, are appended to each vertex
+LightmapUnwrapStats LightmapBaker::unwrap(const vector<GLfloat>& vertices, GLuint floatsPerVertex, float texelsPerUnit, vector<GLfloat>& unwrappedVertices) const
+{
+    LightmapUnwrapStats unwrapStats;
+    size_t triangleCount = vertices.size() / floatsPerVertex / 3;
+
+    // Number the distinct corner positions so the triangles sharing an edge can be found, and find the direction every triangle faces
+    // The builders do not wind every triangle the same way, so the direction is the average of the vertex normals, not the winding's
+    map<array<float, 3>, uint32_t> positionIds;
+    vector<uint32_t> corners(triangleCount * 3);
+    vector<float> faceNormals(triangleCount * 3, 0.0f);
+
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            const GLfloat* vertex = &vertices[(t * 3 + c) * floatsPerVertex];
+            corners[t * 3 + c] = positionIds.emplace(array<float, 3>{ { vertex[0], vertex[1], vertex[2] } }, (uint32_t)positionIds.size()).first->second;
+
+            for (int axis = 0; axis < 3; axis++)
+                faceNormals[t * 3 + axis] += vertex[3 + axis];
+        }
+
+        Normalize(&faceNormals[t * 3]);
+    }
+
+    // The triangles on either side of every edge
+    map<pair<uint32_t, uint32_t>, vector<uint32_t>> edgeTriangles;
+
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            uint32_t a = corners[t * 3 + c], b = corners[t * 3 + (c + 1) % 3];
+            edgeTriangles[{ min(a, b), max(a, b) }].push_back((uint32_t)t);
+        }
+    }
+
+    // Grow each chart from the first triangle without one across its edges to the triangles facing within the cone of the first
+    vector<int> chartOf(triangleCount, -1);
+    vector<uint32_t> chartSeeds;
+    vector<uint32_t> stack;
+
+    for (size_t seed = 0; seed < triangleCount; seed++)
+    {
+        if (chartOf[seed] >= 0)
+            continue;
+
+        chartOf[seed] = (int)chartSeeds.size();
+        chartSeeds.push_back((uint32_t)seed);
+        stack.push_back((uint32_t)seed);
+
+        const float* seedNormal = &faceNormals[seed * 3];
+
+        while (!stack.empty())
+        {
+            uint32_t t = stack.back();
+            stack.pop_back();
+
+            for (int c = 0; c < 3; c++)
+            {
+                uint32_t a = corners[t * 3 + c], b = corners[t * 3 + (c + 1) % 3];
+
+                for (uint32_t neighbour : edgeTriangles[{ min(a, b), max(a, b) }])
+                {
+                    if (chartOf[neighbour] < 0 && Dot(&faceNormals[neighbour * 3], seedNormal) >= CHART_NORMAL_LIMIT)
+                    {
+                        chartOf[neighbour] = chartOf[seed];
+                        stack.push_back(neighbour);
+                    }
+                }
+            }
+        }
+    }
+
+    // Project every corner onto the plane of its chart's first triangle, in texels, and find the bounds of each chart
+    size_t chartCount = chartSeeds.size();
+    vector<float> chartAxes(chartCount * 6);
+    vector<float> chartBounds(chartCount * 4);
+    vector<float> projected(triangleCount * 6);
+
+    for (size_t chart = 0; chart < chartCount; chart++)
+    {
+        float normal[3] = { faceNormals[chartSeeds[chart] * 3], faceNormals[chartSeeds[chart] * 3 + 1], faceNormals[chartSeeds[chart] * 3 + 2] };
+
+        if (Dot(normal, normal) == 0.0f)
+            normal[1] = 1.0f;
+
+        // Any axis far enough from the normal gives the chart's first axis; the second is at right angles to both
+        float up[3] = { 0.0f, 1.0f, 0.0f }, across[3] = { 1.0f, 0.0f, 0.0f };
+        float* tangent = &chartAxes[chart * 6];
+        float* bitangent = &chartAxes[chart * 6 + 3];
+
+        Cross(fabs(normal[1]) < 0.9f ? up : across, normal, tangent);
+        Normalize(tangent);
+        Cross(normal, tangent, bitangent);
+
+        chartBounds[chart * 4] = chartBounds[chart * 4 + 1] = INFINITY;
+        chartBounds[chart * 4 + 2] = chartBounds[chart * 4 + 3] = -INFINITY;
+    }
+
+    for (size_t corner = 0; corner < triangleCount * 3; corner++)
+    {
+        size_t chart = (size_t)chartOf[corner / 3];
+        const GLfloat* position = &vertices[corner * floatsPerVertex];
+        float* uv = &projected[corner * 2];
+        float* bounds = &chartBounds[chart * 4];
+
+        uv[0] = Dot(position, &chartAxes[chart * 6]) * texelsPerUnit;
+        uv[1] = Dot(position, &chartAxes[chart * 6 + 3]) * texelsPerUnit;
+
+        bounds[0] = min(bounds[0], uv[0]), bounds[1] = min(bounds[1], uv[1]);
+        bounds[2] = max(bounds[2], uv[0]), bounds[3] = max(bounds[3], uv[1]);
+    }
+
+    // Pack the charts with their padding into the smallest square that holds them, starting from the square of their total area
+    vector<AtlasRect> rects(chartCount);
+    size_t area = 0;
+    int largest = 0;
+
+    for (size_t chart = 0; chart < chartCount; chart++)
+    {
+        const float* bounds = &chartBounds[chart * 4];
+
+        rects[chart].width = max((int)ceil(bounds[2] - bounds[0]), 1) + CHART_PADDING * 2;
+        rects[chart].height = max((int)ceil(bounds[3] - bounds[1]), 1) + CHART_PADDING * 2;
+
+        area += (size_t)rects[chart].width * rects[chart].height;
+        largest = max(largest, max(rects[chart].width, rects[chart].height));
+    }
+
+    int layoutSize = max((int)ceil(sqrt((double)area)), largest);
+    AtlasPacker packer;
+
+    while (!packer.pack(rects, layoutSize, layoutSize))
+        layoutSize += max(layoutSize / 8, 1);
+
+    // Append each corner's place in its chart's rectangle to the vertex
+    unwrappedVertices.clear();
+    unwrappedVertices.reserve(triangleCount * 3 * (floatsPerVertex + 2));
+
+    for (size_t corner = 0; corner < triangleCount * 3; corner++)
+    {
+        size_t chart = (size_t)chartOf[corner / 3];
+        const float* bounds = &chartBounds[chart * 4];
+
+        unwrappedVertices.insert(unwrappedVertices.end(), vertices.begin() + corner * floatsPerVertex, vertices.begin() + (corner + 1) * floatsPerVertex);
+        unwrappedVertices.push_back((rects[chart].x + CHART_PADDING + projected[corner * 2] - bounds[0]) / layoutSize);
+        unwrappedVertices.push_back((rects[chart].y + CHART_PADDING + projected[corner * 2 + 1] - bounds[1]) / layoutSize);
+    }
+
+    unwrapStats.charts = chartCount;
+    unwrapStats.layoutSize = layoutSize;
+
+    return unwrapStats;
+}
+
+// Bake the ambient light and the diffuse light of every light into a lightmap of RGB floats for the given surfaces
+// Each surface is rasterized into its texels on this thread; the texels are then lit in ranges on the thread pool, with a shadow
+// ray to each light that faces them when shadows are asked for, and the empty texels around the charts are filled last
+void LightmapBaker::bake(const vector<LightmapSurface>& surfaces, const vector<float>& occluders, const vector<LightmapLight>& lights, const float* ambientColor,
+    bool shadows, int width, int height, ThreadPool* pool, vector<float>& lightmap)
+{
+    auto bakeStart = chrono::steady_clock::now();
+
+    stats = LightmapBakeCounters();
+    lightmap.assign((size_t)width * height * 3, 0.0f);
+
+    vector<uint8_t> covered((size_t)width * height, 0);
+    texels.clear();
+
+    for (const LightmapSurface& surface : surfaces)
+        rasterize(surface, width, height, covered);
+
+    if (shadows)
+    {
+        buildBvh(occluders);
+        stats.occluderTriangles = occluders.size() / 9;
+    }
+
+    // Each job writes only the texels of its range and counts its own shadow rays
+    if (pool == nullptr || texels.size() < MIN_TEXELS_PER_JOB * 2)
+        lightTexels(0, texels.size(), lights, ambientColor, shadows, lightmap, stats.shadowRays);
+    else
+    {
+        size_t texelsPerJob = max(texels.size() / (pool->size() * 4), MIN_TEXELS_PER_JOB);
+        vector<size_t> jobShadowRays((texels.size() + texelsPerJob - 1) / texelsPerJob, 0);
+
+        for (size_t job = 0; job < jobShadowRays.size(); job++)
+        {
+            size_t firstTexel = job * texelsPerJob, lastTexel = min(firstTexel + texelsPerJob, texels.size());
+
+            pool->submit([this, firstTexel, lastTexel, &lights, ambientColor, shadows, &lightmap, &jobShadowRays, job] {
+                lightTexels(firstTexel, lastTexel, lights, ambientColor, shadows, lightmap, jobShadowRays[job]);
+            });
+        }
+
+        pool->wait();
+
+        for (size_t rays : jobShadowRays)
+            stats.shadowRays += rays;
+    }
+
+    stats.texelsLit = texels.size();
+    stats.texelsDilated = dilate(width, height, covered, lightmap);
+    stats.bakeMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - bakeStart).count();
+}
+
+const LightmapBakeCounters& LightmapBaker::counters() const
+{
+    return stats;
+}
+
+// Find the texels whose centers lie in each triangle of a surface, with the world position and normal at their centers
+// A texel two triangles share is kept for the first
+void LightmapBaker::rasterize(const LightmapSurface& surface, int width, int height, vector<uint8_t>& covered)
+{
+    size_t triangleCount = surface.positions.size() / 9;
+
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const float* uv = &surface.texels[t * 6];
+        const float* positions = &surface.positions[t * 9];
+        const float* normals = &surface.normals[t * 9];
+
+        // Twice the triangle's signed area in texels; the barycentric weights are the areas of the triangles each edge makes with the
+        // texel center over it, which keeps them correct for either winding
+        float area = (uv[2] - uv[0]) * (uv[5] - uv[1]) - (uv[4] - uv[0]) * (uv[3] - uv[1]);
+
+        if (fabs(area) < 1e-8f)
+            continue;
+
+        int minX = max((int)floor(min(uv[0], min(uv[2], uv[4]))), 0), maxX = min((int)ceil(max(uv[0], max(uv[2], uv[4]))), width - 1);
+        int minY = max((int)floor(min(uv[1], min(uv[3], uv[5]))), 0), maxY = min((int)ceil(max(uv[1], max(uv[3], uv[5]))), height - 1);
+
+        for (int y = minY; y <= maxY; y++)
+        {
+            for (int x = minX; x <= maxX; x++)
+            {
+                float centerX = x + 0.5f, centerY = y + 0.5f;
+                float weights[3];
+
+                weights[0] = ((uv[2] - centerX) * (uv[5] - centerY) - (uv[4] - centerX) * (uv[3] - centerY)) / area;
+                weights[1] = ((uv[4] - centerX) * (uv[1] - centerY) - (uv[0] - centerX) * (uv[5] - centerY)) / area;
+                weights[2] = 1.0f - weights[0] - weights[1];
+
+                size_t index = (size_t)y * width + x;
+
+                if (weights[0] < -1e-5f || weights[1] < -1e-5f || weights[2] < -1e-5f || covered[index])
+                    continue;
+
+                covered[index] = 1;
+
+                SurfaceTexel texel;
+                texel.index = (uint32_t)index;
+
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    texel.position[axis] = weights[0] * positions[axis] + weights[1] * positions[3 + axis] + weights[2] * positions[6 + axis];
+                    texel.normal[axis] = weights[0] * normals[axis] + weights[1] * normals[3 + axis] + weights[2] * normals[6 + axis];
+                }
+
+                Normalize(texel.normal);
+                texels.push_back(texel);
+            }
+        }
+    }
+}
+
+// Light a range of the rasterized texels with the ambient light and the diffuse light of each light that is not blocked
+void LightmapBaker::lightTexels(size_t firstTexel, size_t lastTexel, const vector<LightmapLight>& lights, const float* ambientColor, bool shadows,
+    vector<float>& lightmap, size_t& shadowRays) const
+{
+    for (size_t i = firstTexel; i < lastTexel; i++)
+    {
+        const SurfaceTexel& texel = texels[i];
+        float color[3] = { ambientColor[0], ambientColor[1], ambientColor[2] };
+
+        for (const LightmapLight& light : lights)
+        {
+            float lightDirection[3] = { light.position[0] - texel.position[0], light.position[1] - texel.position[1], light.position[2] - texel.position[2] };
+            Normalize(lightDirection);
+
+            float impact = Dot(texel.normal, lightDirection);
+
+            if (impact <= 0.0f)
+                continue;
+
+            // Start the shadow ray just off the surface and test it against everything between the texel and the light
+            if (shadows)
+            {
+                float origin[3];
+
+                for (int axis = 0; axis < 3; axis++)
+                    origin[axis] = texel.position[axis] + texel.normal[axis] * SHADOW_RAY_OFFSET;
+
+                shadowRays++;
+
+                if (occluded(origin, light.position))
+                    continue;
+            }
+
+            for (int channel = 0; channel < 3; channel++)
+                color[channel] += impact * light.color[channel];
+        }
+
+        for (int channel = 0; channel < 3; channel++)
+            lightmap[(size_t)texel.index * 3 + channel] = color[channel];
+    }
+}
+
+// Fill the empty texels next to covered ones with the average of their covered neighbours, one ring per pass, for as many rings
+// as the charts are padded by; returns the number of texels filled
+size_t LightmapBaker::dilate(int width, int height, vector<uint8_t>& covered, vector<float>& lightmap) const
+{
+    size_t filled = 0;
+    vector<uint8_t> coveredBefore;
+
+    for (int pass = 0; pass < CHART_PADDING; pass++)
+    {
+        coveredBefore = covered;
+
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                size_t index = (size_t)y * width + x;
+
+                if (coveredBefore[index])
+                    continue;
+
+                float sum[3] = { 0.0f, 0.0f, 0.0f };
+                int neighbours = 0;
+
+                for (int neighbourY = max(y - 1, 0); neighbourY <= min(y + 1, height - 1); neighbourY++)
+                {
+                    for (int neighbourX = max(x - 1, 0); neighbourX <= min(x + 1, width - 1); neighbourX++)
+                    {
+                        size_t neighbour = (size_t)neighbourY * width + neighbourX;
+
+                        if (!coveredBefore[neighbour])
+                            continue;
+
+                        for (int channel = 0; channel < 3; channel++)
+                            sum[channel] += lightmap[neighbour * 3 + channel];
+
+                        neighbours++;
+                    }
+                }
+
+                if (neighbours == 0)
+                    continue;
+
+                for (int channel = 0; channel < 3; channel++)
+                    lightmap[index * 3 + channel] = sum[channel] / neighbours;
+
+                covered[index] = 1;
+                filled++;
+            }
+        }
+    }
+
+    return filled;
+}
+
+// Build the bounding volume hierarchy of the occluder triangles the shadow rays are tested against
+void LightmapBaker::buildBvh(const vector<float>& occluders)
+{
+    uint32_t triangleCount = (uint32_t)(occluders.size() / 9);
+    vector<uint32_t> order(triangleCount);
+    vector<float> centroids((size_t)triangleCount * 3);
+
+    iota(order.begin(), order.end(), 0);
+
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+            centroids[t * 3 + axis] = (occluders[t * 9 + axis] + occluders[t * 9 + 3 + axis] + occluders[t * 9 + 6 + axis]) / 3.0f;
+    }
+
+    nodes.clear();
+    triangles.clear();
+    triangles.reserve(occluders.size());
+
+    if (triangleCount > 0)
+        buildNode(order, centroids, occluders, 0, triangleCount);
+}
+
+// Add a node for a range of the triangle order, splitting it at the median centroid along the longest axis of the centroids' bounds
+// until few enough triangles are left for a leaf; returns the node's index
+uint32_t LightmapBaker::buildNode(vector<uint32_t>& order, const vector<float>& centroids, const vector<float>& occluders, uint32_t first, uint32_t count)
+{
+    uint32_t nodeIndex = (uint32_t)nodes.size();
+    BvhNode node = { { INFINITY, INFINITY, INFINITY }, { -INFINITY, -INFINITY, -INFINITY }, 0, 0 };
+    float centroidMin[3] = { INFINITY, INFINITY, INFINITY }, centroidMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            for (int corner = 0; corner < 3; corner++)
+            {
+                node.boundsMin[axis] = min(node.boundsMin[axis], occluders[order[i] * 9 + corner * 3 + axis]);
+                node.boundsMax[axis] = max(node.boundsMax[axis], occluders[order[i] * 9 + corner * 3 + axis]);
+            }
+
+            centroidMin[axis] = min(centroidMin[axis], centroids[order[i] * 3 + axis]);
+            centroidMax[axis] = max(centroidMax[axis], centroids[order[i] * 3 + axis]);
+        }
+    }
+
+    nodes.push_back(node);
+
+    if (count <= BVH_LEAF_TRIANGLES)
+    {
+        nodes[nodeIndex].first = (uint32_t)(triangles.size() / 9);
+        nodes[nodeIndex].count = count;
+
+        for (uint32_t i = first; i < first + count; i++)
+            triangles.insert(triangles.end(), occluders.begin() + order[i] * 9, occluders.begin() + order[i] * 9 + 9);
+
+        return nodeIndex;
+    }
+
+    int splitAxis = 0;
+
+    for (int axis = 1; axis < 3; axis++)
+    {
+        if (centroidMax[axis] - centroidMin[axis] > centroidMax[splitAxis] - centroidMin[splitAxis])
+            splitAxis = axis;
+    }
+
+    nth_element(order.begin() + first, order.begin() + first + count / 2, order.begin() + first + count, [&centroids, splitAxis](uint32_t a, uint32_t b) {
+        return centroids[a * 3 + splitAxis] < centroids[b * 3 + splitAxis];
+    });
+
+    // The first child follows the node; the second is wherever the first child's subtree ends
+    buildNode(order, centroids, occluders, first, count / 2);
+    uint32_t secondChild = buildNode(order, centroids, occluders, first + count / 2, count - count / 2);
+    nodes[nodeIndex].first = secondChild;
+
+    return nodeIndex;
+}
+
+// Whether any occluder triangle crosses the segment from the origin to the target
+bool LightmapBaker::occluded(const float* origin, const float* target) const
+{
+    if (nodes.empty())
+        return false;
+
+    float direction[3] = { target[0] - origin[0], target[1] - origin[1], target[2] - origin[2] };
+    float inverseDirection[3];
+
+    for (int axis = 0; axis < 3; axis++)
+        inverseDirection[axis] = 1.0f / (fabs(direction[axis]) > 1e-12f ? direction[axis] : 1e-12f);
+
+    uint32_t stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        uint32_t nodeIndex = stack[--stackSize];
+        const BvhNode& node = nodes[nodeIndex];
+
+        // Skip the node unless the segment passes through its bounds
+        float nearT = 0.0f, farT = 1.0f;
+
+        for (int axis = 0; axis < 3 && nearT <= farT; axis++)
+        {
+            float t1 = (node.boundsMin[axis] - origin[axis]) * inverseDirection[axis];
+            float t2 = (node.boundsMax[axis] - origin[axis]) * inverseDirection[axis];
+
+            nearT = max(nearT, min(t1, t2));
+            farT = min(farT, max(t1, t2));
+        }
+
+        if (nearT > farT)
+            continue;
+
+        if (node.count == 0)
+        {
+            stack[stackSize++] = node.first;
+            stack[stackSize++] = nodeIndex + 1;
+            continue;
+        }
+
+        // Test the segment against each triangle of the leaf from either side
+        for (uint32_t t = node.first; t < node.first + node.count; t++)
+        {
+            const float* corners = &triangles[(size_t)t * 9];
+            float edge1[3] = { corners[3] - corners[0], corners[4] - corners[1], corners[5] - corners[2] };
+            float edge2[3] = { corners[6] - corners[0], corners[7] - corners[1], corners[8] - corners[2] };
+            float p[3], q[3];
+
+            Cross(direction, edge2, p);
+            float determinant = Dot(edge1, p);
+
+            if (fabs(determinant) < 1e-12f)
+                continue;
+
+            float toOrigin[3] = { origin[0] - corners[0], origin[1] - corners[1], origin[2] - corners[2] };
+            float u = Dot(toOrigin, p) / determinant;
+
+            if (u < 0.0f || u > 1.0f)
+                continue;
+
+            Cross(toOrigin, edge1, q);
+            float v = Dot(direction, q) / determinant;
+
+            if (v < 0.0f || u + v > 1.0f)
+                continue;
+
+            float hit = Dot(edge2, q) / determinant;
+
+            if (hit > 0.0f && hit < 1.0f)
+                return true;
+        }
+    }
+
+    return false;
+}
\ No newline at end of file
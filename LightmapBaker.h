@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "AtlasPacker.h"
+#include "ThreadPool.h"
+
+#ifndef LIGHTMAP_BAKER_H
+#define LIGHTMAP_BAKER_H
+
+using namespace std;
+
+// Charts of a mesh and the square of texels they were packed into
+struct LightmapUnwrapStats {
+    size_t charts = 0;
+    int layoutSize = 0; // Texels across the square the charts were packed into
+};
+
+// The triangles of one static draw in world space, three vertices per triangle, and where they land in the lightmap
+struct LightmapSurface {
+    vector<float> positions;    // World positions (X, Y, Z)
+    vector<float> normals;      // World normals (nX, nY, nZ)
+    vector<float> texels;       // Lightmap coordinates in texels from the lightmap's corner (u, v)
+};
+
+// A light whose diffuse light is baked into the lightmap
+struct LightmapLight {
+    float position[3];
+    float color[3];     // Color times intensity
+};
+
+// Sizes and timing of the most recent bake
+struct LightmapBakeCounters {
+    size_t texelsLit = 0;           // Texels covered by a surface
+    size_t texelsDilated = 0;       // Empty texels filled from their covered neighbours so filtering never reads an empty texel
+    size_t shadowRays = 0;
+    size_t occluderTriangles = 0;
+    double bakeMilliseconds = 0.0;
+};
+
+class LightmapBaker {
+public:
+    LightmapUnwrapStats unwrap(const vector<GLfloat>& vertices, GLuint floatsPerVertex, float texelsPerUnit, vector<GLfloat>& unwrappedVertices) const;
+    void bake(const vector<LightmapSurface>& surfaces, const vector<float>& occluders, const vector<LightmapLight>& lights, const float* ambientColor,
+        bool shadows, int width, int height, ThreadPool* pool, vector<float>& lightmap);
+    const LightmapBakeCounters& counters() const;
+
+private:
+    // A texel covered by a surface, with the world position and normal it was rasterized at
+    struct SurfaceTexel {
+        uint32_t index;
+        float position[3];
+        float normal[3];
+    };
+
+    // A node of the bounding volume hierarchy over the occluder triangles; leaves hold a range of triangles,
+    // inner nodes have no triangles and their second child at the given index, the first right after them
+    struct BvhNode {
+        float boundsMin[3];
+        float boundsMax[3];
+        uint32_t first;
+        uint32_t count;
+    };
+
+    void rasterize(const LightmapSurface& surface, int width, int height, vector<uint8_t>& covered);
+    void lightTexels(size_t firstTexel, size_t lastTexel, const vector<LightmapLight>& lights, const float* ambientColor, bool shadows,
+        vector<float>& lightmap, size_t& shadowRays) const;
+    size_t dilate(int width, int height, vector<uint8_t>& covered, vector<float>& lightmap) const;
+    void buildBvh(const vector<float>& occluders);
+    uint32_t buildNode(vector<uint32_t>& order, const vector<float>& centroids, const vector<float>& occluders, uint32_t first, uint32_t count);
+    bool occluded(const float* origin, const float* target) const;
+
+    vector<SurfaceTexel> texels;
+    vector<BvhNode> nodes;
+    vector<float> triangles;    // Occluder triangles in the order of the hierarchy's leaves, nine floats each
+    LightmapBakeCounters stats;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "MeshArena.h"
+
+#include <algorithm>
+
+// Create the arena with room for the given number of bytes; it grows when more is added than fits
+bool MeshArena::create(GLsizeiptr initialCapacity)
+{
+    used = 0;
+    stats = MeshArenaCounters();
+
+    return grow(initialCapacity);
+}
+
+void MeshArena::destroy()
+{
+    if (arenaBuffer != 0)
+        glDeleteBuffers(1, &arenaBuffer);
+
+    arenaBuffer = 0;
+    capacity = 0;
+    used = 0;
+}
+
+// Copy the whole contents of a buffer to the end of the arena and return where it starts
+// The copy stays on the GPU; every copy starts on 16 bytes so shaders can address it in 32-bit words
+bool MeshArena::add(GLuint sourceBuffer, GLintptr& offset)
+{
+    GLint64 size = 0;
+    glBindBuffer(GL_COPY_READ_BUFFER, sourceBuffer);
+    glGetBufferParameteri64v(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+
+    offset = (used + 15) / 16 * 16;
+
+    if (offset + size > capacity && !grow(max(capacity * 2, (GLsizeiptr)(offset + size))))
+        return false;
+
+    glBindBuffer(GL_COPY_READ_BUFFER, sourceBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arenaBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, offset, (GLsizeiptr)size);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    used = offset + (GLsizeiptr)size;
+    stats.bytesUsed = used;
+    stats.buffersAdded++;
+
+    return true;
+}
+
+GLuint MeshArena::buffer() const
+{
+    return arenaBuffer;
+}
+
+const MeshArenaCounters& MeshArena::counters() const
+{
+    return stats;
+}
+
+// Move the arena into a new buffer with room for the given number of bytes, keeping what it already holds
+bool MeshArena::grow(GLsizeiptr newCapacity)
+{
+    GLuint newBuffer = 0;
+    glGenBuffers(1, &newBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, newCapacity, nullptr, 0);
+
+    if (glGetError() != GL_NO_ERROR)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &newBuffer);
+        return false;
+    }
+
+    if (used > 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, arenaBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        stats.grows++;
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    if (arenaBuffer != 0)
+        glDeleteBuffers(1, &arenaBuffer);
+
+    arenaBuffer = newBuffer;
+    capacity = newCapacity;
+    stats.capacity = capacity;
+
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#ifndef MESH_ARENA_H
+#define MESH_ARENA_H
+
+using namespace std;
+
+// Usage counters of the mesh arena
+struct MeshArenaCounters {
+    GLsizeiptr bytesUsed = 0;
+    GLsizeiptr capacity = 0;
+    unsigned long buffersAdded = 0;
+    unsigned long grows = 0;    // Times the arena moved into a larger buffer to make room
+};
+
+class MeshArena {
+public:
+    bool create(GLsizeiptr initialCapacity);
+    void destroy();
+    bool add(GLuint sourceBuffer, GLintptr& offset);
+    GLuint buffer() const;
+    const MeshArenaCounters& counters() const;
+
+private:
+    bool grow(GLsizeiptr newCapacity);
+
+    // One GPU-only buffer that mesh buffers are copied into back to back, so a shader can fetch the vertices of any mesh
+    GLuint arenaBuffer = 0;
+    GLsizeiptr capacity = 0;
+    GLsizeiptr used = 0;
+    MeshArenaCounters stats;
+};
+
+#endif
\ No newline at end of file
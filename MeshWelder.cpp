@@ -0,0 +1,93 @@
+#include "MeshWelder.h"
+
+#include <cmath>
+
+// Vertex attributes are snapped to a grid of 1 / 2^20 before comparing, so values that differ only by rounding noise still weld
+const double QUANTIZE_SCALE = 1048576.0;
+
+// Welds identical vertices of an unindexed triangle list into unique vertices and an index buffer
+// Works on any interleaved float layout; every attribute of two vertices must match for them to be welded
+// Runs in linear time with an open-addressing hash table keyed on the quantized vertex bits
+MeshWeldStats MeshWelder::weld(const vector<GLfloat>& vertices, int floatsPerVertex, vector<GLfloat>& weldedVertices, vector<GLuint>& indices)
+{
+    size_t vertexCount = vertices.size() / floatsPerVertex;
+
+    // Size the table to a power of two at least twice the vertex count to keep probe chains short
+    size_t tableSize = 16;
+
+    while (tableSize < vertexCount * 2)
+        tableSize <<= 1;
+
+    // Each slot holds the welded vertex index plus one; zero marks an empty slot
+    vector<GLuint> table(tableSize, 0);
+
+    // Quantized key of every welded vertex, used to confirm a match after the hashes collide
+    vector<int64_t> weldedKeys;
+    vector<int64_t> key(floatsPerVertex);
+
+    size_t firstWeldedFloat = weldedVertices.size();
+    GLuint firstWeldedVertex = (GLuint)(firstWeldedFloat / floatsPerVertex);
+
+    indices.reserve(indices.size() + vertexCount);
+
+    for (size_t vertex = 0; vertex < vertexCount; vertex++)
+    {
+        const GLfloat* attributes = &vertices[vertex * floatsPerVertex];
+
+        // Quantize the vertex; adding zero turns -0.0 into 0.0 so both weld together
+        for (int i = 0; i < floatsPerVertex; i++)
+            key[i] = llround((attributes[i] + 0.0) * QUANTIZE_SCALE);
+
+        size_t slot = hashKey(key.data(), floatsPerVertex) & (tableSize - 1);
+
+        // Probe linearly until the vertex is found or an empty slot is reached
+        while (table[slot] != 0)
+        {
+            const int64_t* candidate = &weldedKeys[(size_t)(table[slot] - 1) * floatsPerVertex];
+            bool match = true;
+
+            for (int i = 0; i < floatsPerVertex && match; i++)
+                match = candidate[i] == key[i];
+
+            if (match)
+                break;
+
+            slot = (slot + 1) & (tableSize - 1);
+        }
+
+        // The first occurrence of a vertex is kept with its exact attributes
+        if (table[slot] == 0)
+        {
+            weldedVertices.insert(weldedVertices.end(), attributes, attributes + floatsPerVertex);
+            weldedKeys.insert(weldedKeys.end(), key.begin(), key.end());
+            table[slot] = (GLuint)(weldedKeys.size() / floatsPerVertex);
+        }
+
+        indices.push_back(firstWeldedVertex + table[slot] - 1);
+    }
+
+    MeshWeldStats stats;
+    stats.inputVertices = vertexCount;
+    stats.outputVertices = (weldedVertices.size() - firstWeldedFloat) / floatsPerVertex;
+    stats.reductionRatio = stats.outputVertices > 0 ? (float)stats.inputVertices / stats.outputVertices : 1.0f;
+
+    return stats;
+}
+
+// Hashes the quantized attributes of a vertex (FNV-1a over each attribute followed by a final avalanche)
+uint64_t MeshWelder::hashKey(const int64_t* key, int floatsPerVertex)
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    for (int i = 0; i < floatsPerVertex; i++)
+    {
+        hash ^= (uint64_t)key[i];
+        hash *= 1099511628211ull;
+    }
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+
+    return hash;
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#ifndef MESH_WELDER_H
+#define MESH_WELDER_H
+
+using namespace std;
+
+// Vertex counts before and after welding a mesh
+struct MeshWeldStats {
+    size_t inputVertices;
+    size_t outputVertices;
+    float reductionRatio; // Input vertices per output vertex
+};
+
+class MeshWelder {
+public:
+    MeshWeldStats weld(const vector<GLfloat>& vertices, int floatsPerVertex, vector<GLfloat>& weldedVertices, vector<GLuint>& indices);
+
+private:
+    uint64_t hashKey(const int64_t* key, int floatsPerVertex);
+};
+
+#endif
\ No newline at end of file
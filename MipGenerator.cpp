@@ -0,0 +1,219 @@
+#include "MipGenerator.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <xmmintrin.h>  // SSE
+#include <emmintrin.h>  // SSE2
+
+// Radius of the Lanczos filter in destination pixels
+const int LANCZOS_RADIUS = 3;
+
+const float PI = 3.14159265358979f;
+
+// Minimum number of rows handed to one thread pool job
+const int MIN_ROWS_PER_JOB = 16;
+
+// Lanczos-3 kernel: a sinc windowed by a wider sinc
+static float lanczos(float x)
+{
+    x = fabs(x);
+
+    if (x < 1e-6f)
+        return 1.0f;
+
+    if (x >= LANCZOS_RADIUS)
+        return 0.0f;
+
+    float piX = PI * x;
+
+    return LANCZOS_RADIUS * sin(piX) * sin(piX / LANCZOS_RADIUS) / (piX * piX);
+}
+
+// Generate the full mip chain of an RGBA8 image down to 1x1, including a copy of the image as level 0
+// Every level halves the previous one rounding down, as OpenGL expects for non-power-of-two textures, so odd sizes are resampled
+// by slightly more than two instead of dropping a row or column. Filtering is done on premultiplied alpha so transparent texels
+// do not bleed their color into the visible ones. Repeating textures wrap at the edges; the others clamp to the edge
+// Rows of each pass are split across the thread pool when one is given
+void MipGenerator::generate(const uint8_t* image, int width, int height, bool repeat, ThreadPool* pool, vector<MipLevel>& levels)
+{
+    levels.clear();
+    levels.push_back({ width, height, vector<uint8_t>(image, image + (size_t)width * height * 4) });
+
+    // Premultiplied floating point copy of the current level
+    vector<float> current((size_t)width * height * 4);
+
+    for (size_t i = 0; i < (size_t)width * height; i++)
+    {
+        float alpha = image[i * 4 + 3] / 255.0f;
+
+        for (int c = 0; c < 3; c++)
+            current[i * 4 + c] = image[i * 4 + c] / 255.0f * alpha;
+
+        current[i * 4 + 3] = alpha;
+    }
+
+    int levelWidth = width, levelHeight = height;
+    vector<int> columnIndices, rowIndices;
+    vector<float> columnWeights, rowWeights;
+    int columnTaps, rowTaps;
+
+    while (levelWidth > 1 || levelHeight > 1)
+    {
+        int nextWidth = max(levelWidth / 2, 1), nextHeight = max(levelHeight / 2, 1);
+
+        buildTaps(levelWidth, nextWidth, repeat, columnIndices, columnWeights, columnTaps);
+        buildTaps(levelHeight, nextHeight, repeat, rowIndices, rowWeights, rowTaps);
+
+        // Separable resampling: filter along each row, then along each column
+        vector<float> horizontal((size_t)nextWidth * levelHeight * 4);
+        vector<float> next((size_t)nextWidth * nextHeight * 4);
+
+        runRows(levelHeight, pool, [&](int firstRow, int lastRow) {
+            resampleRows(current.data(), levelWidth, horizontal.data(), nextWidth, firstRow, lastRow, columnIndices, columnWeights, columnTaps);
+        });
+
+        runRows(nextHeight, pool, [&](int firstRow, int lastRow) {
+            resampleColumns(horizontal.data(), nextWidth, next.data(), firstRow, lastRow, rowIndices, rowWeights, rowTaps);
+        });
+
+        MipLevel level = { nextWidth, nextHeight, vector<uint8_t>((size_t)nextWidth * nextHeight * 4) };
+
+        // Clamp the ringing of the filter, then store the level with straight alpha
+        runRows(nextHeight, pool, [&](int firstRow, int lastRow) {
+            const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), scale = _mm_set1_ps(255.0f), tiny = _mm_set1_ps(1e-8f);
+            const __m128 colorMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+
+            for (size_t i = (size_t)firstRow * nextWidth; i < (size_t)lastRow * nextWidth; i++)
+            {
+                __m128 texel = _mm_loadu_ps(&next[i * 4]);
+                __m128 alpha = _mm_shuffle_ps(texel, texel, _MM_SHUFFLE(3, 3, 3, 3));
+                alpha = _mm_min_ps(_mm_max_ps(alpha, zero), one);
+
+                // A premultiplied color can not exceed its alpha
+                texel = _mm_min_ps(_mm_max_ps(texel, zero), alpha);
+                _mm_storeu_ps(&next[i * 4], texel);
+
+                __m128 straight = _mm_div_ps(texel, _mm_max_ps(alpha, tiny));
+                straight = _mm_or_ps(_mm_and_ps(colorMask, straight), _mm_andnot_ps(colorMask, alpha));
+
+                __m128i integers = _mm_cvtps_epi32(_mm_mul_ps(straight, scale));
+                integers = _mm_packs_epi32(integers, integers);
+                integers = _mm_packus_epi16(integers, integers);
+
+                int packed = _mm_cvtsi128_si32(integers);
+                memcpy(&level.pixels[i * 4], &packed, 4);
+            }
+        });
+
+        levels.push_back(move(level));
+        current.swap(next);
+        levelWidth = nextWidth, levelHeight = nextHeight;
+    }
+}
+
+// Source texel indices and normalized weights of every destination texel along one axis
+void MipGenerator::buildTaps(int sourceSize, int destinationSize, bool repeat, vector<int>& indices, vector<float>& weights, int& tapCount)
+{
+    // The kernel is stretched by the reduction so it covers the same destination footprint for odd sizes
+    float scale = max((float)sourceSize / destinationSize, 1.0f);
+    float support = LANCZOS_RADIUS * scale;
+    tapCount = (int)ceil(support) * 2 + 1;
+
+    indices.resize((size_t)destinationSize * tapCount);
+    weights.resize((size_t)destinationSize * tapCount);
+
+    for (int d = 0; d < destinationSize; d++)
+    {
+        // Center of the destination texel in source texel coordinates
+        float center = (d + 0.5f) * sourceSize / destinationSize - 0.5f;
+        int first = (int)floor(center - support);
+        float total = 0.0f;
+
+        for (int k = 0; k < tapCount; k++)
+        {
+            int source = first + k;
+            float weight = lanczos((source - center) / scale);
+
+            if (repeat)
+                source = ((source % sourceSize) + sourceSize) % sourceSize;
+            else
+                source = min(max(source, 0), sourceSize - 1);
+
+            indices[(size_t)d * tapCount + k] = source;
+            weights[(size_t)d * tapCount + k] = weight;
+            total += weight;
+        }
+
+        for (int k = 0; k < tapCount; k++)
+            weights[(size_t)d * tapCount + k] /= total;
+    }
+}
+
+// Filter the given rows horizontally; every RGBA texel is one SSE register
+void MipGenerator::resampleRows(const float* source, int sourceWidth, float* destination, int destinationWidth, int firstRow, int lastRow,
+    const vector<int>& indices, const vector<float>& weights, int tapCount)
+{
+    for (int y = firstRow; y < lastRow; y++)
+    {
+        const float* sourceRow = source + (size_t)y * sourceWidth * 4;
+        float* destinationRow = destination + (size_t)y * destinationWidth * 4;
+
+        for (int x = 0; x < destinationWidth; x++)
+        {
+            const int* texelIndices = &indices[(size_t)x * tapCount];
+            const float* texelWeights = &weights[(size_t)x * tapCount];
+            __m128 sum = _mm_setzero_ps();
+
+            for (int k = 0; k < tapCount; k++)
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(texelWeights[k]), _mm_loadu_ps(sourceRow + texelIndices[k] * 4)));
+
+            _mm_storeu_ps(destinationRow + x * 4, sum);
+        }
+    }
+}
+
+// Filter the given destination rows vertically, accumulating whole source rows at a time
+void MipGenerator::resampleColumns(const float* source, int width, float* destination, int firstRow, int lastRow,
+    const vector<int>& indices, const vector<float>& weights, int tapCount)
+{
+    for (int y = firstRow; y < lastRow; y++)
+    {
+        float* destinationRow = destination + (size_t)y * width * 4;
+
+        for (int x = 0; x < width; x++)
+            _mm_storeu_ps(destinationRow + x * 4, _mm_setzero_ps());
+
+        for (int k = 0; k < tapCount; k++)
+        {
+            const float* sourceRow = source + (size_t)indices[(size_t)y * tapCount + k] * width * 4;
+            __m128 weight = _mm_set1_ps(weights[(size_t)y * tapCount + k]);
+
+            for (int x = 0; x < width; x++)
+            {
+                __m128 sum = _mm_loadu_ps(destinationRow + x * 4);
+                _mm_storeu_ps(destinationRow + x * 4, _mm_add_ps(sum, _mm_mul_ps(weight, _mm_loadu_ps(sourceRow + x * 4))));
+            }
+        }
+    }
+}
+
+// Run a job over row ranges, split across the thread pool when one is given and the rows are worth splitting
+void MipGenerator::runRows(int rowCount, ThreadPool* pool, const function<void(int, int)>& job)
+{
+    if (pool == nullptr || rowCount < MIN_ROWS_PER_JOB * 2)
+    {
+        job(0, rowCount);
+        return;
+    }
+
+    int rowsPerJob = max(rowCount / (int)(pool->size() * 4), MIN_ROWS_PER_JOB);
+
+    for (int firstRow = 0; firstRow < rowCount; firstRow += rowsPerJob)
+    {
+        int lastRow = min(firstRow + rowsPerJob, rowCount);
+        pool->submit([&job, firstRow, lastRow] { job(firstRow, lastRow); });
+    }
+
+    pool->wait();
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "ThreadPool.h"
+
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+using namespace std;
+
+// One level of a mip chain as straight alpha RGBA8 pixels
+struct MipLevel {
+    int width;
+    int height;
+    vector<uint8_t> pixels;
+};
+
+class MipGenerator {
+public:
+    void generate(const uint8_t* image, int width, int height, bool repeat, ThreadPool* pool, vector<MipLevel>& levels);
+
+private:
+    void buildTaps(int sourceSize, int destinationSize, bool repeat, vector<int>& indices, vector<float>& weights, int& tapCount);
+    void resampleRows(const float* source, int sourceWidth, float* destination, int destinationWidth, int firstRow, int lastRow,
+        const vector<int>& indices, const vector<float>& weights, int tapCount);
+    void resampleColumns(const float* source, int width, float* destination, int firstRow, int lastRow,
+        const vector<int>& indices, const vector<float>& weights, int tapCount);
+    void runRows(int rowCount, ThreadPool* pool, const function<void(int, int)>& job);
+};
+
+#endif
\ No newline at end of file
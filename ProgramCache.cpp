@@ -0,0 +1,133 @@
+#include "ProgramCache.h"
+
+#include <cstdio>       // Key formatting
+#include <cstring>      // memcmp and memcpy
+#include <vector>
+#include <fstream>      // Binary files
+
+const char PROGRAM_CACHE_MAGIC[4] = { 'C', 'P', 'R', 'G' };
+const uint32_t PROGRAM_CACHE_VERSION = 2;
+
+// 64-bit FNV-1a hash of a string, continued from the given hash
+static uint64_t fnv1a(const char* text, uint64_t hash = 14695981039346656037ull)
+{
+    for (; *text; text++)
+        hash = (hash ^ (uint8_t)*text) * 1099511628211ull;
+
+    // Hash the terminator too so consecutive strings can not run into each other
+    return hash * 1099511628211ull;
+}
+
+// Use the given directory for cached program binaries; it must already exist
+// The cache stays disabled when the driver can not return program binaries in any format
+bool ProgramCache::open(const char* directory)
+{
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+
+    cacheDirectory = directory;
+    driver = string((const char*)glGetString(GL_VENDOR)) + "\n" + (const char*)glGetString(GL_RENDERER) + "\n" + (const char*)glGetString(GL_VERSION);
+    enabled = formatCount > 0;
+
+    return enabled;
+}
+
+bool ProgramCache::isOpen() const
+{
+    return enabled;
+}
+
+// Key of a program: a hash of both complete sources, including any inserted defines, and of the driver that compiles them
+uint64_t ProgramCache::key(const char* vertexSource, const char* fragmentSource) const
+{
+    return fnv1a(fragmentSource, fnv1a(vertexSource, fnv1a(driver.c_str())));
+}
+
+// Create the program from the binary cached under the key; returns false when there is none or the driver rejects it,
+// in which case the program is left without a binary to be compiled from source
+bool ProgramCache::load(uint64_t key, GLuint program)
+{
+    if (!enabled)
+        return false;
+
+    ifstream file(path(key), ios::binary);
+
+    if (!file)
+        return false;
+
+    BinaryHeader header;
+    vector<char> binary;
+
+    if (!file.read((char*)&header, sizeof(header)) || memcmp(header.magic, PROGRAM_CACHE_MAGIC, 4) != 0 ||
+        header.version != PROGRAM_CACHE_VERSION || header.key != key || header.driverLength != driver.size())
+        return false;
+
+    // The key already covers the driver; comparing the string as well keeps a colliding key from another driver out
+    string savedDriver(header.driverLength, '\0');
+
+    if (!file.read(&savedDriver[0], savedDriver.size()) || savedDriver != driver)
+        return false;
+
+    binary.resize(header.size);
+
+    if (!file.read(binary.data(), binary.size()))
+        return false;
+
+    glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+
+    GLint success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+
+    if (!success)
+    {
+        stats.rejected++;
+        return false;
+    }
+
+    return true;
+}
+
+// Save the binary of a linked program under the key; the program should be linked with the retrievable hint
+void ProgramCache::save(uint64_t key, GLuint program)
+{
+    if (!enabled)
+        return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+    if (length <= 0)
+        return;
+
+    vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    BinaryHeader header;
+    memcpy(header.magic, PROGRAM_CACHE_MAGIC, 4);
+    header.version = PROGRAM_CACHE_VERSION;
+    header.key = key;
+    header.format = format;
+    header.size = (uint32_t)length;
+    header.driverLength = (uint32_t)driver.size();
+    header.reserved = 0;
+
+    ofstream file(path(key), ios::binary | ios::trunc);
+    file.write((const char*)&header, sizeof(header));
+    file.write(driver.data(), driver.size());
+    file.write(binary.data(), length);
+}
+
+ProgramCacheCounters& ProgramCache::counters()
+{
+    return stats;
+}
+
+// File of the binary cached under a key
+string ProgramCache::path(uint64_t key) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+
+    return cacheDirectory + "/" + name;
+}
\ No newline at end of file
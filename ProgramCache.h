@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+using namespace std;
+
+// Hits, misses and time spent of the program cache
+struct ProgramCacheCounters {
+    unsigned loaded = 0;            // Programs created from a cached binary
+    unsigned compiled = 0;          // Programs compiled from source because no usable binary was cached
+    unsigned rejected = 0;          // Cached binaries the driver refused, such as after a driver update
+    double loadMilliseconds = 0.0;
+    double compileMilliseconds = 0.0;
+};
+
+class ProgramCache {
+public:
+    bool open(const char* directory);
+    bool isOpen() const;
+    uint64_t key(const char* vertexSource, const char* fragmentSource) const;
+    bool load(uint64_t key, GLuint program);
+    void save(uint64_t key, GLuint program);
+    ProgramCacheCounters& counters();
+
+private:
+    // Header of a cached program binary file, followed by the driver string it was saved with and then the binary itself
+    // A binary is only loaded when the stored key, a hash of both complete sources and the driver, and the stored driver string
+    // match the program being created
+    struct BinaryHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t key;           // Hash of both complete sources and of the driver the binary was saved with
+        uint32_t format;        // Driver specific binary format returned by glGetProgramBinary
+        uint32_t size;
+        uint32_t driverLength;  // Length of the driver string after the header
+        uint32_t reserved;
+    };
+
+    string path(uint64_t key) const;
+
+    string cacheDirectory;
+    string driver;          // Vendor, renderer and version strings of the driver, hashed into every key
+    bool enabled = false;
+    ProgramCacheCounters stats;
+};
+
+#endif
\ No newline at end of file
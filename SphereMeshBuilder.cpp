@@ -7,6 +7,10 @@ void SphereMeshBuilder::buildMesh(vector<GLfloat>& vertices, vector<GLushort>& i
     const int X_SEGMENTS = segments;
     const int Y_SEGMENTS = segments;
 
+    // A sphere needs at least one segment each way; fewer would divide by zero
+    if (segments < 1)
+        return;
+
     // Generate vertices, normals, and texture coordinates for a sphere with the given amount of segments
     for (int x = 0; x <= X_SEGMENTS; ++x)
     {
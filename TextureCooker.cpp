@@ -0,0 +1,677 @@
+#include "TextureCooker.h"
+
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <algorithm>
+
+// KTX2 file identifier
+const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+// Vulkan format numbers stored in the KTX2 header
+const uint32_t VK_FORMAT_BC1_RGB_UNORM_BLOCK = 131;
+const uint32_t VK_FORMAT_BC3_UNORM_BLOCK = 137;
+const uint32_t VK_FORMAT_BC7_UNORM_BLOCK = 145;
+
+// Data format descriptor color models and channels of the block compressed formats
+const uint32_t KHR_DF_MODEL_BC1A = 128;
+const uint32_t KHR_DF_MODEL_BC3 = 130;
+const uint32_t KHR_DF_MODEL_BC7 = 134;
+const uint32_t KHR_DF_CHANNEL_COLOR = 0;
+const uint32_t KHR_DF_CHANNEL_BC3_ALPHA = 15;
+
+// BC7 interpolation weights for 4-bit indices
+const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Block rows encoded by one thread pool job
+const int BLOCK_ROWS_PER_JOB = 8;
+
+// Pack an 8-bit color into 5:6:5 bits
+static uint16_t pack565(float r, float g, float b)
+{
+    int r5 = (int)(min(max(r, 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    int g6 = (int)(min(max(g, 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+    int b5 = (int)(min(max(b, 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+
+    return (uint16_t)((r5 << 11) | (g6 << 5) | b5);
+}
+
+// Expand a 5:6:5 color back to 8 bits per channel the way the GPU does
+static void unpack565(uint16_t color, int* rgb)
+{
+    int r5 = (color >> 11) & 31, g6 = (color >> 5) & 63, b5 = color & 31;
+
+    rgb[0] = (r5 << 3) | (r5 >> 2);
+    rgb[1] = (g6 << 2) | (g6 >> 4);
+    rgb[2] = (b5 << 3) | (b5 >> 2);
+}
+
+// Append bits to a block, least significant bit first
+static void writeBits(uint8_t* block, int& bitPosition, uint32_t value, int count)
+{
+    for (int i = 0; i < count; i++, bitPosition++)
+    {
+        if ((value >> i) & 1)
+            block[bitPosition >> 3] |= (uint8_t)(1 << (bitPosition & 7));
+    }
+}
+
+// Find the principal axis of the pixels of a block with power iteration; returns false for a block of one color
+static bool principalAxis(const uint8_t* pixels, int channels, float* mean, float* axis)
+{
+    float covariance[4][4] = {};
+
+    for (int c = 0; c < channels; c++)
+    {
+        mean[c] = 0.0f;
+
+        for (int i = 0; i < 16; i++)
+            mean[c] += pixels[i * 4 + c];
+
+        mean[c] /= 16.0f;
+    }
+
+    for (int i = 0; i < 16; i++)
+    {
+        for (int a = 0; a < channels; a++)
+        {
+            for (int b = 0; b < channels; b++)
+                covariance[a][b] += (pixels[i * 4 + a] - mean[a]) * (pixels[i * 4 + b] - mean[b]);
+        }
+    }
+
+    for (int c = 0; c < channels; c++)
+        axis[c] = 1.0f;
+
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {};
+        float length = 0.0f;
+
+        for (int a = 0; a < channels; a++)
+        {
+            for (int b = 0; b < channels; b++)
+                next[a] += covariance[a][b] * axis[b];
+
+            length = max(length, fabs(next[a]));
+        }
+
+        if (length < 1e-6f)
+            return false;
+
+        for (int c = 0; c < channels; c++)
+            axis[c] = next[c] / length;
+    }
+
+    // Normalize the axis so projections are in color units
+    float length = 0.0f;
+
+    for (int c = 0; c < channels; c++)
+        length += axis[c] * axis[c];
+
+    length = sqrt(length);
+
+    for (int c = 0; c < channels; c++)
+        axis[c] /= length;
+
+    return true;
+}
+
+// Encode the RGB part of a 4x4 block of RGBA pixels as an 8 byte BC1 block in four color mode
+void TextureCooker::encodeBC1(const uint8_t* pixels, uint8_t* block)
+{
+    float mean[4], axis[4];
+    float endpoints[2][3];
+
+    if (principalAxis(pixels, 3, mean, axis))
+    {
+        // Place the endpoints at the extremes of the pixels along the principal axis
+        float minProjection = 1e9f, maxProjection = -1e9f;
+
+        for (int i = 0; i < 16; i++)
+        {
+            float projection = 0.0f;
+
+            for (int c = 0; c < 3; c++)
+                projection += (pixels[i * 4 + c] - mean[c]) * axis[c];
+
+            minProjection = min(minProjection, projection), maxProjection = max(maxProjection, projection);
+        }
+
+        for (int c = 0; c < 3; c++)
+        {
+            endpoints[0][c] = mean[c] + maxProjection * axis[c];
+            endpoints[1][c] = mean[c] + minProjection * axis[c];
+        }
+    }
+    else
+    {
+        for (int c = 0; c < 3; c++)
+            endpoints[0][c] = endpoints[1][c] = mean[c];
+    }
+
+    uint16_t bestColors[2] = { 0, 0 };
+    uint8_t bestIndices[16] = {};
+    int bestError = INT32_MAX;
+
+    // Pick indices for the quantized endpoints, then refit the endpoints to those indices with least squares
+    for (int iteration = 0; iteration < 3; iteration++)
+    {
+        uint16_t colors[2] = { pack565(endpoints[0][0], endpoints[0][1], endpoints[0][2]), pack565(endpoints[1][0], endpoints[1][1], endpoints[1][2]) };
+        int palette[4][3];
+
+        unpack565(colors[0], palette[0]);
+        unpack565(colors[1], palette[1]);
+
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        uint8_t indices[16];
+        int error = 0;
+
+        for (int i = 0; i < 16; i++)
+        {
+            int bestDistance = INT32_MAX;
+
+            for (int p = 0; p < 4; p++)
+            {
+                int distance = 0;
+
+                for (int c = 0; c < 3; c++)
+                    distance += (pixels[i * 4 + c] - palette[p][c]) * (pixels[i * 4 + c] - palette[p][c]);
+
+                if (distance < bestDistance)
+                    bestDistance = distance, indices[i] = (uint8_t)p;
+            }
+
+            error += bestDistance;
+        }
+
+        if (error < bestError)
+        {
+            bestError = error;
+            bestColors[0] = colors[0], bestColors[1] = colors[1];
+            memcpy(bestIndices, indices, sizeof(indices));
+        }
+
+        // Least squares fit of both endpoints given the weight each index puts on the first endpoint
+        const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f, ap[3] = {}, bp[3] = {};
+
+        for (int i = 0; i < 16; i++)
+        {
+            float a = weights[indices[i]], b = 1.0f - a;
+            aa += a * a, ab += a * b, bb += b * b;
+
+            for (int c = 0; c < 3; c++)
+                ap[c] += a * pixels[i * 4 + c], bp[c] += b * pixels[i * 4 + c];
+        }
+
+        float determinant = aa * bb - ab * ab;
+
+        if (fabs(determinant) < 1e-6f)
+            break;
+
+        for (int c = 0; c < 3; c++)
+        {
+            endpoints[0][c] = (ap[c] * bb - bp[c] * ab) / determinant;
+            endpoints[1][c] = (bp[c] * aa - ap[c] * ab) / determinant;
+        }
+    }
+
+    // Four color mode requires the first color to be greater; swapping the colors swaps the index pairs
+    if (bestColors[0] < bestColors[1])
+    {
+        swap(bestColors[0], bestColors[1]);
+
+        for (uint8_t& index : bestIndices)
+            index ^= 1;
+    }
+    else if (bestColors[0] == bestColors[1])
+    {
+        memset(bestIndices, 0, sizeof(bestIndices));
+    }
+
+    uint32_t packedIndices = 0;
+
+    for (int i = 0; i < 16; i++)
+        packedIndices |= (uint32_t)bestIndices[i] << (i * 2);
+
+    memcpy(block, &bestColors[0], 2);
+    memcpy(block + 2, &bestColors[1], 2);
+    memcpy(block + 4, &packedIndices, 4);
+}
+
+// Encode the alpha of a 4x4 block of RGBA pixels as the 8 byte alpha half of a BC3 block in eight alpha mode
+void TextureCooker::encodeBC3Alpha(const uint8_t* pixels, uint8_t* block)
+{
+    int alpha0 = 0, alpha1 = 255;
+
+    for (int i = 0; i < 16; i++)
+        alpha0 = max(alpha0, (int)pixels[i * 4 + 3]), alpha1 = min(alpha1, (int)pixels[i * 4 + 3]);
+
+    int palette[8] = { alpha0, alpha1 };
+
+    for (int p = 1; p < 7; p++)
+        palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+
+    uint64_t packedIndices = 0;
+
+    for (int i = 0; i < 16 && alpha0 != alpha1; i++)
+    {
+        int bestDistance = INT32_MAX;
+        uint64_t bestIndex = 0;
+
+        for (int p = 0; p < 8; p++)
+        {
+            int distance = abs(pixels[i * 4 + 3] - palette[p]);
+
+            if (distance < bestDistance)
+                bestDistance = distance, bestIndex = p;
+        }
+
+        packedIndices |= bestIndex << (i * 3);
+    }
+
+    block[0] = (uint8_t)alpha0;
+    block[1] = (uint8_t)alpha1;
+    memcpy(block + 2, &packedIndices, 6);
+}
+
+// Encode a 4x4 block of RGBA pixels as a 16 byte BC7 mode 6 block
+// Mode 6 has one subset with 7-bit RGBA endpoints, a shared low bit per endpoint, and 4-bit indices
+void TextureCooker::encodeBC7(const uint8_t* pixels, uint8_t* block)
+{
+    float mean[4], axis[4];
+    float endpoints[2][4];
+
+    if (principalAxis(pixels, 4, mean, axis))
+    {
+        float minProjection = 1e9f, maxProjection = -1e9f;
+
+        for (int i = 0; i < 16; i++)
+        {
+            float projection = 0.0f;
+
+            for (int c = 0; c < 4; c++)
+                projection += (pixels[i * 4 + c] - mean[c]) * axis[c];
+
+            minProjection = min(minProjection, projection), maxProjection = max(maxProjection, projection);
+        }
+
+        for (int c = 0; c < 4; c++)
+        {
+            endpoints[0][c] = mean[c] + minProjection * axis[c];
+            endpoints[1][c] = mean[c] + maxProjection * axis[c];
+        }
+    }
+    else
+    {
+        for (int c = 0; c < 4; c++)
+            endpoints[0][c] = endpoints[1][c] = mean[c];
+    }
+
+    int bestQuantized[2][4] = {}, bestPBits[2] = {};
+    uint8_t bestIndices[16] = {};
+    int bestError = INT32_MAX;
+
+    for (int iteration = 0; iteration < 3; iteration++)
+    {
+        // Try every combination of the shared low bits for the quantized endpoints
+        for (int pBitCombination = 0; pBitCombination < 4; pBitCombination++)
+        {
+            int pBits[2] = { pBitCombination & 1, pBitCombination >> 1 };
+            int quantized[2][4], expanded[2][4];
+
+            for (int e = 0; e < 2; e++)
+            {
+                for (int c = 0; c < 4; c++)
+                {
+                    float value = min(max(endpoints[e][c], 0.0f), 255.0f);
+                    quantized[e][c] = min(max((int)((value - pBits[e]) / 2.0f + 0.5f), 0), 127);
+                    expanded[e][c] = (quantized[e][c] << 1) | pBits[e];
+                }
+            }
+
+            int palette[16][4];
+
+            for (int p = 0; p < 16; p++)
+            {
+                for (int c = 0; c < 4; c++)
+                    palette[p][c] = ((64 - BC7_WEIGHTS[p]) * expanded[0][c] + BC7_WEIGHTS[p] * expanded[1][c] + 32) >> 6;
+            }
+
+            uint8_t indices[16];
+            int error = 0;
+
+            for (int i = 0; i < 16 && error < bestError; i++)
+            {
+                int bestDistance = INT32_MAX;
+
+                for (int p = 0; p < 16; p++)
+                {
+                    int distance = 0;
+
+                    for (int c = 0; c < 4; c++)
+                        distance += (pixels[i * 4 + c] - palette[p][c]) * (pixels[i * 4 + c] - palette[p][c]);
+
+                    if (distance < bestDistance)
+                        bestDistance = distance, indices[i] = (uint8_t)p;
+                }
+
+                error += bestDistance;
+            }
+
+            if (error < bestError)
+            {
+                bestError = error;
+                memcpy(bestQuantized, quantized, sizeof(quantized));
+                bestPBits[0] = pBits[0], bestPBits[1] = pBits[1];
+                memcpy(bestIndices, indices, sizeof(indices));
+            }
+        }
+
+        // Least squares fit of both endpoints given the best indices so far
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f, ap[4] = {}, bp[4] = {};
+
+        for (int i = 0; i < 16; i++)
+        {
+            float b = BC7_WEIGHTS[bestIndices[i]] / 64.0f, a = 1.0f - b;
+            aa += a * a, ab += a * b, bb += b * b;
+
+            for (int c = 0; c < 4; c++)
+                ap[c] += a * pixels[i * 4 + c], bp[c] += b * pixels[i * 4 + c];
+        }
+
+        float determinant = aa * bb - ab * ab;
+
+        if (fabs(determinant) < 1e-6f)
+            break;
+
+        for (int c = 0; c < 4; c++)
+        {
+            endpoints[0][c] = (ap[c] * bb - bp[c] * ab) / determinant;
+            endpoints[1][c] = (bp[c] * aa - ap[c] * ab) / determinant;
+        }
+    }
+
+    // The first index is stored with 3 bits, so its top bit must be zero; swapping the endpoints inverts every index
+    if (bestIndices[0] >= 8)
+    {
+        for (int c = 0; c < 4; c++)
+            swap(bestQuantized[0][c], bestQuantized[1][c]);
+
+        swap(bestPBits[0], bestPBits[1]);
+
+        for (uint8_t& index : bestIndices)
+            index = 15 - index;
+    }
+
+    memset(block, 0, 16);
+    int bitPosition = 0;
+
+    writeBits(block, bitPosition, 1 << 6, 7); // Mode 6
+
+    for (int c = 0; c < 4; c++)
+    {
+        writeBits(block, bitPosition, bestQuantized[0][c], 7);
+        writeBits(block, bitPosition, bestQuantized[1][c], 7);
+    }
+
+    writeBits(block, bitPosition, bestPBits[0], 1);
+    writeBits(block, bitPosition, bestPBits[1], 1);
+
+    for (int i = 0; i < 16; i++)
+        writeBits(block, bitPosition, bestIndices[i], i == 0 ? 3 : 4);
+}
+
+// Encode one RGBA mip level into blocks, splitting the block rows across the thread pool
+// Blocks that extend past the edge of the image repeat the edge pixels
+void TextureCooker::encodeLevel(const uint8_t* image, int width, int height, CookedFormat format, uint8_t* blocks, ThreadPool& pool)
+{
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    size_t bytesPerBlock = blockBytes(format);
+
+    for (int firstRow = 0; firstRow < blocksY; firstRow += BLOCK_ROWS_PER_JOB)
+    {
+        pool.submit([=] {
+            uint8_t pixels[64];
+
+            for (int blockY = firstRow; blockY < min(firstRow + BLOCK_ROWS_PER_JOB, blocksY); blockY++)
+            {
+                for (int blockX = 0; blockX < blocksX; blockX++)
+                {
+                    for (int i = 0; i < 16; i++)
+                    {
+                        int x = min(blockX * 4 + (i & 3), width - 1), y = min(blockY * 4 + (i >> 2), height - 1);
+                        memcpy(pixels + i * 4, image + ((size_t)y * width + x) * 4, 4);
+                    }
+
+                    uint8_t* block = blocks + ((size_t)blockY * blocksX + blockX) * bytesPerBlock;
+
+                    if (format == COOKED_BC1)
+                        encodeBC1(pixels, block);
+                    else if (format == COOKED_BC3)
+                        encodeBC3Alpha(pixels, block), encodeBC1(pixels, block + 8);
+                    else
+                        encodeBC7(pixels, block);
+                }
+            }
+        });
+    }
+
+    pool.wait();
+}
+
+// Build the full mip chain of one or more equally sized RGBA layers and encode every level in the given format
+// The chain comes from the mip generator, so it has the same filtering and non-power-of-two sizes as uncooked textures
+void TextureCooker::cook(const vector<const uint8_t*>& layers, int width, int height, bool isArray, bool repeat, CookedFormat format, ThreadPool& pool, CookedTexture& cooked)
+{
+    cooked.format = format;
+    cooked.width = width;
+    cooked.height = height;
+    cooked.layers = isArray ? (int)layers.size() : 0;
+    cooked.levels.clear();
+    cooked.data.clear();
+
+    size_t bytesPerBlock = blockBytes(format);
+
+    // The mip chain of every layer
+    vector<vector<MipLevel>> layerLevels(layers.size());
+
+    for (size_t layer = 0; layer < layers.size(); layer++)
+        mipGenerator.generate(layers[layer], width, height, repeat, &pool, layerLevels[layer]);
+
+    for (size_t mip = 0; mip < layerLevels[0].size(); mip++)
+    {
+        int levelWidth = layerLevels[0][mip].width, levelHeight = layerLevels[0][mip].height;
+        size_t layerSize = (size_t)((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * bytesPerBlock;
+        CookedLevel level = { levelWidth, levelHeight, cooked.data.size(), layerSize * layers.size() };
+        cooked.data.resize(cooked.data.size() + level.size);
+
+        for (size_t layer = 0; layer < layers.size(); layer++)
+            encodeLevel(layerLevels[layer][mip].pixels.data(), levelWidth, levelHeight, format, &cooked.data[level.offset + layer * layerSize], pool);
+
+        cooked.levels.push_back(level);
+    }
+}
+
+// Write a cooked texture as a KTX2 file with a basic data format descriptor and no supercompression
+// Mip levels are stored from the smallest to the largest as the KTX2 layout requires
+bool TextureCooker::writeKtx2(const char* filename, const CookedTexture& cooked)
+{
+    uint32_t vkFormat = cooked.format == COOKED_BC1 ? VK_FORMAT_BC1_RGB_UNORM_BLOCK :
+        cooked.format == COOKED_BC3 ? VK_FORMAT_BC3_UNORM_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+    uint32_t bytesPerBlock = (uint32_t)blockBytes(cooked.format);
+    uint32_t levelCount = (uint32_t)cooked.levels.size();
+
+    // Data format descriptor: the total size followed by one basic descriptor block with one sample per compressed channel
+    uint32_t sampleCount = cooked.format == COOKED_BC3 ? 2 : 1;
+    uint32_t descriptorBlockSize = 24 + 16 * sampleCount;
+    uint32_t colorModel = cooked.format == COOKED_BC1 ? KHR_DF_MODEL_BC1A : cooked.format == COOKED_BC3 ? KHR_DF_MODEL_BC3 : KHR_DF_MODEL_BC7;
+
+    vector<uint32_t> dfd = {
+        4 + descriptorBlockSize,
+        0,                                          // Khronos vendor, basic descriptor type
+        2 | (descriptorBlockSize << 16),            // Version 1.3
+        colorModel | (1 << 8) | (1 << 16),          // BT.709 primaries, linear transfer, straight alpha
+        3 | (3 << 8),                               // 4x4 texel blocks
+        bytesPerBlock,
+        0
+    };
+
+    if (cooked.format == COOKED_BC3)
+    {
+        dfd.insert(dfd.end(), { 0 | (63 << 16) | (KHR_DF_CHANNEL_BC3_ALPHA << 24), 0, 0, 0xFFFFFFFF });
+        dfd.insert(dfd.end(), { 64 | (63 << 16) | (KHR_DF_CHANNEL_COLOR << 24), 0, 0, 0xFFFFFFFF });
+    }
+    else
+    {
+        uint32_t bitLength = bytesPerBlock * 8 - 1;
+        dfd.insert(dfd.end(), { 0 | (bitLength << 16) | (KHR_DF_CHANNEL_COLOR << 24), 0, 0, 0xFFFFFFFF });
+    }
+
+    uint32_t dfdOffset = 80 + 24 * levelCount;
+    uint32_t dfdLength = (uint32_t)(dfd.size() * sizeof(uint32_t));
+
+    // Level data is aligned to the block size, which is a multiple of 4
+    vector<uint64_t> levelOffsets(levelCount);
+    uint64_t offset = dfdOffset + dfdLength;
+
+    for (int level = (int)levelCount - 1; level >= 0; level--)
+    {
+        offset = (offset + bytesPerBlock - 1) / bytesPerBlock * bytesPerBlock;
+        levelOffsets[level] = offset;
+        offset += cooked.levels[level].size;
+    }
+
+    vector<uint8_t> file((size_t)offset, 0);
+    uint32_t header[17] = {
+        vkFormat, 1, (uint32_t)cooked.width, (uint32_t)cooked.height, 0, (uint32_t)cooked.layers, 1, levelCount, 0,
+        dfdOffset, dfdLength, 0, 0, 0, 0, 0, 0
+    };
+
+    memcpy(&file[0], KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    memcpy(&file[12], header, sizeof(header));
+
+    for (uint32_t level = 0; level < levelCount; level++)
+    {
+        uint64_t levelIndex[3] = { levelOffsets[level], cooked.levels[level].size, cooked.levels[level].size };
+        memcpy(&file[80 + 24 * level], levelIndex, sizeof(levelIndex));
+        memcpy(&file[(size_t)levelOffsets[level]], &cooked.data[cooked.levels[level].offset], cooked.levels[level].size);
+    }
+
+    memcpy(&file[dfdOffset], dfd.data(), dfdLength);
+
+    ofstream output(filename, ios::binary);
+    output.write((const char*)file.data(), file.size());
+
+    return output.good();
+}
+
+// Read a KTX2 file written by the cooker; returns false for missing files and formats the cooker does not produce
+bool TextureCooker::readKtx2(const char* filename, CookedTexture& cooked)
+{
+    ifstream input(filename, ios::binary);
+
+    if (!input)
+        return false;
+
+    vector<uint8_t> file((istreambuf_iterator<char>(input)), istreambuf_iterator<char>());
+
+    if (file.size() < 80 || memcmp(&file[0], KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+        return false;
+
+    uint32_t header[9];
+    memcpy(header, &file[12], sizeof(header));
+
+    uint32_t vkFormat = header[0], levelCount = header[7], supercompression = header[8];
+
+    if (vkFormat == VK_FORMAT_BC1_RGB_UNORM_BLOCK)
+        cooked.format = COOKED_BC1;
+    else if (vkFormat == VK_FORMAT_BC3_UNORM_BLOCK)
+        cooked.format = COOKED_BC3;
+    else if (vkFormat == VK_FORMAT_BC7_UNORM_BLOCK)
+        cooked.format = COOKED_BC7;
+    else
+        return false;
+
+    if (supercompression != 0 || levelCount == 0 || file.size() < 80 + 24 * (size_t)levelCount)
+        return false;
+
+    cooked.width = header[2];
+    cooked.height = header[3];
+    cooked.layers = header[5];
+    cooked.levels.clear();
+    cooked.data.clear();
+
+    for (uint32_t level = 0; level < levelCount; level++)
+    {
+        uint64_t levelIndex[3];
+        memcpy(levelIndex, &file[80 + 24 * level], sizeof(levelIndex));
+
+        if (levelIndex[0] + levelIndex[1] > file.size())
+            return false;
+
+        CookedLevel cookedLevel = { max(cooked.width >> level, 1), max(cooked.height >> level, 1), cooked.data.size(), (size_t)levelIndex[1] };
+        cooked.data.insert(cooked.data.end(), file.begin() + (size_t)levelIndex[0], file.begin() + (size_t)(levelIndex[0] + levelIndex[1]));
+        cooked.levels.push_back(cookedLevel);
+    }
+
+    return true;
+}
+
+// Read only the format and array layer count of a KTX2 file written by the cooker; returns false for missing files and other formats
+bool TextureCooker::readKtx2Format(const char* filename, CookedFormat& format, int& layers)
+{
+    ifstream input(filename, ios::binary);
+    uint8_t header[36];
+
+    if (!input.read((char*)header, sizeof(header)) || memcmp(header, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+        return false;
+
+    uint32_t vkFormat;
+    memcpy(&vkFormat, &header[12], sizeof(vkFormat));
+
+    if (vkFormat == VK_FORMAT_BC1_RGB_UNORM_BLOCK)
+        format = COOKED_BC1;
+    else if (vkFormat == VK_FORMAT_BC3_UNORM_BLOCK)
+        format = COOKED_BC3;
+    else if (vkFormat == VK_FORMAT_BC7_UNORM_BLOCK)
+        format = COOKED_BC7;
+    else
+        return false;
+
+    uint32_t layerCount;
+    memcpy(&layerCount, &header[32], sizeof(layerCount));
+    layers = (int)layerCount;
+
+    return true;
+}
+
+// OpenGL internal format of a cooked format
+GLenum TextureCooker::glInternalFormat(CookedFormat format)
+{
+    if (format == COOKED_BC1)
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    else if (format == COOKED_BC3)
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+
+    return GL_COMPRESSED_RGBA_BPTC_UNORM;
+}
+
+// Size of one 4x4 block in bytes
+size_t TextureCooker::blockBytes(CookedFormat format)
+{
+    return format == COOKED_BC1 ? 8 : 16;
+}
+
+// Display name of a cooked format
+const char* TextureCooker::formatName(CookedFormat format)
+{
+    return format == COOKED_BC1 ? "BC1" : format == COOKED_BC3 ? "BC3" : "BC7";
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "ThreadPool.h"
+#include "MipGenerator.h"
+
+#ifndef TEXTURE_COOKER_H
+#define TEXTURE_COOKER_H
+
+using namespace std;
+
+// Block compressed formats the cooker can encode
+enum CookedFormat {
+    COOKED_BC1, // Opaque RGB, 8 bytes per 4x4 block
+    COOKED_BC3, // RGBA with interpolated alpha, 16 bytes per 4x4 block
+    COOKED_BC7  // RGBA encoded with BC7 mode 6, 16 bytes per 4x4 block
+};
+
+// One mip level of a cooked texture; each level holds every array layer back to back
+struct CookedLevel {
+    int width;
+    int height;
+    size_t offset; // Offset of the level in the cooked data in bytes
+    size_t size;   // Size of the level in bytes
+};
+
+// A block compressed texture with its whole mip chain
+struct CookedTexture {
+    CookedFormat format;
+    int width;
+    int height;
+    int layers; // Number of array layers, or 0 for a texture that is not an array
+    vector<CookedLevel> levels;
+    vector<uint8_t> data;
+};
+
+class TextureCooker {
+public:
+    void cook(const vector<const uint8_t*>& layers, int width, int height, bool isArray, bool repeat, CookedFormat format, ThreadPool& pool, CookedTexture& cooked);
+    bool writeKtx2(const char* filename, const CookedTexture& cooked);
+    bool readKtx2(const char* filename, CookedTexture& cooked);
+    bool readKtx2Format(const char* filename, CookedFormat& format, int& layers);
+    GLenum glInternalFormat(CookedFormat format);
+    size_t blockBytes(CookedFormat format);
+    const char* formatName(CookedFormat format);
+
+private:
+    void encodeLevel(const uint8_t* image, int width, int height, CookedFormat format, uint8_t* blocks, ThreadPool& pool);
+    void encodeBC1(const uint8_t* pixels, uint8_t* block);
+    void encodeBC3Alpha(const uint8_t* pixels, uint8_t* block);
+    void encodeBC7(const uint8_t* pixels, uint8_t* block);
+
+    MipGenerator mipGenerator;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,479 @@
+#include "TextureStreamer.h"
+
+#include <cmath>        // log2
+#include <cstring>      // memcpy
+#include <algorithm>    // min and max
+
+// Levels no larger than this are uploaded when a texture is added so it can be drawn right away
+const int STREAM_TAIL_SIZE = 64;
+
+// Levels that can be on their way through the staging ring at once
+const size_t MAX_UPLOADS_IN_FLIGHT = 8;
+
+// Allocate the staging buffer and start the background job that copies levels into it
+// Textures can be added from any thread with a shared context current; every other call belongs to the render thread
+bool TextureStreamer::create(size_t budgetBytes, size_t stagingBytes)
+{
+    budget = budgetBytes;
+    copyPool.reset(new ThreadPool(1));
+    lastUpdate = chrono::steady_clock::now();
+
+    return createStaging(stagingBytes);
+}
+
+// Wait for the background job and release the staging buffer and the streaming sources
+// The textures themselves belong to the caller
+void TextureStreamer::destroy()
+{
+    if (copyPool)
+        copyPool->wait();
+
+    copyPool.reset();
+
+    for (StreamUpload& upload : uploads)
+    {
+        if (upload.fence)
+            glDeleteSync(upload.fence);
+    }
+
+    uploads.clear();
+    destroyStaging();
+
+    lock_guard<mutex> lock(texturesMutex);
+    texturesByName.clear();
+    textures.clear();
+}
+
+// Allocate full immutable storage for every level of the texture, but only upload its smallest levels
+// The larger levels are streamed in once a draw needs them; returns the texture name
+GLuint TextureStreamer::add(StreamedTextureData&& data, int wrapType)
+{
+    unique_ptr<StreamedTexture> streamed(new StreamedTexture());
+    streamed->target = data.layers > 0 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+    streamed->data = move(data);
+
+    const StreamedTextureData& source = streamed->data;
+    GLenum target = streamed->target;
+    GLsizei levelCount = (GLsizei)source.levels.size();
+
+    glGenTextures(1, &streamed->texture);
+    glBindTexture(target, streamed->texture);
+
+    // Set the texture wrapping parameters
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, wrapType);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, wrapType);
+
+    // Set texture parameters for trilinear filtering to reduce texture shimmer
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // Compact formats are swizzled so shaders read the same RGBA values as from the RGBA8 texture they replace
+    if (!source.compressed)
+    {
+        GLenum format, type;
+        GLint swizzle[4];
+        pixelLayout(source.internalFormat, format, type, swizzle);
+        glTexParameteriv(target, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+
+    if (target == GL_TEXTURE_2D_ARRAY)
+        glTexStorage3D(target, levelCount, source.internalFormat, source.width, source.height, source.layers);
+    else
+        glTexStorage2D(target, levelCount, source.internalFormat, source.width, source.height);
+
+    // Upload the tail of the mip chain; the last level is always part of it
+    int tailLevel = levelCount - 1;
+
+    while (tailLevel > 0 && max(source.levels[tailLevel - 1].width, source.levels[tailLevel - 1].height) <= STREAM_TAIL_SIZE)
+        tailLevel--;
+
+    size_t tailBytes = 0;
+
+    for (int level = tailLevel; level < levelCount; level++)
+    {
+        uploadLevel(*streamed, level, levelData(*streamed, level));
+        tailBytes += source.levels[level].size;
+    }
+
+    // Sampling is limited to the uploaded levels
+    setBaseLevel(*streamed, tailLevel);
+    glBindTexture(target, 0);
+
+    streamed->tailLevel = tailLevel;
+    streamed->residentLevel = tailLevel;
+    streamed->wantedLevel = tailLevel;
+
+    GLuint texture = streamed->texture;
+
+    lock_guard<mutex> lock(texturesMutex);
+    stats.allocatedBytes += source.levels.back().offset + source.levels.back().size;
+    stats.residentBytes += tailBytes;
+    stats.peakResidentBytes = max(stats.peakResidentBytes, stats.residentBytes);
+    texturesByName[texture] = streamed.get();
+    textures.push_back(move(streamed));
+
+    return texture;
+}
+
+// Ask for the level of the texture that a draw covering the given number of screen pixels per texture repeat needs
+// One texel per pixel is level 0; every halving of the screen size is one level coarser
+void TextureStreamer::request(GLuint texture, float screenPixels)
+{
+    lock_guard<mutex> lock(texturesMutex);
+    auto found = texturesByName.find(texture);
+
+    if (found == texturesByName.end())
+        return;
+
+    StreamedTexture& streamed = *found->second;
+    float texelsPerPixel = max(streamed.data.width, streamed.data.height) / max(screenPixels, 1.0f);
+    int level = texelsPerPixel > 1.0f ? (int)floor(log2(texelsPerPixel)) : 0;
+    level = min(level, (int)streamed.data.levels.size() - 1);
+
+    // The finest level any draw of the frame asked for wins
+    if (streamed.lastUsedFrame != frame)
+        streamed.wantedLevel = level;
+    else
+        streamed.wantedLevel = min(streamed.wantedLevel, level);
+
+    streamed.lastUsedFrame = frame;
+}
+
+// Upload the levels the background job has copied, retire the staging space the GPU is done with,
+// and start streaming the next level of every texture drawn with less detail than it asked for
+// Call once per frame after the frame's requests
+void TextureStreamer::update()
+{
+    lock_guard<mutex> lock(texturesMutex);
+
+    // Time with uploads in flight since the last frame counts toward the upload throughput
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+
+    if (!uploads.empty())
+        stats.uploadMilliseconds += chrono::duration<double, milli>(now - lastUpdate).count();
+
+    lastUpdate = now;
+
+    for (auto upload = uploads.begin(); upload != uploads.end();)
+    {
+        if (!upload->issued)
+        {
+            if (!upload->copied.load(memory_order_acquire))
+            {
+                ++upload;
+                continue;
+            }
+
+            StreamedTexture& streamed = *upload->texture;
+
+            // Upload from the staging buffer; the source pointer is an offset into the bound pixel unpack buffer
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+            glBindTexture(streamed.target, streamed.texture);
+            uploadLevel(streamed, upload->level, (const void*)(uintptr_t)upload->stagingOffset);
+
+            // Commands of this context run in order, so the new level can be sampled from the next draw on
+            setBaseLevel(streamed, upload->level);
+            glBindTexture(streamed.target, 0);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+            // The staging space is free once the GPU has read it
+            upload->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            upload->issued = true;
+
+            streamed.residentLevel = upload->level;
+            streamed.streaming = false;
+            stats.levelsStreamed++;
+            stats.streamedBytes += levelBytes(streamed, upload->level);
+
+            ++upload;
+            continue;
+        }
+
+        GLenum result = glClientWaitSync(upload->fence, 0, 0);
+
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+        {
+            glDeleteSync(upload->fence);
+            upload = uploads.erase(upload);
+        }
+        else
+        {
+            ++upload;
+        }
+    }
+
+    startUploads();
+
+    frame++;
+}
+
+// Leave the base level of every texture at zero and let the shaders clamp sampling to the resident level instead
+// Needed for bindless textures, whose parameters can not change once they have a handle; set before adding textures
+void TextureStreamer::clampLevelsInShader(bool enable)
+{
+    shaderLevelClamp = enable;
+}
+
+// Finest uploaded level of the texture, which shaders clamping levels themselves must not sample past; zero for unknown textures
+int TextureStreamer::residentLevel(GLuint texture)
+{
+    lock_guard<mutex> lock(texturesMutex);
+    auto found = texturesByName.find(texture);
+
+    return found != texturesByName.end() ? found->second->residentLevel : 0;
+}
+
+// Residency and streaming counters
+const TextureStreamerCounters& TextureStreamer::counters() const
+{
+    return stats;
+}
+
+// Limit sampling of the bound texture to the given level and coarser ones, unless the shaders clamp the level themselves
+void TextureStreamer::setBaseLevel(const StreamedTexture& texture, int level)
+{
+    if (!shaderLevelClamp)
+        glTexParameteri(texture.target, GL_TEXTURE_BASE_LEVEL, level);
+}
+
+// Upload one level, with every array layer, into the bound texture from client memory or the bound pixel unpack buffer
+void TextureStreamer::uploadLevel(const StreamedTexture& texture, int level, const void* pixels)
+{
+    const StreamedLevel& streamedLevel = texture.data.levels[level];
+    GLenum format = GL_RGBA, type = GL_UNSIGNED_BYTE;
+    GLint swizzle[4];
+
+    // Rows of the one, two, and three byte formats are tightly packed
+    if (!texture.data.compressed)
+    {
+        pixelLayout(texture.data.internalFormat, format, type, swizzle);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    }
+
+    if (texture.target == GL_TEXTURE_2D_ARRAY)
+    {
+        if (texture.data.compressed)
+            glCompressedTexSubImage3D(texture.target, level, 0, 0, 0, streamedLevel.width, streamedLevel.height, texture.data.layers,
+                texture.data.internalFormat, (GLsizei)streamedLevel.size, pixels);
+        else
+            glTexSubImage3D(texture.target, level, 0, 0, 0, streamedLevel.width, streamedLevel.height, texture.data.layers,
+                format, type, pixels);
+    }
+    else
+    {
+        if (texture.data.compressed)
+            glCompressedTexSubImage2D(texture.target, level, 0, 0, streamedLevel.width, streamedLevel.height,
+                texture.data.internalFormat, (GLsizei)streamedLevel.size, pixels);
+        else
+            glTexSubImage2D(texture.target, level, 0, 0, streamedLevel.width, streamedLevel.height, format, type, pixels);
+    }
+}
+
+// Pixel transfer format and type of an uncompressed format, and the swizzle that expands it back to RGBA
+// R8 holds gray and RG8 holds gray and alpha; formats without alpha read it as one
+void TextureStreamer::pixelLayout(GLenum internalFormat, GLenum& format, GLenum& type, GLint* swizzle) const
+{
+    type = GL_UNSIGNED_BYTE;
+    swizzle[0] = GL_RED, swizzle[1] = GL_GREEN, swizzle[2] = GL_BLUE, swizzle[3] = GL_ALPHA;
+
+    switch (internalFormat)
+    {
+    case GL_R8:
+        format = GL_RED;
+        swizzle[1] = GL_RED, swizzle[2] = GL_RED, swizzle[3] = GL_ONE;
+        break;
+    case GL_RG8:
+        format = GL_RG;
+        swizzle[1] = GL_RED, swizzle[2] = GL_RED, swizzle[3] = GL_GREEN;
+        break;
+    case GL_RGB8:
+        format = GL_RGB;
+        swizzle[3] = GL_ONE;
+        break;
+    case GL_RGB565:
+        format = GL_RGB;
+        type = GL_UNSIGNED_SHORT_5_6_5;
+        swizzle[3] = GL_ONE;
+        break;
+    default:
+        format = GL_RGBA;
+        break;
+    }
+}
+
+// Stream the next finer level of every texture that was drawn last frame with less detail than it asked for
+// Levels arrive one at a time from coarse to fine, evicting unused detail when the budget is reached
+void TextureStreamer::startUploads()
+{
+    for (unique_ptr<StreamedTexture>& texture : textures)
+    {
+        StreamedTexture& streamed = *texture;
+
+        if (streamed.streaming || streamed.lastUsedFrame != frame || streamed.wantedLevel >= streamed.residentLevel)
+            continue;
+
+        if (uploads.size() >= MAX_UPLOADS_IN_FLIGHT)
+            break;
+
+        int level = streamed.residentLevel - 1;
+        size_t bytes = levelBytes(streamed, level);
+
+        // Grow the staging ring for a level larger than all of it once no level is in flight
+        if (bytes > stagingSize && (!uploads.empty() || !createStaging((bytes + 15) / 16 * 16)))
+            break;
+
+        // Wait for the oldest levels to retire when the ring has no room left
+        size_t stagingOffset, previousHead = stagingHead;
+
+        if (!reserveStaging(bytes, stagingOffset))
+            break;
+
+        if (stats.residentBytes + bytes > budget && !evictFor(bytes, &streamed))
+        {
+            stagingHead = previousHead;
+            stats.budgetStalls++;
+            continue;
+        }
+
+        uploads.emplace_back();
+        StreamUpload& upload = uploads.back();
+        upload.texture = &streamed;
+        upload.level = level;
+        upload.stagingOffset = stagingOffset;
+        streamed.streaming = true;
+        stats.residentBytes += bytes;
+        stats.peakResidentBytes = max(stats.peakResidentBytes, stats.residentBytes);
+
+        // The background job only copies memory; the upload itself is issued by the render thread once the copy is done
+        const uint8_t* source = levelData(streamed, level);
+        uint8_t* destination = stagingData + upload.stagingOffset;
+        StreamUpload* pending = &upload;
+
+        copyPool->submit([pending, source, destination, bytes] {
+            memcpy(destination, source, bytes);
+            pending->copied.store(true, memory_order_release);
+        });
+    }
+}
+
+// Evict the finest levels of textures that were not drawn last frame, least recently drawn first,
+// or that hold more detail than they asked for, until the given number of bytes fits in the budget
+bool TextureStreamer::evictFor(size_t bytes, const StreamedTexture* requester)
+{
+    while (stats.residentBytes + bytes > budget)
+    {
+        StreamedTexture* victim = nullptr;
+
+        for (unique_ptr<StreamedTexture>& texture : textures)
+        {
+            StreamedTexture* candidate = texture.get();
+
+            // The tail levels always stay resident
+            if (candidate == requester || candidate->streaming || candidate->residentLevel >= candidate->tailLevel)
+                continue;
+
+            bool unused = candidate->lastUsedFrame != frame;
+            bool excess = candidate->wantedLevel > candidate->residentLevel;
+
+            if ((unused || excess) && (victim == nullptr || candidate->lastUsedFrame < victim->lastUsedFrame))
+                victim = candidate;
+        }
+
+        if (victim == nullptr)
+            return false;
+
+        // Sample from the next coarser level; the storage is immutable, so the evicted level is invalidated to let the driver discard it
+        glBindTexture(victim->target, victim->texture);
+        setBaseLevel(*victim, victim->residentLevel + 1);
+        glBindTexture(victim->target, 0);
+        glInvalidateTexImage(victim->texture, victim->residentLevel);
+
+        stats.residentBytes -= levelBytes(*victim, victim->residentLevel);
+        stats.levelsEvicted++;
+        victim->residentLevel++;
+    }
+
+    return true;
+}
+
+// Hand out space for a level from the staging ring, wrapping to the front when the end has no room
+// Levels retire in the order they were reserved, so the free space runs from the head to the oldest level in flight
+bool TextureStreamer::reserveStaging(size_t bytes, size_t& offset)
+{
+    // Keep every upload 16 byte aligned within the ring
+    size_t alignedBytes = (bytes + 15) / 16 * 16;
+
+    if (uploads.empty())
+        stagingHead = 0;
+
+    size_t tail = uploads.empty() ? stagingSize : uploads.front().stagingOffset;
+
+    if (!uploads.empty() && stagingHead < tail)
+    {
+        // The used space wraps: only the gap up to the oldest level is free
+        if (stagingHead + alignedBytes >= tail)
+            return false;
+    }
+    else if (stagingHead + alignedBytes > stagingSize)
+    {
+        // Not enough room before the end; wrap when the front has room, leaving the head short of the oldest level
+        if (uploads.empty() || alignedBytes >= tail)
+            return false;
+
+        stagingHead = 0;
+    }
+
+    offset = stagingHead;
+    stagingHead += alignedBytes;
+
+    return true;
+}
+
+// Create a persistently mapped staging buffer the background job writes levels into
+bool TextureStreamer::createStaging(size_t size)
+{
+    destroyStaging();
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glGenBuffers(1, &stagingBuffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, NULL, flags);
+    stagingData = (uint8_t*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    stagingSize = stagingData != nullptr ? size : 0;
+    stagingHead = 0;
+
+    return stagingData != nullptr;
+}
+
+// Unmap and release the staging buffer
+void TextureStreamer::destroyStaging()
+{
+    if (stagingBuffer != 0)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &stagingBuffer);
+    }
+
+    stagingBuffer = 0;
+    stagingData = nullptr;
+    stagingSize = 0;
+}
+
+// Size of one level with every array layer in bytes
+size_t TextureStreamer::levelBytes(const StreamedTexture& texture, int level) const
+{
+    return texture.data.levels[level].size;
+}
+
+// Start of one level in the texture's source data
+const uint8_t* TextureStreamer::levelData(const StreamedTexture& texture, int level) const
+{
+    const uint8_t* data = texture.data.mapped != nullptr ? texture.data.mapped : texture.data.data.data();
+
+    return data + texture.data.levels[level].offset;
+}
\ No newline at end of file
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vector>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "ThreadPool.h"
+
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+using namespace std;
+
+// One mip level of a streamed texture; each level holds every array layer back to back
+struct StreamedLevel {
+    int width;
+    int height;
+    size_t offset; // Offset of the level in the texture data in bytes
+    size_t size;   // Size of the level in bytes
+};
+
+// The whole mip chain of a texture in the format it is sampled in, kept in system memory as the streaming source
+struct StreamedTextureData {
+    GLenum internalFormat;
+    bool compressed;    // Block compressed levels; otherwise R8 gray, RG8 gray and alpha, RGB8, RGB565, or RGBA8 texels
+    int width;
+    int height;
+    int layers;         // Number of array layers, or 0 for a texture that is not an array
+    vector<StreamedLevel> levels;
+    vector<uint8_t> data;
+    const uint8_t* mapped = nullptr; // Level data owned elsewhere, such as a mapped asset archive, used in place of data
+};
+
+// Residency and streaming counters of the texture streamer
+struct TextureStreamerCounters {
+    size_t allocatedBytes = 0;      // Storage allocated for every level of every texture
+    size_t residentBytes = 0;       // Bytes of the levels that are currently uploaded and sampled
+    size_t peakResidentBytes = 0;
+    size_t streamedBytes = 0;       // Bytes uploaded by streaming after the initial tail levels
+    unsigned long levelsStreamed = 0;
+    unsigned long levelsEvicted = 0;
+    unsigned long budgetStalls = 0; // Frames a wanted level could not be streamed because nothing could be evicted
+    double uploadMilliseconds = 0.0; // Time with levels on their way through the staging ring, for the upload throughput
+};
+
+class TextureStreamer {
+public:
+    bool create(size_t budgetBytes, size_t stagingBytes = 32 * 1024 * 1024);
+    void destroy();
+    GLuint add(StreamedTextureData&& data, int wrapType);
+    void request(GLuint texture, float screenPixels);
+    void update();
+    void clampLevelsInShader(bool enable);
+    int residentLevel(GLuint texture);
+    const TextureStreamerCounters& counters() const;
+
+private:
+    // A texture with full immutable storage of which only the levels from residentLevel down are uploaded
+    struct StreamedTexture {
+        GLuint texture;
+        GLenum target;
+        StreamedTextureData data;
+        int residentLevel;          // Finest uploaded level; the texture's base level
+        int tailLevel;              // Finest of the small levels that are uploaded up front and never evicted
+        int wantedLevel;            // Finest level asked for during the last frame
+        unsigned long lastUsedFrame = 0;
+        bool streaming = false;     // A level is on its way through the staging buffer
+    };
+
+    // A level copied into the staging buffer by the background job and uploaded from it by the render thread
+    struct StreamUpload {
+        StreamedTexture* texture;
+        int level;
+        size_t stagingOffset;
+        atomic<bool> copied{ false };
+        bool issued = false;
+        GLsync fence = nullptr;
+    };
+
+    void uploadLevel(const StreamedTexture& texture, int level, const void* pixels);
+    void startUploads();
+    bool evictFor(size_t bytes, const StreamedTexture* requester);
+    bool reserveStaging(size_t bytes, size_t& offset);
+    bool createStaging(size_t size);
+    void destroyStaging();
+    void setBaseLevel(const StreamedTexture& texture, int level);
+    void pixelLayout(GLenum internalFormat, GLenum& format, GLenum& type, GLint* swizzle) const;
+    size_t levelBytes(const StreamedTexture& texture, int level) const;
+    const uint8_t* levelData(const StreamedTexture& texture, int level) const;
+
+    list<unique_ptr<StreamedTexture>> textures;
+    map<GLuint, StreamedTexture*> texturesByName;
+    list<StreamUpload> uploads;
+    mutex texturesMutex;
+    unique_ptr<ThreadPool> copyPool;
+    GLuint stagingBuffer = 0;
+    uint8_t* stagingData = nullptr;
+    size_t stagingSize = 0;
+    size_t stagingHead = 0;     // Where the next level is copied; the oldest level in flight marks the end of the free space
+    chrono::steady_clock::time_point lastUpdate;
+    size_t budget = 0;
+    unsigned long frame = 1;
+    bool shaderLevelClamp = false; // The base level stays at zero and shaders clamp sampling to the resident level instead
+    TextureStreamerCounters stats;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include "ThreadPool.h"
+
+#include <algorithm>    // max
+
+// Start the worker threads; a thread count of zero uses one thread per hardware thread
+ThreadPool::ThreadPool(unsigned threadCount)
+{
+    if (threadCount == 0)
+        threadCount = max(thread::hardware_concurrency(), 1u);
+
+    for (unsigned i = 0; i < threadCount; i++)
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+// Finish every queued job, then stop the worker threads
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock(jobsMutex);
+        stopping = true;
+    }
+
+    jobAvailable.notify_all();
+
+    for (thread& worker : workers)
+        worker.join();
+}
+
+// Queue a job to run on the next free worker thread
+void ThreadPool::submit(function<void()> job)
+{
+    {
+        lock_guard<mutex> lock(jobsMutex);
+        jobs.push(move(job));
+    }
+
+    jobAvailable.notify_one();
+}
+
+// Block until every submitted job has finished
+void ThreadPool::wait()
+{
+    unique_lock<mutex> lock(jobsMutex);
+    jobsDone.wait(lock, [this] { return jobs.empty() && activeJobs == 0; });
+}
+
+// Number of worker threads
+unsigned ThreadPool::size() const
+{
+    return (unsigned)workers.size();
+}
+
+// Run queued jobs until the pool is stopping and the queue is empty
+void ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        function<void()> job;
+
+        {
+            unique_lock<mutex> lock(jobsMutex);
+            jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+            if (jobs.empty())
+                return;
+
+            job = move(jobs.front());
+            jobs.pop();
+            activeJobs++;
+        }
+
+        job();
+
+        {
+            lock_guard<mutex> lock(jobsMutex);
+            activeJobs--;
+        }
+
+        jobsDone.notify_all();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+using namespace std;
+
+class ThreadPool {
+public:
+    ThreadPool(unsigned threadCount = 0);
+    ~ThreadPool();
+    void submit(function<void()> job);
+    void wait();
+    unsigned size() const;
+
+private:
+    void workerLoop();
+
+    vector<thread> workers;
+    queue<function<void()>> jobs;
+    mutex jobsMutex;
+    condition_variable jobAvailable;
+    condition_variable jobsDone;
+    size_t activeJobs = 0;
+    bool stopping = false;
+};
+
+#endif
\ No newline at end of file
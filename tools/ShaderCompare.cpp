@@ -0,0 +1,392 @@
+// Offscreen comparison of the object shaders of two versions of FinalProject.cpp
+// Draws the same field of randomly oriented, textured triangles lit by the three windows with the object shaders of the version
+// before the per-fragment light loop and of the current version, then counts the 8-bit channels that differ and times both
+//
+// Needs an EGL driver that can make a surfaceless OpenGL 4.4 core context, such as Mesa's llvmpipe; it is not part of the
+// Visual Studio project. Build and run from the repository root:
+//     g++ -std=c++14 -O2 tools/ShaderCompare.cpp -o ShaderCompare -lEGL -lGL
+//     git show <commit before the light loop>:FinalProject.cpp > OldFinalProject.cpp
+//     ./ShaderCompare OldFinalProject.cpp FinalProject.cpp
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#define GL_GLEXT_PROTOTYPES
+#include <GL/glcorearb.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+using namespace std;
+
+// Framebuffer size and the number of timed frames
+const int WIDTH = 1280;
+const int HEIGHT = 720;
+const int TIMED_FRAMES = 15;
+
+// Grid of quads the triangles are made from
+const int GRID_SIZE = 48;
+
+// Per-frame data of the old object shaders, matching their std140 FrameData block with each window in its own members
+struct OldFrameUniforms
+{
+    float view[16];
+    float projection[16];
+    float viewPosition[3];
+    float ambStren;
+    float lightPosBack[3];
+    float lightIntenBack;
+    float lightColorBack[3];
+    float specSize;
+    float lightPosLeft[3];
+    float lightIntenLeft;
+    float lightColorLeft[3];
+    float padding0;
+    float lightPosRight[3];
+    float lightIntenRight;
+    float lightColorRight[3];
+    float padding1;
+};
+
+// Per-frame data of the current object shaders, matching the FrameUniforms struct of FinalProject.cpp
+struct FrameUniforms
+{
+    float view[16];
+    float projection[16];
+    float viewPosition[3];
+    float specSize;
+    float ambientColor[3];
+    float padding0;
+    unsigned int clusterCounts[4];
+    float clusterParams[4];
+    float windowPositions[3][4];
+    float windowColors[3][4];
+};
+
+// Per-draw data matching the DrawUniforms struct of FinalProject.cpp; the old shaders read only the members before lightmapRegion
+struct DrawUniforms
+{
+    float model[16];
+    float uvScale[2];
+    float specInten;
+    int materialId;
+    float uvRegion[4];
+    float lightmapRegion[4];
+    int firstTextureLayer;
+    int padding[3];
+};
+
+// Returns the source of a shader declared with the GLSL or GLSL_PART macros in a FinalProject.cpp, or an empty string
+// Comments are left in place; the compiler skips them the same way the macros drop them
+string UExtractShader(const string& file, const string& name)
+{
+    size_t start = file.find("const GLchar* " + name + " = ");
+
+    if (start == string::npos)
+        return "";
+
+    size_t bodyStart = file.find('(', start) + 1;
+    bool hasVersion = file.compare(bodyStart, 4, "440,") == 0;
+
+    if (hasVersion)
+        bodyStart += 4;
+
+    size_t bodyEnd = file.find("\n);", bodyStart);
+
+    return (hasVersion ? "#version 440 core\n" : "") + file.substr(bodyStart, bodyEnd - bodyStart) + "\n";
+}
+
+// Insert lines of defines after the #version line of a shader source
+string UInsertShaderLines(const string& source, const string& lines)
+{
+    size_t lineEnd = source.find('\n');
+
+    return source.substr(0, lineEnd + 1) + lines + source.substr(lineEnd + 1);
+}
+
+GLuint UCompileShader(GLenum type, const string& source)
+{
+    GLuint shader = glCreateShader(type);
+    const char* text = source.c_str();
+    GLint success;
+
+    glShaderSource(shader, 1, &text, NULL);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+
+    if (!success)
+    {
+        char infoLog[4096];
+        glGetShaderInfoLog(shader, sizeof(infoLog), NULL, infoLog);
+        cout << "ERROR: Shader compilation failed\n" << infoLog << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    return shader;
+}
+
+GLuint UCreateProgram(const string& vertexSource, const string& fragmentSource)
+{
+    GLuint program = glCreateProgram();
+    GLint success;
+
+    glAttachShader(program, UCompileShader(GL_VERTEX_SHADER, vertexSource));
+    glAttachShader(program, UCompileShader(GL_FRAGMENT_SHADER, fragmentSource));
+    glLinkProgram(program);
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+
+    if (!success)
+    {
+        char infoLog[4096];
+        glGetProgramInfoLog(program, sizeof(infoLog), NULL, infoLog);
+        cout << "ERROR: Shader program linking failed\n" << infoLog << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    return program;
+}
+
+// Draw the triangles once into the pixels, then time a number of frames; returns milliseconds per frame
+double UDrawFrames(GLuint program, GLsizei vertexCount, vector<unsigned char>& pixels)
+{
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "uTexture"), 0);
+    glUniform1i(glGetUniformLocation(program, "uTextureArray"), 1);
+    glUniform1i(glGetUniformLocation(program, "uLightmap"), 2);
+
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+    glFinish();
+
+    pixels.resize((size_t)WIDTH * HEIGHT * 4);
+    glReadPixels(0, 0, WIDTH, HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+    auto start = chrono::steady_clock::now();
+
+    for (int frame = 0; frame < TIMED_FRAMES; frame++)
+        glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+
+    glFinish();
+
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / TIMED_FRAMES;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        cout << "Usage: ShaderCompare <old FinalProject.cpp> <new FinalProject.cpp>" << endl;
+        return EXIT_FAILURE;
+    }
+
+    string files[2];
+
+    for (int i = 0; i < 2; i++)
+    {
+        ifstream input(argv[i + 1]);
+        stringstream contents;
+        contents << input.rdbuf();
+        files[i] = contents.str();
+
+        if (files[i].empty())
+        {
+            cout << "ERROR: Failed to read " << argv[i + 1] << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Surfaceless context; the default display works on most drivers, Mesa's surfaceless platform on the rest
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    if (!eglInitialize(display, NULL, NULL))
+    {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        eglInitialize(display, NULL, NULL);
+    }
+
+    eglBindAPI(EGL_OPENGL_API);
+
+    EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+    EGLint contextAttributes[] = { EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 4, EGL_CONTEXT_OPENGL_PROFILE_MASK,
+        EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE };
+    EGLConfig config;
+    EGLint configCount = 0;
+
+    eglChooseConfig(display, configAttributes, &config, 1, &configCount);
+    EGLContext context = eglCreateContext(display, configCount > 0 ? config : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttributes);
+
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    {
+        cout << "ERROR: Failed to create an OpenGL 4.4 context" << endl;
+        return EXIT_FAILURE;
+    }
+
+    cout << "INFO: " << glGetString(GL_RENDERER) << ", " << glGetString(GL_VERSION) << endl;
+
+    // Quads of two triangles facing the camera at varying depths, each vertex with a random normal
+    // Vertex: Position (X, Y, Z) - Normal (nX, nY, nZ) - Texture Coordinate (tX, tY)
+    vector<float> vertices;
+    srand(1);
+
+    for (int y = 0; y < GRID_SIZE; y++)
+    {
+        for (int x = 0; x < GRID_SIZE; x++)
+        {
+            float size = 8.0f / GRID_SIZE, left = -4.0f + x * size, bottom = -2.25f + y * size * 0.5625f;
+            float corners[6][2] = { { left, bottom }, { left + size, bottom }, { left + size, bottom + size * 0.5625f },
+                { left, bottom }, { left + size, bottom + size * 0.5625f }, { left, bottom + size * 0.5625f } };
+
+            for (float* corner : corners)
+            {
+                float nX = rand() / (float)RAND_MAX - 0.5f, nY = rand() / (float)RAND_MAX - 0.5f, nZ = rand() / (float)RAND_MAX + 0.1f;
+                float length = sqrt(nX * nX + nY * nY + nZ * nZ);
+                float z = rand() / (float)RAND_MAX * 0.5f - 0.25f - (corner[1] + 2.25f) * 2.0f;
+                float vertex[8] = { corner[0], corner[1], z, nX / length, nY / length, nZ / length, (corner[0] + 4.0f) * 0.5f, (corner[1] + 2.0f) * 0.5f };
+
+                vertices.insert(vertices.end(), vertex, vertex + 8);
+            }
+        }
+    }
+
+    GLuint vao, vbo;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+
+    const GLint attributeSizes[3] = { 3, 3, 2 };
+    const size_t attributeOffsets[3] = { 0, 3, 6 };
+
+    for (GLuint location = 0; location < 3; location++)
+    {
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, attributeSizes[location], GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(attributeOffsets[location] * sizeof(float)));
+    }
+
+    // Attributes the meshes do not have: no texture array layers or decal, and no lightmap coordinate
+    glVertexAttrib2f(3, 0.0f, -1.0f);
+    glVertexAttrib2f(4, 0.0f, 0.0f);
+
+    // Noisy mipmapped texture so filtering and every texel's color show up in the comparison
+    vector<unsigned char> texels(256 * 256 * 4);
+
+    for (unsigned char& texel : texels)
+        texel = 128 + rand() % 128;
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 256, 256, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+    GLuint framebuffer, colorBuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, WIDTH, HEIGHT);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glViewport(0, 0, WIDTH, HEIGHT);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+    // The scene's window lights, and a camera looking down -Z from 6 units away
+    const float windowPositions[3][3] = { { 0.0f, 15.0f, -50.0f }, { -40.0f, 15.0f, -5.0f }, { 40.0f, 15.0f, -5.0f } };
+    const float windowColors[3][3] = { { 0.95f, 0.90f, 0.80f }, { 0.95f, 0.90f, 0.80f }, { 0.95f, 0.90f, 0.80f } };
+    const float windowIntensities[3] = { 0.9f, 0.9f, 0.9f };
+    const float ambientStrength = 0.12f, specularHighlightSize = 20.0f;
+
+    float view[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, -6, 1 };
+    float projection[16] = {};
+    float focal = 1.0f / tan(0.4f), nearPlane = 0.1f, farPlane = 100.0f;
+    projection[0] = focal * HEIGHT / WIDTH, projection[5] = focal, projection[11] = -1.0f;
+    projection[10] = (farPlane + nearPlane) / (nearPlane - farPlane), projection[14] = 2.0f * farPlane * nearPlane / (nearPlane - farPlane);
+
+    OldFrameUniforms oldFrame = {};
+    memcpy(oldFrame.view, view, sizeof(view)), memcpy(oldFrame.projection, projection, sizeof(projection));
+    oldFrame.viewPosition[2] = 6.0f, oldFrame.ambStren = ambientStrength, oldFrame.specSize = specularHighlightSize;
+    memcpy(oldFrame.lightPosBack, windowPositions[0], 12), memcpy(oldFrame.lightColorBack, windowColors[0], 12), oldFrame.lightIntenBack = windowIntensities[0];
+    memcpy(oldFrame.lightPosLeft, windowPositions[1], 12), memcpy(oldFrame.lightColorLeft, windowColors[1], 12), oldFrame.lightIntenLeft = windowIntensities[1];
+    memcpy(oldFrame.lightPosRight, windowPositions[2], 12), memcpy(oldFrame.lightColorRight, windowColors[2], 12), oldFrame.lightIntenRight = windowIntensities[2];
+
+    // The current shaders take every window's color times its intensity and the ambient light of all windows summed, as URender writes them
+    FrameUniforms frame = {};
+    memcpy(frame.view, view, sizeof(view)), memcpy(frame.projection, projection, sizeof(projection));
+    frame.viewPosition[2] = 6.0f, frame.specSize = specularHighlightSize;
+    frame.clusterCounts[0] = frame.clusterCounts[1] = frame.clusterCounts[2] = 1;
+    frame.clusterParams[0] = (float)WIDTH, frame.clusterParams[1] = (float)HEIGHT;
+
+    for (int i = 0; i < 3; i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            frame.windowPositions[i][c] = windowPositions[i][c];
+            frame.windowColors[i][c] = windowColors[i][c] * windowIntensities[i];
+            frame.ambientColor[c] += ambientStrength * frame.windowColors[i][c];
+        }
+
+        frame.windowPositions[i][3] = frame.windowColors[i][3] = 1.0f;
+    }
+
+    DrawUniforms draw = {};
+    draw.model[0] = draw.model[5] = draw.model[10] = draw.model[15] = 1.0f;
+    draw.uvScale[0] = draw.uvScale[1] = 1.0f, draw.specInten = 0.6f, draw.uvRegion[2] = draw.uvRegion[3] = 1.0f;
+
+    GLuint uniformBuffers[3];
+    glGenBuffers(3, uniformBuffers);
+    glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffers[0]);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(oldFrame), &oldFrame, GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffers[1]);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(frame), &frame, GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffers[2]);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(draw), &draw, GL_STATIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 1, uniformBuffers[2]);
+
+    // Variant defines of a textured, specular draw without texture arrays, decals, clustered lights, or a lightmap; versions
+    // without variants ignore them. The lighting source only exists in the versions that share it between render paths
+    string defines = "#define WINDOW_LIGHT_COUNT 3\n#define LIGHT_COUNT 3\n#define MAX_TEXTURE_LAYERS 16\n#define TEXTURE_ARRAY false\n"
+        "#define HAS_DECAL false\n#define HAS_SPECULAR true\n#define CLUSTERED_LIGHTS false\n#define GBUFFER_PASS false\n#define HAS_LIGHTMAP false\n";
+    vector<unsigned char> pixels[2];
+    double milliseconds[2];
+
+    for (int i = 0; i < 2; i++)
+    {
+        string vertexSource = UInsertShaderLines(UExtractShader(files[i], "objectVertexShaderSource"), defines);
+        string fragmentSource = UInsertShaderLines(UExtractShader(files[i], "objectFragmentShaderSource"), defines)
+            + UExtractShader(files[i], "lightingSource") + UExtractShader(files[i], "boundTextureSamplingSource");
+
+        // Versions before the light loop declare each window in its own FrameData members
+        bool oldLayout = UExtractShader(files[i], "objectFragmentShaderSource").find("lightIntenBack") != string::npos;
+        glBindBufferBase(GL_UNIFORM_BUFFER, 0, uniformBuffers[oldLayout ? 0 : 1]);
+
+        milliseconds[i] = UDrawFrames(UCreateProgram(vertexSource, fragmentSource), (GLsizei)(vertices.size() / 8), pixels[i]);
+    }
+
+    size_t differentChannels = 0;
+    int largestDifference = 0;
+
+    for (size_t channel = 0; channel < pixels[0].size(); channel++)
+    {
+        int difference = abs(pixels[0][channel] - pixels[1][channel]);
+        differentChannels += difference > 0;
+        largestDifference = max(largestDifference, difference);
+    }
+
+    cout << "INFO: " << differentChannels << " of " << pixels[0].size() << " channels differ, by at most " << largestDifference << endl;
+    cout << "INFO: Old shaders " << milliseconds[0] << " ms, new shaders " << milliseconds[1] << " ms per frame over " << TIMED_FRAMES
+        << " frames" << endl;
+
+    eglTerminate(display);
+
+    return differentChannels == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file